@@ -0,0 +1,67 @@
+/*
+  Stockfish, a OS X GUI for the UCI chess engine with the same name.
+  Copyright (C) 2004-2011 Marco Costalba, Joona Kiiski, Tord Romstad
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#import <Cocoa/Cocoa.h>
+
+#include "annotate.h"
+#include "uciinfo.h"
+
+@class ChessPosition;
+@class Engine;
+@class GameAnnotator;
+
+// An AnnotationWorker analyzes positions given to it by a GameAnnotator,
+// one at a time, with an engine process of its own. Positions in the
+// tablebases, positions without legal moves and positions analyzed deep
+// enough before, according to the analysis cache, are not searched.
+
+@interface AnnotationWorker : NSObject {
+  GameAnnotator *annotator;
+  Engine *engine;
+  BOOL configured;         // Threads and Hash have been set
+  BOOL changedOptions;     // ... to other values than the saved ones
+  ChessPosition *position; // The position being analyzed, or nil
+  BOOL frc;
+  int gameNumber, ply;
+  analysis_t analysis;
+  BOOL hasExactScore;
+}
+
+-(id)initWithAnnotator:(GameAnnotator *)anAnnotator engine:(NSString *)path;
+-(BOOL)isReady;
+-(BOOL)isAnalyzing;
+-(void)analyzePosition:(ChessPosition *)aPosition
+	       command:(NSString *)positionCommand
+		   FRC:(BOOL)isFRC
+		  game:(int)number
+		   ply:(int)aPly;
+-(BOOL)takeUnfinishedAnalysis:(analysis_t *)result
+			  game:(int *)number
+			   ply:(int *)aPly;
+-(void)stop;
+
+// Messages from the engine:
+-(ChessPosition *)currentPosition;
+-(void)setEngineName:(NSString *)newEngineName;
+-(void)setEngineIsReady:(BOOL)state;
+-(void)setInfo:(const uci_info_t *)info;
+-(void)bestmove:(NSString *)bestmove ponder:(NSString *)ponder;
+-(void)engineDidTerminate:(Engine *)anEngine;
+
+@end
@@ -0,0 +1,255 @@
+/*
+  Stockfish, a OS X GUI for the UCI chess engine with the same name.
+  Copyright (C) 2004-2011 Marco Costalba, Joona Kiiski, Tord Romstad
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#import "AnnotationWorker.h"
+#import "ChessMove.h"
+#import "ChessPosition.h"
+#import "Engine.h"
+#import "EnginePool.h"
+#import "GameAnnotator.h"
+#import "UCIOption.h"
+
+#include "analysiscache.h"
+#include "syzygy.h"
+
+
+@interface AnnotationWorker (PrivateAPI)
+-(void)setOptionName:(NSString *)optionName value:(NSString *)value;
+-(void)finishAnalysis;
+@end
+
+
+@implementation AnnotationWorker
+
+-(id)initWithAnnotator:(GameAnnotator *)anAnnotator engine:(NSString *)path {
+  self = [super init];
+  annotator = anAnnotator;
+  engine = [[[EnginePool sharedPool] engineWithController: self path: path]
+	     retain];
+  return self;
+}
+
+-(BOOL)isReady {
+  return configured;
+}
+
+-(BOOL)isAnalyzing {
+  return position != nil;
+}
+
+// Positions in the tablebases get the tablebase result, positions without
+// legal moves their result by the rules, and positions in the analysis
+// cache with an exact score at the search depth or deeper the cached
+// analysis, without a search. The
+// result is still reported later, from the run loop, so that the
+// annotator is never called back from inside its own call.
+
+-(void)analyzePosition:(ChessPosition *)aPosition
+	       command:(NSString *)positionCommand
+		   FRC:(BOOL)isFRC
+		  game:(int)number
+		   ply:(int)aPly {
+  analysis_cache_entry_t entry;
+  int wdl, dtz;
+
+  [aPosition retain];
+  [position release];
+  position = aPosition;
+  frc = isFRC;
+  gameNumber = number;
+  ply = aPly;
+  analysis.depth = 0;
+  analysis.score_type = UCI_SCORE_CP;
+  analysis.score = 0;
+  analysis.tablebase = false;
+  analysis.terminal = false;
+  analysis.move = NoMove;
+  hasExactScore = NO;
+
+  if([position isTerminal]) {
+    analysis.terminal = true;
+    if([position isMate])
+      analysis.score_type = UCI_SCORE_MATE;
+    [self performSelector: @selector(finishAnalysis)
+	  withObject: nil
+	  afterDelay: 0.0];
+    return;
+  }
+  if(tb_can_probe([position pos]) &&
+     tb_probe_root([position pos], &analysis.move, &wdl, &dtz)) {
+    analysis.tablebase = true;
+    analysis.score = wdl;
+    [self performSelector: @selector(finishAnalysis)
+	  withObject: nil
+	  afterDelay: 0.0];
+    return;
+  }
+  if([annotator searchDepth] > 0 &&
+     analysis_cache_probe([position pos]->key, &entry) &&
+     entry.depth >= [annotator searchDepth] && entry.bound == 0 &&
+     entry.pv_length > 0 && move_is_legal([position pos], entry.pv[0])) {
+    analysis.depth = entry.depth;
+    analysis.score_type = entry.score_type;
+    analysis.score = entry.score;
+    analysis.move = entry.pv[0];
+    [self performSelector: @selector(finishAnalysis)
+	  withObject: nil
+	  afterDelay: 0.0];
+    return;
+  }
+
+  [engine setOptionName: @"Ponder" value: @"false"];
+  [engine setOptionName: @"OwnBook" value: @"false"];
+  [engine setOptionName: @"UCI_AnalyseMode" value: @"true"];
+  [engine setOptionName: @"MultiPV" value: @"1"];
+  [engine setOptionName: @"UCI_LimitStrength" value: @"false"];
+  [engine setOptionName: @"UCI_Chess960" value: frc? @"true" : @"false"];
+  [engine setPosition: positionCommand];
+  [engine searchWithDepth: [annotator searchDepth]
+	  nodes: [annotator searchNodes]];
+}
+
+// Hands over the analysis of a position whose search can't be finished,
+// as far as it got, and forgets the position. Returns NO if the worker
+// isn't analyzing anything.
+
+-(BOOL)takeUnfinishedAnalysis:(analysis_t *)result
+			  game:(int *)number
+			   ply:(int *)aPly {
+  if(position == nil) return NO;
+  *result = analysis;
+  *number = gameNumber;
+  *aPly = ply;
+  [position release];
+  position = nil;
+  return YES;
+}
+
+// An engine with other Threads or Hash values than the saved ones can't
+// be reused by the rest of the GUI, so it is quit rather than recycled.
+
+-(void)stop {
+  [position release];
+  position = nil;
+  if(changedOptions) {
+    [engine setController: nil];
+    [engine quit];
+  }
+  else
+    [[EnginePool sharedPool] recycleEngine: engine];
+  [engine release];
+  engine = nil;
+}
+
+-(ChessPosition *)currentPosition {
+  return position;
+}
+
+-(void)setEngineName:(NSString *)newEngineName {
+}
+
+// The engine is configured when it is first ready, after it has reported
+// its options.
+
+-(void)setEngineIsReady:(BOOL)state {
+  if(!state || configured || engine == nil) return;
+  [self setOptionName: @"Threads"
+	value: [NSString stringWithFormat: @"%d", [annotator engineThreads]]];
+  [self setOptionName: @"Hash"
+	value: [NSString stringWithFormat: @"%d", [annotator engineHash]]];
+  configured = YES;
+  [annotator workerIsReady: self];
+}
+
+// Bounded scores only replace earlier bounded scores, so that a fail high
+// or low at the last depth doesn't hide the exact score before it.
+
+-(void)setInfo:(const uci_info_t *)info {
+  if(position == nil) return;
+  if((info->fields & UCI_INFO_MULTIPV) && info->multipv > 1) return;
+  if(info->fields & UCI_INFO_SCORE) {
+    if(info->bound == 0 || !hasExactScore) {
+      analysis.score_type = info->score_type;
+      analysis.score = info->score;
+      if(info->fields & UCI_INFO_DEPTH)
+	analysis.depth = info->depth;
+      if(info->bound == 0) hasExactScore = YES;
+    }
+  }
+  if((info->fields & UCI_INFO_PV) && info->pv_length > 0)
+    analysis.move = info->pv[0];
+  if((info->fields & (UCI_INFO_DEPTH | UCI_INFO_SCORE | UCI_INFO_PV)) ==
+     (UCI_INFO_DEPTH | UCI_INFO_SCORE | UCI_INFO_PV))
+    analysis_cache_store([position pos]->key, info->depth, info->score_type,
+			 info->score, info->bound, info->pv, info->pv_length);
+}
+
+-(void)bestmove:(NSString *)bestmove ponder:(NSString *)ponder {
+  ChessMove *move;
+
+  if(position == nil) return;
+  move = [position parseCoordinateMove: bestmove];
+  if(![move isNullMove] && [move move] != NoMove)
+    analysis.move = [move move];
+  if(analysis.depth == 0) analysis.depth = 1;
+  [self finishAnalysis];
+}
+
+// A worker whose engine crashed takes no more work. The annotator takes
+// over what it was doing.
+
+-(void)engineDidTerminate:(Engine *)anEngine {
+  if(anEngine != engine) return;
+  [engine setController: nil];
+  [engine release];
+  engine = nil;
+  configured = NO;
+  [annotator workerDidTerminate: self];
+}
+
+-(void)dealloc {
+  [self stop];
+  [super dealloc];
+}
+
+@end
+
+
+@implementation AnnotationWorker (PrivateAPI)
+
+-(void)setOptionName:(NSString *)optionName value:(NSString *)value {
+  UCIOption *option = [engine optionWithName: optionName];
+
+  if(option == nil || [[option value] isEqualToString: value]) return;
+  [engine setOptionName: optionName value: value];
+  changedOptions = YES;
+}
+
+// Does nothing if the worker was stopped in the meantime.
+
+-(void)finishAnalysis {
+  analysis_t result = analysis;
+
+  if(position == nil) return;
+  [position release];
+  position = nil;
+  [annotator worker: self analyzed: &result game: gameNumber ply: ply];
+}
+
+@end
@@ -21,6 +21,7 @@
 
 @class BoardController;
 @class PreferencesController;
+@class RootSplitController;
 @class UninstallWindowController;
 
 @interface AppController : NSObject {
@@ -30,6 +31,7 @@
   NSString *mainEngineName;
   PreferencesController *preferencesController;
   UninstallWindowController *uninstallWindowController;
+  RootSplitController *rootSplitController;
 }
 
 -(id)boardController;
@@ -38,11 +40,16 @@
 -(IBAction)copyGame:(id)sender;
 -(IBAction)paste:(id)sender;
 -(IBAction)openGameFile:(id)sender;
+-(IBAction)openGameDatabase:(id)sender;
+-(IBAction)removeDuplicateGames:(id)sender;
+-(IBAction)exportTrainingData:(id)sender;
+-(IBAction)annotateGames:(id)sender;
 -(IBAction)selectEngine:(id)sender;
 -(IBAction)computerPlaysBlack:(id)sender;
 -(IBAction)computerPlaysWhite:(id)sender;
 -(IBAction)youPlayBoth:(id)sender;
 -(IBAction)analysisMode:(id)sender;
+-(IBAction)splitAnalysis:(id)sender;
 -(void)waitForEngineExit:(id)engine;
 -(void)installEngineWithPath:(NSString *)path;
 -(IBAction)installNewUCIEngine:(id)sender;
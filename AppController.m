@@ -19,13 +19,22 @@
 
 #import "AppController.h"
 #import "BoardController.h"
+#import "DuplicateGameFinder.h"
 #import "Engine.h"
+#import "EnginePool.h"
 #import "EngineConfigController.h"
 #import "Game.h"
+#import "GameAnnotator.h"
 #import "GameListController.h"
+#import "PGNDatabase.h"
 #import "PreferencesController.h"
+#import "RootSplitController.h"
+#import "TrainingDataExporter.h"
 #import "UninstallWindowController.h"
 
+#include "analysiscache.h"
+#include "syzygy.h"
+
 
 static BOOL this_mac_runs_leopard(void) {
   NSString *versionPlistPath = @"/System/Library/CoreServices/SystemVersion.plist";
@@ -36,6 +45,16 @@ static BOOL this_mac_runs_leopard(void) {
 }
 
 
+// private methods:
+
+@interface AppController (PrivateAPI)
+-(void)addMenuItemWithTitle:(NSString *)title
+		     action:(SEL)action
+		     toMenu:(NSString *)menuTitle
+		 afterItem:(NSString *)itemTitle;
+@end
+
+
 @implementation AppController
 
 // static NSMutableDictionary *installedEngines;
@@ -89,6 +108,73 @@ static BOOL this_mac_runs_leopard(void) {
 
   [defaultValues setObject: [NSNumber numberWithBool: NO]
 		 forKey: @"Beep when Making Moves"];
+
+  [defaultValues setObject: [NSNumber numberWithInt: 1]
+		 forKey: @"Training Data Shards"];
+  [defaultValues setObject: [NSNumber numberWithInt: 1]
+		 forKey: @"Training Data Position Interval"];
+  [defaultValues setObject: [NSNumber numberWithBool: YES]
+		 forKey: @"Remove Duplicate Training Positions"];
+
+  [defaultValues setObject: [NSNumber numberWithBool: YES]
+		 forKey: @"Run Engine Matches in the Background"];
+  [defaultValues setObject: [NSNumber numberWithInt: 0]
+		 forKey: @"Parallel Engine Match Games"];
+  [defaultValues setObject: [NSNumber numberWithBool: NO]
+		 forKey: @"Stop Engine Matches by SPRT"];
+  [defaultValues setObject: [NSNumber numberWithDouble: 0.0]
+		 forKey: @"SPRT Elo0"];
+  [defaultValues setObject: [NSNumber numberWithDouble: 5.0]
+		 forKey: @"SPRT Elo1"];
+  [defaultValues setObject: [NSNumber numberWithDouble: 0.05]
+		 forKey: @"SPRT Alpha"];
+  [defaultValues setObject: [NSNumber numberWithDouble: 0.05]
+		 forKey: @"SPRT Beta"];
+  [defaultValues setObject: [NSNumber numberWithBool: YES]
+		 forKey: @"Adjudicate Engine Matches"];
+  [defaultValues setObject: [NSNumber numberWithBool: YES]
+		 forKey: @"Adjudicate Engine Matches by Tablebases"];
+  [defaultValues setObject: @"" forKey: @"Syzygy Path"];
+  [defaultValues setObject: [NSNumber numberWithInt: 4]
+		 forKey: @"Idle Engine Processes"];
+  [defaultValues setObject: [NSNumber numberWithInt: 40]
+		 forKey: @"Adjudication Draw Move Number"];
+  [defaultValues setObject: [NSNumber numberWithInt: 8]
+		 forKey: @"Adjudication Draw Moves"];
+  [defaultValues setObject: [NSNumber numberWithInt: 10]
+		 forKey: @"Adjudication Draw Score"];
+  [defaultValues setObject: [NSNumber numberWithInt: 4]
+		 forKey: @"Adjudication Win Moves"];
+  [defaultValues setObject: [NSNumber numberWithInt: 1000]
+		 forKey: @"Adjudication Win Score"];
+  [defaultValues setObject: [NSNumber numberWithInt: 32]
+		 forKey: @"Analysis Cache Size"];
+  [defaultValues setObject: [NSNumber numberWithInt: 1]
+		 forKey: @"Analysis Lines"];
+  [defaultValues setObject: [NSNumber numberWithInt: 18]
+		 forKey: @"Annotation Depth"];
+  [defaultValues setObject: [NSNumber numberWithInt: 0]
+		 forKey: @"Annotation Nodes"];
+  [defaultValues setObject: [NSNumber numberWithInt: 1]
+		 forKey: @"Annotation Engine Threads"];
+  [defaultValues setObject: [NSNumber numberWithInt: 64]
+		 forKey: @"Annotation Engine Hash"];
+  [defaultValues setObject: [NSNumber numberWithInt: 0]
+		 forKey: @"Annotation Engine Processes"];
+  [defaultValues setObject: [NSNumber numberWithInt: 50]
+		 forKey: @"Annotation Inaccuracy Limit"];
+  [defaultValues setObject: [NSNumber numberWithInt: 100]
+		 forKey: @"Annotation Mistake Limit"];
+  [defaultValues setObject: [NSNumber numberWithInt: 300]
+		 forKey: @"Annotation Blunder Limit"];
+  [defaultValues setObject: [NSNumber numberWithInt: 0]
+		 forKey: @"Split Analysis Depth"];
+  [defaultValues setObject: [NSNumber numberWithInt: 0]
+		 forKey: @"Split Analysis Engines"];
+  [defaultValues setObject: [NSNumber numberWithInt: 1]
+		 forKey: @"Split Analysis Engine Threads"];
+  [defaultValues setObject: [NSNumber numberWithInt: 64]
+		 forKey: @"Split Analysis Engine Hash"];
   
   [[NSUserDefaults standardUserDefaults] registerDefaults: defaultValues];
   [defaultInstalledEngines release];
@@ -127,6 +213,27 @@ static BOOL this_mac_runs_leopard(void) {
   }
 }
 
+-(void)addMenuItemWithTitle:(NSString *)title
+		     action:(SEL)action
+		     toMenu:(NSString *)menuTitle
+		 afterItem:(NSString *)itemTitle {
+  NSMenu *menu = [[[NSApp mainMenu] itemWithTitle: menuTitle] submenu];
+  NSMenuItem *item;
+  int index;
+
+  if(menu == nil) return;
+  index = [menu indexOfItemWithTitle: itemTitle];
+  item = [[NSMenuItem alloc] initWithTitle: title
+			     action: action
+			     keyEquivalent: @""];
+  [item setTarget: self];
+  if(index >= 0)
+    [menu insertItem: item atIndex: index + 1];
+  else
+    [menu addItem: item];
+  [item release];
+}
+
 -(void)awakeFromNib {
   [self updateEnginesMenu];
   [NSApp setDelegate: self];
@@ -134,7 +241,7 @@ static BOOL this_mac_runs_leopard(void) {
 
 -(IBAction)openGameFile:(id)sender {
   NSOpenPanel *panel = [NSOpenPanel openPanel];
-  NSArray *fileTypes = [NSArray arrayWithObjects: @"pgn", nil];
+  NSArray *fileTypes = [PGNDatabase pgnFileTypes];
   GameListController *glc;
   
   if([panel runModalForTypes: fileTypes] == NSOKButton) {
@@ -147,6 +254,185 @@ static BOOL this_mac_runs_leopard(void) {
   }
 }
 
+// Opens any number of PGN files and directories containing PGN files as a
+// single game list.
+
+-(IBAction)openGameDatabase:(id)sender {
+  NSOpenPanel *panel = [NSOpenPanel openPanel];
+  NSArray *fileTypes = [PGNDatabase pgnFileTypes];
+  NSMutableArray *filenames = [NSMutableArray array];
+  NSEnumerator *e;
+  NSString *path, *title;
+  GameListController *glc;
+
+  [panel setCanChooseDirectories: YES];
+  [panel setAllowsMultipleSelection: YES];
+  if([panel runModalForTypes: fileTypes] != NSOKButton) return;
+
+  e = [[panel filenames] objectEnumerator];
+  while((path = [e nextObject]) != nil)
+    [filenames addObjectsFromArray: [PGNDatabase pgnFilenamesAtPath: path]];
+  if([filenames count] == 0) {
+    NSRunAlertPanel(@"No PGN files found",
+		    @"The selected folders don't contain any PGN files.",
+		    nil, nil, nil);
+    return;
+  }
+  if([[panel filenames] count] == 1)
+    title = [[panel filenames] objectAtIndex: 0];
+  else
+    title = [NSString stringWithFormat: @"%d PGN files", (int)[filenames count]];
+
+  glc = [[GameListController alloc]
+	  initWithBoardController: boardController
+	  filenames: filenames
+	  title: title];
+  [gameListWindows addObject: glc];
+  [glc showWindow: self];
+  [glc release];  // Retained in gameListWindows
+}
+
+-(IBAction)removeDuplicateGames:(id)sender {
+  NSOpenPanel *openPanel = [NSOpenPanel openPanel];
+  NSSavePanel *savePanel = [NSSavePanel savePanel];
+  NSString *filename, *outputFilename;
+  DuplicateGameFinder *finder;
+
+  [openPanel setTitle: @"Remove Duplicate Games"];
+  if([openPanel runModalForTypes: [NSArray arrayWithObject: @"pgn"]]
+     != NSOKButton)
+    return;
+  filename = [openPanel filename];
+
+  [savePanel setTitle: @"Save Games Without Duplicates"];
+  [savePanel setRequiredFileType: @"pgn"];
+  if([savePanel runModalForDirectory:
+		  [filename stringByDeletingLastPathComponent]
+		file: [[[filename lastPathComponent]
+			 stringByDeletingPathExtension]
+			stringByAppendingString: @"-unique.pgn"]]
+     != NSOKButton)
+    return;
+  outputFilename = [savePanel filename];
+  if([outputFilename isEqualToString: filename]) {
+    NSRunAlertPanel(@"Remove Duplicate Games",
+		    @"The games without duplicates must be saved to a different file.",
+		    nil, nil, nil);
+    return;
+  }
+
+  finder = [[DuplicateGameFinder alloc] initWithFilename: filename
+					outputFilename: outputFilename];
+  [finder start];
+  [finder release]; // The finder releases itself when it is done
+}
+
+-(IBAction)exportTrainingData:(id)sender {
+  NSOpenPanel *openPanel = [NSOpenPanel openPanel];
+  NSSavePanel *savePanel = [NSSavePanel savePanel];
+  NSMutableArray *filenames = [NSMutableArray array];
+  NSEnumerator *e;
+  NSString *path;
+  TrainingDataExporter *exporter;
+
+  [openPanel setTitle: @"Export Training Data"];
+  [openPanel setCanChooseDirectories: YES];
+  [openPanel setAllowsMultipleSelection: YES];
+  if([openPanel runModalForTypes: [NSArray arrayWithObject: @"pgn"]]
+     != NSOKButton)
+    return;
+
+  // Compressed files can't be scanned in parallel, so only plain PGN files
+  // are exported:
+  e = [[openPanel filenames] objectEnumerator];
+  while((path = [e nextObject]) != nil) {
+    NSEnumerator *f = [[PGNDatabase pgnFilenamesAtPath: path] objectEnumerator];
+    NSString *filename;
+    while((filename = [f nextObject]) != nil)
+      if([[[filename pathExtension] lowercaseString] isEqualToString: @"pgn"])
+	[filenames addObject: filename];
+  }
+  if([filenames count] == 0) {
+    NSRunAlertPanel(@"No PGN files found",
+		    @"The selected folders don't contain any uncompressed PGN files.",
+		    nil, nil, nil);
+    return;
+  }
+
+  [savePanel setTitle: @"Save Training Data"];
+  [savePanel setRequiredFileType: @"bin"];
+  if([savePanel runModalForDirectory:
+		  [[filenames objectAtIndex: 0] stringByDeletingLastPathComponent]
+		file: @"training.bin"]
+     != NSOKButton)
+    return;
+
+  exporter = [[TrainingDataExporter alloc]
+	       initWithFilenames: filenames
+	       outputFilename: [savePanel filename]];
+  [exporter start];
+  [exporter release]; // The exporter releases itself when it is done
+}
+
+// Annotates the games in a PGN file with the selected engine. If the
+// output file exists, the annotation can be continued after the games in
+// it, from an earlier run which was stopped.
+
+-(IBAction)annotateGames:(id)sender {
+  NSOpenPanel *openPanel = [NSOpenPanel openPanel];
+  NSSavePanel *savePanel = [NSSavePanel savePanel];
+  NSString *filename, *outputFilename;
+  GameAnnotator *annotator;
+  BOOL resume = NO;
+
+  [openPanel setTitle: @"Annotate Games"];
+  if([openPanel runModalForTypes: [NSArray arrayWithObject: @"pgn"]]
+     != NSOKButton)
+    return;
+  filename = [openPanel filename];
+
+  [savePanel setTitle: @"Save Annotated Games"];
+  [savePanel setRequiredFileType: @"pgn"];
+  if([savePanel runModalForDirectory:
+		  [filename stringByDeletingLastPathComponent]
+		file: [[[filename lastPathComponent]
+			 stringByDeletingPathExtension]
+			stringByAppendingString: @"-annotated.pgn"]]
+     != NSOKButton)
+    return;
+  outputFilename = [savePanel filename];
+  if([outputFilename isEqualToString: filename]) {
+    NSRunAlertPanel(@"Annotate Games",
+		    @"The annotated games must be saved to a different file.",
+		    nil, nil, nil);
+    return;
+  }
+  if([[NSFileManager defaultManager] fileExistsAtPath: outputFilename]) {
+    int choice =
+      NSRunAlertPanel(@"Annotate Games",
+		      @"%@ already contains annotated games. Do you want to continue the annotation after them, or start over?",
+		      @"Continue", @"Start Over", @"Cancel",
+		      [outputFilename lastPathComponent]);
+    if(choice == NSAlertOtherReturn)
+      return;
+    resume = (choice == NSAlertDefaultReturn);
+  }
+
+  @try {
+    annotator = [[GameAnnotator alloc] initWithFilename: filename
+				       outputFilename: outputFilename
+				       engine: mainEngineName
+				       resume: resume];
+  }
+  @catch (NSException *e) {
+    NSRunAlertPanel(@"Error while annotating games", @"%@",
+		    nil, nil, nil, [e reason]);
+    return;
+  }
+  [annotator start];
+  [annotator release]; // The annotator releases itself when it is done
+}
+
 -(IBAction)selectEngine:(id)sender {
   [mainEngineName release];
   mainEngineName = [[NSString stringWithString: [sender title]] retain];
@@ -235,6 +521,20 @@ static BOOL this_mac_runs_leopard(void) {
   [boardController analysisMode: sender];
 }
 
+// Analyzes the current board position in a window of its own, with the
+// root moves split over several instances of the main engine. A new
+// split analysis replaces the previous one.
+
+-(IBAction)splitAnalysis:(id)sender {
+  Game *game = [boardController game];
+
+  [rootSplitController close];
+  [rootSplitController release];
+  rootSplitController =
+    [[RootSplitController alloc] initWithGame: game engine: mainEngineName];
+  [rootSplitController start];
+}
+
 -(void)waitForEngineExit:(id)engine {
   NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
   // NSMenuItem *item;
@@ -326,15 +626,57 @@ static BOOL this_mac_runs_leopard(void) {
 }
 
 -(void)applicationDidFinishLaunching:(NSNotification *)aNotification {
+  NSUserDefaults *defaults = [NSUserDefaults standardUserDefaults];
+  NSString *tablebasePath = [defaults stringForKey: @"Syzygy Path"];
+  NSString *cacheDirectory =
+    [[NSSearchPathForDirectoriesInDomains(NSApplicationSupportDirectory,
+					  NSUserDomainMask, YES)
+		     objectAtIndex: 0]
+      stringByAppendingPathComponent: @"Stockfish"];
+
+  if([tablebasePath length] > 0)
+    tb_init([[tablebasePath stringByExpandingTildeInPath] UTF8String]);
+  if([defaults integerForKey: @"Analysis Cache Size"] > 0 &&
+     ([[NSFileManager defaultManager] fileExistsAtPath: cacheDirectory] ||
+      [[NSFileManager defaultManager] createDirectoryAtPath: cacheDirectory
+				      attributes: nil]))
+    analysis_cache_init([[cacheDirectory stringByAppendingPathComponent:
+					   @"Analysis Cache"]
+			  fileSystemRepresentation],
+			[defaults integerForKey: @"Analysis Cache Size"]);
+  [self addMenuItemWithTitle: @"Open Game Database..."
+	action: @selector(openGameDatabase:)
+	toMenu: @"File"
+	afterItem: @"Open Game File..."];
+  [self addMenuItemWithTitle: @"Remove Duplicate Games..."
+	action: @selector(removeDuplicateGames:)
+	toMenu: @"File"
+	afterItem: @"Open Recent"];
+  [self addMenuItemWithTitle: @"Export Training Data..."
+	action: @selector(exportTrainingData:)
+	toMenu: @"File"
+	afterItem: @"Remove Duplicate Games..."];
+  [self addMenuItemWithTitle: @"Annotate Games..."
+	action: @selector(annotateGames:)
+	toMenu: @"File"
+	afterItem: @"Export Training Data..."];
+  [self addMenuItemWithTitle: @"Split Analysis"
+	action: @selector(splitAnalysis:)
+	toMenu: @"Game"
+	afterItem: @"Continuous Analysis"];
   [boardController raiseBoardWindow];
 }
 
 -(void)applicationWillTerminate:(NSNotification *)aNotification {
+  [rootSplitController close];
+  [[EnginePool sharedPool] quitIdleEngines];
+  analysis_cache_close();
 }
 
 -(void)dealloc {
   [gameListWindows release];
   [mainEngineName release];
+  [rootSplitController release];
   [super dealloc];
 }
 
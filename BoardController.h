@@ -18,6 +18,7 @@
 
 
 #import <Cocoa/Cocoa.h>
+#import "position.h"
 
 @class BoardView;
 @class Book;
@@ -28,6 +29,7 @@
 @class EngineController;
 @class Game;
 @class MatchController;
+@class MoveListController;
 @class NewEngineMatchController;
 @class SearchLogController;
 @class SetupR64WindowController;
@@ -67,6 +69,7 @@ enum {BLITZ_LEVEL, FISCHER_LEVEL, OLDFASHIONED_LEVEL, CUSTOM_LEVEL};
   CustomLevelController *customLevelController;
   EngineController *ec1, *ec2;
   SearchLogController *searchLogController;
+  MoveListController *moveListController;
   BOOL boardIsFlipped;
   int gameMode;  // COMPUTER_WHITE, COMPUTER_BLACK, BOTH, ANALYSIS or 
                  // ENGINE_MATCH
@@ -150,6 +153,9 @@ enum {BLITZ_LEVEL, FISCHER_LEVEL, OLDFASHIONED_LEVEL, CUSTOM_LEVEL};
 -(Game *)game;
 -(void)engineMadeMove:(ChessMove *)move comment:(NSString *)comment;
 -(void)engineResigns;
+-(int)adjudicateEngineMove;
+-(void)adjudicateMatchGameWithResult:(result_t)result
+			      reason:(NSString *)reason;
 -(IBAction)analysisMode:(id)sender;
 -(IBAction)computerPlaysBlack:(id)sender;
 -(IBAction)computerPlaysWhite:(id)sender;
@@ -159,6 +165,7 @@ enum {BLITZ_LEVEL, FISCHER_LEVEL, OLDFASHIONED_LEVEL, CUSTOM_LEVEL};
 -(BOOL)isAtBeginningOfGame;
 -(BOOL)isAtEndOfGame;
 -(void)displayMoveList;
+-(void)redisplayMoveList;
 -(void)switchMainEngineTo:(NSString *)newMainEngine;
 -(void)continueAutoplayWithEngine1White:(BOOL)engine1White
 		    enginesShouldPonder:(BOOL)shouldPonder;
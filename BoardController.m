@@ -29,11 +29,14 @@
 #import "EngineConfigController.h"
 #import "EngineController.h"
 #import "MatchController.h"
+#import "MoveListController.h"
 #import "NewEngineMatchController.h"
 #import "SearchLogController.h"
 #import "SetupR64WindowController.h"
 #import "UCIOption.h"
 
+#include "adjudicate.h"
+
 
 @implementation BoardController
 
@@ -165,8 +168,20 @@
 }
 
 -(void)displayMoveList {
-  [[moveListView textStorage] setAttributedString: 
-				[self moveListAttributedString]];
+  if(moveListController == nil)
+    moveListController =
+      [[MoveListController alloc] initWithTextView: moveListView];
+  [moveListController displayGame: game
+		      comments: displayComments
+		      variations: displayVariations];
+}
+
+// Redraws the whole move list. Needed after changing moves without going
+// through the Game object, like the comment window does.
+
+-(void)redisplayMoveList {
+  [moveListController invalidate];
+  [self displayMoveList];
 }
 
 -(void)animateMove:(ChessMove *)move {
@@ -250,6 +265,8 @@
 }
 
 -(void)engineMadeMove:(ChessMove *)move comment:(NSString *)comment {
+  int adjudication;
+
   //  NSLog(@"inEngineMadeMove:, move is %@", move);
   [self animateMove: move];
   [game makeMove: move];
@@ -266,6 +283,11 @@
     [self gameOver];
     [self displayMoveList];
   }
+  else if(gameMode == ENGINE_MATCH &&
+	  (adjudication = [self adjudicateEngineMove]) != ADJUDICATE_NONE)
+    [self adjudicateMatchGameWithResult: adjudication_result(adjudication)
+	  reason: [NSString stringWithUTF8String:
+			      adjudication_reason(adjudication)]];
   else { // Game not over!
     if(tournamentMode) {
       [[NSSound soundNamed: @"Glass"] play];
@@ -322,6 +344,42 @@
   }
 }
 
+// Lets the match controller judge the game by the score of the engine
+// which just moved.
+
+-(int)adjudicateEngineMove {
+  EngineController *ec =
+    ([game blackToMove] == ([ec1 role] == PLAYING_WHITE))? ec1 : ec2;
+  BOOL hasScore, isMate;
+  int score = 0;
+
+  isMate = NO;
+  hasScore = [ec takeSearchScore: &score isMate: &isMate];
+  return [engineMatchController adjudicateMoveInGame: game
+				hasScore: hasScore
+				score: score
+				isMate: isMate];
+}
+
+-(void)adjudicateMatchGameWithResult:(result_t)result
+			      reason:(NSString *)reason {
+  ChessMove *lastMove = [[game currentNode] move];
+
+  if(gameMode != ENGINE_MATCH) return;
+  [ec1 stopThinking];
+  [ec2 stopThinking];
+  [game setResult: result];
+  if(reason != nil && ![game isAtBeginningOfGame]) {
+    if([lastMove hasComment])
+      [game addComment: [NSString stringWithFormat: @"%@ %@",
+				  [lastMove comment], reason]];
+    else
+      [game addComment: reason];
+  }
+  [self displayMoveList];
+  [engineMatchController gameFinished: game];
+}
+
 -(void)displayPlayerNames {
   [playersTextField setStringValue: [NSString stringWithFormat: @"%@ - %@",
 					      [game whitePlayer],
@@ -1063,7 +1121,7 @@
 }
 
 -(void)switchMainEngineTo:(NSString *)newMainEngine {
-  [[ec1 engine] quit];
+  [ec1 recycleEngine];
   [ec1 close];
   [ec1 release];
   ec1 = [[EngineController alloc] 
@@ -1140,18 +1198,20 @@
 
   gameMode = BOTH;
   
-  [[ec1 engine] quit];
+  // Both engines go back to the pool before either is asked for, so that
+  // the engines of the last game are reused when the colours change.
+  [ec1 recycleEngine];
   [ec1 close];
   [ec1 release];
-  ec1 = [[EngineController alloc] 
-	  initWithBoardController: self name: whiteEngine];
-  [ec1 setRole: IDLE];
-  [ec1 showWindow: self];
   if(ec2) {
-    [[ec2 engine] quit];
+    [ec2 recycleEngine];
     [ec2 close];
     [ec2 release];
   }
+  ec1 = [[EngineController alloc] 
+	  initWithBoardController: self name: whiteEngine];
+  [ec1 setRole: IDLE];
+  [ec1 showWindow: self];
   ec2 = [[EngineController alloc] 
 	  initWithBoardController: self name: blackEngine];
   [ec2 setRole: IDLE];
@@ -1226,7 +1286,7 @@
 
 -(void)stopEngine2 {
   if(ec2) {
-    [[ec2 engine] quit];
+    [ec2 recycleEngine];
     [ec2 close];
     [ec2 release];
     ec2 = nil;
@@ -1297,6 +1357,7 @@
   if(ec2) [ec2 release];
   [engineConfigController release];
   [guiBook release];
+  [moveListController release];
   [super dealloc];
 }
 
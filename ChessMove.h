@@ -30,6 +30,8 @@
 }
 
 -(id)initWithPosition:(ChessPosition *)position move:(move_t)m;
+-(id)initWithMove:(move_t)m;
+-(void)setSANStringFromPosition:(ChessPosition *)position;
 -(move_t)move;
 -(BOOL)isNullMove;
 -(int)time;
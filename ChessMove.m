@@ -32,6 +32,25 @@
   time = 0;
   return self;
 }
+
+// Creates a move without its SAN string, which is expensive to compute. It
+// must be set with -setSANStringFromPosition: before it is used.
+
+-(id)initWithMove:(move_t)m {
+  [super init];
+  SANString = nil;
+  move = m;
+  time = 0;
+  return self;
+}
+
+-(void)setSANStringFromPosition:(ChessPosition *)position {
+  char str[10];
+  [SANString release];
+  SANString =
+    [[NSString stringWithUTF8String: san_string([position pos], move, str)]
+      retain];
+}
 	
 -(void)setTime:(int)t {
   time = t;
@@ -43,7 +43,7 @@
           [[textView string] 
             stringByTrimmingCharactersInSet:
               [NSCharacterSet whitespaceAndNewlineCharacterSet]]];
-  [boardController displayMoveList];
+  [boardController redisplayMoveList];
   [[self window] close];
 }
 
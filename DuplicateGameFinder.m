@@ -0,0 +1,125 @@
+/*
+  Stockfish, a OS X GUI for the UCI chess engine with the same name.
+  Copyright (C) 2004-2011 Marco Costalba, Joona Kiiski, Tord Romstad
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#import "DuplicateGameFinder.h"
+#import "PGNProgressController.h"
+
+#import <sys/stat.h>
+
+
+@interface DuplicateGameFinder (PrivateAPI)
+-(void)findDuplicates:(id)anObject;
+-(void)updateProgress:(NSTimer *)aTimer;
+-(void)finishedFindingDuplicates:(id)anObject;
+@end
+
+
+@implementation DuplicateGameFinder
+
+-(id)initWithFilename:(NSString *)aFilename
+       outputFilename:(NSString *)anOutputFilename {
+  struct stat fs;
+
+  self = [super init];
+  filename = [aFilename retain];
+  outputFilename = [anOutputFilename retain];
+  reportFilename =
+    [[[outputFilename stringByDeletingPathExtension]
+       stringByAppendingString: @"-duplicates.txt"] retain];
+  if(stat([filename fileSystemRepresentation], &fs) == 0)
+    fileSize = fs.st_size;
+  else
+    fileSize = 0.0;
+  return self;
+}
+
+-(void)start {
+  progressController =
+    [[PGNProgressController alloc] initWithFilename: filename];
+  [[progressController window]
+    setTitle: [NSString stringWithFormat: @"Finding duplicates in %@...",
+			[filename lastPathComponent]]];
+  [progressController showWindow: self];
+
+  // We stay alive until the search is finished:
+  [self retain];
+
+  timer = [[NSTimer scheduledTimerWithTimeInterval: 0.25
+		    target: self
+		    selector: @selector(updateProgress:)
+		    userInfo: nil
+		    repeats: YES]
+	    retain];
+  [NSThread detachNewThreadSelector: @selector(findDuplicates:)
+	    toTarget: self
+	    withObject: nil];
+}
+
+-(void)findDuplicates:(id)anObject {
+  NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+
+  result = pgn_dedup_file([filename fileSystemRepresentation],
+			  [outputFilename fileSystemRepresentation],
+			  [reportFilename fileSystemRepresentation],
+			  [NSTemporaryDirectory() fileSystemRepresentation],
+			  pgn_cpu_count(), &stats);
+  error = errno;
+  [self performSelectorOnMainThread: @selector(finishedFindingDuplicates:)
+	withObject: nil
+	waitUntilDone: NO];
+  [pool release];
+}
+
+-(void)updateProgress:(NSTimer *)aTimer {
+  if(fileSize > 0.0)
+    [progressController setDoubleValue: (stats.progress * 100.0) / fileSize];
+}
+
+-(void)finishedFindingDuplicates:(id)anObject {
+  [timer invalidate];
+  [timer release];
+  timer = nil;
+  [[progressController window] close];
+  [progressController release];
+  progressController = nil;
+
+  if(result != 0)
+    NSRunAlertPanel(@"Error while finding duplicate games", @"%s",
+		    nil, nil, nil, strerror(error));
+  else if(stats.duplicates == 0)
+    NSRunAlertPanel(@"No duplicate games found",
+		    @"None of the %ld games in %@ is a duplicate.",
+		    nil, nil, nil, stats.games, [filename lastPathComponent]);
+  else
+    NSRunAlertPanel(@"Duplicate games removed",
+		    @"Found %ld duplicates among %ld games. The remaining games were saved to %@, and a list of the duplicates to %@.",
+		    nil, nil, nil, stats.duplicates, stats.games,
+		    [outputFilename lastPathComponent],
+		    [reportFilename lastPathComponent]);
+  [self release];
+}
+
+-(void)dealloc {
+  [filename release];
+  [outputFilename release];
+  [reportFilename release];
+  [super dealloc];
+}
+
+@end
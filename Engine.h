@@ -19,13 +19,15 @@
 
 #import <Cocoa/Cocoa.h>
 
+#include "linebuf.h"
+#include "spscqueue.h"
+
 typedef enum {
   SCORE_LOWER_BOUND = -1,
   SCORE_EXACT = 0,
   SCORE_UPPER_BOUND = 1
 } ScoreType;
 
-@class EngineController;
 @class UCIOption;
 
 @interface Engine : NSObject {
@@ -36,13 +38,26 @@ typedef enum {
   NSMutableArray *options;
   NSTask *task;
   NSFileHandle *taskInput, *taskOutput, *taskError;
-  EngineController *controller;
-  char inputBuffer[16384];
-  char errorBuffer[1024];
-  NSMutableArray *commandQueue;
+  id controller;   // An EngineController, or anything answering the same
+                   // messages. A controller answering -engineDidTerminate:
+                   // is told when the engine process goes away.
+  line_buffer_t outputLines[1], errorLines[1];
+  spsc_queue_t outputQueue[1];     // Lines from the reader thread
+  volatile int32_t drainScheduled;
+  volatile int32_t queuedBestmoves;  // bestmove lines in outputQueue
+  BOOL processingOutput;
+  NSString **commandQueue;   // A ring of commands waiting to be sent
+  int queueHead, queueCount, queueCapacity;
+  NSMutableData *pendingOutput;
+  BOOL flushScheduled;
   BOOL thinking;
   BOOL isReady;
   BOOL installOnly;
+  BOOL discardBestmove;   // The search in progress was abandoned
+  // The engine was started from a cached handshake, and the options it
+  // reports are collected in handshakeOptions to check the cache:
+  BOOL verifyingHandshake;
+  NSMutableArray *handshakeOptions;
 }
 
 +(NSString *)mainEnginePath;
@@ -55,13 +70,17 @@ typedef enum {
 +(BOOL)useOwnBookForEngineWithName:(NSString *)name;
 +(BOOL)useGUIBookForEngineWithName:(NSString *)name;
 +(void)uninstallEngineWithName:(NSString *)name;
--(id)initWithController:(EngineController *)ec path:(NSString *)p
+-(id)initWithController:(id)ec path:(NSString *)p
 	    installOnly:(BOOL)instOnly;
--(id)initWithController:(EngineController *)ec path:(NSString *)p;
--(id)initWithController:(EngineController *)ec;
+-(id)initWithController:(id)ec path:(NSString *)p;
+-(id)initWithController:(id)ec;
 -(NSString *)name;
 -(NSString *)author;
+-(NSString *)path;
 -(NSTask *)task;
+-(BOOL)isRunning;
+-(void)setController:(id)ec;
+-(void)abandonSearch;
 -(void)saveOptions;
 -(void)loadOptions;
 -(NSMutableArray *)options;
@@ -86,6 +105,10 @@ typedef enum {
                   winc:(int)winc
                   binc:(int)binc;
 -(void)searchInfinite;
+-(void)searchWithDepth:(int)depth nodes:(long long)nodes;
+-(void)searchWithDepth:(int)depth
+		 nodes:(long long)nodes
+	   searchMoves:(NSArray *)moves;
 -(void)pushButtonNamed:(NSString *)buttonName;
 -(void)setOptionName:(NSString *)optionName value:(NSString *)value;
 -(void)immediateSetOptionName:(NSString *)optionName value:(NSString *)value;
@@ -94,7 +117,6 @@ typedef enum {
 -(void)setPosition:(NSString *)setposString;
 -(void)startNewGame;
 -(void)askIfReady;
--(void)taskDataAvailable:(NSNotification *)aNotification;
 -(void)quit;
 
 
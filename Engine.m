@@ -18,9 +18,47 @@
 
 
 #import "Engine.h"
+#import "ChessPosition.h"
 #import "EngineController.h"
 #import "UCIOption.h"
 
+#import <errno.h>
+#import <libkern/OSAtomic.h>
+#import <unistd.h>
+
+// Initial and maximum size of the buffers for incomplete lines of engine
+// output. Longer lines are split.
+static const int LINE_BUFFER_SIZE = 1024;
+static const int MAX_LINE_LENGTH = 64 * 1024;
+
+// Size of the queue of lines from the reader thread to the main thread:
+static const uint32_t OUTPUT_QUEUE_SIZE = 1024 * 1024;
+
+// Kinds of lines in the queue. Progress lines are info lines without a
+// score or a PV, such as currmove or nps updates:
+enum { LINE_INFO, LINE_PROGRESS, LINE_BESTMOVE, LINE_OTHER };
+
+static void queue_output_line(void *context, const char *line, int length);
+static void dispatch_error_line(void *context, const char *line, int length);
+static BOOL is_command(const char *line, int length, const char *command);
+static BOOL has_word(const char *line, int length, const char *word);
+static NSString *string_from_bytes(const char *bytes, int length);
+
+// The handshakes of engines (id lines and options) are cached in the user
+// defaults under this key, by the path of the engine:
+static NSString *HANDSHAKE_CACHE_KEY = @"UCI Handshake Cache";
+
+
+@interface Engine (PrivateAPI)
+-(void)finishHandshake;
+-(NSDictionary *)binaryIdentity;
+-(NSArray *)handshakeDictionariesOfOptions:(NSArray *)optionList;
+-(BOOL)loadCachedHandshake;
+-(void)saveHandshake;
+-(void)verifyHandshake;
+-(void)outputDidClose:(id)anObject;
+@end
+
 
 @implementation Engine
 
@@ -108,25 +146,32 @@
   }
 }
 
--(id)initWithController:(EngineController *)ec path:(NSString *)p
+-(id)initWithController:(id)ec path:(NSString *)p
 	    installOnly:(BOOL)instOnly {
   [super init];
   controller = [ec retain];  // Should I really retain this?
   path = [p retain];
-  commandQueue = [[NSMutableArray alloc] init];
+  queueCapacity = 16;
+  commandQueue = malloc(queueCapacity * sizeof(NSString *));
+  queueHead = queueCount = 0;
+  pendingOutput = [[NSMutableData alloc] init];
+  flushScheduled = NO;
   thinking = NO;
-  sprintf(inputBuffer, "");
-  sprintf(errorBuffer, "");
+  line_buffer_init(outputLines, LINE_BUFFER_SIZE, MAX_LINE_LENGTH);
+  line_buffer_init(errorLines, LINE_BUFFER_SIZE, MAX_LINE_LENGTH);
+  spsc_queue_init(outputQueue, OUTPUT_QUEUE_SIZE);
+  drainScheduled = 0;
+  queuedBestmoves = 0;
   isReady = NO;
   installOnly = instOnly;
   return self;
 }
   
--(id)initWithController:(EngineController *)ec path:(NSString *)p {
+-(id)initWithController:(id)ec path:(NSString *)p {
   return [self initWithController: ec path: p installOnly: NO];
 }
 
--(id)initWithController:(EngineController *)ec {
+-(id)initWithController:(id)ec {
   return [self initWithController: ec path: [Engine mainEnginePath]];
 }
 
@@ -138,10 +183,39 @@
   return author;
 }
 
+-(NSString *)path {
+  return path;
+}
+
 -(NSTask *)task {
   return task;
 }
 
+-(BOOL)isRunning {
+  return [task isRunning];
+}
+
+// Hands the engine over to another controller, or to none while it waits
+// in the engine pool.
+
+-(void)setController:(id)ec {
+  [ec retain];
+  [controller release];
+  controller = ec;
+}
+
+// Stops the search in progress without telling anyone about its best
+// move, and forgets the commands not sent yet.
+
+-(void)abandonSearch {
+  while(queueCount > 0)
+    [self removeLastQueuedCommand];
+  if(thinking) {
+    discardBestmove = YES;
+    [self stop];
+  }
+}
+
 -(NSMutableArray *)options {
   return options;
 }
@@ -175,10 +249,6 @@
   // Set up pipe for stdout
   outputPipe = [NSPipe pipe];
   taskOutput = [outputPipe fileHandleForReading];
-  [defaultCenter addObserver: self 
-                    selector: @selector(taskDataAvailable:)
-                        name: NSFileHandleReadCompletionNotification
-                      object: taskOutput];
   [task setStandardOutput: outputPipe];
 
   // Set up pipe for stderr
@@ -197,44 +267,131 @@
 
   // Start the task and start looking for data:
   [task launch];
-  [taskOutput readInBackgroundAndNotify];
+  [NSThread detachNewThreadSelector: @selector(readOutput:)
+	    toTarget: self
+	    withObject: nil];
+  [taskError readInBackgroundAndNotify];
 
   [self sendCommand: @"uci\n"];
 
+  // With a cached handshake, the engine is configured right away, and the
+  // cache is checked when the engine has answered. The commands are held
+  // back until uciok, as UCI requires, but the options don't have to be
+  // parsed first:
+  if(!installOnly && [self loadCachedHandshake]) {
+    verifyingHandshake = YES;
+    handshakeOptions = [[NSMutableArray alloc] init];
+    [controller setEngineName: name];
+    [self finishHandshake];
+  }
+
   // Clean-up
   [environment release];
 }
 
+// Commands are collected in pendingOutput and written to the engine in
+// one go: either right away by -sendCommand:, or at the end of the current
+// run loop pass by -writeCommand:.
+
 -(void)sendCommand:(NSString *)command {
+  [self writeCommand: command];
+  [self flushCommands];
+}
+
+-(void)writeCommand:(NSString *)command {
   //  NSLog(@"%@ < %@", name, command);
-  [taskInput writeData: [command dataUsingEncoding: 
-				   [NSString defaultCStringEncoding]]];
+  [pendingOutput appendData: [command dataUsingEncoding: 
+					[NSString defaultCStringEncoding]]];
+  if(!flushScheduled) {
+    flushScheduled = YES;
+    [self performSelector: @selector(flushCommands)
+	  withObject: nil
+	  afterDelay: 0.0
+	  inModes: [NSArray arrayWithObjects: NSRunLoopCommonModes,
+			    NSModalPanelRunLoopMode,
+			    NSEventTrackingRunLoopMode, nil]];
+  }
+}
+
+// Writing to an engine which has died raises an exception, and the
+// commands are then dropped. Commands are not written before uciok.
+
+-(void)flushCommands {
+  flushScheduled = NO;
+  if([pendingOutput length] == 0 || verifyingHandshake) return;
+  @try {
+    if([task isRunning])
+      [taskInput writeData: pendingOutput];
+  }
+  @catch (NSException *e) {
+    NSLog(@"%@: %@", name, [e reason]);
+  }
+  [pendingOutput setLength: 0];
 }
 
 -(void)queueCommand:(NSString *)command {
   if(thinking || !isReady) {
     //    NSLog(@"%@ q < %@", name, command);
-    [commandQueue addObject: command];
+    if(queueCount == queueCapacity) {
+      NSString **queue = malloc(2 * queueCapacity * sizeof(NSString *));
+      int i;
+      for(i = 0; i < queueCount; i++)
+	queue[i] = commandQueue[(queueHead + i) % queueCapacity];
+      free(commandQueue);
+      commandQueue = queue;
+      queueHead = 0;
+      queueCapacity *= 2;
+    }
+    commandQueue[(queueHead + queueCount++) % queueCapacity] = [command retain];
   }
-  else [self sendCommand: command];
+  else [self writeCommand: command];
 }
 
+-(NSString *)lastQueuedCommand {
+  if(queueCount == 0) return nil;
+  return commandQueue[(queueHead + queueCount - 1) % queueCapacity];
+}
+
+-(void)removeLastQueuedCommand {
+  [commandQueue[(queueHead + --queueCount) % queueCapacity] release];
+}
+
+// A position command (and the search after it) which hasn't been sent yet
+// is superseded by a new position command. The controller counts the
+// searches it has started, so it gets a null best move for a dropped one.
+
+-(void)dropSupersededPosition {
+  if([[self lastQueuedCommand] hasPrefix: @"go"] &&
+     queueCount >= 2 &&
+     [commandQueue[(queueHead + queueCount - 2) % queueCapacity]
+		  hasPrefix: @"position"]) {
+    [self removeLastQueuedCommand];
+    [self removeLastQueuedCommand];
+    [controller bestmove: @"0000" ponder: nil];
+  }
+  else if([[self lastQueuedCommand] hasPrefix: @"position"])
+    [self removeLastQueuedCommand];
+}
+
+// Sends the queued commands up to and including the next go command, all
+// in one write.
+
 -(void)processQueue {
   NSString *command;
-  //  NSLog(@"commandQueue for %@ is: %@", name, commandQueue);
-  while([commandQueue count] > 0) {
-    command = [[commandQueue objectAtIndex: 0] retain];
-    [commandQueue removeObjectAtIndex: 0];
-    if([command length] >= 3 && 
-       [[command substringToIndex: 2] isEqualToString: @"go"]) {
+  //  NSLog(@"commandQueue for %@ has %d commands", name, queueCount);
+  while(queueCount > 0) {
+    command = commandQueue[queueHead];
+    queueHead = (queueHead + 1) % queueCapacity;
+    queueCount--;
+    [self writeCommand: command];
+    if([command hasPrefix: @"go"]) {
       thinking = YES;
-      [self sendCommand: command];
       [command release];
       break;
     }
-    [self sendCommand: command];
     [command release];
   }
+  [self flushCommands];
 }
 
 -(void)searchWithWtime:(int)wtime 
@@ -259,7 +416,7 @@
                  btime:(int)btime 
                   winc:(int)winc
                   binc:(int)binc {
-  if(thinking) 
+  if(thinking || !isReady) 
     [self queueCommand:
 	    [NSString stringWithFormat: 
 			@"go ponder wtime %d btime %d winc %d binc %d\n",
@@ -275,14 +432,43 @@
 
 
 -(void)searchInfinite {
-  if(thinking) [self queueCommand: [NSString stringWithString:
-					       @"go infinite\n"]];
+  if(thinking || !isReady) [self queueCommand: [NSString stringWithString:
+							    @"go infinite\n"]];
   else {
     thinking = YES;
     [self sendCommand: @"go infinite\n"];
   }
 }
 
+// Searches to a fixed depth or number of nodes, whichever comes first. A
+// limit of zero is not used. The search can be restricted to some of the
+// moves, given in coordinate notation.
+
+-(void)searchWithDepth:(int)depth nodes:(long long)nodes {
+  [self searchWithDepth: depth nodes: nodes searchMoves: nil];
+}
+
+-(void)searchWithDepth:(int)depth
+		 nodes:(long long)nodes
+	   searchMoves:(NSArray *)moves {
+  NSMutableString *command = [NSMutableString stringWithString: @"go"];
+
+  if(depth > 0)
+    [command appendFormat: @" depth %d", depth];
+  if(nodes > 0)
+    [command appendFormat: @" nodes %lld", nodes];
+  if([moves count] > 0)
+    [command appendFormat: @" searchmoves %@",
+	     [moves componentsJoinedByString: @" "]];
+  [command appendString: @"\n"];
+  if(thinking || !isReady)
+    [self queueCommand: command];
+  else {
+    thinking = YES;
+    [self sendCommand: command];
+  }
+}
+
 -(BOOL)hasOptionWithName:(NSString *)optionName {
   NSEnumerator *enumerator = [options objectEnumerator];
   UCIOption *option;
@@ -314,7 +500,7 @@
     theOption = [options objectAtIndex: i];
     if([[theOption name] isEqualToString: buttonName]) {
       [self queueCommand: [NSString stringWithFormat: 
-				      @"setoption name %@", buttonName]];
+				      @"setoption name %@\n", buttonName]];
       return;
     }
   }
@@ -370,96 +556,17 @@
 }
 
 -(void)setPosition:(NSString *)setposString {
-  [self queueCommand: setposString];
-  [self queueCommand: [NSString stringWithString: @"\n"]];
+  [self dropSupersededPosition];
+  [self queueCommand: [setposString stringByAppendingString: @"\n"]];
 }
 
--(void)parseInfo:(NSString *)infoString {
-  NSScanner *scanner = [[NSScanner alloc] initWithString: infoString];
-  NSCharacterSet *charSet = 
-    [[NSCharacterSet whitespaceCharacterSet] invertedSet];
-  NSString *str;
-  NSMutableString *mstr;
-  NSMutableArray *array = [[NSMutableArray alloc] init];
-  int i, j;
-
-  // Split infoString into white-space separated tokens, and store them into 
-  // 'array':
-  while(![scanner isAtEnd]) {
-    [scanner scanCharactersFromSet: charSet intoString: &str];
-    [array addObject: str];
-    // ? [str release]; ?
-  }
-  [scanner release];
-
-  // Scan for depth:
-  for(i = 0; i < [array count]; i++) 
-    if([[array objectAtIndex: i] isEqualToString: @"depth"] &&
-       i + 1 < [array count]) 
-      [controller setDepth: [array objectAtIndex: i + 1]];
-
-  // Scan for node count:
-  for(i = 0; i < [array count]; i++) 
-    if([[array objectAtIndex: i] isEqualToString: @"nodes"] &&
-       i + 1 < [array count]) 
-      [controller setNodes: [array objectAtIndex: i + 1]];
-
-  // Scan for nps:
-  for(i = 0; i < [array count]; i++) 
-    if([[array objectAtIndex: i] isEqualToString: @"nps"] &&
-       i + 1 < [array count]) 
-      [controller setNPS: [array objectAtIndex: i + 1]];
-
-  // Scan for move:
-  for(i = 0; i < [array count]; i++) 
-    if([[array objectAtIndex: i] isEqualToString: @"currmove"] &&
-       i + 1 < [array count]) {
-      // Scan for move number:
-      for(j = 0; j < [array count]; j++) 
-        if([[array objectAtIndex: j] isEqualToString: @"currmovenumber"] &&
-           j + 1 < [array count])
-          [controller setMove: [array objectAtIndex: i + 1]
-                       number: [array objectAtIndex: j + 1]];
-    }
-
-  // scan for time:
-  for(i = 0; i < [array count]; i++)
-    if([[array objectAtIndex: i] isEqualToString: @"time"] &&
-       i + 1 < [array count]) 
-      [controller setTime: [array objectAtIndex: i+1]];
-
-  // Scan for score:
-  for(i = 0; i < [array count]; i++) 
-    if([[array objectAtIndex: i] isEqualToString: @"score"] &&
-       i + 2 < [array count]) {
-      ScoreType s;
-      if (i + 3 < [array count] &&
-          [[array objectAtIndex: i + 3] isEqualToString: @"lowerbound"])
-        s = SCORE_LOWER_BOUND;
-      else if (i + 3 < [array count] &&
-               [[array objectAtIndex: i + 3] isEqualToString: @"upperbound"])
-        s = SCORE_UPPER_BOUND;
-      else
-        s = SCORE_EXACT;
-      if([[array objectAtIndex: i + 1] isEqualToString: @"cp"])
-        [controller setCPScore: [array objectAtIndex: i + 2]
-                     scoreType: s];
-      else if([[array objectAtIndex: i + 1] isEqualToString: @"mate"])
-        [controller setMateScore: [array objectAtIndex: i + 2]
-                       scoreType: s];
-    }
-
-  // Scan for PV:
-  for(i = 0; i < [array count]; i++) 
-    if([[array objectAtIndex: i] isEqualToString: @"pv"] &&
-       i + 1 < [array count]) {
-      mstr = [NSMutableString stringWithString: @""];
-      for(j = i + 1; j < [array count]; j++)
-        [mstr appendFormat: @"%@ ", [array objectAtIndex: j]];
-      [controller setPV: mstr];
-    }
+-(void)parseInfo:(const char *)infoString length:(int)length {
+  uci_info_t info[1];
 
-  [array release];
+  if(controller == nil || discardBestmove) return;
+  if(uci_parse_info([[controller currentPosition] pos], infoString, length,
+		    info))
+    [controller setInfo: info];
 }
 
 -(void)parseBestmove:(NSString *)bestmoveString {
@@ -571,140 +678,162 @@
   [bookOptions release];
 }
   
--(void)handleCommand:(char *)command {
-  // NSLog(@"%@ > %@", name, [NSString stringWithUTF8String: command]);
-  if(strncmp(command, "option", 6) == 0) {
+// Engine output arrives as (pointer, length) views into the line buffer or
+// into the data read from the pipe. They are not null terminated.
+
+-(void)handleCommand:(const char *)command length:(int)length {
+  // NSLog(@"%@ > %.*s", name, length, command);
+  if(NO) {
+  } else if(is_command(command, length, "info")) {
+    [self parseInfo: command + 4 length: length - 4];
+  } else if(is_command(command, length, "option")) {
     UCIOption *newOption = 
       [[UCIOption alloc]
-        initWithString: [NSString stringWithUTF8String:command]];
+        initWithString: string_from_bytes(command, length)];
     if(options == NULL) 
       options = [[NSMutableArray alloc] init];
-    [options addObject: newOption];
+    if(verifyingHandshake)
+      [handshakeOptions addObject: newOption];
+    else
+      [options addObject: newOption];
     // NSLog(@"new UCI option: %@", newOption);
     [newOption release];
-  }
-  if(strncmp(command, "uciok", 5) == 0) {
-    NSMutableDictionary *installedEngines = 
-      [NSMutableDictionary dictionaryWithDictionary:
-			     [Engine installedEngines]];
-    NSMutableDictionary *installedEngineOptions =
-      [NSMutableDictionary dictionaryWithDictionary:
-			     [Engine installedEngineOptions]];
-    NSMutableDictionary *installedEngineBookOptions =
-      [NSMutableDictionary dictionaryWithDictionary:
-			     [Engine installedEngineBookOptions]];
-    NSUserDefaults *defaults = [NSUserDefaults standardUserDefaults];
-
-    if([installedEngines objectForKey: name] == nil) {
-      [installedEngines setObject: path forKey: name];
-      [defaults setObject: installedEngines forKey: @"InstalledEngines"];
-    }
-
-    if(installOnly)
-      [self quit];
+  } else if(is_command(command, length, "uciok")) {
+    if(verifyingHandshake)
+      [self verifyHandshake];
     else {
-      if([installedEngineOptions objectForKey: name] == nil) {
-	[self setOptionName: @"Hash" 
-                      value: [NSString stringWithFormat: @"%d", [Engine defaultHashSize]]];
-	[self saveOptions];
-      }
-      else
-	[self loadOptions];
-      
-      if([installedEngineBookOptions objectForKey: name] == nil) {
-	if([self supportsOwnBook] &&
-	   [[[self optionWithName: @"OwnBook"] defaultValue] 
-	     isEqualToString: @"true"]) 
-	  [self setShouldUseOwnBook];
-	else
-	  [self setShouldUseGUIBook];
-      }
-      
-      [self askIfReady];
+      [self saveHandshake];
+      [self finishHandshake];
     }
-  }
-  if(strncmp(command, "readyok", 7) == 0) {
+  } else if(is_command(command, length, "readyok")) {
     isReady = YES;
     [controller setEngineIsReady: YES];
-    [self processQueue];
-  }
-  if(strncmp(command, "id name", 7) == 0) {
-    name = [[NSString stringWithUTF8String: command + 8] retain];
+    // An abandoned search may still be running:
+    if(!thinking) [self processQueue];
+  } else if(is_command(command, length, "id name")) {
+    [name release];
+    name = [string_from_bytes(command + 8, length - 8) retain];
     [controller setEngineName: name];
     // NSLog(@"Engine name: %@", name);
-  }
-  if(strncmp(command, "id author", 9) == 0) {
-    author = [[NSString stringWithUTF8String: command + 10] retain];
+  } else if(is_command(command, length, "id author")) {
+    [author release];
+    author = [string_from_bytes(command + 10, length - 10) retain];
     // NSLog(@"Engine author: %@", author);
-  }
-  if(strncmp(command, "info", 4) == 0) {
-    [self parseInfo: [NSString stringWithUTF8String: command + 5]];
-  }
-  if(strncmp(command, "bestmove", 8) == 0) {
+  } else if(is_command(command, length, "bestmove")) {
     thinking = NO;
-    [self parseBestmove: [NSString stringWithUTF8String: command]];
+    if(discardBestmove)
+      discardBestmove = NO;
+    else
+      [self parseBestmove: string_from_bytes(command, length)];
     [self processQueue];
   }
 }
 
--(void)taskDataAvailable:(NSNotification *)aNotification {
-  const char *bytes;
-  NSData *incomingData;
+// The output of the engine is read by a thread of its own, so that lines
+// are read and split while the main thread is busy. They are passed to the
+// main thread in a lock-free queue, and the main thread is asked to
+// process the queue unless it has been asked already. Info lines arriving
+// in quick succession are thus handled in one go, while a bestmove never
+// waits for anything but the lines before it. Lines are handled in order,
+// so that the last score of a search arrives before its best move, but
+// progress lines are dropped when a bestmove is already waiting behind
+// them.
+
+-(void)readOutput:(id)anObject {
+  NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+  int fd = [taskOutput fileDescriptor];
+  char buffer[4096];
+  ssize_t n;
+
+  while((n = read(fd, buffer, sizeof(buffer))) != 0) {
+    if(n < 0 && errno == EINTR) continue;
+    if(n < 0) break;
+    line_buffer_feed(outputLines, buffer, n, queue_output_line, self);
+    [pool release];
+    pool = [[NSAutoreleasePool alloc] init];
+  }
+  line_buffer_flush(outputLines, queue_output_line, self);
+  [self performSelectorOnMainThread: @selector(outputDidClose:)
+	withObject: nil
+	waitUntilDone: NO
+	modes: [NSArray arrayWithObjects: NSRunLoopCommonModes,
+			NSModalPanelRunLoopMode,
+			NSEventTrackingRunLoopMode, nil]];
+  [pool release];
+}
 
-  // NSLog(@"task data for %@", name);
-  incomingData =
-    [[aNotification userInfo] objectForKey: NSFileHandleNotificationDataItem];
-  if(incomingData && [incomingData length]) {
-    NSString *incomingText = 
-      [[NSString alloc] initWithData: incomingData
-                            encoding: NSASCIIStringEncoding];
-    //    bytes = [incomingData bytes];
-    bytes = [incomingText UTF8String];
-    if(bytes != NULL) {
-      strcat(inputBuffer, bytes);
-      if(inputBuffer[strlen(inputBuffer) - 1] == '\n') {
-	char *running, *command;
-	running = inputBuffer;
-	for(command = strsep(&running, "\n"); command != NULL; 
-	    command = strsep(&running, "\n")) 
-	  [self handleCommand: command];
-	sprintf(inputBuffer, "");
-      }
+// Called in the reader thread. When the queue is full, we wait for the main
+// thread rather than drop lines.
+
+-(void)queueLine:(const char *)line length:(int)length {
+  int type;
+
+  if(is_command(line, length, "info"))
+    type = (has_word(line, length, "score") || has_word(line, length, "pv"))?
+      LINE_INFO : LINE_PROGRESS;
+  else if(is_command(line, length, "bestmove")) type = LINE_BESTMOVE;
+  else type = LINE_OTHER;
+  while(!spsc_queue_push(outputQueue, type, line, length)) {
+    [self scheduleProcessing];
+    usleep(1000);
+  }
+  if(type == LINE_BESTMOVE)
+    OSAtomicIncrement32Barrier(&queuedBestmoves);
+  [self scheduleProcessing];
+}
+
+-(void)scheduleProcessing {
+  if(OSAtomicCompareAndSwap32Barrier(0, 1, &drainScheduled))
+    [self performSelectorOnMainThread: @selector(processOutputQueue:)
+	  withObject: nil
+	  waitUntilDone: NO
+	  modes: [NSArray arrayWithObjects: NSRunLoopCommonModes,
+			  NSModalPanelRunLoopMode,
+			  NSEventTrackingRunLoopMode, nil]];
+}
+
+// A line stays in the queue until it has been handled. Handling a line can
+// run a modal panel (at the end of a game), whose run loop may call this
+// method again; the queue is then left to the outer call.
+
+-(void)processOutputQueue:(id)anObject {
+  const char *line;
+  int type, length;
+
+  OSAtomicCompareAndSwap32Barrier(1, 0, &drainScheduled);
+  if(processingOutput) return;
+  processingOutput = YES;
+  while(spsc_queue_peek(outputQueue, &type, &line, &length)) {
+    if(type == LINE_PROGRESS && OSAtomicAdd32Barrier(0, &queuedBestmoves) > 0)
+      ; // Superseded by the best move
+    else if(type == LINE_INFO || type == LINE_PROGRESS)
+      [self parseInfo: line + 4 length: length - 4];
+    else {
+      if(type == LINE_BESTMOVE)
+	OSAtomicDecrement32Barrier(&queuedBestmoves);
+      [self handleCommand: line length: length];
     }
-    [incomingText release];
-    [taskOutput readInBackgroundAndNotify];
+    spsc_queue_pop(outputQueue);
   }
+  processingOutput = NO;
 }
 
--(void)handleError:(char *)error {
-  NSLog(@"%@ > ERROR: %@", name, [NSString stringWithUTF8String: error]);
+-(void)handleError:(const char *)error length:(int)length {
+  NSLog(@"%@ > ERROR: %@", name, string_from_bytes(error, length));
 }
 
 -(void)taskErrorDataAvailable:(NSNotification *)aNotification {
-  const char *bytes;
   NSData *incomingData;
 
   incomingData =
     [[aNotification userInfo] objectForKey: NSFileHandleNotificationDataItem];
   if(incomingData && [incomingData length]) {
-    NSString *incomingText = 
-      [[NSString alloc] initWithData: incomingData
-                            encoding: NSASCIIStringEncoding];
-    bytes = [incomingText UTF8String];
-    if(bytes != NULL) {
-      strcat(errorBuffer, bytes);
-      if(errorBuffer[strlen(inputBuffer) - 1] == '\n') {
-	char *running, *command;
-	running = errorBuffer;
-	for(command = strsep(&running, "\n"); command != NULL; 
-	    command = strsep(&running, "\n")) 
-	  [self handleError: command];
-	sprintf(errorBuffer, "");
-      }
-    }
-    [incomingText release];
+    line_buffer_feed(errorLines, [incomingData bytes], [incomingData length],
+		     dispatch_error_line, self);
     [taskError readInBackgroundAndNotify];
   }
+  else
+    line_buffer_flush(errorLines, dispatch_error_line, self);
 }
 
 -(void)askIfReady {
@@ -729,8 +858,232 @@
     [taskError release];
   */
   [controller release];
-  [commandQueue release];
+  while(queueCount > 0)
+    [self removeLastQueuedCommand];
+  free(commandQueue);
+  [pendingOutput release];
+  line_buffer_free(outputLines);
+  line_buffer_free(errorLines);
+  spsc_queue_free(outputQueue);
+  [handshakeOptions release];
   [super dealloc];
 }
 
 @end
+
+
+@implementation Engine (PrivateAPI)
+
+// Registers the engine and sends it its saved options once its id and
+// options are known, or quits it if it was only started to be installed.
+
+-(void)finishHandshake {
+  NSMutableDictionary *installedEngines = 
+    [NSMutableDictionary dictionaryWithDictionary:
+			   [Engine installedEngines]];
+  NSMutableDictionary *installedEngineOptions =
+    [NSMutableDictionary dictionaryWithDictionary:
+			   [Engine installedEngineOptions]];
+  NSMutableDictionary *installedEngineBookOptions =
+    [NSMutableDictionary dictionaryWithDictionary:
+			   [Engine installedEngineBookOptions]];
+  NSUserDefaults *defaults = [NSUserDefaults standardUserDefaults];
+
+  if([installedEngines objectForKey: name] == nil) {
+    [installedEngines setObject: path forKey: name];
+    [defaults setObject: installedEngines forKey: @"InstalledEngines"];
+  }
+
+  if(installOnly)
+    [self quit];
+  else {
+    if([installedEngineOptions objectForKey: name] == nil) {
+      [self setOptionName: @"Hash" 
+	    value: [NSString stringWithFormat: @"%d", [Engine defaultHashSize]]];
+      [self saveOptions];
+    }
+    else
+      [self loadOptions];
+      
+    if([installedEngineBookOptions objectForKey: name] == nil) {
+      if([self supportsOwnBook] &&
+	 [[[self optionWithName: @"OwnBook"] defaultValue] 
+	   isEqualToString: @"true"]) 
+	[self setShouldUseOwnBook];
+      else
+	[self setShouldUseGUIBook];
+    }
+      
+    [self askIfReady];
+  }
+}
+
+// The size and modification time of the engine binary, which a cached
+// handshake must match.
+
+-(NSDictionary *)binaryIdentity {
+  NSDictionary *attributes = [[NSFileManager defaultManager]
+			       attributesOfItemAtPath:
+				 [path stringByResolvingSymlinksInPath]
+			       error: NULL];
+
+  if(attributes == nil) return nil;
+  return [NSDictionary dictionaryWithObjectsAndKeys:
+			 [attributes objectForKey: NSFileSize], @"size",
+		       [NSNumber numberWithLongLong:
+				   [[attributes objectForKey:
+						  NSFileModificationDate]
+				     timeIntervalSince1970]],
+		       @"modified", nil];
+}
+
+// Options as the engine reports them, without the values the user chose.
+
+-(NSArray *)handshakeDictionariesOfOptions:(NSArray *)optionList {
+  NSMutableArray *array = [NSMutableArray array];
+  NSEnumerator *enumerator = [optionList objectEnumerator];
+  NSMutableDictionary *dict;
+  UCIOption *option;
+
+  while((option = [enumerator nextObject])) {
+    dict = [NSMutableDictionary dictionaryWithDictionary: [option dictionary]];
+    [dict removeObjectForKey: @"value"];
+    [array addObject: dict];
+  }
+  return array;
+}
+
+-(BOOL)loadCachedHandshake {
+  NSDictionary *cache = [[[NSUserDefaults standardUserDefaults]
+			   objectForKey: HANDSHAKE_CACHE_KEY]
+			  objectForKey: path];
+  NSDictionary *identity = [self binaryIdentity];
+  NSEnumerator *enumerator;
+  NSDictionary *dict;
+
+  if(cache == nil || identity == nil ||
+     ![[cache objectForKey: @"binary"] isEqual: identity] ||
+     [cache objectForKey: @"name"] == nil)
+    return NO;
+
+  [name release];
+  name = [[cache objectForKey: @"name"] retain];
+  [author release];
+  author = [[cache objectForKey: @"author"] retain];
+  [options release];
+  options = [[NSMutableArray alloc] init];
+  enumerator = [[cache objectForKey: @"options"] objectEnumerator];
+  while((dict = [enumerator nextObject])) {
+    UCIOption *option = [[UCIOption alloc] initWithDictionary: dict];
+    [options addObject: option];
+    [option release];
+  }
+  return YES;
+}
+
+-(void)saveHandshake {
+  NSUserDefaults *defaults = [NSUserDefaults standardUserDefaults];
+  NSMutableDictionary *cache =
+    [NSMutableDictionary dictionaryWithDictionary:
+			   [defaults objectForKey: HANDSHAKE_CACHE_KEY]];
+  NSDictionary *identity = [self binaryIdentity];
+
+  if(identity == nil || name == nil) return;
+  [cache setObject: [NSDictionary dictionaryWithObjectsAndKeys:
+				    identity, @"binary",
+				  name, @"name",
+				  [self handshakeDictionariesOfOptions: options],
+				  @"options",
+				  author, @"author", nil]
+	 forKey: path];
+  [defaults setObject: cache forKey: HANDSHAKE_CACHE_KEY];
+}
+
+// Called at uciok for an engine started from a cached handshake. If the
+// engine reported other options than the cached ones, its options are
+// replaced and sent again, and the cache is updated. Then the commands
+// held back since uci are written.
+
+-(void)verifyHandshake {
+  NSDictionary *cache = [[[NSUserDefaults standardUserDefaults]
+			   objectForKey: HANDSHAKE_CACHE_KEY]
+			  objectForKey: path];
+
+  verifyingHandshake = NO;
+  if(![[self handshakeDictionariesOfOptions: handshakeOptions]
+	isEqual: [self handshakeDictionariesOfOptions: options]]) {
+    [options release];
+    options = handshakeOptions;
+    handshakeOptions = nil;
+    [self loadOptions];
+    [self saveHandshake];
+  }
+  else if(![name isEqualToString: [cache objectForKey: @"name"]] ||
+	  (author && ![author isEqualToString: [cache objectForKey: @"author"]]))
+    [self saveHandshake];
+  [handshakeOptions release];
+  handshakeOptions = nil;
+  [self flushCommands];
+}
+
+// The engine has closed its output, which means that it has quit or
+// crashed. The lines read before are handled first. No best move is coming
+// for a search in progress.
+
+-(void)outputDidClose:(id)anObject {
+  [self processOutputQueue: nil];
+  thinking = NO;
+  isReady = NO;
+  if([controller respondsToSelector: @selector(engineDidTerminate:)])
+    [controller engineDidTerminate: self];
+}
+
+@end
+
+
+static void queue_output_line(void *context, const char *line, int length) {
+  [(Engine *)context queueLine: line length: length];
+}
+
+static void dispatch_error_line(void *context, const char *line, int length) {
+  [(Engine *)context handleError: line length: length];
+}
+
+// Tests whether a line is the given command, possibly followed by
+// arguments.
+
+static BOOL is_command(const char *line, int length, const char *command) {
+  int n = strlen(command);
+  return length >= n && memcmp(line, command, n) == 0 &&
+    (length == n || line[n] == ' ' || line[n] == '\t');
+}
+
+// Tests whether a line contains the given word, separated by blanks.
+
+static BOOL has_word(const char *line, int length, const char *word) {
+  int n = strlen(word), i;
+
+  for(i = 1; i + n <= length; i++)
+    if((line[i - 1] == ' ' || line[i - 1] == '\t') &&
+       memcmp(line + i, word, n) == 0 &&
+       (i + n == length || line[i + n] == ' ' || line[i + n] == '\t'))
+      return YES;
+  return NO;
+}
+
+// Engines should write ASCII, but names and options sometimes contain
+// UTF-8 or Latin-1.
+
+static NSString *string_from_bytes(const char *bytes, int length) {
+  NSString *string;
+
+  if(length < 0) length = 0;
+  string = [[NSString alloc] initWithBytes: bytes
+			     length: length
+			     encoding: NSUTF8StringEncoding];
+  if(string == nil)
+    string = [[NSString alloc] initWithBytes: bytes
+			       length: length
+			       encoding: NSISOLatin1StringEncoding];
+  return [string autorelease];
+}
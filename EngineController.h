@@ -18,6 +18,10 @@
 
 
 #import <Cocoa/Cocoa.h>
+#import "multipv.h"
+#import "position.h"
+#import "pvsan.h"
+#import "uciinfo.h"
 
 @class BoardController;
 @class ChessMove;
@@ -57,20 +61,49 @@ enum {PLAYING_WHITE, PLAYING_BLACK, ANALYSING, IDLE};
   int currentTime, currentDepth, currentCPScore, currentMateScore;
   int currentNodeCount;
 
+  // Search information not yet shown in the window:
+  uci_info_t pendingInfo;
+  int pendingFields;
+  NSTimer *displayTimer;
+  pv_san_cache_t *pvCache;
+
+  // Lines of a MultiPV analysis, each with a SAN cache of its own:
+  int analysisLines;
+  multipv_t *lines;
+  pv_san_cache_t *lineCaches[MULTIPV_MAX_LINES];
+
   int subjectiveCPScore;
+  // The last score of the current search, from the engine's point of view:
+  BOOL hasSearchScore, searchScoreIsMate;
+  int searchScore;
+  // The score and main line come from the tablebases rather than the engine:
+  BOOL tablebaseHit;
+  // Depth of the cached analysis shown, until the engine searches as deep:
+  int cachedDepth;
   int resignCounter;
   BOOL shouldResignInHopelessPositions;
 
   NSMutableString *analysisOutput;
   NSString *previousAnalysisOutput;
+
+  // The last position command sent, which is usually extended or cut
+  // back by a few moves for the next one:
+  NSMutableString *setposCommand;
+  NSString *setposFEN;
+  BOOL setposFRC;
+  move_t *setposMoves;
+  int *setposLengths;  // Length of the command with the first n moves
+  int setposMoveCount, setposCapacity;
 }
 
 -(id)initWithBoardController:(BoardController *)bc path:(NSString *)path;
 -(id)initWithBoardController:(BoardController *)bc name:(NSString *)name;
 -(id)initWithBoardController:(BoardController *)bc;
 -(id)engine;
+-(void)recycleEngine;
 -(NSString *)engineName;
 -(void)setEngineName:(NSString *)newEngineName;
+-(ChessPosition *)currentPosition;
 -(void)setCurrentPosition:(ChessPosition *)newPosition;
 -(void)setPositionFromGame:(Game *)aGame;
 -(void)setPositionFromGame:(Game *)aGame withPonderMove:(ChessMove *)pmove;
@@ -83,6 +116,7 @@ enum {PLAYING_WHITE, PLAYING_BLACK, ANALYSING, IDLE};
 -(void)setNodes:(NSString *)nodes;
 -(void)setNPS:(NSString *)nps;
 -(void)setPV:(NSString *)pv;
+-(void)setInfo:(const uci_info_t *)info;
 -(void)bestmove:(NSString *)bestmove ponder:(NSString *)ponder;
 -(void)searchInfinite;
 -(void)searchWithWtime:(int)wtime
@@ -104,5 +138,6 @@ enum {PLAYING_WHITE, PLAYING_BLACK, ANALYSING, IDLE};
 -(void)startAnalyseMode;
 -(void)startNewGame;
 -(void)setEngineIsReady:(BOOL)state;
+-(BOOL)takeSearchScore:(int *)score isMate:(BOOL *)isMate;
 
 @end
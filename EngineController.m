@@ -21,10 +21,28 @@
 #import "ChessPosition.h"
 #import "Engine.h"
 #import "EngineController.h"
+#import "EnginePool.h"
 #import "Game.h"
 #import "GameNode.h"
 #import "position.h"
 
+#include "analysiscache.h"
+#include "syzygy.h"
+
+// Number of times per second the window is updated during a search:
+static const int DISPLAY_FRAME_RATE = 20;
+
+
+@interface EngineController (PrivateAPI)
+-(NSString *)scoreString:(int)value type:(int)type bound:(int)bound;
+-(void)displayScore:(int)value type:(int)type bound:(int)bound;
+-(void)displayLines;
+-(void)updateDisplay:(NSTimer *)timer;
+-(void)displayTablebaseResult;
+-(void)displayCachedAnalysis;
+@end
+
+
 @implementation EngineController
 
 -(id)initWithBoardController:(BoardController *)bc path:(NSString *)path {
@@ -46,8 +64,12 @@
   shouldResignInHopelessPositions = 
     [[NSUserDefaults standardUserDefaults]
       boolForKey: @"Resign in Hopeless Positions"];
-  engine = [[Engine alloc] initWithController: self path: path];
-  [engine start];
+  pvCache = pv_san_cache_new();
+  analysisLines = 1;
+  lines = malloc(sizeof(multipv_t));
+  multipv_clear(lines);
+  engine = [[[EnginePool sharedPool] engineWithController: self path: path]
+	     retain];
   return self;
 }
 
@@ -65,6 +87,16 @@
   return engine;
 }
 
+// Gives the engine back to the engine pool, which keeps it running for the
+// next controller.
+
+-(void)recycleEngine {
+  if(engine == nil) return;
+  [[EnginePool sharedPool] recycleEngine: engine];
+  [engine release];
+  engine = nil;
+}
+
 -(NSString *)engineName {
   return engineName;
 }
@@ -94,43 +126,66 @@
 }
 
 -(NSString *)setposString {
-  GameNode *node = [game currentNode];
-  NSMutableArray *pathToRoot = [[NSMutableArray alloc] init];
-  NSMutableString *result;
-  int i;
-
-  // Traverse the path from the current node up to the root, and store the
-  // moves in an array:
-  while([node parent]) {
-    [pathToRoot addObject: [node move]];
-    node = [node parent];
+  GameNode *node = [game currentNode], **path;
+  int ply = [node ply], common = 0, i;
+  BOOL frc = [game isFRCGame];
+
+  if(setposCommand == nil || frc != setposFRC ||
+     ![[game rootFEN] isEqualToString: setposFEN]) {
+    [setposFEN release];
+    setposFEN = [[game rootFEN] copy];
+    setposFRC = frc;
+    [setposCommand release];
+    setposCommand = [[NSMutableString alloc]
+		      initWithFormat: @"position fen %@ ", setposFEN];
+    setposMoveCount = 0;
   }
-
-  // Build the string:
-  result = [NSMutableString stringWithFormat: @"position fen %@ ", 
-                            [game rootFEN]];
-  // if([node move]) [result appendFormat: @"moves "];
-  if([pathToRoot count] > 0) [result appendFormat: @"moves "];
-  for(i = [pathToRoot count] - 1; i >= 0; i--) {
-    ChessMove *move = [pathToRoot objectAtIndex: i];
-    if([game isFRCGame] && [move isKingsideCastle])
-      [result appendFormat: @"%@ ",
-	      [[game currentPosition] UCIStringFromOOMove: move]];
-    else if([game isFRCGame] && [move isQueensideCastle])
-      [result appendFormat: @"%@ ",
-	      [[game currentPosition] UCIStringFromOOOMove: move]];
-    else 
-      [result appendFormat: @"%@ ", [[pathToRoot objectAtIndex: i] UCIString]];
+  if(ply >= setposCapacity) {
+    setposCapacity = Max(2 * setposCapacity, ply + 64);
+    setposMoves = realloc(setposMoves, setposCapacity * sizeof(move_t));
+    setposLengths = realloc(setposLengths, (setposCapacity + 1) * sizeof(int));
   }
-  
-  [pathToRoot release];
+  if(setposMoveCount == 0)
+    setposLengths[0] = [setposCommand length];
+
+  // Find out how many moves from the start of the game are the same as in
+  // the last command:
+  path = malloc((ply + 1) * sizeof(GameNode *));
+  for(i = ply; i > 0; i--, node = [node parent])
+    path[i - 1] = node;
+  while(common < ply && common < setposMoveCount &&
+	setposMoves[common] == [[path[common] move] move])
+    common++;
+
+  // Cut the command back to these moves, and add the rest:
+  [setposCommand deleteCharactersInRange:
+		   NSMakeRange(setposLengths[common],
+			       [setposCommand length] - setposLengths[common])];
+  if(common == 0 && ply > 0)
+    [setposCommand appendString: @"moves "];
+  for(i = common; i < ply; i++) {
+    [setposCommand appendString: [path[i] UCIStringInFRCGame: frc]];
+    [setposCommand appendString: @" "];
+    setposMoves[i] = [[path[i] move] move];
+    setposLengths[i + 1] = [setposCommand length];
+  }
+  setposMoveCount = ply;
+  free(path);
+
+  return [[setposCommand copy] autorelease];
+}
 
-  return result;
+-(ChessPosition *)currentPosition {
+  return currentPosition;
 }
 
 -(void)setCurrentPosition:(ChessPosition *)newPosition {
   copy_position([currentPosition pos], [newPosition pos]);
   legalMovesCount = [currentPosition countLegalMoves];
+  pendingFields = 0;
+  tablebaseHit = NO;
+  cachedDepth = 0;
+  multipv_clear(lines);
 }
 
 -(void)setPositionFromGame:(Game *)aGame {
@@ -182,6 +237,7 @@
 }
 
 -(void)clearWindow {
+  pendingFields = 0;
   [self setDepth: @""];
   [self setMove: @"" number: @""];
   [self setTime: @""];
@@ -214,7 +270,6 @@
 
 -(void)setCPScore:(NSString *)score scoreType:(int)scoreType {
   int value = [score intValue];
-  static char scoreTypeChar[3][2] = { ">", "", "<" };
 
   if(pendingSearches != 1) return;
   if(!engineIsReady) return;
@@ -228,21 +283,11 @@
 
   currentMateScore = 0;
   currentCPScore = value;
-  if(value >= 0) 
-    [scoreTextField setStringValue:
-		      [NSString stringWithFormat: @"Score: %s+%.2f",
-                                scoreTypeChar[scoreType + 1],
-				(float)value / 100.0]];
-  else
-    [scoreTextField setStringValue: 
-		      [NSString stringWithFormat: @"Score: %s%.2f",
-                                scoreTypeChar[scoreType + 1],
-				(float)value / 100.0]];
+  [self displayScore: value type: UCI_SCORE_CP bound: scoreType];
 }
 
 -(void)setMateScore:(NSString *)score scoreType:(int)scoreType {
   int value = [score intValue];
-  static char scoreTypeChar[3][2] = { ">", "", "<" };
   
   if(pendingSearches != 1) return;
   if(!engineIsReady) return;
@@ -253,16 +298,30 @@
   }
 
   currentMateScore = value;
-  if(value >= 0)
-    [scoreTextField setStringValue:
-                      [NSString stringWithFormat: @"Score: %s+#%d",
-                                scoreTypeChar[scoreType + 1],
-                                value]];
+  [self displayScore: value type: UCI_SCORE_MATE bound: scoreType];
+}
+
+-(NSString *)scoreString:(int)value type:(int)type bound:(int)bound {
+  static char scoreTypeChar[3][2] = { ">", "", "<" };
+
+  if(type == UCI_SCORE_CP && value >= 0) 
+    return [NSString stringWithFormat: @"%s+%.2f",
+		     scoreTypeChar[bound + 1], (float)value / 100.0];
+  else if(type == UCI_SCORE_CP)
+    return [NSString stringWithFormat: @"%s%.2f",
+		     scoreTypeChar[bound + 1], (float)value / 100.0];
+  else if(value >= 0)
+    return [NSString stringWithFormat: @"%s+#%d",
+		     scoreTypeChar[bound + 1], value];
   else
-    [scoreTextField setStringValue:
-                      [NSString stringWithFormat: @"Score: %s-#%d",
-                                scoreTypeChar[scoreType + 1],
-                                -value]];
+    return [NSString stringWithFormat: @"%s-#%d",
+		     scoreTypeChar[bound + 1], -value];
+}
+
+-(void)displayScore:(int)value type:(int)type bound:(int)bound {
+  [scoreTextField setStringValue:
+		    [NSString stringWithFormat: @"Score: %@",
+			      [self scoreString: value type: type bound: bound]]];
 }
 
 -(void)setNodes:(NSString *)nodes {
@@ -294,6 +353,220 @@
 			     [currentPosition lineToSAN: pv]]];
 }
 
+// Takes the information from an info line of the engine. The state of the
+// search is updated right away, but the window is only updated
+// DISPLAY_FRAME_RATE times per second, with the latest value of each field.
+
+-(void)setInfo:(const uci_info_t *)info {
+  int fields = info->fields, value, bound;
+
+  if(pendingSearches != 1) return;
+  if(!engineIsReady) fields &= UCI_INFO_DEPTH;
+  else if(analysisLines > 1 && multipv_add(lines, info))
+    fields |= UCI_INFO_MULTIPV;
+
+  // The lines after the first only go to the MultiPV table:
+  if((info->fields & UCI_INFO_MULTIPV) && info->multipv > 1)
+    fields &= UCI_INFO_MULTIPV;
+
+  if(fields & UCI_INFO_DEPTH)
+    currentDepth = pendingInfo.depth = info->depth;
+  if(fields & UCI_INFO_TIME)
+    currentTime = info->time;
+  if(fields & UCI_INFO_NODES) {
+    currentNodeCount = info->nodes;
+    pendingInfo.nodes = info->nodes;
+  }
+  if(fields & UCI_INFO_NPS)
+    pendingInfo.nps = info->nps;
+  if(fields & UCI_INFO_CURRMOVE) {
+    pendingInfo.currmove = info->currmove;
+    pendingInfo.currmovenumber = info->currmovenumber;
+  }
+  if(fields & UCI_INFO_SCORE) {
+    value = info->score;
+    bound = info->bound;
+    if(info->score_type == UCI_SCORE_CP)
+      subjectiveCPScore = value;
+    searchScore = value;
+    searchScoreIsMate = info->score_type == UCI_SCORE_MATE;
+    hasSearchScore = YES;
+    if(whiteScore && ![currentPosition whiteToMove]) {
+      value = -value;
+      bound = -bound;
+    }
+    if(info->score_type == UCI_SCORE_CP) {
+      currentMateScore = 0;
+      currentCPScore = value;
+    }
+    else
+      currentMateScore = value;
+    pendingInfo.score_type = info->score_type;
+    pendingInfo.score = value;
+    pendingInfo.bound = bound;
+  }
+  if(fields & UCI_INFO_PV) {
+    memcpy(pendingInfo.pv, info->pv, info->pv_length * sizeof(move_t));
+    pendingInfo.pv_length = info->pv_length;
+  }
+  if(!pondering &&
+     (fields & (UCI_INFO_DEPTH | UCI_INFO_SCORE | UCI_INFO_PV)) ==
+     (UCI_INFO_DEPTH | UCI_INFO_SCORE | UCI_INFO_PV) &&
+     !((fields & UCI_INFO_MULTIPV) && info->multipv > 1))
+    analysis_cache_store([currentPosition pos]->key, info->depth,
+			 info->score_type, info->score, info->bound,
+			 info->pv, info->pv_length);
+
+  pendingFields |= fields;
+  if(pendingFields != 0 && displayTimer == nil) {
+    // Common modes, so the display keeps updating during menu tracking
+    // and window resizing:
+    displayTimer =
+      [NSTimer timerWithTimeInterval: 1.0 / DISPLAY_FRAME_RATE
+	       target: self
+	       selector: @selector(updateDisplay:)
+	       userInfo: nil
+	       repeats: NO];
+    [[NSRunLoop currentRunLoop] addTimer: displayTimer
+				 forMode: NSRunLoopCommonModes];
+  }
+}
+
+-(void)updateDisplay:(NSTimer *)timer {
+  const char *line;
+  char str[16];
+
+  displayTimer = nil;
+  if((pendingFields & UCI_INFO_DEPTH) && pendingInfo.depth >= cachedDepth)
+    cachedDepth = 0;
+  if(pendingFields & UCI_INFO_DEPTH && cachedDepth == 0)
+    [depthTextField setStringValue: 
+		      [NSString stringWithFormat: @"Depth: %d",
+				pendingInfo.depth]];
+  if(pendingFields & UCI_INFO_CURRMOVE) {
+    [moveTextField setStringValue: 
+		     [NSString stringWithFormat: @"Move: %s (%d/%d)", 
+			       san_string([currentPosition pos],
+					  pendingInfo.currmove, str),
+			       pendingInfo.currmovenumber, legalMovesCount]];
+  }
+  if(pendingFields & UCI_INFO_SCORE && !tablebaseHit && cachedDepth == 0)
+    [self displayScore: pendingInfo.score
+	  type: pendingInfo.score_type
+	  bound: pendingInfo.bound];
+  if(pendingFields & UCI_INFO_NODES)
+    [nodesTextField setStringValue: 
+		      [NSString stringWithFormat: @"Nodes: %lld",
+				(long long)pendingInfo.nodes]];
+  if(pendingFields & UCI_INFO_NPS)
+    [npsTextField setStringValue: 
+		    [NSString stringWithFormat: @"Nodes/second: %lld",
+			      (long long)pendingInfo.nps]];
+  if(pendingFields & UCI_INFO_MULTIPV && analysisLines > 1 &&
+     !tablebaseHit && cachedDepth == 0)
+    [self displayLines];
+  else if(pendingFields & UCI_INFO_PV && !tablebaseHit && cachedDepth == 0) {
+    // Only the moves after those the PV has in common with the previous
+    // one are converted:
+    line = pv_san_line(pvCache, [currentPosition pos],
+		       pendingInfo.pv, pendingInfo.pv_length);
+    if(pondering)
+      [pvTextField setStringValue: 
+		     [NSString stringWithFormat: @"Main Line: (%@) %s", 
+			       ponderMoveString, line]];
+    else
+      [pvTextField setStringValue: 
+		     [NSString stringWithFormat: @"Main Line: %s", line]];
+  }
+  pendingFields = 0;
+}
+
+// Shows the top lines of a MultiPV search in the main line field, one per
+// line of text, each with its score and depth.
+
+-(void)displayLines {
+  NSMutableString *text = [NSMutableString string];
+  const multipv_line_t *line;
+  int i, value, bound;
+
+  for(i = 1; i <= analysisLines; i++) {
+    if((line = multipv_line(lines, i)) == NULL) continue;
+    value = line->score;
+    bound = line->bound;
+    if(whiteScore && ![currentPosition whiteToMove]) {
+      value = -value;
+      bound = -bound;
+    }
+    if(lineCaches[i - 1] == NULL)
+      lineCaches[i - 1] = pv_san_cache_new();
+    [text appendFormat: @"%@%d: %@/%d  %s", ([text length] > 0)? @"\n" : @"",
+	  i, [self scoreString: value type: line->score_type bound: bound],
+	  line->depth,
+	  pv_san_line(lineCaches[i - 1], [currentPosition pos],
+		      line->pv, line->pv_length)];
+  }
+  [pvTextField setStringValue: text];
+}
+
+// Shows the exact result and the best move of a position found in the
+// tablebases, in place of the score and main line of the engine.
+
+-(void)displayTablebaseResult {
+  position_t *pos = [currentPosition pos];
+  NSString *result;
+  move_t move;
+  int wdl, dtz;
+  char str[16];
+
+  tablebaseHit = tb_probe_root(pos, &move, &wdl, &dtz);
+  if(!tablebaseHit) return;
+  if(wdl == TB_WIN || wdl == TB_LOSS)
+    result = [NSString stringWithFormat: @"%@ wins, DTZ %d",
+		       ((wdl == TB_WIN) == (pos->side == WHITE))?
+		       @"White" : @"Black",
+		       abs(dtz)];
+  else if(wdl == TB_DRAW)
+    result = @"Draw";
+  else
+    result = @"Draw by the 50 move rule";
+  [scoreTextField setStringValue:
+		    [NSString stringWithFormat: @"Score: %@ (tablebase)", result]];
+  if(move != NoMove)
+    [pvTextField setStringValue:
+		   [NSString stringWithFormat: @"Main Line: %s",
+			     san_string(pos, move, str)]];
+}
+
+// Shows the deepest analysis of the position from earlier searches, which
+// stays in place of the engine's depth, score and main line until the
+// engine has searched as deep.
+
+-(void)displayCachedAnalysis {
+  analysis_cache_entry_t entry;
+  int value, bound;
+
+  if(tablebaseHit ||
+     !analysis_cache_probe([currentPosition pos]->key, &entry) ||
+     entry.pv_length == 0 ||
+     !move_is_legal([currentPosition pos], entry.pv[0]))
+    return;
+  cachedDepth = entry.depth;
+  value = entry.score;
+  bound = entry.bound;
+  if(whiteScore && ![currentPosition whiteToMove]) {
+    value = -value;
+    bound = -bound;
+  }
+  [depthTextField setStringValue:
+		    [NSString stringWithFormat: @"Depth: %d (cached)",
+			      entry.depth]];
+  [self displayScore: value type: entry.score_type bound: bound];
+  [pvTextField setStringValue:
+		 [NSString stringWithFormat: @"Main Line: %s",
+			   pv_san_line(pvCache, [currentPosition pos],
+				       entry.pv, entry.pv_length)]];
+}
+
 -(NSString *)moveComment {
   if(!commentMoves) return nil;
   if(currentMateScore == 0 && currentCPScore >= 0)
@@ -336,6 +609,7 @@
       ponderMoveString = [[currentPosition moveToSAN: ponder] retain];
       [currentPosition makeMove: pmove];
       legalMovesCount = [currentPosition countLegalMoves];
+      pendingFields = 0;
       [self ponderWithWtime: [game whiteRemainingTime]
 	    btime: [game blackRemainingTime]
 	    winc: [game whiteIncrement]
@@ -365,12 +639,21 @@
   }
   [engine setOptionName: @"OwnBook" value: @"false"];
   [engine setOptionName: @"UCI_AnalyseMode" value: @"true"];
+  analysisLines = MAX(MIN([[NSUserDefaults standardUserDefaults]
+			    integerForKey: @"Analysis Lines"],
+			  MULTIPV_MAX_LINES), 1);
+  if(![engine hasOptionWithName: @"MultiPV"])
+    analysisLines = 1;
+  [engine setOptionName: @"MultiPV"
+	  value: [NSString stringWithFormat: @"%d", analysisLines]];
   if([game isFRCGame])
     [engine setOptionName: @"UCI_Chess960" value: @"true"];
   else
     [engine setOptionName: @"UCI_Chess960" value: @"false"];
   [engine setPosition: [self setposString]];
   [engine searchInfinite];
+  [self displayTablebaseResult];
+  [self displayCachedAnalysis];
 }
 
 -(void)searchWithWtime:(int)wtime
@@ -381,6 +664,7 @@
   pendingSearches++;
   pondering = NO;
   thinking = YES;
+  hasSearchScore = NO;
   if(analysisOutput) {
     [previousAnalysisOutput release];
     previousAnalysisOutput = [[NSString stringWithString: analysisOutput]
@@ -397,6 +681,8 @@
     [engine setOptionName: @"OwnBook" value: @"false"];
 
   [engine setOptionName: @"UCI_AnalyseMode" value: @"false"];
+  analysisLines = 1;
+  [engine setOptionName: @"MultiPV" value: @"1"];
   if([game isFRCGame])
     [engine setOptionName: @"UCI_Chess960" value: @"true"];
   else
@@ -423,7 +709,10 @@
   }
   pondering = YES;
   ponderedWrongMove = NO;
+  hasSearchScore = NO;
   [engine setOptionName: @"UCI_AnalyseMode" value: @"false"];
+  analysisLines = 1;
+  [engine setOptionName: @"MultiPV" value: @"1"];
   if([game isFRCGame])
     [engine setOptionName: @"UCI_Chess960" value: @"true"];
   else
@@ -472,11 +761,32 @@
   engineIsReady = state;
 }
 
+// Returns the score of the search for the last move, once. A move which
+// was not searched for (a book move) thus has no score.
+
+-(BOOL)takeSearchScore:(int *)score isMate:(BOOL *)isMate {
+  if(!hasSearchScore) return NO;
+  *score = searchScore;
+  *isMate = searchScoreIsMate;
+  hasSearchScore = NO;
+  return YES;
+}
+
 -(void)dealloc {
+  int i;
+
+  [displayTimer invalidate];
+  pv_san_cache_delete(pvCache);
+  for(i = 0; i < MULTIPV_MAX_LINES; i++)
+    if(lineCaches[i] != NULL) pv_san_cache_delete(lineCaches[i]);
+  free(lines);
   [currentPosition release];
-  [engine quit];
-  [engine release];
+  [self recycleEngine];
   [ponderMoveString release];
+  [setposCommand release];
+  [setposFEN release];
+  free(setposMoves);
+  free(setposLengths);
   [super dealloc];
 }
 
@@ -0,0 +1,42 @@
+/*
+  Stockfish, a OS X GUI for the UCI chess engine with the same name.
+  Copyright (C) 2004-2011 Marco Costalba, Joona Kiiski, Tord Romstad
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#import <Cocoa/Cocoa.h>
+
+@class Engine;
+
+// The EnginePool keeps engine processes running when their controllers are
+// done with them. The next controller asking for the same engine gets the
+// initialized process, which only needs ucinewgame and isready, instead of
+// a new one which goes through the whole UCI handshake and allocates its
+// hash table again. Options which the controller changed are set back to
+// their saved values when an engine is put back, and an idle engine is
+// replaced by a new process if it has crashed or its saved options have
+// been changed since.
+
+@interface EnginePool : NSObject {
+  NSMutableArray *idleEngines;
+  NSMutableArray *idleEngineOptions;  // Saved options of each idle engine
+}
+
++(EnginePool *)sharedPool;
+-(Engine *)engineWithController:(id)ec path:(NSString *)path;
+-(void)recycleEngine:(Engine *)engine;
+-(void)quitIdleEngines;
+
+@end
@@ -0,0 +1,169 @@
+/*
+  Stockfish, a OS X GUI for the UCI chess engine with the same name.
+  Copyright (C) 2004-2011 Marco Costalba, Joona Kiiski, Tord Romstad
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#import "Engine.h"
+#import "EnginePool.h"
+#import "UCIOption.h"
+
+
+@interface EnginePool (PrivateAPI)
+-(id)optionsOfEngine:(Engine *)engine;
+-(void)restoreSavedOptionsOfEngine:(Engine *)engine;
+-(void)removeIdleEngineAtIndex:(int)i;
+@end
+
+
+@implementation EnginePool
+
++(EnginePool *)sharedPool {
+  static EnginePool *sharedPool = nil;
+
+  if(sharedPool == nil)
+    sharedPool = [[EnginePool alloc] init];
+  return sharedPool;
+}
+
+-(id)init {
+  self = [super init];
+  idleEngines = [[NSMutableArray alloc] init];
+  idleEngineOptions = [[NSMutableArray alloc] init];
+  return self;
+}
+
+// Returns a running engine for the controller, reusing an idle one with
+// the same path when possible. A reused engine starts a new game and is
+// asked whether it is ready, so the controller gets -setEngineIsReady:
+// as with a new engine.
+
+-(Engine *)engineWithController:(id)ec path:(NSString *)path {
+  Engine *engine;
+  int i;
+
+  for(i = 0; i < [idleEngines count]; i++) {
+    engine = [idleEngines objectAtIndex: i];
+    if(![[engine path] isEqualToString: path]) continue;
+    if(![engine isRunning] ||
+       ![[self optionsOfEngine: engine]
+	  isEqual: [idleEngineOptions objectAtIndex: i]]) {
+      [engine quit];
+      [self removeIdleEngineAtIndex: i--];
+      continue;
+    }
+    [[engine retain] autorelease];
+    [self removeIdleEngineAtIndex: i];
+    [engine setController: ec];
+    [ec setEngineName: [engine name]];
+    [engine startNewGame];
+    [engine askIfReady];
+    return engine;
+  }
+
+  engine = [[[Engine alloc] initWithController: ec path: path] autorelease];
+  [engine start];
+  return engine;
+}
+
+// Takes back an engine whose controller is done with it. At most "Idle
+// Engine Processes" engines are kept; the oldest ones are quit.
+
+-(void)recycleEngine:(Engine *)engine {
+  int maxIdleEngines = [[NSUserDefaults standardUserDefaults]
+			 integerForKey: @"Idle Engine Processes"];
+
+  if(engine == nil ||
+     [idleEngines indexOfObjectIdenticalTo: engine] != NSNotFound)
+    return;
+  [engine setController: nil];
+  if(![engine isRunning] || [engine name] == nil || maxIdleEngines <= 0) {
+    [engine quit];
+    return;
+  }
+  [engine abandonSearch];
+  [self restoreSavedOptionsOfEngine: engine];
+  [idleEngines addObject: engine];
+  [idleEngineOptions addObject: [self optionsOfEngine: engine]];
+  while([idleEngines count] > maxIdleEngines) {
+    [[idleEngines objectAtIndex: 0] quit];
+    [self removeIdleEngineAtIndex: 0];
+  }
+}
+
+-(void)quitIdleEngines {
+  [idleEngines makeObjectsPerformSelector: @selector(quit)];
+  [idleEngines removeAllObjects];
+  [idleEngineOptions removeAllObjects];
+}
+
+-(void)dealloc {
+  [self quitIdleEngines];
+  [idleEngines release];
+  [idleEngineOptions release];
+  [super dealloc];
+}
+
+@end
+
+
+@implementation EnginePool (PrivateAPI)
+
+// The options and book settings saved for an engine, which are sent to it
+// when it starts.
+
+-(id)optionsOfEngine:(Engine *)engine {
+  id options = [Engine optionsOfEngineWithName: [engine name]];
+  id bookOptions =
+    [[Engine installedEngineBookOptions] objectForKey: [engine name]];
+
+  return [NSArray arrayWithObjects: options? options : [NSNull null],
+		  bookOptions? bookOptions : [NSNull null], nil];
+}
+
+// Controllers change options such as MultiPV or UCI_AnalyseMode for their
+// own searches. Before an engine waits for the next controller, every
+// option is set back to its saved value, or to its default if it has none,
+// as for a new process.
+
+-(void)restoreSavedOptionsOfEngine:(Engine *)engine {
+  NSArray *savedOptions =
+    (NSArray *)[Engine optionsOfEngineWithName: [engine name]];
+  NSMutableDictionary *savedValues = [NSMutableDictionary dictionary];
+  NSEnumerator *enumerator = [savedOptions objectEnumerator];
+  NSDictionary *dict;
+  UCIOption *option;
+  NSString *value;
+
+  while((dict = [enumerator nextObject]))
+    if([dict objectForKey: @"value"])
+      [savedValues setObject: [dict objectForKey: @"value"]
+		   forKey: [dict objectForKey: @"name"]];
+  enumerator = [[engine options] objectEnumerator];
+  while((option = [enumerator nextObject])) {
+    if([option type] == UCI_BUTTON) continue;
+    value = [savedValues objectForKey: [option name]];
+    if(value == nil) value = [option defaultValue];
+    if(value != nil && ![[option value] isEqualToString: value])
+      [engine setOptionName: [option name] value: value];
+  }
+}
+
+-(void)removeIdleEngineAtIndex:(int)i {
+  [idleEngines removeObjectAtIndex: i];
+  [idleEngineOptions removeObjectAtIndex: i];
+}
+
+@end
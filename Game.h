@@ -36,6 +36,7 @@
   GameNode *currentNode;
   ChessClock *clock;
   BOOL FRC;
+  unsigned long modificationStamp;
 }
 
 -(id)initWithFEN:(NSString *)fen;
@@ -96,6 +97,12 @@
 			     variations:(BOOL)includeVariations;
 -(NSAttributedString *)moveListAttributedStringWithComments:(BOOL)includeComments
 						 variations:(BOOL)includeVariations;
+-(void)appendMoveListToAttributedString:(NSMutableAttributedString *)str
+			       fromNode:(GameNode *)node
+			       comments:(BOOL)includeComments
+			     variations:(BOOL)includeVariations
+				 ranges:(NSMapTable *)ranges;
+-(unsigned long)modificationStamp;
 -(NSString *)PGNString;
 -(ChessMove *)generateMoveFrom:(int)from to:(int)to 
 		     promotion:(int)promotion;
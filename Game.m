@@ -19,8 +19,20 @@
 
 #import "Game.h"
 #import "GameParser.h"
+#import "PGNMoveTree.h"
 #import "MyNSMutableAttributedStringAdditions.h"
 
+// Every change to a game which can't be shown by redrawing the end of the
+// move list gets a new stamp, unique across all games:
+static unsigned long LastModificationStamp = 0;
+
+
+@interface Game (PrivateAPI)
+-(id)initWithMoveTree:(PGNMoveTree *)tree;
+-(void)moveListChanged;
+@end
+
+
 @implementation Game
 
 -(id)initWithFEN:(NSString *)fen {
@@ -49,6 +61,7 @@
   result = UNKNOWN;
   clock = [[ChessClock alloc] init];
   FRC = NO;
+  modificationStamp = ++LastModificationStamp;
   //  [self startClock];
 
   return self;
@@ -64,6 +77,15 @@
   GameParser *gp;
   PGNToken token[1];
   char name[PGN_STRING_SIZE], value[PGN_STRING_SIZE];
+  PGNMoveTree *tree;
+
+  // Most games can be read by the fast parser, which builds the game tree
+  // lazily. The rest (and those with errors) go through the GameParser.
+  if((tree = [[PGNMoveTree alloc] initWithPGNString: string]) != nil) {
+    [self initWithMoveTree: tree];
+    [tree release];
+    return self;
+  }
 
   [self init];
 
@@ -195,6 +217,40 @@
   return self;
 }
   
+-(id)initWithMoveTree:(PGNMoveTree *)tree {
+  ChessPosition *position;
+  NSString *value;
+
+  if((value = [tree valueForTag: @"FEN"]) != nil)
+    [self initWithFEN: value];
+  else
+    [self init];
+
+  if((value = [tree valueForTag: @"White"]) != nil)
+    [self setWhitePlayer: value];
+  if((value = [tree valueForTag: @"Black"]) != nil)
+    [self setBlackPlayer: value];
+  if((value = [tree valueForTag: @"Event"]) != nil)
+    [self setEvent: value];
+  if((value = [tree valueForTag: @"Site"]) != nil)
+    [self setSite: value];
+  if((value = [tree valueForTag: @"Round"]) != nil)
+    [self setRound: value];
+  if((value = [tree valueForTag: @"Date"]) != nil)
+    [self setDate: value];
+  result = [tree tree]->result;
+
+  position = [[ChessPosition alloc] init];
+  copy_position([position pos], [tree tree]->start);
+  [root release];
+  root = [[GameNode alloc] initWithPosition: position moveTree: tree];
+  [position release];
+
+  // Like the GameParser, leave the game at the end of the main line
+  [self goToEndOfGame];
+  return self;
+}
+
 -(id)init {
   return [self initWithFEN: [NSString stringWithUTF8String: STARTPOS]];
 }
@@ -302,13 +358,23 @@
   else [clock pushClock];
 }
 
+-(void)moveListChanged {
+  modificationStamp = ++LastModificationStamp;
+}
+
+-(unsigned long)modificationStamp {
+  return modificationStamp;
+}
+
 -(void)insertMove:(ChessMove *)move {
+  if(![self isAtEndOfGame]) [self moveListChanged];
   [currentNode addChildNode: move];
   currentNode = [[currentNode children] lastObject];
   [self pushClock];
 } 
 
 -(void)makeMove:(ChessMove *)move {
+  if([[currentNode children] count] > 0) [self moveListChanged];
   [currentNode removeAllChildNodes];
   [self insertMove: move];
 }
@@ -337,6 +403,7 @@
     GameNode *parent = [currentNode parent];
     [[parent children] removeObjectIdenticalTo: currentNode];
     currentNode = parent;
+    [self moveListChanged];
   }
 }
 
@@ -397,6 +464,7 @@
     [siblings replaceObjectAtIndex: index - 1 withObject: currentNode];
     [siblings replaceObjectAtIndex: index withObject: tmp];
     [tmp release];
+    [self moveListChanged];
   }
 }
 
@@ -409,6 +477,7 @@
     [siblings replaceObjectAtIndex: index + 1 withObject: currentNode];
     [siblings replaceObjectAtIndex: index withObject: tmp];
     [tmp release];
+    [self moveListChanged];
   }
 }
 
@@ -499,13 +568,17 @@
 }
 
 -(void)addComment:(NSString *)comment {
-  if(currentNode != root)
+  if(currentNode != root) {
+    if(![self isAtEndOfGame]) [self moveListChanged];
     [[currentNode move] setComment: comment];
+  }
 }
 
 -(void)deleteComment {
-  if(currentNode != root)
+  if(currentNode != root) {
+    if(![self isAtEndOfGame]) [self moveListChanged];
     [[currentNode move] deleteComment];
+  }
 }
 
 -(BOOL)commentExistsForCurrentMove {
@@ -514,8 +587,10 @@
 }
 
 -(void)addNAG:(int)nag {
-  if(currentNode != root)
+  if(currentNode != root) {
+    if(![self isAtEndOfGame]) [self moveListChanged];
     [[currentNode move] setNAG: nag];
+  }
 }
 
 -(ChessMove *)parseSANMove:(NSString *)str {
@@ -597,15 +672,47 @@ static char ResultString[6][10] =
 
 -(NSAttributedString *)moveListAttributedStringWithComments:(BOOL)includeComments
 						 variations:(BOOL)includeVariations {
-  NSMutableAttributedString *string = 
-    [root moveListAttributedStringWithComments: includeComments
-	  variations: includeVariations
-	  currentNode: currentNode];
-  [string appendString: [NSString stringWithFormat: @"\n%s",
-				  ResultString[result]]];
+  NSMutableAttributedString *string =
+    [NSMutableAttributedString attributedStringWithString: @""];
+  NSMapTable *ranges =
+    NSCreateMapTable(NSNonOwnedPointerMapKeyCallBacks,
+		     NSOwnedPointerMapValueCallBacks, 0);
+  MoveListRange *range;
+
+  [self appendMoveListToAttributedString: string
+	fromNode: root
+	comments: includeComments
+	variations: includeVariations
+	ranges: ranges];
+  if((range = NSMapGet(ranges, currentNode)) != NULL)
+    [string addAttribute: NSBackgroundColorAttributeName
+	    value: [NSColor lightGrayColor]
+	    range: range->move];
+  NSFreeMapTable(ranges);
   return string;
 }
 
+// Appends the move list from a node on the main line to the end of the
+// game, followed by the result. Everything before the node's text stays the
+// same as long as the modification stamp doesn't change, which is what
+// lets a move list view redraw only its end.
+
+-(void)appendMoveListToAttributedString:(NSMutableAttributedString *)str
+			       fromNode:(GameNode *)node
+			       comments:(BOOL)includeComments
+			     variations:(BOOL)includeVariations
+				 ranges:(NSMapTable *)ranges {
+  if(node == root)
+    node = ([[root children] count] > 0)? [root firstChildNode] : nil;
+  [node appendMoveListToAttributedString: str
+	comments: includeComments
+	variations: includeVariations
+	startOfVariation: NO
+	ranges: ranges];
+  [str appendString: [NSString stringWithFormat: @"\n%s",
+			       ResultString[result]]];
+}
+
 -(ChessMove *)generateMoveFrom:(int)from to:(int)to 
 		     promotion:(int)promotion {
   return [[self currentPosition] generateMoveFrom: from to: to
@@ -0,0 +1,76 @@
+/*
+  Stockfish, a OS X GUI for the UCI chess engine with the same name.
+  Copyright (C) 2004-2011 Marco Costalba, Joona Kiiski, Tord Romstad
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#import <Cocoa/Cocoa.h>
+
+#include "annotate.h"
+
+@class AnnotationWorker;
+@class PGN;
+@class PGNProgressController;
+@class PGNWriter;
+
+struct annotated_game_t;
+
+// A GameAnnotator analyzes every mainline position of the games in a PGN
+// file, spread over several AnnotationWorkers, and writes the games with
+// the scores as move comments and NAGs for bad moves to another file. The
+// games are written in the order of the input file, so an interrupted
+// annotation can be resumed after the games already written.
+
+@interface GameAnnotator : NSObject {
+  NSString *filename;
+  NSString *outputFilename;
+  NSString *enginePath;
+  PGN *pgn;
+  PGNWriter *writer;
+  PGNProgressController *progressController;
+  NSMutableArray *workers;
+  struct annotated_game_t *games;  // Games being analyzed, in file order
+  int gamesInProgress, maxGamesInProgress;
+  int numberOfGames, firstGame, nextGame;
+  int gamesAnnotated, errors;
+  int depth, threads, hash;
+  long long nodes;
+  annotation_rules_t rules;
+  BOOL whiteScore;
+  BOOL stopped;
+}
+
++(int)defaultNumberOfWorkers;
+-(id)initWithFilename:(NSString *)aFilename
+       outputFilename:(NSString *)anOutputFilename
+	       engine:(NSString *)engineName
+	       resume:(BOOL)resume;
+-(void)start;
+-(void)stop;
+-(int)searchDepth;
+-(long long)searchNodes;
+-(int)engineThreads;
+-(int)engineHash;
+
+// Messages from the workers:
+-(void)workerIsReady:(AnnotationWorker *)worker;
+-(void)workerDidTerminate:(AnnotationWorker *)worker;
+-(void)worker:(AnnotationWorker *)worker
+     analyzed:(const analysis_t *)analysis
+	 game:(int)number
+	  ply:(int)ply;
+
+@end
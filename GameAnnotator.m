@@ -0,0 +1,466 @@
+/*
+  Stockfish, a OS X GUI for the UCI chess engine with the same name.
+  Copyright (C) 2004-2011 Marco Costalba, Joona Kiiski, Tord Romstad
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#import "AnnotationWorker.h"
+#import "ChessMove.h"
+#import "ChessPosition.h"
+#import "Engine.h"
+#import "Game.h"
+#import "GameAnnotator.h"
+#import "GameNode.h"
+#import "PGN.h"
+#import "PGNProgressController.h"
+#import "PGNWriter.h"
+
+#include "pgnscan.h"
+#include "syzygy.h"
+
+
+// A game being annotated, with the positions along its mainline and their
+// analysis. Games which could not be read are copied to the output file
+// as they are, in their place among the others.
+
+typedef struct annotated_game_t {
+  int number;            // Game number in the input file
+  Game *game;            // nil if the game could not be read
+  NSString *pgnString;   // The game as it was in the input file
+  NSMutableArray *positions;
+  NSMutableString *positionCommand;  // The mainline as a position command
+  int *commandLengths;   // Length of the command up to each position
+  analysis_t *analyses;
+  int nextPosition;      // The next position to give to a worker
+  int positionsLeft;     // Positions which have not been analyzed
+} annotated_game_t;
+
+
+@interface GameAnnotator (PrivateAPI)
+-(void)giveWorkTo:(AnnotationWorker *)worker;
+-(void)addAnalysis:(const analysis_t *)analysis game:(int)number ply:(int)ply;
+-(BOOL)loadNextGame;
+-(void)writeFinishedGames;
+-(void)annotateGame:(annotated_game_t *)g;
+-(NSString *)stringForAnalysis:(const analysis_t *)a whiteMoves:(BOOL)white;
+-(void)freeGame:(annotated_game_t *)g;
+-(void)progressWindowWillClose:(NSNotification *)aNotification;
+-(void)finishAnnotation;
+-(void)abortAnnotation;
+@end
+
+
+@implementation GameAnnotator
+
+// The engines together use one thread per core unless told otherwise.
+
++(int)defaultNumberOfWorkers {
+  NSUserDefaults *defaults = [NSUserDefaults standardUserDefaults];
+  int n = [defaults integerForKey: @"Annotation Engine Processes"];
+  if(n <= 0)
+    n = MAX(pgn_cpu_count() /
+	    MAX([defaults integerForKey: @"Annotation Engine Threads"], 1), 1);
+  return n;
+}
+
+-(id)initWithFilename:(NSString *)aFilename
+       outputFilename:(NSString *)anOutputFilename
+	       engine:(NSString *)engineName
+	       resume:(BOOL)resume {
+  NSUserDefaults *defaults = [NSUserDefaults standardUserDefaults];
+
+  self = [super init];
+  filename = [aFilename retain];
+  outputFilename = [anOutputFilename retain];
+  enginePath = [[Engine pathOfEngineWithName: engineName] retain];
+  workers = [[NSMutableArray alloc] init];
+  depth = [defaults integerForKey: @"Annotation Depth"];
+  nodes = [[defaults objectForKey: @"Annotation Nodes"] longLongValue];
+  if(depth <= 0 && nodes <= 0) depth = 1;
+  threads = MAX([defaults integerForKey: @"Annotation Engine Threads"], 1);
+  hash = MAX([defaults integerForKey: @"Annotation Engine Hash"], 1);
+  rules.inaccuracy = [defaults integerForKey: @"Annotation Inaccuracy Limit"];
+  rules.mistake = [defaults integerForKey: @"Annotation Mistake Limit"];
+  rules.blunder = [defaults integerForKey: @"Annotation Blunder Limit"];
+  whiteScore =
+    [defaults boolForKey: @"Display all Scores from White's Point of View"];
+
+  @try {
+    pgn = [[PGN alloc] initWithFilename: filename];
+    [pgn initializeGameIndices];
+    numberOfGames = [pgn numberOfGames];
+
+    // The games in the output file were annotated before:
+    if(resume &&
+       [[NSFileManager defaultManager] fileExistsAtPath: outputFilename]) {
+      PGN *output = [[PGN alloc] initWithFilename: outputFilename];
+      [output initializeGameIndicesQuietly];
+      firstGame = MIN([output numberOfGames], numberOfGames);
+      [output close];
+      [output release];
+    }
+    else
+      [[NSFileManager defaultManager] removeFileAtPath: outputFilename
+				      handler: nil];
+    writer = [[PGNWriter alloc] initWithFilename: outputFilename];
+  }
+  @catch (NSException *e) {
+    [self release];
+    @throw;
+  }
+  nextGame = firstGame;
+  return self;
+}
+
+-(void)start {
+  int i, n = [GameAnnotator defaultNumberOfWorkers];
+  NSString *title = [filename lastPathComponent];
+
+  progressController =
+    [[PGNProgressController alloc] initWithFilename: title];
+  [[progressController window]
+    setTitle: [NSString stringWithFormat: @"Annotating games in %@...",
+			title]];
+  [progressController setDoubleValue: (firstGame * 100.0) /
+		      MAX(numberOfGames, 1)];
+  [progressController showWindow: self];
+  [[NSNotificationCenter defaultCenter]
+    addObserver: self
+    selector: @selector(progressWindowWillClose:)
+    name: NSWindowWillCloseNotification
+    object: [progressController window]];
+
+  // We stay alive until the annotation is finished or stopped:
+  [self retain];
+
+  if(nextGame >= numberOfGames) {
+    [self finishAnnotation];
+    return;
+  }
+
+  // Each worker keeps a few games open at a time at most, so that the
+  // games can be written in order without keeping many in memory:
+  maxGamesInProgress = 2 * n + 1;
+  games = malloc(maxGamesInProgress * sizeof(annotated_game_t));
+  for(i = 0; i < n; i++) {
+    AnnotationWorker *worker =
+      [[AnnotationWorker alloc] initWithAnnotator: self engine: enginePath];
+    [workers addObject: worker];
+    [worker release];
+  }
+}
+
+-(void)stop {
+  int i;
+
+  stopped = YES;
+  [workers makeObjectsPerformSelector: @selector(stop)];
+  [workers removeAllObjects];
+  [writer close];
+  for(i = 0; i < gamesInProgress; i++)
+    [self freeGame: games + i];
+  gamesInProgress = 0;
+}
+
+-(int)searchDepth {
+  return depth;
+}
+
+-(long long)searchNodes {
+  return nodes;
+}
+
+-(int)engineThreads {
+  return threads;
+}
+
+-(int)engineHash {
+  return hash;
+}
+
+-(void)workerIsReady:(AnnotationWorker *)worker {
+  if(!stopped)
+    [self giveWorkTo: worker];
+}
+
+-(void)worker:(AnnotationWorker *)worker
+     analyzed:(const analysis_t *)analysis
+	 game:(int)number
+	  ply:(int)ply {
+  if(!stopped)
+    [self addAnalysis: analysis game: number ply: ply];
+}
+
+// The position a crashed engine was analyzing gets what was found before
+// the crash, often nothing, and the annotation goes on with the other
+// workers as long as there are any.
+
+-(void)workerDidTerminate:(AnnotationWorker *)worker {
+  analysis_t analysis;
+  int number, ply;
+
+  if(stopped) return;
+  [[worker retain] autorelease];
+  [workers removeObjectIdenticalTo: worker];
+  if([workers count] == 0) {
+    [self abortAnnotation];
+    return;
+  }
+  if([worker takeUnfinishedAnalysis: &analysis game: &number ply: &ply])
+    [self addAnalysis: &analysis game: number ply: ply];
+}
+
+-(void)dealloc {
+  [[NSNotificationCenter defaultCenter] removeObserver: self];
+  [self stop];
+  free(games);
+  [filename release];
+  [outputFilename release];
+  [enginePath release];
+  [pgn close];
+  [pgn release];
+  [writer release];
+  [progressController release];
+  [workers release];
+  [super dealloc];
+}
+
+@end
+
+
+@implementation GameAnnotator (PrivateAPI)
+
+// Gives the worker the first position not given out yet, in the games
+// being analyzed or the next game of the file.
+
+-(void)giveWorkTo:(AnnotationWorker *)worker {
+  annotated_game_t *g;
+  int i = 0;
+
+  if(![worker isReady] || [worker isAnalyzing]) return;
+  while(i < gamesInProgress || [self loadNextGame]) {
+    g = games + i++;
+    if(g->game != nil && g->nextPosition < [g->positions count]) {
+      int ply = g->nextPosition++;
+      [worker analyzePosition: [g->positions objectAtIndex: ply]
+	      command: [g->positionCommand
+			 substringToIndex: g->commandLengths[ply]]
+	      FRC: [g->game isFRCGame]
+	      game: g->number
+	      ply: ply];
+      return;
+    }
+  }
+}
+
+-(void)addAnalysis:(const analysis_t *)analysis game:(int)number ply:(int)ply {
+  int i;
+
+  for(i = 0; i < gamesInProgress; i++)
+    if(games[i].number == number) {
+      games[i].analyses[ply] = *analysis;
+      games[i].positionsLeft--;
+      break;
+    }
+  [self writeFinishedGames];
+  if(gamesInProgress == 0 && nextGame >= numberOfGames) {
+    [self finishAnnotation];
+    return;
+  }
+
+  // Writing games makes room for new ones, which idle workers can start:
+  for(i = 0; i < [workers count]; i++)
+    [self giveWorkTo: [workers objectAtIndex: i]];
+}
+
+-(BOOL)loadNextGame {
+  annotated_game_t *g;
+  GameNode *node;
+  int i;
+
+  if(gamesInProgress >= maxGamesInProgress || nextGame >= numberOfGames)
+    return NO;
+  g = games + gamesInProgress++;
+  g->number = nextGame++;
+  g->game = nil;
+  g->pgnString = nil;
+  g->positions = nil;
+  g->positionCommand = nil;
+  g->commandLengths = NULL;
+  g->analyses = NULL;
+  g->nextPosition = g->positionsLeft = 0;
+  @try {
+    g->pgnString = [[pgn pgnStringForGameNumber: g->number] retain];
+    g->game = [[Game alloc] initWithPGNString: g->pgnString];
+  }
+  @catch (NSException *e) {
+    NSLog(@"Error in %@, game %d: %@", filename, g->number + 1, [e reason]);
+    errors++;
+    return YES;
+  }
+  // Each position is sent with the moves leading to it, so that the engine
+  // knows about repetitions:
+  g->positions = [[NSMutableArray alloc] init];
+  g->positionCommand = [[NSMutableString alloc]
+			 initWithFormat: @"position fen %@", [g->game rootFEN]];
+  for(node = [g->game root]; ; node = [node firstChildNode]) {
+    i = [g->positions count];
+    if(i > 0)
+      [g->positionCommand appendFormat: (i == 1)? @" moves %@" : @" %@",
+		       [node UCIStringInFRCGame: [g->game isFRCGame]]];
+    [g->positions addObject: [node position]];
+    g->commandLengths = realloc(g->commandLengths, (i + 1) * sizeof(int));
+    g->commandLengths[i] = [g->positionCommand length];
+    if([[node children] count] == 0) break;
+  }
+  g->positionsLeft = [g->positions count];
+  g->analyses = malloc(g->positionsLeft * sizeof(analysis_t));
+  return YES;
+}
+
+-(void)writeFinishedGames {
+  while(gamesInProgress > 0 && games[0].positionsLeft == 0) {
+    if(games[0].game != nil) {
+      [self annotateGame: games];
+      [writer writeGame: games[0].game];
+    }
+    else if(games[0].pgnString != nil)
+      [writer writePGNString:
+		[[games[0].pgnString stringByTrimmingCharactersInSet:
+			       [NSCharacterSet whitespaceAndNewlineCharacterSet]]
+		  stringByAppendingString: @"\n\n"]];
+    gamesAnnotated++;
+    [self freeGame: games];
+    memmove(games, games + 1, --gamesInProgress * sizeof(annotated_game_t));
+  }
+  [progressController setDoubleValue: ((firstGame + gamesAnnotated) * 100.0) /
+		      MAX(numberOfGames, 1)];
+}
+
+// Each move gets the score of the position after it as a comment, after
+// the comment it already had. A move which is marked as bad also gets the
+// engine's best move and its score.
+
+-(void)annotateGame:(annotated_game_t *)g {
+  Game *game = g->game;
+  ChessPosition *position;
+  ChessMove *move, *bestMove;
+  NSString *comment;
+  analysis_t *before, moveAnalysis;
+  int i, nag;
+
+  [game goToBeginningOfGame];
+  for(i = 1; i < [g->positions count]; i++) {
+    [game stepForward];
+    position = [g->positions objectAtIndex: i - 1];
+    move = [[game currentNode] move];
+    before = g->analyses + i - 1;
+    analysis_of_move(g->analyses + i, &moveAnalysis);
+    if(moveAnalysis.depth == 0 && !moveAnalysis.tablebase &&
+       !moveAnalysis.terminal)
+      continue;
+
+    comment = [self stringForAnalysis: &moveAnalysis
+		    whiteMoves: [position whiteToMove]];
+    nag = annotation_nag(&rules, before, g->analyses + i, [move move]);
+    if(nag != ANNOTATE_NAG_NONE && ![move hasNAG]) {
+      [game addNAG: nag];
+      if(before->move != NoMove) {
+	bestMove = [[ChessMove alloc] initWithPosition: position
+				      move: before->move];
+	comment = [NSString stringWithFormat: @"%@ Best: %@ %@", comment,
+			    [bestMove SANString],
+			    [self stringForAnalysis: before
+				  whiteMoves: [position whiteToMove]]];
+	[bestMove release];
+      }
+    }
+    if([move hasComment])
+      comment = [NSString stringWithFormat: @"%@ %@", [move comment], comment];
+    [game addComment: comment];
+  }
+}
+
+// Scores in the format of the engine comments in games played by the GUI,
+// from the point of view of the side to move.
+
+-(NSString *)stringForAnalysis:(const analysis_t *)a whiteMoves:(BOOL)white {
+  int score = (whiteScore && !white)? -a->score : a->score;
+
+  if(a->terminal)
+    return (a->score_type == UCI_SCORE_MATE)? @"Mate" : @"Stalemate";
+  if(a->tablebase) {
+    if(a->score == TB_WIN || a->score == TB_LOSS)
+      return (white == (a->score == TB_WIN))?
+	@"Tablebase win for White" : @"Tablebase win for Black";
+    return @"Tablebase draw";
+  }
+  if(a->score_type == UCI_SCORE_CP && score >= 0)
+    return [NSString stringWithFormat: @"+%.2f/%d",
+		     (float)score / 100.0, a->depth];
+  else if(a->score_type == UCI_SCORE_CP)
+    return [NSString stringWithFormat: @"%.2f/%d",
+		     (float)score / 100.0, a->depth];
+  else if(score > 0)
+    return [NSString stringWithFormat: @"+#%d/%d", score, a->depth];
+  else
+    return [NSString stringWithFormat: @"-#%d/%d", -score, a->depth];
+}
+
+-(void)freeGame:(annotated_game_t *)g {
+  [g->game release];
+  [g->pgnString release];
+  [g->positions release];
+  [g->positionCommand release];
+  free(g->commandLengths);
+  free(g->analyses);
+}
+
+// Closing the progress window stops the annotation. The games written so
+// far are kept, and the annotation can be resumed later.
+
+-(void)progressWindowWillClose:(NSNotification *)aNotification {
+  [[NSNotificationCenter defaultCenter] removeObserver: self];
+  if(!stopped) {
+    [self stop];
+    [self release];
+  }
+}
+
+-(void)finishAnnotation {
+  [[NSNotificationCenter defaultCenter] removeObserver: self];
+  [self stop];
+  [[progressController window] close];
+  NSRunAlertPanel(@"Games annotated",
+		  @"Annotated %d games from %@ to %@. %d games could not be read and were copied without annotations.",
+		  nil, nil, nil, gamesAnnotated - errors,
+		  [filename lastPathComponent],
+		  [outputFilename lastPathComponent], errors);
+  [self release];
+}
+
+-(void)abortAnnotation {
+  [[NSNotificationCenter defaultCenter] removeObserver: self];
+  [self stop];
+  [[progressController window] close];
+  NSRunAlertPanel(@"Annotation stopped",
+		  @"The engine terminated. %d games were annotated to %@; the annotation can be resumed later.",
+		  nil, nil, nil, gamesAnnotated,
+		  [outputFilename lastPathComponent]);
+  [self release];
+}
+
+@end
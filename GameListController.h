@@ -26,14 +26,25 @@
   BoardController *boardController;
   IBOutlet id gameList;
   NSString *filename;
-  PGN *pgnFile;
+  id pgnFile;   // A PGN or a PGNDatabase
   BOOL pgnFileFinishedLoading;
   BOOL errorWhileReadingFile;
+  BOOL watchingFile;
+  int watchQueue;    // The kqueue of the thread watching the file
+  BOOL fileChangePending;
+  NSPopUpButton *queryType;
+  NSSearchField *queryField;
+  int *shownGames;   // The games matching the query, or NULL for all
+  int shownGameCount;
 }
 
 -(id)initWithBoardController:(BoardController *)bc
 		    filename:(NSString *)aFilename;
+-(id)initWithBoardController:(BoardController *)bc
+		   filenames:(NSArray *)filenames
+		       title:(NSString *)aTitle;
 -(IBAction)closeGameFile:(id)sender;
 -(IBAction)loadGame:(id)sender;
+-(IBAction)findGames:(id)sender;
 
 @end
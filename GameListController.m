@@ -18,9 +18,20 @@
 
 
 #import "BoardController.h"
+#import "ChessPosition.h"
+#import "Game.h"
 #import "GameListController.h"
 #import "GameParser.h"
 #import "PGN.h"
+#import "PGNDatabase.h"
+
+#import <fcntl.h>
+#import <sys/event.h>
+
+#include "pgnquery.h"
+
+// Items of the query type menu:
+enum { QUERY_TAGS, QUERY_POSITION, QUERY_MATERIAL };
 
 
 // private  methods:
@@ -28,6 +39,11 @@
 @interface GameListController (PrivateAPI)
 -(void)initializeGameIndicesInBackground:(id)ignore;
 -(void)finishedReadingIndices:(NSNotification *)note;
+-(void)watchFile:(id)ignore;
+-(void)stopWatchingFile;
+-(void)addQueryControls;
+-(int)gameNumberForRow:(int)row;
+-(void)fileDidChange:(id)ignore;
 @end
 
 @implementation GameListController
@@ -75,6 +91,36 @@
   
   pgnFileFinishedLoading = YES;
 
+  // Watch the file for changes, so that games appended to it (for instance
+  // by an engine match, or by a live broadcast) show up in the game list:
+  watchQueue = -1;
+  if(!errorWhileReadingFile && (watchQueue = kqueue()) >= 0) {
+    watchingFile = YES;
+    [NSThread detachNewThreadSelector: @selector(watchFile:)
+	      toTarget: self
+	      withObject: nil];
+  }
+
+  return self;
+}
+
+// Opens a set of PGN files as a single game list. The files are not
+// watched for changes.
+
+-(id)initWithBoardController:(BoardController *)bc
+		   filenames:(NSArray *)filenames
+		       title:(NSString *)aTitle {
+  self = [super initWithWindowNibName: @"GameList"];
+  pgnFileFinishedLoading = NO;
+  boardController = bc;
+  filename = [aTitle retain];
+  watchQueue = -1;
+  errorWhileReadingFile = NO;
+
+  pgnFile = [[PGNDatabase alloc] initWithFilenames: filenames name: aTitle];
+  [pgnFile initializeGameIndices];
+  pgnFileFinishedLoading = YES;
+
   return self;
 }
 
@@ -94,21 +140,105 @@
   pgnFileFinishedLoading = YES;
 }
 
+// The kqueue is closed by -stopWatchingFile, which wakes up the thread if
+// it is waiting.
+
+-(void)watchFile:(id)ignore {
+  NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+  const char *path = [filename fileSystemRepresentation];
+  struct kevent change, event;
+  struct timespec timeout = {1, 0};
+  int kq = watchQueue, fd = -1;
+
+  while(watchingFile) {
+    if(fd < 0) {
+      if((fd = open(path, O_EVTONLY)) < 0) {
+	sleep(1);
+	continue;
+      }
+      EV_SET(&change, fd, EVFILT_VNODE, EV_ADD | EV_CLEAR,
+	     NOTE_WRITE | NOTE_EXTEND | NOTE_DELETE | NOTE_RENAME, 0, NULL);
+      if(kevent(kq, &change, 1, NULL, 0, NULL) < 0) {
+	close(fd); fd = -1;
+	sleep(1);
+	continue;
+      }
+    }
+    // Wake up regularly to see if we should stop watching:
+    if(kevent(kq, NULL, 0, &event, 1, &timeout) > 0) {
+      if(event.fflags & (NOTE_DELETE | NOTE_RENAME)) {
+	// The file was replaced. Start watching the new file.
+	close(fd); fd = -1;
+      }
+      if(!fileChangePending) {
+	fileChangePending = YES;
+	[self performSelectorOnMainThread: @selector(fileDidChange:)
+	      withObject: nil
+	      waitUntilDone: NO];
+      }
+    }
+  }
+  if(fd >= 0) close(fd);
+  [pool release];
+}
+
+-(void)stopWatchingFile {
+  watchingFile = NO;
+  if(watchQueue >= 0) {
+    close(watchQueue);
+    watchQueue = -1;
+  }
+}
+
+-(void)fileDidChange:(id)ignore {
+  int newGames;
+
+  fileChangePending = NO;
+  if(!watchingFile || pgnFile == nil) return;
+  newGames = [pgnFile indexNewGames];
+  // The query is not run again, so a filtered list stays as it is:
+  if(shownGames != NULL) return;
+  if(newGames < 0) 
+    [gameList reloadData];
+  else if(newGames > 0) 
+    [gameList noteNumberOfRowsChanged];
+}
+
+-(void)windowWillClose:(NSNotification *)aNotification {
+  [self stopWatchingFile];
+}
+
 -(void)doubleClickInGameList:(id)sender {
   [self loadGame: sender];
 }
 
 -(void)windowDidLoad {
+  [[self window] setDelegate: self];
   [[self window] setTitle: [filename lastPathComponent]];
   [gameList setDoubleAction: @selector(doubleClickInGameList:)];
+
+  // Show which file each game comes from:
+  if([pgnFile isKindOfClass: [PGNDatabase class]]) {
+    NSTableColumn *column = 
+      [[NSTableColumn alloc] initWithIdentifier: @"FILE"];
+    [[column headerCell] setStringValue: @"File"];
+    [column setEditable: NO];
+    [column setWidth: 120.0];
+    [gameList addTableColumn: column];
+    [column release];
+  }
+  [self addQueryControls];
 }
 
 -(int)numberOfRowsInTableView:(id)aTableView {
+  if(shownGames != NULL) return shownGameCount;
   return [pgnFile numberOfGames];
 }
 
 -(id)tableView:(id)aTableView objectValueForTableColumn:(id)aTableColumn
-	   row:(int)rowIndex {
+	   row:(int)row {
+  int rowIndex = [self gameNumberForRow: row];
+
   if(!pgnFileFinishedLoading) return [NSString stringWithFormat: @""];
   [pgnFile goToGameNumber: rowIndex];
   if([[aTableColumn identifier] isEqualToString: @"GAME"])
@@ -119,24 +249,112 @@
     return [pgnFile black];
   else if([[aTableColumn identifier] isEqualToString: @"RESULT"])
     return [pgnFile result];
+  else if([[aTableColumn identifier] isEqualToString: @"FILE"])
+    return [[pgnFile filenameForGameNumber: rowIndex] lastPathComponent];
   else return [NSString stringWithFormat: @""];
 }
 
 -(IBAction)closeGameFile:(id)sender {
+  [self stopWatchingFile];
   [[self window] close];
   [pgnFile release];
+  pgnFile = nil;
 }
 
 -(IBAction)loadGame:(id)sender {
+  if([gameList selectedRow] < 0) return;
   [boardController newGameWithPGNString:
-		     [pgnFile pgnStringForGameNumber: [gameList selectedRow]]];
+		     [pgnFile pgnStringForGameNumber:
+				[self gameNumberForRow: [gameList selectedRow]]]];
   [boardController raiseBoardWindow];
 }
 
+// Shows the games whose tags contain the text in the query field, and
+// which reach the position or the material of the board, depending on the
+// query type. A tag query without text shows all games again. In a
+// database, all files are searched at once.
+
+-(IBAction)findGames:(id)sender {
+  NSString *text = [queryField stringValue];
+  position_t *pos = [[[boardController game] currentPosition] pos];
+  pgn_query_t query;
+  NSIndexSet *games;
+  NSUInteger number;
+
+  pgn_query_init(&query);
+  if([text length] > 0)
+    pgn_query_add_tag(&query, "", [text UTF8String]);
+  if([queryType indexOfSelectedItem] == QUERY_POSITION)
+    pgn_query_set_position(&query, pos);
+  else if([queryType indexOfSelectedItem] == QUERY_MATERIAL)
+    pgn_query_set_material(&query, pos);
+
+  free(shownGames);
+  shownGames = NULL;
+  if(!pgn_query_is_empty(&query)) {
+    games = [pgnFile gamesMatchingQuery: &query];
+    shownGameCount = 0;
+    shownGames = malloc(MAX([games count], 1) * sizeof(int));
+    for(number = [games firstIndex]; number != NSNotFound;
+	number = [games indexGreaterThanIndex: number])
+      shownGames[shownGameCount++] = number;
+  }
+  [gameList deselectAll: self];
+  [gameList reloadData];
+}
+
 -(void)dealloc {
+  free(shownGames);
   [filename release];
   if(pgnFile) [pgnFile release];
   [super dealloc];
 }
 
 @end
+
+
+@implementation GameListController (PrivateAPI)
+
+// The query controls go above the game list, which is made smaller to
+// make room for them.
+
+-(void)addQueryControls {
+  NSScrollView *scrollView = [gameList enclosingScrollView];
+  NSRect frame = [scrollView frame];
+  NSView *contentView = [[self window] contentView];
+  const float height = 32.0;
+
+  frame.size.height -= height;
+  [scrollView setFrame: frame];
+
+  queryType = [[NSPopUpButton alloc]
+		initWithFrame: NSMakeRect(frame.origin.x,
+					  NSMaxY(frame) + 4.0, 110.0, 24.0)
+		pullsDown: NO];
+  [queryType addItemsWithTitles:
+	       [NSArray arrayWithObjects: @"Tags", @"Board Position",
+			@"Board Material", nil]];
+  [queryType setTarget: self];
+  [queryType setAction: @selector(findGames:)];
+  [queryType setAutoresizingMask: NSViewMinYMargin];
+  [contentView addSubview: queryType];
+  [queryType release];
+
+  queryField = [[NSSearchField alloc]
+		 initWithFrame: NSMakeRect(frame.origin.x + 118.0,
+					   NSMaxY(frame) + 6.0,
+					   frame.size.width - 118.0, 22.0)];
+  [[queryField cell] setPlaceholderString: @"Player, event, site, ..."];
+  [[queryField cell] setSendsWholeSearchString: YES];
+  [queryField setTarget: self];
+  [queryField setAction: @selector(findGames:)];
+  [queryField setAutoresizingMask: NSViewWidthSizable | NSViewMinYMargin];
+  [contentView addSubview: queryField];
+  [queryField release];
+}
+
+-(int)gameNumberForRow:(int)row {
+  return (shownGames != NULL)? shownGames[row] : row;
+}
+
+@end
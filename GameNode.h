@@ -21,20 +21,50 @@
 
 @class ChessPosition;
 @class ChessMove;
+@class PGNMoveTree;
+
+// Where the text of a node starts in a rendered move list (including the
+// move number), and where its move is:
+typedef struct {
+  NSUInteger start;
+  NSRange move;
+} MoveListRange;
+
+// To keep large game trees small, a node only stores the position at
+// checkpoints (the root and every CHECKPOINT_INTERVAL plies below it). The
+// positions of other nodes are rebuilt from the nearest checkpoint above
+// them when asked for, and the most recently used ones are kept in a small
+// cache shared by the nodes of one tree. Nodes
+// without children have no children array. Games loaded from a PGNMoveTree
+// create their nodes only when they are first visited.
 
 @interface GameNode : NSObject {
   ChessPosition *position;
   ChessMove *move;
   GameNode *parent;
   NSMutableArray *children;
+  int ply;
+  int gply;               // Like the gply of the node's position
+  int moveNumber;
+  BOOL whiteToMove;
+  PGNMoveTree *moveTree;  // Set until the children have been created
+  int moveTreeIndex;
+  NSString *UCIString;
+  struct position_cache_t *positionCache;  // Shared by all nodes of the tree
 }
 
 -(id)initWithPosition:(ChessPosition *)pos move:(ChessMove *)mv
 	       parent:(GameNode *)pnode;
 -(id)initWithPosition:(ChessPosition *)pos;
+-(id)initWithPosition:(ChessPosition *)pos moveTree:(PGNMoveTree *)tree;
 -(id)init;
 -(id)position;
 -(id)move;
+-(NSString *)SANString;
+-(NSString *)UCIStringInFRCGame:(BOOL)frc;
+-(int)ply;
+-(int)moveNumber;
+-(BOOL)whiteToMove;
 -(GameNode *)parent;
 -(NSMutableArray *)children;
 -(void)addChildNode:(ChessMove *)mv;
@@ -52,8 +82,10 @@
 -(NSString *)moveListString;
 -(NSString *)moveListStringWithComments:(BOOL)includeComments
 			     variations:(BOOL)includeVariations;
--(NSAttributedString *)moveListAttributedStringWithComments:(BOOL)includeComments
-						 variations:(BOOL)includeVariations
-						currentNode:(GameNode *)currentNode;
+-(void)appendMoveListToAttributedString:(NSMutableAttributedString *)str
+			       comments:(BOOL)includeComments
+			     variations:(BOOL)includeVariations
+		       startOfVariation:(BOOL)startOfVariation
+				 ranges:(NSMapTable *)ranges;
 
 @end
@@ -20,10 +20,49 @@
 #import "GameNode.h"
 #import "ChessMove.h"
 #import "ChessPosition.h"
+#import "PGNMoveTree.h"
 
 #import "MyNSAttributedStringAdditions.h"
 #import "MyNSMutableAttributedStringAdditions.h"
 
+
+// Number of plies between two nodes which store their positions:
+#define CHECKPOINT_INTERVAL 16
+
+// Number of rebuilt positions kept in the cache:
+#define POSITION_CACHE_SIZE 32
+
+typedef struct {
+  GameNode *node;
+  ChessPosition *position;
+  unsigned lastUse;
+} cache_entry_t;
+
+// Each game tree has a cache of its own, created by the root and freed when
+// the last node referring to it goes away. Like the rest of the tree, it
+// is only used by one thread at a time.
+
+typedef struct position_cache_t {
+  cache_entry_t entries[POSITION_CACHE_SIZE];
+  unsigned clock;
+  int lastHit;
+  int references;
+} position_cache_t;
+
+static ChessPosition *cachedPositionForNode(GameNode *node);
+static void cachePositionForNode(GameNode *node, ChessPosition *position);
+static void removeNodeFromCache(GameNode *node);
+static void releasePositionCache(position_cache_t *cache);
+
+
+@interface GameNode (PrivateAPI)
+-(id)initWithMove:(ChessMove *)mv parent:(GameNode *)pnode
+	 moveTree:(PGNMoveTree *)tree index:(int)index;
+-(void)expand;
+-(ChessPosition *)rebuildPosition;
+@end
+
+
 @implementation GameNode
 
 -(id)initWithPosition:(ChessPosition *)pos move:(ChessMove *)mv
@@ -31,10 +70,26 @@
   [super init];
   //  NSLog(@"Creating new node with pos = %@, move = %@, parent = %@",
   //	pos, move, parent);
-  position = [pos retain];
   move = [mv retain];
   parent = pnode; // [pnode retain];
-  children = [[NSMutableArray alloc] init];
+  children = nil;
+  ply = (parent == nil)? 0 : [parent ply] + 1;
+  if(parent == nil)
+    positionCache = calloc(1, sizeof(position_cache_t));
+  else
+    positionCache = parent->positionCache;
+  positionCache->references++;
+  gply = [pos pos]->gply;
+  moveNumber = [pos moveNumber];
+  whiteToMove = [pos whiteToMove];
+  if(ply % CHECKPOINT_INTERVAL == 0)
+    position = [pos retain];
+  else {
+    // The position is usually needed again right away, when the new node
+    // becomes the current node:
+    position = nil;
+    cachePositionForNode(self, pos);
+  }
 
   return self;
 }
@@ -43,28 +98,171 @@
   return [self initWithPosition: pos move: nil parent: nil];
 }
 
+// Creates the root of a game loaded into a PGNMoveTree. The rest of the
+// nodes are created from the tree when they are first asked for.
+
+-(id)initWithPosition:(ChessPosition *)pos moveTree:(PGNMoveTree *)tree {
+  [self initWithPosition: pos move: nil parent: nil];
+  moveTree = [tree retain];
+  moveTreeIndex = 0;
+  return self;
+}
+
+// A node from a PGNMoveTree knows neither its position nor the SAN string
+// of its move until they are needed. Its move number and side to move
+// follow from its parent's, the move number computed as by ChessPosition.
+
+-(id)initWithMove:(ChessMove *)mv parent:(GameNode *)pnode
+	 moveTree:(PGNMoveTree *)tree index:(int)index {
+  [super init];
+  move = [mv retain];
+  parent = pnode;
+  children = nil;
+  position = nil;
+  ply = [parent ply] + 1;
+  positionCache = parent->positionCache;
+  positionCache->references++;
+  whiteToMove = ![parent whiteToMove];
+  gply = parent->gply + 1;
+  if(whiteToMove == (gply % 2 == 0))
+    moveNumber = gply / 2 + 1;
+  else
+    moveNumber = gply / 2 + 2;
+  moveTree = [tree retain];
+  moveTreeIndex = index;
+  return self;
+}
+
+// Creates the child nodes of a node from a PGNMoveTree.
+
+-(void)expand {
+  pgn_tree_t *tree;
+  pgn_tree_node_t *n;
+  ChessMove *mv;
+  GameNode *child;
+  int i;
+
+  if(moveTree == nil) return;
+  tree = [moveTree tree];
+  for(i = tree->nodes[moveTreeIndex].first_child; i >= 0; i = n->next_sibling) {
+    n = tree->nodes + i;
+    mv = [[ChessMove alloc] initWithMove: n->move];
+    if(n->comment >= 0)
+      [mv setComment: [moveTree stringWithBytes: tree->text + n->comment
+				length: n->comment_length]];
+    if(n->nag != 0)
+      [mv setNAG: n->nag];
+    child = [[GameNode alloc] initWithMove: mv parent: self
+			      moveTree: moveTree index: i];
+    if(children == nil)
+      children = [[NSMutableArray alloc] init];
+    [children addObject: child];
+    [child release];
+    [mv release];
+  }
+  [moveTree release];
+  moveTree = nil;
+}
+
 -(id)init {
   return [self initWithPosition: [ChessPosition initialPosition]];
 }
 
 -(id)position {
-  return position;
+  ChessPosition *p;
+
+  if(position != nil) return position;
+  if(ply % CHECKPOINT_INTERVAL == 0) {
+    // A checkpoint from a PGNMoveTree which hasn't been needed before
+    position = [[self rebuildPosition] retain];
+    return position;
+  }
+  if((p = cachedPositionForNode(self)) == nil) {
+    p = [self rebuildPosition];
+    cachePositionForNode(self, p);
+  }
+  return p;
+}
+
+// Replays the moves from the nearest ancestor with a known position. This
+// is at most CHECKPOINT_INTERVAL - 1 moves, except in games loaded from a
+// PGNMoveTree, where checkpoints get their positions on the way.
+
+-(ChessPosition *)rebuildPosition {
+  GameNode **path, *node;
+  ChessPosition *start = nil, *p;
+  undo_info_t u[1];
+  int n = 0;
+
+  path = malloc((ply + 1) * sizeof(GameNode *));
+  for(node = self; start == nil; node = node->parent) {
+    if(node->position != nil)
+      start = node->position;
+    else if(node == self || (start = cachedPositionForNode(node)) == nil)
+      path[n++] = node;
+  }
+  p = [[[ChessPosition alloc] init] autorelease];
+  copy_position([p pos], [start pos]);
+  while(n > 0) {
+    node = path[--n];
+    make_move([p pos], [node->move move], u);
+    if(node != self && node->ply % CHECKPOINT_INTERVAL == 0) {
+      node->position = [[ChessPosition alloc] init];
+      copy_position([node->position pos], [p pos]);
+    }
+  }
+  free(path);
+  return p;
+}
+
+// The SAN string of the move leading to this node.
+
+-(NSString *)SANString {
+  if([move SANString] == nil)
+    [move setSANStringFromPosition: [parent position]];
+  return [move SANString];
+}
+
+// The move leading to this node in UCI notation. In FRC games, castling
+// moves are written as the king capturing its rook.
+
+-(NSString *)UCIStringInFRCGame:(BOOL)frc {
+  if(frc && [move isKingsideCastle])
+    return [[parent position] UCIStringFromOOMove: move];
+  if(frc && [move isQueensideCastle])
+    return [[parent position] UCIStringFromOOOMove: move];
+  if(UCIString == nil)
+    UCIString = [[move UCIString] retain];
+  return UCIString;
 }
 
 -(id)move {
   return move;
 }
 
+-(int)ply {
+  return ply;
+}
+
+-(int)moveNumber {
+  return moveNumber;
+}
+
+-(BOOL)whiteToMove {
+  return whiteToMove;
+}
+
 -(GameNode *)parent {
   return parent;
 }
 
 -(NSMutableArray *)children {
+  if(moveTree != nil) [self expand];
   return children;
 }
 
 -(id)childNodeAtIndex:(int)index {
-  return [children objectAtIndex: index];
+  return [[self children] objectAtIndex: index];
 }
 
 -(id)firstChildNode {
@@ -73,7 +271,7 @@
 
 -(NSArray *)remainingChildNodes {
   NSRange range;
-  int numOfChildren = [children count];
+  int numOfChildren = [[self children] count];
   if(numOfChildren <= 1) return nil;
   range.location = 1;
   range.length = [children count] - 1;
@@ -96,20 +294,26 @@
   //  [mv retain];
   newNode = [[GameNode alloc] initWithPosition: [ChessPosition
                                                   positionAfterMakingMove: mv
-                                                  fromPosition: position]
+                                                  fromPosition: [self position]]
                               move: mv
                               parent: self];
+  if(moveTree != nil) [self expand];
+  if(children == nil)
+    children = [[NSMutableArray alloc] init];
   [children addObject: newNode];
   [newNode release];
   //  [mv release];
 }
 
 -(void)removeChildNodeAtIndex:(int)index {
-  [children removeObjectAtIndex: index];
+  [[self children] removeObjectAtIndex: index];
 }
 
 -(void)removeAllChildNodes {
-  [children removeAllObjects];
+  [children release];
+  children = nil;
+  [moveTree release];
+  moveTree = nil;
 }
 
 -(NSString *)moveListStringWithoutSiblings {
@@ -117,16 +321,16 @@
     return [[self childNodeAtIndex: 0] moveListString];
   else {
     NSMutableString *str;
-    if(![position whiteToMove])
+    if(!whiteToMove)
       str = [[NSMutableString stringWithFormat: @"%d. ",
-			      [[parent position] moveNumber]] retain];
+			      [parent moveNumber]] retain];
     else
       str = [[NSMutableString stringWithFormat: @"%d... ",
-			      [[parent position] moveNumber]] retain];
-    [str appendString: [move SANString]];
+			      [parent moveNumber]] retain];
+    [str appendString: [self SANString]];
     if([move comment]) 
       [str appendString: [NSString stringWithFormat:@" {%@} ", [move comment]]];
-    if([children count] > 0) {
+    if([[self children] count] > 0) {
       [str appendString: @" "];
       [str appendString: [[self firstChildNode] moveListString]];
     }
@@ -150,21 +354,21 @@
     return [[self childNodeAtIndex: 0] moveListString];
   else {
     NSMutableString *str;
-    if(![position whiteToMove])
+    if(!whiteToMove)
       str = [[NSMutableString stringWithFormat: @"%d. ",
-			      [[parent position] moveNumber]] retain];
+			      [parent moveNumber]] retain];
     else
       str = [[NSMutableString stringWithString: @""] retain];
-    [str appendString: [move SANString]];
+    [str appendString: [self SANString]];
     if([move comment]) 
       [str appendString: [NSString stringWithFormat:@" {%@} ", [move comment]]];
-    if([children count] > 0 || [[parent remainingChildNodes] count] > 0)
+    if([[self children] count] > 0 || [[parent remainingChildNodes] count] > 0)
       [str appendString: @" "];
     [[parent remainingChildNodes] 
       makeObjectsPerformSelector: 
 	@selector(moveListStringWithParensAppendedToString:)
       withObject: str];
-    if([children count] > 0) {
+    if([[self children] count] > 0) {
       [str appendString: [[self firstChildNode] moveListString]];
     }
     [str autorelease];
@@ -180,20 +384,20 @@
 	     variations: includeVariations];
   else {
     NSMutableString *str;
-    if(![position whiteToMove])
+    if(!whiteToMove)
       str = [[NSMutableString stringWithFormat: @"%d. ",
-			      [[parent position] moveNumber]] retain];
+			      [parent moveNumber]] retain];
     else if([[self parent] move] == nil)
       // Parent node was root move, and black moved first:  Add move number
       str = [[NSMutableString stringWithString: @"1... "] retain];
     else
       str = [[NSMutableString stringWithString: @""] retain];
-    [str appendString: [move SANString]];
+    [str appendString: [self SANString]];
 
     if(includeComments && [move comment]) 
       [str appendString: [NSString stringWithFormat:@" {%@} ", [move comment]]];
 
-    if([children count] > 0 || 
+    if([[self children] count] > 0 || 
        ([[parent remainingChildNodes] count] > 0 && includeVariations))
       [str appendString: @" "];
 
@@ -203,7 +407,7 @@
 	  @selector(moveListStringWithParensAppendedToString:)
 	withObject: str];
 
-    if([children count] > 0)
+    if([[self children] count] > 0)
       [str appendString: 
 	     [[self firstChildNode] moveListStringWithComments: includeComments
 				    variations: includeVariations]];
@@ -212,116 +416,71 @@
   }
 }
 
--(NSAttributedString *)moveListAttributedStringWithoutSiblingsIncludeComments:(BOOL)includeComments
-								  currentNode:(GameNode *)currentNode {
-  if(move == nil) // root node, should never happen.
-    return nil;
-  else {
-    NSMutableAttributedString *str, *movestr;
-    if(![position whiteToMove])
-      str = [[NSMutableAttributedString 
-	       attributedStringWithFormat: @"%d. ",
-	       [[parent position] moveNumber]] retain];
-    else
-      str = [[NSMutableAttributedString 
-	       attributedStringWithFormat: @"%d... ",
-	       [[parent position] moveNumber]] retain];
-
-    movestr = [NSMutableAttributedString attributedStringWithString:
-					   [move SANString]];
-    if(self == currentNode) {
-      [movestr addAttribute: NSBackgroundColorAttributeName
-	       value: [NSColor lightGrayColor]
-	       range: NSMakeRange(0, [movestr length])];
-    }
-    [str appendAttributedString: movestr];
-
-    if([move comment]) {
-      NSMutableAttributedString *commentString =
-	[NSMutableAttributedString attributedStringWithFormat: @" {%@} ",
-				   [move comment]];
-      [commentString addAttribute: NSForegroundColorAttributeName
-		     value: [NSColor blueColor]
-		     range: NSMakeRange(0, [commentString length])];
-      [str appendAttributedString: commentString];
-    }
-    if([children count] > 0) {
-      [str appendString: @" "];
-      [str appendAttributedString:
-	     [[self firstChildNode]
-	       moveListAttributedStringWithComments: includeComments
-	       variations: YES
-	       currentNode: currentNode]];
-    }
-    [str autorelease];
-    return str;
-  }
-}
-
--(NSAttributedString *)moveListAttributedStringWithComments:(BOOL)includeComments
-						 variations:(BOOL)includeVariations
-						currentNode:(GameNode *)currentNode {
-  if(move == nil) // root node
-    return [[self childNodeAtIndex: 0]
-	     moveListAttributedStringWithComments: includeComments
-	     variations: includeVariations
-	     currentNode: currentNode];
-  else {
-    NSMutableAttributedString *str, *movestr;
-    
-    if(![position whiteToMove])
-      str = [[NSMutableAttributedString attributedStringWithFormat: @"%d. ",
-					[[parent position] moveNumber]] retain];
-    else if([[self parent] move] == nil)
+// Appends the moves from this node to the end of its line, with the
+// variations branching off along the way. The text is built in one pass
+// into 'str', and if 'ranges' isn't NULL, a MoveListRange is stored in it
+// for every node.
+
+-(void)appendMoveListToAttributedString:(NSMutableAttributedString *)str
+			       comments:(BOOL)includeComments
+			     variations:(BOOL)includeVariations
+		       startOfVariation:(BOOL)startOfVariation
+				 ranges:(NSMapTable *)ranges {
+  GameNode *node = self, *sibling;
+  NSMutableAttributedString *commentString;
+  NSEnumerator *e;
+  MoveListRange *range;
+  NSUInteger start;
+  BOOL showSiblings;
+
+  while(node != nil) {
+    start = [str length];
+    if(!node->whiteToMove)
+      [str appendString: [NSString stringWithFormat: @"%d. ",
+				   [node->parent moveNumber]]];
+    else if(startOfVariation)
+      [str appendString: [NSString stringWithFormat: @"%d... ",
+				   [node->parent moveNumber]]];
+    else if([node->parent move] == nil)
       // Parent node was root move, and black moved first:  Add move number
-      str = [[NSMutableAttributedString attributedStringWithString: @"1... "]
-	      retain];
-    else
-      str = [[NSMutableAttributedString attributedStringWithString: @""] retain];
-    movestr = [NSMutableAttributedString attributedStringWithString:
-					   [move SANString]];
-    if(self == currentNode) {
-      [movestr addAttribute: NSBackgroundColorAttributeName
-	       value: [NSColor lightGrayColor]
-	       range: NSMakeRange(0, [movestr length])];
+      [str appendString: @"1... "];
+    if(ranges != NULL) {
+      range = malloc(sizeof(MoveListRange));
+      range->start = start;
+      range->move = NSMakeRange([str length], [[node SANString] length]);
+      NSMapInsert(ranges, node, range);
     }
-    [str appendAttributedString: movestr];
+    [str appendString: [node SANString]];
 
-    if(includeComments && [move comment]) {
-      NSMutableAttributedString *commentString =
+    if(includeComments && [node->move comment]) {
+      commentString =
 	[NSMutableAttributedString attributedStringWithFormat: @" {%@} ",
-				   [move comment]];
+				   [node->move comment]];
       [commentString addAttribute: NSForegroundColorAttributeName
 		     value: [NSColor blueColor]
 		     range: NSMakeRange(0, [commentString length])];
       [str appendAttributedString: commentString];
     }
 
-    if([children count] > 0 ||
-       ([[parent remainingChildNodes] count] > 0 && includeVariations))
+    showSiblings = includeVariations && !startOfVariation &&
+      [node->parent->children count] > 1;
+    if([[node children] count] > 0 || showSiblings)
       [str appendString: @" "];
-
-    if(includeVariations) {
-      NSEnumerator *e = [[parent remainingChildNodes] objectEnumerator];
-      GameNode *node;
-      while((node = [e nextObject])) {
+    if(showSiblings) {
+      e = [[node->parent remainingChildNodes] objectEnumerator];
+      while((sibling = [e nextObject]) != nil) {
 	[str appendString: @"("];
-	[str appendAttributedString: 
-	       [node moveListAttributedStringWithoutSiblingsIncludeComments:
-		       includeComments
-		     currentNode: currentNode]];
+	[sibling appendMoveListToAttributedString: str
+		 comments: includeComments
+		 variations: includeVariations
+		 startOfVariation: YES
+		 ranges: ranges];
 	[str appendString: @") "];
       }
     }
-    if([children count] > 0)
-      [str appendAttributedString:
-	     [[self firstChildNode]
-	       moveListAttributedStringWithComments: includeComments
-	       variations: includeVariations
-	       currentNode: currentNode]];
 
-    [str autorelease];
-    return str;
+    node = ([[node children] count] > 0)? [node firstChildNode] : nil;
+    startOfVariation = NO;
   }
 }
     
@@ -330,7 +489,11 @@
   // [children removeAllObjects];
   // NSLog(@"Releasing children: %@", children);
   [children release];
+  [moveTree release];
+  [UCIString release];
   if(move != nil) [move release];
+  if(position == nil) removeNodeFromCache(self);
+  releasePositionCache(positionCache);
   [position release];
   // [parent release];
   [super dealloc];
@@ -338,7 +501,74 @@
 
 -(NSString *)description {
   return [NSString stringWithFormat: @"pos=%@, move=%@, %d children",
-		   position, [move SANString], [children count]];
+		   [self position], [self SANString], [[self children] count]];
 }
 
 @end
+
+
+// The position cache is a small array searched linearly, starting with the
+// entry found last time, which is almost always the current node of the
+// game being displayed. Entries hold on to their positions but not to their
+// nodes; a node removes itself from the cache when it is deallocated.
+
+static ChessPosition *cachedPositionForNode(GameNode *node) {
+  position_cache_t *cache = node->positionCache;
+  int i;
+
+  if(cache->entries[cache->lastHit].node == node)
+    i = cache->lastHit;
+  else
+    for(i = 0; i < POSITION_CACHE_SIZE; i++)
+      if(cache->entries[i].node == node) break;
+  if(i == POSITION_CACHE_SIZE) return nil;
+  cache->entries[i].lastUse = ++cache->clock;
+  cache->lastHit = i;
+  return [[cache->entries[i].position retain] autorelease];
+}
+
+// A node already in the cache keeps its entry; otherwise it gets an empty
+// entry, or the least recently used one.
+
+static void cachePositionForNode(GameNode *node, ChessPosition *position) {
+  position_cache_t *cache = node->positionCache;
+  int i, slot = -1, oldest = 0;
+
+  for(i = 0; i < POSITION_CACHE_SIZE; i++) {
+    if(cache->entries[i].node == node) {
+      slot = i;
+      break;
+    }
+    if(cache->entries[i].lastUse < cache->entries[oldest].lastUse)
+      oldest = i;
+  }
+  if(slot < 0) slot = oldest;  // Empty entries have lastUse 0
+  [position retain];
+  [cache->entries[slot].position release];
+  cache->entries[slot].node = node;
+  cache->entries[slot].position = position;
+  cache->entries[slot].lastUse = ++cache->clock;
+  cache->lastHit = slot;
+}
+
+static void removeNodeFromCache(GameNode *node) {
+  position_cache_t *cache = node->positionCache;
+  int i;
+
+  for(i = 0; i < POSITION_CACHE_SIZE; i++)
+    if(cache->entries[i].node == node) {
+      [cache->entries[i].position release];
+      cache->entries[i].node = nil;
+      cache->entries[i].position = nil;
+      cache->entries[i].lastUse = 0;
+    }
+}
+
+static void releasePositionCache(position_cache_t *cache) {
+  int i;
+
+  if(--cache->references > 0) return;
+  for(i = 0; i < POSITION_CACHE_SIZE; i++)
+    [cache->entries[i].position release];
+  free(cache);
+}
@@ -41,8 +41,7 @@ static BOOL is_symbol_next(int c);
 -(id)initWithString:(NSString *)string {
   self = [super init];
   gameString = [string retain];
-  gameCString = malloc([gameString length] * sizeof(char));
-  strcpy(gameCString, [gameString UTF8String]);
+  gameCString = strdup([gameString UTF8String]);
   currentCharIndex = 0;
   charUnread = NO;
   tokenUnread = NO;
@@ -274,28 +273,28 @@ static BOOL is_symbol_next(int c);
 }
 
 -(NSString *)readComment {
-  char *cstring;
-  int length, size = 1024, depth = 1;
-  char c;
-  cstring = malloc(size * sizeof(char));
-  length = 0;
-  for(c = gameCString[currentCharIndex++]; c != '\0';
-      c = gameCString[currentCharIndex++]) {
-    if(c == '{') depth++;
-    else if(c == '}') depth--;
-    if(depth == 0) break;
+  char *start = gameCString + currentCharIndex, *c;
+  int depth = 1;
+  NSString *string;
 
-    if(c == '\n' || c == '\r') c = ' ';
-    cstring[length++] = c;
-    if(length >= size - 1) {
-      size *= 2;
-      cstring = realloc(cstring, size * sizeof(char));
-    }
+  // Line breaks are replaced in our own copy of the game text, so that the
+  // comment can be made into a string right where it is.
+  for(c = start; *c != '\0'; c++) {
+    if(*c == '{') depth++;
+    else if(*c == '}' && --depth == 0) break;
+    else if(*c == '\n' || *c == '\r') *c = ' ';
   }
-  cstring[length] = '\0';
-  return [[NSString stringWithUTF8String: cstring]
-	   stringByTrimmingCharactersInSet:
-	     [NSCharacterSet whitespaceAndNewlineCharacterSet]];
+  currentCharIndex = (c - gameCString) + (*c != '\0');
+  string = [[NSString alloc] initWithBytes: start
+			     length: c - start
+			     encoding: NSUTF8StringEncoding];
+  if(string == nil)
+    string = [[NSString alloc] initWithBytes: start
+			       length: c - start
+			       encoding: NSISOLatin1StringEncoding];
+  [string autorelease];
+  return [string stringByTrimmingCharactersInSet:
+		   [NSCharacterSet whitespaceAndNewlineCharacterSet]];
 }
 
 -(void)charRead {
@@ -19,8 +19,12 @@
 
 #import <Cocoa/Cocoa.h>
 
+#include "adjudicate.h"
+#include "matchstats.h"
+
 @class BoardController;
 @class Game;
+@class MatchRunner;
 @class PGN;
 
 @interface MatchController : NSWindowController {
@@ -33,7 +37,16 @@
   NSString *engine1, *engine2;
   int engine1Time, engine2Time, engine1Increment, engine2Increment;
   int numberOfGames, gamesFinished;
-  int engine1Wins, engine1Draws, engine1Losses;
+  match_stats_t stats;
+  int *pairResults;  // Engine 1's half points in the first game of each
+                     // pair, or -1 while it is still being played
+  BOOL useSPRT;
+  sprt_t sprt;
+  int sprtStatus;
+  BOOL matchOver;
+  BOOL adjudicate;  // Adjudicate games by the engines' scores
+  adjudication_rules_t adjudicationRules;
+  adjudication_t gameAdjudication;  // For the game on the board
   NSString *saveGameFile, *positionFile;
   PGN *positionPGNFile;
   BOOL FRC;
@@ -41,6 +54,7 @@
   int frcId;
 
   NSTimer *timer;
+  MatchRunner *runner;  // Plays the games without the board, if not nil
 }
 
 -(id)initWithBoardController:(BoardController *)bc
@@ -59,6 +73,13 @@
 -(void)startNextMatchGame:(NSTimer *)aTimer;
 -(void)displayMatchState;
 -(void)gameFinished:(Game *)game;
+-(void)gameFinished:(Game *)game number:(int)number;
+-(BOOL)adjudicatesGames;
+-(const adjudication_rules_t *)adjudicationRules;
+-(int)adjudicateMoveInGame:(Game *)game
+		  hasScore:(BOOL)hasScore
+		     score:(int)score
+		    isMate:(BOOL)isMate;
 -(IBAction)abortButtonPressed:(id)sender;
 -(IBAction)adjudicateButtonPressed:(id)sender;
 -(IBAction)okButtonPressed:(id)sender;
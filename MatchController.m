@@ -20,8 +20,16 @@
 #import "BoardController.h"
 #import "Game.h"
 #import "MatchController.h"
+#import "MatchRunner.h"
 #import "PGN.h"
 
+
+@interface MatchController (PrivateAPI)
+-(void)countResult:(result_t)result number:(int)number;
+-(NSString *)statisticsString;
+@end
+
+
 @implementation MatchController
 
 -(id)initWithBoardController:(BoardController *)bc
@@ -36,6 +44,9 @@
 		positionFile:(NSString *)pFile
 			 FRC:(BOOL)frc 
 		      ponder:(BOOL)ponder {
+  NSUserDefaults *defaults = [NSUserDefaults standardUserDefaults];
+  int i;
+
   self = [super initWithWindowNibName: @"MatchStats"];
 
   boardController = bc;
@@ -53,7 +64,33 @@
 
   FRC = frc;
   enginesShouldPonder = ponder;
-  gamesFinished = engine1Wins = engine1Draws = engine1Losses = 0;
+  gamesFinished = 0;
+  match_stats_init(&stats);
+  pairResults = malloc(((numberOfGames + 1) / 2) * sizeof(int));
+  for(i = 0; i < (numberOfGames + 1) / 2; i++)
+    pairResults[i] = -1;
+
+  useSPRT = [defaults boolForKey: @"Stop Engine Matches by SPRT"];
+  sprt.elo0 = [defaults doubleForKey: @"SPRT Elo0"];
+  sprt.elo1 = [defaults doubleForKey: @"SPRT Elo1"];
+  sprt.alpha = [defaults doubleForKey: @"SPRT Alpha"];
+  sprt.beta = [defaults doubleForKey: @"SPRT Beta"];
+  sprtStatus = SPRT_CONTINUE;
+  matchOver = NO;
+
+  adjudicate = [defaults boolForKey: @"Adjudicate Engine Matches"];
+  adjudicationRules.draw_move_number =
+    [defaults integerForKey: @"Adjudication Draw Move Number"];
+  adjudicationRules.draw_moves =
+    [defaults integerForKey: @"Adjudication Draw Moves"];
+  adjudicationRules.draw_score =
+    [defaults integerForKey: @"Adjudication Draw Score"];
+  adjudicationRules.win_moves =
+    [defaults integerForKey: @"Adjudication Win Moves"];
+  adjudicationRules.win_score =
+    [defaults integerForKey: @"Adjudication Win Score"];
+  adjudicationRules.tablebases =
+    [defaults boolForKey: @"Adjudicate Engine Matches by Tablebases"];
 
   return self;
 }
@@ -64,7 +101,31 @@
 }
 
 -(void)startMatch {
-  [self startNextMatchGame: nil];
+  if([[NSUserDefaults standardUserDefaults]
+       boolForKey: @"Run Engine Matches in the Background"]) {
+    @try {
+      runner = [[MatchRunner alloc] initWithController: self
+				    engine1: engine1
+				    engine2: engine2
+				    engine1Time: engine1Time
+				    engine2Time: engine2Time
+				    engine1Increment: engine1Increment
+				    engine2Increment: engine2Increment
+				    numberOfGames: numberOfGames
+				    saveFile: saveGameFile
+				    positionFile: positionPGNFile
+				    FRC: FRC];
+    }
+    @catch (NSException *e) {
+      NSRunAlertPanel(@"Could not start match", [e reason],
+		      nil, nil, nil);
+      return;
+    }
+    [runner start];
+    [self displayMatchState];
+  }
+  else
+    [self startNextMatchGame: nil];
 }
 
 -(void)startNextMatchGame:(NSTimer *)aTimer {
@@ -72,7 +133,9 @@
   if(aTimer) {
     [aTimer invalidate];
     [aTimer release];
+    timer = nil;
   }
+  adjudication_init(&gameAdjudication, &adjudicationRules);
   if(positionFile) {
     [boardController newGameWithPGNString:
 		       [positionPGNFile pgnStringForGameNumber:
@@ -112,23 +175,33 @@
     
 
 -(void)displayMatchState {
+  NSString *count, *statistics;
+
   [engine1StatsTextField 
     setStringValue: [NSString stringWithFormat:
 				@"%@: %.1f (+%d, =%d, -%d)",
 			      engine1,
-			      engine1Wins + engine1Draws * 0.5,
-			      engine1Wins, engine1Draws, engine1Losses]];
+			      stats.wins + stats.draws * 0.5,
+			      stats.wins, stats.draws, stats.losses]];
   [engine2StatsTextField 
     setStringValue: [NSString stringWithFormat:
 				@"%@: %.1f (+%d, =%d, -%d)",
 			      engine2,
-			      engine1Losses + engine1Draws * 0.5,
-			      engine1Losses, engine1Draws, engine1Wins]];
-  [gameCountTextField 
-    setStringValue: [NSString stringWithFormat: @"%d/%d games played",
-			      gamesFinished, numberOfGames]];
-  if(gamesFinished == numberOfGames) {
-    [boardController stopEngine2];
+			      stats.losses + stats.draws * 0.5,
+			      stats.losses, stats.draws, stats.wins]];
+  if(runner && !matchOver)
+    count = [NSString stringWithFormat: @"%d/%d games played, %d running",
+		      gamesFinished, numberOfGames, [runner gamesRunning]];
+  else
+    count = [NSString stringWithFormat: @"%d/%d games played",
+		      gamesFinished, numberOfGames];
+  statistics = [self statisticsString];
+  if([statistics length] > 0)
+    count = [NSString stringWithFormat: @"%@. %@", count, statistics];
+  [gameCountTextField setStringValue: count];
+  if(matchOver) {
+    if(runner) [runner stop];
+    else [boardController stopEngine2];
     [okButton setEnabled: YES];
   }
   else
@@ -142,19 +215,9 @@
     [game setRound: [NSString stringWithFormat: @"%d", gamesFinished+1]];
     [game saveToFile: saveGameFile];
   }
-  if(gamesFinished % 2 == 0) { // Engine 1 was white
-    if([game result] == WHITE_WINS) engine1Wins++;
-    else if([game result] == BLACK_WINS) engine1Losses++;
-    else engine1Draws++;
-  }
-  else { // Engine 1 was black
-    if([game result] == WHITE_WINS) engine1Losses++;
-    else if([game result] == BLACK_WINS) engine1Wins++;
-    else engine1Draws++;
-  }
-  gamesFinished++;
+  [self countResult: [game result] number: gamesFinished];
   [self displayMatchState];
-  if(gamesFinished < numberOfGames)
+  if(!matchOver)
     timer = [[NSTimer scheduledTimerWithTimeInterval: 1.0
 		      target: self
 		      selector: @selector(startNextMatchGame:)
@@ -162,12 +225,74 @@
 		      repeats: NO] retain];
 }
 
+// Called by the runner, which has already saved the game.
+
+-(void)gameFinished:(Game *)game number:(int)number {
+  if(matchOver) return;
+  [self countResult: [game result] number: number];
+  [self displayMatchState];
+}
+
 -(IBAction)abortButtonPressed:(id)sender {
   NSRunAlertPanel(@"Not implemented yet!", @"", @"OK", nil, nil);
 }
 
+-(BOOL)adjudicatesGames {
+  return adjudicate;
+}
+
+-(const adjudication_rules_t *)adjudicationRules {
+  return &adjudicationRules;
+}
+
+// Called by the board controller after each engine move, with the score
+// the engine gave the move. Returns ADJUDICATE_NONE if the game goes on.
+// A result from the tablebases takes precedence over the scores.
+
+-(int)adjudicateMoveInGame:(Game *)game
+		  hasScore:(BOOL)hasScore
+		     score:(int)score
+		    isMate:(BOOL)isMate {
+  int result, tablebaseResult;
+
+  if(!adjudicate) return ADJUDICATE_NONE;
+  result = adjudication_add_move(&gameAdjudication,
+				 [[game currentPosition] moveNumber],
+				 [game whiteToMove]? BLACK : WHITE,
+				 hasScore, score, isMate);
+  tablebaseResult =
+    adjudication_by_tablebase(&adjudicationRules,
+			      [[game currentPosition] pos]);
+  return (tablebaseResult != ADJUDICATE_NONE)? tablebaseResult : result;
+}
+
+// Games in the background are adjudicated by the last score of the
+// engines, the game on the board as the user says.
+
 -(IBAction)adjudicateButtonPressed:(id)sender {
-  NSRunAlertPanel(@"Not implemented yet!", @"", @"OK", nil, nil);
+  int answer, adjudication;
+
+  if(matchOver) return;
+  if(runner) {
+    if(NSRunAlertPanel(@"Adjudicate games",
+		       @"Adjudicate all running games by the last scores of the engines?",
+		       @"OK", @"Cancel", nil) == NSAlertDefaultReturn)
+      [runner adjudicateRunningGames];
+  }
+  else if(timer == nil) {
+    answer = NSRunAlertPanel(@"Adjudicate game", @"Who wins the current game?",
+			     @"White", @"Black", @"Draw");
+    if(answer == NSAlertDefaultReturn)
+      adjudication = ADJUDICATE_WHITE_WINS;
+    else if(answer == NSAlertAlternateReturn)
+      adjudication = ADJUDICATE_BLACK_WINS;
+    else
+      adjudication = ADJUDICATE_DRAW;
+    [boardController
+      adjudicateMatchGameWithResult: adjudication_result(adjudication)
+      reason: [NSString stringWithUTF8String:
+			  adjudication_reason(adjudication)]];
+  }
 }
 
 -(IBAction)okButtonPressed:(id)sender {
@@ -175,13 +300,68 @@
 }
 
 -(void)dealloc {
+  [runner stop];
+  [runner release];
   [engine1 release];
   [engine2 release];
   [saveGameFile release];
   [positionFile release];
   [positionPGNFile release];
+  free(pairResults);
   [super dealloc];
 }
 
 
 @end
+
+
+@implementation MatchController (PrivateAPI)
+
+// Games number 2n and 2n+1 are a pair, played from the same position with
+// engine 1 white in the first one, and either may finish first. A game
+// whose partner is never played (the last one of an odd number of games)
+// only counts as a single game. The match is over when all games are
+// played, or when the SPRT accepts one of its hypotheses.
+
+-(void)countResult:(result_t)result number:(int)number {
+  int halfPoints, pair = number / 2;
+  double llr;
+
+  if(result == WHITE_WINS) halfPoints = 2;
+  else if(result == BLACK_WINS) halfPoints = 0;
+  else halfPoints = 1;
+  if(number % 2 == 1) halfPoints = 2 - halfPoints;
+
+  match_stats_add_game(&stats, halfPoints);
+  if(pairResults[pair] < 0 && (number ^ 1) < numberOfGames)
+    pairResults[pair] = halfPoints;
+  else if(pairResults[pair] >= 0)
+    match_stats_add_pair(&stats, pairResults[pair] + halfPoints);
+  gamesFinished++;
+
+  if(useSPRT)
+    sprtStatus = sprt_status(&sprt, &stats, &llr);
+  matchOver = gamesFinished == numberOfGames || sprtStatus != SPRT_CONTINUE;
+}
+
+-(NSString *)statisticsString {
+  NSMutableString *string = [NSMutableString string];
+  double elo, error, llr, lower, upper;
+
+  if(match_stats_elo(&stats, &elo, &error))
+    [string appendFormat: @"Elo %+.1f +/- %.1f", elo, error];
+  if(useSPRT) {
+    llr = match_stats_llr(&stats, sprt.elo0, sprt.elo1);
+    sprt_bounds(&sprt, &lower, &upper);
+    [string appendFormat: @"%@LLR %.2f (%.2f, %.2f) [%.1f, %.1f]",
+	    [string length] > 0? @", " : @"", llr, lower, upper,
+	    sprt.elo0, sprt.elo1];
+    if(sprtStatus == SPRT_ACCEPT_H0)
+      [string appendString: @", H0 accepted"];
+    else if(sprtStatus == SPRT_ACCEPT_H1)
+      [string appendString: @", H1 accepted"];
+  }
+  return string;
+}
+
+@end
@@ -0,0 +1,77 @@
+/*
+  Stockfish, a OS X GUI for the UCI chess engine with the same name.
+  Copyright (C) 2004-2011 Marco Costalba, Joona Kiiski, Tord Romstad
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#import <Cocoa/Cocoa.h>
+
+#include "adjudicate.h"
+
+@class Book;
+@class ChessMove;
+@class ChessPosition;
+@class Game;
+@class MatchController;
+@class MatchWorker;
+@class PGN;
+@class PGNWriter;
+
+// A MatchRunner plays an engine match without the board, several games at
+// a time. Each game is played by a MatchWorker with an engine pair of its
+// own. Finished games are written to the save file in one PGNWriter, and
+// reported to the MatchController.
+
+@interface MatchRunner : NSObject {
+  MatchController *controller;
+  NSString *engine1, *engine2;
+  int engine1Time, engine2Time, engine1Increment, engine2Increment;
+  int numberOfGames, gamesStarted, gamesFinished;
+  PGN *positionPGNFile;
+  BOOL FRC;
+  int frcId;
+  NSString *site;
+  PGNWriter *writer;
+  Book *book;
+  NSMutableArray *workers;
+  BOOL adjudicate;
+  adjudication_rules_t adjudicationRules;
+  BOOL stopped;
+}
+
++(int)defaultNumberOfWorkers;
+-(id)initWithController:(MatchController *)mc
+		engine1:(NSString *)e1
+		engine2:(NSString *)e2
+	    engine1Time:(int)e1time
+	    engine2Time:(int)e2time
+       engine1Increment:(int)e1inc
+       engine2Increment:(int)e2inc
+	  numberOfGames:(int)numOfGames
+	       saveFile:(NSString *)saveFile
+	   positionFile:(PGN *)positionFile
+		    FRC:(BOOL)frc;
+-(void)start;
+-(void)stop;
+-(int)numberOfWorkers;
+-(int)gamesRunning;
+-(ChessMove *)bookMoveForPosition:(ChessPosition *)position;
+-(BOOL)adjudicatesGames;
+-(const adjudication_rules_t *)adjudicationRules;
+-(void)adjudicateRunningGames;
+-(void)worker:(MatchWorker *)worker finishedGame:(Game *)game number:(int)n;
+
+@end
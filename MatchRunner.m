@@ -0,0 +1,220 @@
+/*
+  Stockfish, a OS X GUI for the UCI chess engine with the same name.
+  Copyright (C) 2004-2011 Marco Costalba, Joona Kiiski, Tord Romstad
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#import "Book.h"
+#import "ChessClock.h"
+#import "Game.h"
+#import "MatchController.h"
+#import "MatchRunner.h"
+#import "MatchWorker.h"
+#import "PGN.h"
+#import "PGNWriter.h"
+
+#include "pgnscan.h"
+
+
+@interface MatchRunner (PrivateAPI)
+-(void)startNextGameForWorker:(MatchWorker *)worker;
+@end
+
+
+@implementation MatchRunner
+
+// Each game keeps two engine processes busy, one thinking and one waiting
+// (or pondering), so we play one game per pair of cores unless told
+// otherwise.
+
++(int)defaultNumberOfWorkers {
+  int n = [[NSUserDefaults standardUserDefaults]
+	    integerForKey: @"Parallel Engine Match Games"];
+  if(n <= 0) n = MAX(pgn_cpu_count() / 2, 1);
+  return n;
+}
+
+-(id)initWithController:(MatchController *)mc
+		engine1:(NSString *)e1
+		engine2:(NSString *)e2
+	    engine1Time:(int)e1time
+	    engine2Time:(int)e2time
+       engine1Increment:(int)e1inc
+       engine2Increment:(int)e2inc
+	  numberOfGames:(int)numOfGames
+	       saveFile:(NSString *)saveFile
+	   positionFile:(PGN *)positionFile
+		    FRC:(BOOL)frc {
+  self = [super init];
+  controller = mc;
+  engine1 = [e1 retain]; engine2 = [e2 retain];
+  engine1Time = e1time; engine2Time = e2time;
+  engine1Increment = e1inc; engine2Increment = e2inc;
+  numberOfGames = numOfGames;
+  gamesStarted = gamesFinished = 0;
+  positionPGNFile = [positionFile retain];
+  FRC = frc;
+  adjudicate = [mc adjudicatesGames];
+  adjudicationRules = *[mc adjudicationRules];
+  site = [[[NSHost currentHost] name] retain];
+  workers = [[NSMutableArray alloc] init];
+  book = [[Book alloc] initWithFilename: [[NSBundle mainBundle]
+					   pathForResource: @"guibook.bin"
+					   ofType: nil]];
+  if(saveFile) {
+    @try {
+      writer = [[PGNWriter alloc] initWithFilename: saveFile];
+    }
+    @catch (NSException *e) {
+      [self release];
+      @throw;
+    }
+  }
+  stopped = NO;
+  return self;
+}
+
+-(void)start {
+  int i, n = MIN([MatchRunner defaultNumberOfWorkers], numberOfGames);
+
+  for(i = 0; i < n; i++) {
+    MatchWorker *worker = [[MatchWorker alloc] initWithRunner: self
+					       engine1: engine1
+					       engine2: engine2];
+    [workers addObject: worker];
+    [worker release];
+  }
+  for(i = 0; i < n; i++)
+    [self startNextGameForWorker: [workers objectAtIndex: i]];
+}
+
+-(void)stop {
+  stopped = YES;
+  [workers makeObjectsPerformSelector: @selector(stop)];
+  [workers removeAllObjects];
+  [writer close];
+}
+
+-(int)numberOfWorkers {
+  return [workers count];
+}
+
+-(int)gamesRunning {
+  return gamesStarted - gamesFinished;
+}
+
+-(ChessMove *)bookMoveForPosition:(ChessPosition *)position {
+  return [book pickMoveForPosition: position withVariety: 0];
+}
+
+-(BOOL)adjudicatesGames {
+  return adjudicate;
+}
+
+-(const adjudication_rules_t *)adjudicationRules {
+  return &adjudicationRules;
+}
+
+-(void)adjudicateRunningGames {
+  int i;
+
+  for(i = 0; i < [workers count]; i++)
+    [[workers objectAtIndex: i] adjudicate];
+}
+
+// Games can finish in any order, so each game keeps its number, which
+// decides the colors and the starting position.
+
+-(void)worker:(MatchWorker *)worker finishedGame:(Game *)game number:(int)n {
+  gamesFinished++;
+  [writer writeGame: game];
+  [controller gameFinished: game number: n];
+  if(!stopped)
+    [self startNextGameForWorker: worker];
+}
+
+-(void)dealloc {
+  [self stop];
+  [engine1 release];
+  [engine2 release];
+  [positionPGNFile release];
+  [site release];
+  [writer release];
+  [book close];
+  [book release];
+  [workers release];
+  [super dealloc];
+}
+
+@end
+
+
+@implementation MatchRunner (PrivateAPI)
+
+-(void)startNextGameForWorker:(MatchWorker *)worker {
+  Game *game = nil;
+  int n;
+
+  if(gamesStarted >= numberOfGames) return;
+  n = gamesStarted++;
+
+  // Both games of a pair start from the same position, with colors
+  // reversed:
+  if(positionPGNFile && [positionPGNFile numberOfGames] > 0) {
+    @try {
+      game = [[Game alloc] initWithPGNString:
+			     [positionPGNFile pgnStringForGameNumber:
+						(n / 2) % [positionPGNFile numberOfGames]]];
+      [game goToBeginningOfGame];
+    }
+    @catch (NSException *e) {
+      NSLog(@"Error in position file, game %d: %@", n / 2 + 1, [e reason]);
+      [game release];
+      game = [[Game alloc] init];
+    }
+  }
+  else if(FRC) {
+    if(n % 2 == 0) // Pick new random position:
+      frcId = abs([ChessClock currentSystemTime]) % 960;
+    game = [[Game alloc] initWithFRCid: frcId];
+  }
+  else
+    game = [[Game alloc] init];
+
+  [game setEvent: @"Computer chess game"];
+  [game setSite: site];
+  [game setRound: [NSString stringWithFormat: @"%d", n + 1]];
+  if(n % 2 == 0) { // Engine 1 is white:
+    [game setWhitePlayer: engine1];
+    [game setBlackPlayer: engine2];
+    [game setTimeControlWithWhiteTime: engine1Time
+	  blackTime: engine2Time
+	  whiteIncrement: engine1Increment
+	  blackIncrement: engine2Increment];
+  }
+  else { // Engine 2 is white:
+    [game setWhitePlayer: engine2];
+    [game setBlackPlayer: engine1];
+    [game setTimeControlWithWhiteTime: engine2Time
+	  blackTime: engine1Time
+	  whiteIncrement: engine2Increment
+	  blackIncrement: engine1Increment];
+  }
+  [worker playGame: game number: n engine1White: n % 2 == 0];
+  [game release];
+}
+
+@end
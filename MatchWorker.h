@@ -0,0 +1,70 @@
+/*
+  Stockfish, a OS X GUI for the UCI chess engine with the same name.
+  Copyright (C) 2004-2011 Marco Costalba, Joona Kiiski, Tord Romstad
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#import <Cocoa/Cocoa.h>
+
+#include "adjudicate.h"
+#include "uciinfo.h"
+
+@class ChessPosition;
+@class Engine;
+@class Game;
+@class MatchRunner;
+
+// A MatchWorker plays the games of a match given to it by a MatchRunner,
+// one at a time, without a board or engine windows. It keeps the same two
+// engine processes for all its games, and is the controller of both.
+
+@interface MatchWorker : NSObject {
+  MatchRunner *runner;
+  Engine *engines[2];      // Engine 1 and engine 2 of the match
+  Game *game;
+  int gameNumber, gamesPlayed;
+  BOOL engine1White;
+  BOOL playing;
+  NSMutableString *positionCommand;
+  BOOL commentMoves, whiteScore;
+  int currentDepth, currentCPScore, currentMateScore;
+  // The last score of the current search, from the engine's point of view,
+  // and the last score of a move, from white's:
+  BOOL hasSearchScore, searchScoreIsMate;
+  int searchScore;
+  BOOL hasLastScore, lastScoreIsMate;
+  int lastScore;
+  adjudication_t adjudication;
+  NSTimer *moveTimer;      // Fires if the engine to move doesn't answer
+}
+
+-(id)initWithRunner:(MatchRunner *)aRunner
+	    engine1:(NSString *)engine1
+	    engine2:(NSString *)engine2;
+-(BOOL)isPlaying;
+-(void)playGame:(Game *)aGame number:(int)number engine1White:(BOOL)e1white;
+-(void)adjudicate;
+-(void)stop;
+
+// Messages from the engines:
+-(ChessPosition *)currentPosition;
+-(void)setEngineName:(NSString *)newEngineName;
+-(void)setEngineIsReady:(BOOL)state;
+-(void)setInfo:(const uci_info_t *)info;
+-(void)bestmove:(NSString *)bestmove ponder:(NSString *)ponder;
+-(void)engineDidTerminate:(Engine *)engine;
+
+@end
@@ -0,0 +1,379 @@
+/*
+  Stockfish, a OS X GUI for the UCI chess engine with the same name.
+  Copyright (C) 2004-2011 Marco Costalba, Joona Kiiski, Tord Romstad
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#import "Engine.h"
+#import "EnginePool.h"
+#import "Game.h"
+#import "MatchRunner.h"
+#import "MatchWorker.h"
+
+// Seconds an engine may exceed its remaining time before it is considered
+// hung and loses the game:
+static const NSTimeInterval MOVE_TIME_GRACE = 10.0;
+
+
+@interface MatchWorker (PrivateAPI)
+-(Engine *)engineToMove;
+-(void)startNextMove;
+-(void)makeMove:(ChessMove *)move comment:(NSString *)comment;
+-(NSString *)moveComment;
+-(void)finishGameWithResult:(result_t)result reason:(NSString *)reason;
+-(void)replaceEngine:(int)i;
+-(void)moveTimedOut:(NSTimer *)timer;
+-(void)stopMoveTimer;
+@end
+
+
+@implementation MatchWorker
+
+-(id)initWithRunner:(MatchRunner *)aRunner
+	    engine1:(NSString *)engine1
+	    engine2:(NSString *)engine2 {
+  self = [super init];
+  runner = aRunner;
+  // Engines may send info lines before the first game, which are parsed in
+  // the position of this placeholder game:
+  game = [[Game alloc] init];
+  positionCommand = [[NSMutableString alloc] init];
+  engines[0] = [[[EnginePool sharedPool]
+		  engineWithController: self
+		  path: [Engine pathOfEngineWithName: engine1]] retain];
+  engines[1] = [[[EnginePool sharedPool]
+		  engineWithController: self
+		  path: [Engine pathOfEngineWithName: engine2]] retain];
+  return self;
+}
+
+-(BOOL)isPlaying {
+  return playing;
+}
+
+-(void)playGame:(Game *)aGame number:(int)number engine1White:(BOOL)e1white {
+  NSUserDefaults *defaults = [NSUserDefaults standardUserDefaults];
+  int i;
+
+  [aGame retain];
+  [game release];
+  game = aGame;
+  gameNumber = number;
+  engine1White = e1white;
+  playing = YES;
+  commentMoves = [defaults boolForKey: @"Include Engine Analysis in Move List"];
+  whiteScore =
+    [defaults boolForKey: @"Display all Scores from White's Point of View"];
+  [positionCommand setString:
+		     [NSString stringWithFormat: @"position fen %@ ",
+			       [game rootFEN]]];
+  adjudication_init(&adjudication, [runner adjudicationRules]);
+  hasLastScore = NO;
+  for(i = 0; i < 2; i++)
+    if(![engines[i] isRunning])
+      [self replaceEngine: i];
+  if(gamesPlayed++ > 0)
+    for(i = 0; i < 2; i++) {
+      [engines[i] startNewGame];
+      [engines[i] askIfReady];
+    }
+  [self startNextMove];
+}
+
+// Ends the game by the last score of a move. The search in progress is
+// abandoned, so that the engine drops its best move even if it arrives
+// after the next game has started.
+
+-(void)adjudicate {
+  int result;
+
+  if(!playing) return;
+  [[self engineToMove] abandonSearch];
+  if(hasLastScore)
+    result = adjudication_by_score([runner adjudicationRules],
+				   lastScore, lastScoreIsMate);
+  else
+    result = ADJUDICATE_DRAW;
+  [self finishGameWithResult: adjudication_result(result)
+	reason: [NSString stringWithUTF8String: adjudication_reason(result)]];
+}
+
+-(void)stop {
+  int i;
+
+  playing = NO;
+  [self stopMoveTimer];
+  for(i = 0; i < 2; i++) {
+    [[EnginePool sharedPool] recycleEngine: engines[i]];
+    [engines[i] release];
+    engines[i] = nil;
+  }
+}
+
+-(ChessPosition *)currentPosition {
+  return [game currentPosition];
+}
+
+-(void)setEngineName:(NSString *)newEngineName {
+}
+
+-(void)setEngineIsReady:(BOOL)state {
+}
+
+// Only one of the two engines searches at any time, so the info lines and
+// the best move come from the engine of the side to move.
+
+-(void)setInfo:(const uci_info_t *)info {
+  int value;
+
+  if(!playing) return;
+  if(info->fields & UCI_INFO_DEPTH)
+    currentDepth = info->depth;
+  if(info->fields & UCI_INFO_SCORE) {
+    searchScore = value = info->score;
+    searchScoreIsMate = info->score_type == UCI_SCORE_MATE;
+    hasSearchScore = YES;
+    if(whiteScore && ![game whiteToMove])
+      value = -value;
+    if(info->score_type == UCI_SCORE_CP) {
+      currentMateScore = 0;
+      currentCPScore = value;
+    }
+    else
+      currentMateScore = value;
+  }
+}
+
+-(void)bestmove:(NSString *)bestmove ponder:(NSString *)ponder {
+  ChessMove *move;
+
+  if([bestmove isEqualToString: @"0000"]) return;
+  if(!playing) return;
+  [self stopMoveTimer];
+
+  // The clock starts with the first move, as on the board:
+  if([[game clock] isRunning] &&
+     ([game whiteToMove]? [game whiteRemainingTime] :
+      [game blackRemainingTime]) == 0) {
+    [self finishGameWithResult: [game whiteToMove]? BLACK_WINS : WHITE_WINS
+	  reason: [game whiteToMove]? @"White loses on time" :
+	  @"Black loses on time"];
+    return;
+  }
+
+  move = [[game currentPosition] parseCoordinateMove: bestmove];
+  if([move isNullMove] || [move move] == NoMove) {
+    [self finishGameWithResult: [game whiteToMove]? BLACK_WINS : WHITE_WINS
+	  reason: [NSString stringWithFormat: @"%@ plays illegal move %@",
+			    [game whiteToMove]? @"White" : @"Black",
+			    bestmove]];
+    return;
+  }
+  [self makeMove: move comment: (currentDepth > 0)? [self moveComment] : nil];
+}
+
+// An engine which crashed (or quit) loses the game in progress. It is
+// replaced by a new process when the next game starts.
+
+-(void)engineDidTerminate:(Engine *)engine {
+  int i = (engine == engines[0])? 0 : 1;
+  BOOL white = (i == 0) == engine1White;
+
+  if(engine != engines[i] || !playing) return;
+  [self finishGameWithResult: white? BLACK_WINS : WHITE_WINS
+	reason: white? @"White's engine terminated" :
+	@"Black's engine terminated"];
+}
+
+-(void)dealloc {
+  [self stop];
+  [game release];
+  [positionCommand release];
+  [super dealloc];
+}
+
+@end
+
+
+@implementation MatchWorker (PrivateAPI)
+
+-(Engine *)engineToMove {
+  if([game whiteToMove] == engine1White)
+    return engines[0];
+  else
+    return engines[1];
+}
+
+-(void)startNextMove {
+  ChessPosition *position = [game currentPosition];
+  Engine *engine = [self engineToMove];
+
+  if([position isTerminal]) {
+    if(![position isMate])
+      [self finishGameWithResult: DRAW reason: nil];
+    else if([game whiteToMove])
+      [self finishGameWithResult: BLACK_WINS reason: nil];
+    else
+      [self finishGameWithResult: WHITE_WINS reason: nil];
+    return;
+  }
+
+  if([engine shouldUseGUIBook]) {
+    ChessMove *bookMove = [runner bookMoveForPosition: position];
+    if(bookMove != nil) {
+      [self makeMove: bookMove comment: nil];
+      return;
+    }
+  }
+
+  currentDepth = 0;
+  hasSearchScore = NO;
+  [engine setOptionName: @"Ponder" value: @"false"];
+  if([engine shouldUseOwnBook])
+    [engine setOptionName: @"OwnBook" value: @"true"];
+  else
+    [engine setOptionName: @"OwnBook" value: @"false"];
+  [engine setOptionName: @"UCI_AnalyseMode" value: @"false"];
+  [engine setOptionName: @"MultiPV" value: @"1"];
+  [engine setOptionName: @"UCI_LimitStrength" value: @"false"];
+  if([game isFRCGame])
+    [engine setOptionName: @"UCI_Chess960" value: @"true"];
+  else
+    [engine setOptionName: @"UCI_Chess960" value: @"false"];
+  [engine setPosition: positionCommand];
+  [engine searchWithWtime: [game whiteRemainingTime]
+	  btime: [game blackRemainingTime]
+	  winc: [game whiteIncrement]
+	  binc: [game blackIncrement]];
+  [self stopMoveTimer];
+  moveTimer =
+    [NSTimer scheduledTimerWithTimeInterval:
+	       ([game whiteToMove]? [game whiteRemainingTime] :
+		[game blackRemainingTime]) / 1000.0 + MOVE_TIME_GRACE
+	     target: self
+	     selector: @selector(moveTimedOut:)
+	     userInfo: nil
+	     repeats: NO];
+}
+
+-(void)makeMove:(ChessMove *)move comment:(NSString *)comment {
+  if([[game currentNode] ply] == 0)
+    [positionCommand appendString: @"moves "];
+  [game makeMove: move];
+  if(comment)
+    [game addComment: comment];
+  [positionCommand appendString:
+		     [[game currentNode] UCIStringInFRCGame: [game isFRCGame]]];
+  [positionCommand appendString: @" "];
+
+  // The search score is used once, so that a book move has none:
+  if(hasSearchScore) {
+    hasLastScore = YES;
+    lastScore = [game whiteToMove]? -searchScore : searchScore;
+    lastScoreIsMate = searchScoreIsMate;
+  }
+  if([runner adjudicatesGames]) {
+    int result =
+      adjudication_add_move(&adjudication, [[game currentPosition] moveNumber],
+			    [game whiteToMove]? BLACK : WHITE,
+			    hasSearchScore, searchScore, searchScoreIsMate);
+    int tablebaseResult =
+      adjudication_by_tablebase([runner adjudicationRules],
+				[[game currentPosition] pos]);
+    if(tablebaseResult != ADJUDICATE_NONE)
+      result = tablebaseResult;
+    if(result != ADJUDICATE_NONE) {
+      hasSearchScore = NO;
+      [self finishGameWithResult: adjudication_result(result)
+	    reason: [NSString stringWithUTF8String:
+				adjudication_reason(result)]];
+      return;
+    }
+  }
+  hasSearchScore = NO;
+  [self startNextMove];
+}
+
+-(NSString *)moveComment {
+  if(!commentMoves) return nil;
+  if(currentMateScore == 0 && currentCPScore >= 0)
+    return [NSString stringWithFormat: @"+%.2f/%d",
+		     (float)currentCPScore / 100.0, currentDepth];
+  else if(currentMateScore == 0 && currentCPScore < 0)
+    return [NSString stringWithFormat: @"%.2f/%d",
+		     (float)currentCPScore / 100.0, currentDepth];
+  else if(currentMateScore > 0)
+    return [NSString stringWithFormat: @"+#%d/%d",
+		     currentMateScore, currentDepth];
+  else
+    return [NSString stringWithFormat: @"-#%d/%d",
+		     -currentMateScore, currentDepth];
+}
+
+// The reason a game ended other than by the rules is added to the comment
+// of the last move.
+
+-(void)finishGameWithResult:(result_t)result reason:(NSString *)reason {
+  ChessMove *lastMove = [[game currentNode] move];
+
+  playing = NO;
+  [self stopMoveTimer];
+  [game stopClock];
+  [game setResult: result];
+  if(reason != nil && [[game currentNode] ply] > 0) {
+    if([lastMove hasComment])
+      [game addComment: [NSString stringWithFormat: @"%@ %@",
+				  [lastMove comment], reason]];
+    else
+      [game addComment: reason];
+  }
+  [runner worker: self finishedGame: game number: gameNumber];
+}
+
+// Takes a new engine process instead of one which can't be trusted to
+// answer any more.
+
+-(void)replaceEngine:(int)i {
+  NSString *path = [[[engines[i] path] retain] autorelease];
+
+  [engines[i] setController: nil];
+  [engines[i] quit];
+  [engines[i] release];
+  engines[i] = [[[EnginePool sharedPool] engineWithController: self path: path]
+		 retain];
+}
+
+// The engine to move has neither moved nor lost on time long after its
+// time ran out. It loses the game, and its process is replaced, since it
+// may never answer again.
+
+-(void)moveTimedOut:(NSTimer *)timer {
+  BOOL white = [game whiteToMove];
+
+  moveTimer = nil;
+  if(!playing) return;
+  [self replaceEngine: ([self engineToMove] == engines[0])? 0 : 1];
+  [self finishGameWithResult: white? BLACK_WINS : WHITE_WINS
+	reason: white? @"White's engine doesn't respond" :
+	@"Black's engine doesn't respond"];
+}
+
+-(void)stopMoveTimer {
+  [moveTimer invalidate];
+  moveTimer = nil;
+}
+
+@end
@@ -0,0 +1,47 @@
+/*
+  Stockfish, a OS X GUI for the UCI chess engine with the same name.
+  Copyright (C) 2004-2011 Marco Costalba, Joona Kiiski, Tord Romstad
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+  
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#import <Cocoa/Cocoa.h>
+
+@class Game;
+@class GameNode;
+
+// A MoveListController keeps the move list of a game in a text view up to
+// date. It remembers where the text of each move is, so that moves added at
+// the end of the game, a new result or a new current move only change the
+// affected part of the text. Other changes redraw everything.
+
+@interface MoveListController : NSObject {
+  NSTextView *textView;
+  NSMapTable *ranges;
+  Game *game;
+  unsigned long modificationStamp;
+  BOOL comments, variations;
+  GameNode *lastNode;
+  GameNode *highlightedNode;
+  NSUInteger length;
+}
+
+-(id)initWithTextView:(NSTextView *)aTextView;
+-(void)displayGame:(Game *)aGame
+	  comments:(BOOL)includeComments
+	variations:(BOOL)includeVariations;
+-(void)invalidate;
+
+@end
@@ -0,0 +1,107 @@
+/*
+  Stockfish, a OS X GUI for the UCI chess engine with the same name.
+  Copyright (C) 2004-2011 Marco Costalba, Joona Kiiski, Tord Romstad
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+  
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#import "Game.h"
+#import "GameNode.h"
+#import "MoveListController.h"
+
+
+@interface MoveListController (PrivateAPI)
+-(void)setHighlighted:(BOOL)highlighted forNode:(GameNode *)node;
+@end
+
+
+@implementation MoveListController
+
+-(id)initWithTextView:(NSTextView *)aTextView {
+  self = [super init];
+  textView = [aTextView retain];
+  ranges = NSCreateMapTable(NSNonOwnedPointerMapKeyCallBacks,
+			    NSOwnedPointerMapValueCallBacks, 0);
+  return self;
+}
+
+-(void)invalidate {
+  game = nil;
+}
+
+-(void)displayGame:(Game *)aGame
+	  comments:(BOOL)includeComments
+	variations:(BOOL)includeVariations {
+  NSTextStorage *text = [textView textStorage];
+  MoveListRange *range;
+  GameNode *node;
+
+  [text beginEditing];
+  [self setHighlighted: NO forNode: highlightedNode];
+
+  // Redraw from the start of the last move shown if nothing else changed,
+  // and everything otherwise. Someone else may have changed the text
+  // view, too.
+  if(aGame == game && [aGame modificationStamp] == modificationStamp &&
+     includeComments == comments && includeVariations == variations &&
+     [text length] == length &&
+     (range = NSMapGet(ranges, lastNode)) != NULL) {
+    [text deleteCharactersInRange:
+	    NSMakeRange(range->start, [text length] - range->start)];
+    node = lastNode;
+  } else {
+    NSResetMapTable(ranges);
+    [text deleteCharactersInRange: NSMakeRange(0, [text length])];
+    game = aGame;
+    comments = includeComments;
+    variations = includeVariations;
+    node = [game root];
+  }
+  [game appendMoveListToAttributedString: text
+	fromNode: node
+	comments: comments
+	variations: variations
+	ranges: ranges];
+
+  modificationStamp = [game modificationStamp];
+  for(lastNode = [game root]; [[lastNode children] count] > 0;
+      lastNode = [lastNode firstChildNode]);
+  highlightedNode = [game currentNode];
+  [self setHighlighted: YES forNode: highlightedNode];
+  length = [text length];
+  [text endEditing];
+}
+
+-(void)setHighlighted:(BOOL)highlighted forNode:(GameNode *)node {
+  MoveListRange *range = NSMapGet(ranges, node);
+  NSTextStorage *text = [textView textStorage];
+
+  if(range == NULL || NSMaxRange(range->move) > [text length]) return;
+  if(highlighted)
+    [text addAttribute: NSBackgroundColorAttributeName
+	  value: [NSColor lightGrayColor]
+	  range: range->move];
+  else
+    [text removeAttribute: NSBackgroundColorAttributeName
+	  range: range->move];
+}
+
+-(void)dealloc {
+  [textView release];
+  NSFreeMapTable(ranges);
+  [super dealloc];
+}
+
+@end
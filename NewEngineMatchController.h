@@ -33,6 +33,10 @@
   IBOutlet id whiteInitialTimeTextField;
   IBOutlet id whiteMoveBonusTextField;
 
+  // SPRT controls, added to the window in code
+  NSButton *sprtSwitch;
+  NSTextField *sprtElo0Field, *sprtElo1Field, *sprtAlphaField, *sprtBetaField;
+
   NSString *saveFile;
   NSString *positionFile;
   BoardController *boardController;
@@ -20,6 +20,15 @@
 #import "BoardController.h"
 #import "Engine.h"
 #import "NewEngineMatchController.h"
+#import "PGNDatabase.h"
+
+@interface NewEngineMatchController (PrivateAPI)
+-(void)addSPRTControls;
+-(NSTextField *)addSPRTField:(NSString *)label
+			  at:(float)x
+		  defaultKey:(NSString *)key;
+-(void)sprtSwitchChanged:(id)sender;
+@end
 
 @implementation NewEngineMatchController
 
@@ -44,6 +53,7 @@
     [whiteEnginePopup addItemWithTitle: s];
     [blackEnginePopup addItemWithTitle: s];
   }
+  [self addSPRTControls];
 }
   
 -(IBAction)cancelButtonPressed:(id)sender {
@@ -57,10 +67,20 @@
 }
 
 -(IBAction)okButtonPressed:(id)sender {
+  NSUserDefaults *defaults = [NSUserDefaults standardUserDefaults];
+
   if(saveFile != nil ||
      NSRunAlertPanel(@"No save game file chosen!", 
 		     @"The games will not be saved. Continue?",
 		     @"OK", @"Cancel", nil) == NSAlertDefaultReturn) {
+    // The match controller reads its SPRT parameters from the defaults:
+    [defaults setBool: [sprtSwitch state] == NSOnState
+	      forKey: @"Stop Engine Matches by SPRT"];
+    [defaults setDouble: [sprtElo0Field doubleValue] forKey: @"SPRT Elo0"];
+    [defaults setDouble: [sprtElo1Field doubleValue] forKey: @"SPRT Elo1"];
+    [defaults setDouble: [sprtAlphaField doubleValue] forKey: @"SPRT Alpha"];
+    [defaults setDouble: [sprtBetaField doubleValue] forKey: @"SPRT Beta"];
+
     [[self window] close];
     [boardController 
       startMatchWithEngine1: [whiteEnginePopup titleOfSelectedItem]
@@ -79,7 +99,7 @@
 
 -(IBAction)pickPositionPressed:(id)sender {
   NSOpenPanel *panel = [NSOpenPanel openPanel];
-  NSArray *fileTypes = [NSArray arrayWithObjects: @"pgn", nil];
+  NSArray *fileTypes = [PGNDatabase pgnFileTypes];
 
   [panel beginSheetForDirectory: nil
 	 file: nil
@@ -119,6 +139,82 @@
   }
 }
 
+-(void)addSPRTControls {
+  NSView *contentView = [[self window] contentView];
+  NSEnumerator *e = [[contentView subviews] objectEnumerator];
+  NSRect frame = [[self window] frame];
+  const float height = 60.0;
+  NSView *view;
+
+  // Make room at the bottom of the window, moving the nib's controls up
+  // ourselves rather than by their autoresizing masks:
+  frame.origin.y -= height;
+  frame.size.height += height;
+  [contentView setAutoresizesSubviews: NO];
+  [[self window] setFrame: frame display: NO];
+  [contentView setAutoresizesSubviews: YES];
+  while((view = [e nextObject])) {
+    NSRect r = [view frame];
+    r.origin.y += height;
+    [view setFrame: r];
+  }
+
+  sprtSwitch = [[NSButton alloc]
+		 initWithFrame: NSMakeRect(20.0, 34.0, 300.0, 18.0)];
+  [sprtSwitch setButtonType: NSSwitchButton];
+  [sprtSwitch setTitle: @"Stop the match early by SPRT"];
+  [sprtSwitch setState: [[NSUserDefaults standardUserDefaults]
+			  boolForKey: @"Stop Engine Matches by SPRT"]?
+	      NSOnState : NSOffState];
+  [sprtSwitch setTarget: self];
+  [sprtSwitch setAction: @selector(sprtSwitchChanged:)];
+  [contentView addSubview: sprtSwitch];
+  [sprtSwitch release];
+
+  sprtElo0Field = [self addSPRTField: @"Elo0:" at: 38.0
+			  defaultKey: @"SPRT Elo0"];
+  sprtElo1Field = [self addSPRTField: @"Elo1:" at: 128.0
+			  defaultKey: @"SPRT Elo1"];
+  sprtAlphaField = [self addSPRTField: @"Alpha:" at: 218.0
+			   defaultKey: @"SPRT Alpha"];
+  sprtBetaField = [self addSPRTField: @"Beta:" at: 308.0
+			  defaultKey: @"SPRT Beta"];
+  [self sprtSwitchChanged: sprtSwitch];
+}
+
+-(NSTextField *)addSPRTField:(NSString *)label
+			  at:(float)x
+		  defaultKey:(NSString *)key {
+  NSView *contentView = [[self window] contentView];
+  NSTextField *field;
+
+  field = [[NSTextField alloc] initWithFrame: NSMakeRect(x, 10.0, 40.0, 17.0)];
+  [field setStringValue: label];
+  [field setAlignment: NSRightTextAlignment];
+  [field setEditable: NO];
+  [field setBordered: NO];
+  [field setDrawsBackground: NO];
+  [contentView addSubview: field];
+  [field release];
+
+  field = [[NSTextField alloc]
+	    initWithFrame: NSMakeRect(x + 44.0, 8.0, 40.0, 22.0)];
+  [field setDoubleValue:
+	   [[NSUserDefaults standardUserDefaults] doubleForKey: key]];
+  [contentView addSubview: field];
+  [field release];
+  return field;
+}
+
+-(void)sprtSwitchChanged:(id)sender {
+  BOOL enabled = [sprtSwitch state] == NSOnState;
+
+  [sprtElo0Field setEnabled: enabled];
+  [sprtElo1Field setEnabled: enabled];
+  [sprtAlphaField setEnabled: enabled];
+  [sprtBetaField setEnabled: enabled];
+}
+
 -(void)dealloc {
   [saveFile release];
   [positionFile release];
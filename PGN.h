@@ -28,10 +28,14 @@
 
 #define PGN_STRING_SIZE 256
 
+struct pgn_source_t;
+struct pgn_query_t;
+
 @interface PGN : NSObject {
   NSString *filename;
-  FILE *file;
-  int fileSize;
+  struct pgn_source_t *source;
+  off_t fileSize;
+  off_t indexedFileSize;
   int charHack;
   int charColumn;
   BOOL charUnread;
@@ -44,7 +48,9 @@
   int depth;
   int numberOfGames;
   int gameIndicesSize;
-  int *gameIndices;
+  off_t *gameIndices;
+  BOOL gameIndicesChanged;
+  unsigned long long headChecksum, tailChecksum;
   char white[PGN_STRING_SIZE];
   char black[PGN_STRING_SIZE];
   char site[PGN_STRING_SIZE];
@@ -59,14 +65,19 @@
 
 -(id)initWithFilename:(NSString *)aFilename;
 -(void)initializeGameIndices;
+-(void)initializeGameIndicesQuietly;
+-(int)indexNewGames;
 -(void)close;
 -(BOOL)nextGame;
 -(BOOL)nextMove:(NSString **)string;
 -(void)rewind;
 -(void)goToGameNumber:(int)number;
 -(NSString *)pgnStringForGameNumber:(int)number;
+-(NSIndexSet *)gamesMatchingQuery:(const struct pgn_query_t *)query;
 -(NSString *)moveList;
 -(int)numberOfGames;
+-(off_t)fileSize;
+-(NSString *)filename;
 -(NSString *)white;
 -(NSString *)black;
 -(NSString *)event;
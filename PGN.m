@@ -28,6 +28,10 @@
 #import "PGNProgressController.h"
 
 #import <sys/stat.h>
+#import <zlib.h>
+
+#include "pgnquery.h"
+#include "pgnsource.h"
 
 
 // constants
@@ -35,6 +39,19 @@
 static const int TAB_SIZE = 8;
 static const int CHAR_EOF = 256;
 
+// Games are indexed without a progress window when less than this number of
+// bytes need to be read:
+static const off_t PROGRESS_WINDOW_THRESHOLD = 4 * 1024 * 1024;
+
+// Number of bytes at the start and at the end of the indexed part of the
+// file which are checksummed, in order to detect whether the file was
+// changed in other ways than by appending games. For compressed files the
+// whole file is considered indexed, and any change means reindexing.
+static const int CHECKSUM_SIZE = 4096;
+
+static const char INDEX_MAGIC[8] = "SFPGNIX2";
+static const uint32_t INDEX_BYTE_ORDER = 0x01020304;
+
 // types
 
 enum token_t {
@@ -47,15 +64,51 @@ enum token_t {
   TOKEN_RESULT = 261
 };
 
+// Header of the index files stored next to PGN files. The header is
+// followed by number_of_games + 1 game offsets, and for compressed files
+// by number_of_frames access points, each consisting of an index_frame_t
+// and a window compressed to window_length bytes.
+
+typedef struct index_header_t {
+  char magic[8];
+  uint32_t byte_order;
+  uint32_t reserved;
+  int64_t indexed_size;
+  int64_t file_size;
+  uint64_t head_checksum, tail_checksum;
+  int64_t number_of_games;
+  int64_t number_of_frames;
+} index_header_t;
+
+typedef struct index_frame_t {
+  int64_t in, out;
+  int32_t bits;
+  uint32_t window_length;
+} index_frame_t;
+
 // prototypes
 
 static BOOL is_symbol_start(int c);
 static BOOL is_symbol_next(int c);
 static void raisePGNException(NSString *exceptionreason);
+static uint64_t checksum(int fd, off_t start, off_t stop);
+static uint64_t string_checksum(const char *str);
 
 // private methods:
 
 @interface PGN (PrivateAPI) 
+-(void)initializeGameIndicesShowingProgress:(BOOL)showProgress;
+-(void)indexGamesWithProgressController:(PGNProgressController *)pc;
+-(BOOL)reopenFile;
+-(void)computeChecksums;
+-(off_t)checksummedSize;
+-(BOOL)indexIsValid;
+-(NSString *)indexFilename;
+-(BOOL)readIndexFile;
+-(void)readFramesFromIndex:(NSData *)data offset:(size_t)offset
+                     count:(int64_t)count;
+-(void)writeIndexFile;
+-(void)resetLexer;
 -(BOOL)nextMoveIntoCString:(char *)string withSize:(int)size;
 -(BOOL)skipMove;
 -(void)tokenRead;
@@ -69,25 +122,28 @@ static void raisePGNException(NSString *exceptionreason);
 @implementation PGN
 
 -(id)initWithFilename:(NSString *)aFilename {
-  struct stat fs;
-
   self = [super init];
 
   @try {
     gameIndicesSize = 1024;
-    gameIndices = malloc(gameIndicesSize * sizeof(int));
+    gameIndices = malloc(gameIndicesSize * sizeof(off_t));
     filename = [aFilename retain];
-    file = fopen([filename UTF8String], "r");
-    if(file == NULL) {
+    source = malloc(sizeof(pgn_source_t));
+    if(source == NULL || 
+       pgn_source_open(source, [filename fileSystemRepresentation]) != 0) {
+      NSString *reason = (errno == ENOTSUP)?
+	[NSString stringWithFormat: 
+		    @"File %@ is compressed with zstd, which this version does not support",
+		  filename] :
+	[NSString stringWithFormat: @"File %@ not found", filename];
+      free(source);
+      source = NULL;
       [[NSException exceptionWithName: @"PGNFileNotFoundException"
-		    reason: [NSString stringWithFormat: 
-					@"File %@ not found",
-				      filename]
+		    reason: reason
 		    userInfo: nil]
 	raise];
     }
-    stat([filename UTF8String], &fs);
-    fileSize = fs.st_size;
+    fileSize = source->size;
 
     charHack = CHAR_EOF; // DEBUG
     charColumn = 0;
@@ -116,52 +172,352 @@ static void raisePGNException(NSString *exceptionreason);
 }
 
 -(void)initializeGameIndices {
-  PGNProgressController *progressController;
+  [self initializeGameIndicesShowingProgress: YES];
+}
 
-  progressController = 
-    [[PGNProgressController alloc] initWithFilename: filename];
-  [progressController showWindow: self];
+// Like -initializeGameIndices, but without any progress window or alert
+// panel, so that it can be used from background threads. Errors are
+// reported by raising an exception.
+
+-(void)initializeGameIndicesQuietly {
+  [self initializeGameIndicesShowingProgress: NO];
+}
+
+-(void)initializeGameIndicesShowingProgress:(BOOL)showProgress {
+  PGNProgressController *progressController = nil;
 
   numberOfGames = 0;
   gameIndices[0] = 0;
+  gameIndicesChanged = NO;
+
+  // If the file has been indexed before, we only need to index the games
+  // which have been appended since then:
+  [self readIndexFile];
+
+  if(showProgress && 
+     fileSize - gameIndices[numberOfGames] > PROGRESS_WINDOW_THRESHOLD) {
+    progressController = 
+      [[PGNProgressController alloc] initWithFilename: filename];
+    [progressController showWindow: self];
+  }
+
+  @try {
+    [self indexGamesWithProgressController: progressController];
+  }
+  @catch (NSException *e) {
+    if(showProgress)
+      NSRunAlertPanel(@"Error while opening PGN file", 
+		      [e reason], nil, nil, nil, nil);
+    @throw e;
+  }
+  @finally {
+    [[progressController window] close];
+    [progressController release];
+  }
+
+  if(gameIndicesChanged) [self writeIndexFile];
+  [self rewind];
+}
+
+-(int)indexNewGames {
+  struct stat fs, ofs;
+  int oldNumberOfGames = numberOfGames;
+  BOOL reindex = NO;
+
+  if(stat([filename fileSystemRepresentation], &fs) != 0) return 0;
+
+  // If the file has been replaced by a new file, open the new file:
+  if(fstat(source->fd, &ofs) != 0 || 
+     fs.st_dev != ofs.st_dev || fs.st_ino != ofs.st_ino) {
+    if(![self reopenFile]) return 0;
+    reindex = YES;
+  }
+  fileSize = fs.st_size;
+
+  // Unless games were only added at the end of the file, everything has to
+  // be indexed again. Buffered data and the access points of a compressed
+  // file are no longer valid either, so the file is opened again.
+  if(reindex || ![self indexIsValid]) {
+    if(!reindex && ![self reopenFile]) return 0;
+    numberOfGames = 0;
+    gameIndices[0] = 0;
+    reindex = YES;
+  }
+  else if(source->format != PGN_SOURCE_PLAIN ||
+	  fileSize == gameIndices[numberOfGames]) 
+    return 0;
+
+  @try {
+    [self indexGamesWithProgressController: nil];
+  }
+  @catch (NSException *e) {
+    NSLog(@"Error while indexing %@: %@", filename, [e reason]);
+  }
+  @finally {
+  }
+
+  if(gameIndicesChanged) [self writeIndexFile];
+  return reindex? -1 : numberOfGames - oldNumberOfGames;
+}
+
+-(void)close {
+  if(source != NULL) {
+    pgn_source_close(source);
+    free(source);
+    source = NULL;
+  }
+}
+
+-(void)indexGamesWithProgressController:(PGNProgressController *)pc {
+  [self resetLexer];
+  pgn_source_seek(source, gameIndices[numberOfGames]);
+
   @try {
     while([self nextGame]) {
       while([self skipMove]);
-      // while([self nextMoveIntoCString: string withSize: 256]);
       numberOfGames++;
       if(numberOfGames >= gameIndicesSize) {
+	off_t *newGameIndices;
 	gameIndicesSize *= 2;
-	gameIndices = realloc(gameIndices, gameIndicesSize * sizeof(int));
-	if(gameIndices == NULL) {
+	newGameIndices = realloc(gameIndices, gameIndicesSize * sizeof(off_t));
+	if(newGameIndices == NULL) {
 	  NSException *e = 
 	    [NSException exceptionWithName: @"PGNOutOfMemoryException"
 			 reason: @"Not enough memory to read PGN file"
 			 userInfo: nil];
-	
+	  numberOfGames--;
+	  gameIndicesSize /= 2;
 	  @throw e;
 	}
+	gameIndices = newGameIndices;
       }
-      gameIndices[numberOfGames] = ftell(file);
-      if(numberOfGames % 200 == 0)
-	[progressController 
-	  setDoubleValue: (gameIndices[numberOfGames]*100.0) / (fileSize*1.0)];
+      gameIndices[numberOfGames] = pgn_source_tell(source);
+      gameIndicesChanged = YES;
+      if(pc != nil && numberOfGames % 200 == 0)
+	[pc setDoubleValue: (pgn_source_position(source)*100.0) / (fileSize*1.0)];
     }
   }
   @catch (NSException *e) {
-    NSRunAlertPanel(@"Error while opening PGN file", 
-		    [e reason], nil, nil, nil, nil);
-    @throw e;
+    // A game which ends prematurely at the end of the file is most likely
+    // still being written. It is left out of the index for now, and will
+    // be picked up by -indexNewGames once it is complete.
+    if(charHack != CHAR_EOF || 
+       [[e name] isEqualToString: @"PGNOutOfMemoryException"])
+      @throw e;
   }
   @finally {
-    [[progressController window] close];
-    [progressController release];
+    [self computeChecksums];
   }
+}
 
-  [self rewind];
+-(BOOL)reopenFile {
+  pgn_source_t newSource;
+
+  if(pgn_source_open(&newSource, [filename fileSystemRepresentation]) != 0)
+    return NO;
+  pgn_source_close(source);
+  *source = newSource;
+  return YES;
 }
-  
--(void)close {
-  fclose(file);
+
+-(void)computeChecksums {
+  off_t end;
+
+  indexedFileSize = fileSize;
+  end = [self checksummedSize];
+  headChecksum = checksum(source->fd, 0, MIN(end, CHECKSUM_SIZE));
+  tailChecksum = checksum(source->fd, MAX(end - CHECKSUM_SIZE, 0), end);
+}
+
+// Games are indexed by their offsets in the uncompressed data, but the
+// checksums are computed over the file as stored on disk.
+
+-(off_t)checksummedSize {
+  if(source->format == PGN_SOURCE_PLAIN)
+    return gameIndices[numberOfGames];
+  return indexedFileSize;
+}
+
+-(BOOL)indexIsValid {
+  off_t end = [self checksummedSize];
+  if(source->format != PGN_SOURCE_PLAIN && fileSize != indexedFileSize)
+    return NO;
+  return fileSize >= end &&
+    headChecksum == checksum(source->fd, 0, MIN(end, CHECKSUM_SIZE)) &&
+    tailChecksum == checksum(source->fd, MAX(end - CHECKSUM_SIZE, 0), end);
+}
+
+// The index is stored next to the PGN file if possible, and in the user's
+// cache directory otherwise.
+
+-(NSString *)indexFilename {
+  NSFileManager *fm = [NSFileManager defaultManager];
+  NSString *path = [filename stringByAppendingString: @".index"];
+  NSString *dir;
+
+  if([fm fileExistsAtPath: path]? [fm isWritableFileAtPath: path] :
+     [fm isWritableFileAtPath: [filename stringByDeletingLastPathComponent]])
+    return path;
+
+  dir = [[NSSearchPathForDirectoriesInDomains(NSCachesDirectory,
+					       NSUserDomainMask, YES)
+	   objectAtIndex: 0]
+	  stringByAppendingPathComponent: @"Stockfish/Indexes"];
+  [fm createDirectoryAtPath: dir withIntermediateDirectories: YES
+      attributes: nil error: NULL];
+  return [dir stringByAppendingPathComponent:
+		[NSString stringWithFormat: @"%016llx.index", 
+			  string_checksum([filename fileSystemRepresentation])]];
+}
+
+-(BOOL)readIndexFile {
+  NSData *data = [NSData dataWithContentsOfFile: [self indexFilename]];
+  index_header_t header;
+  const int64_t *offsets;
+  int i;
+
+  if(data == nil || [data length] < sizeof(index_header_t)) return NO;
+  memcpy(&header, [data bytes], sizeof(index_header_t));
+  if(memcmp(header.magic, INDEX_MAGIC, 8) != 0 || 
+     header.byte_order != INDEX_BYTE_ORDER || 
+     header.number_of_games < 0 || header.number_of_games >= INT_MAX ||
+     [data length] < sizeof(index_header_t) + 
+     (header.number_of_games + 1) * sizeof(int64_t))
+    return NO;
+
+  offsets = (const int64_t *)((const char *)[data bytes] + 
+			      sizeof(index_header_t));
+  if(offsets[header.number_of_games] != header.indexed_size ||
+     (source->format == PGN_SOURCE_PLAIN && header.indexed_size > fileSize))
+    return NO;
+
+  if(header.number_of_games >= gameIndicesSize) {
+    off_t *newGameIndices;
+    int newSize = gameIndicesSize;
+    while(newSize <= header.number_of_games) newSize *= 2;
+    newGameIndices = realloc(gameIndices, newSize * sizeof(off_t));
+    if(newGameIndices == NULL) return NO;
+    gameIndices = newGameIndices;
+    gameIndicesSize = newSize;
+  }
+  for(i = 0; i <= header.number_of_games; i++)
+    gameIndices[i] = offsets[i];
+  numberOfGames = header.number_of_games;
+  indexedFileSize = header.file_size;
+  headChecksum = header.head_checksum;
+  tailChecksum = header.tail_checksum;
+
+  // Is the file still the same, apart from games appended at the end?
+  if(![self indexIsValid]) {
+    numberOfGames = 0;
+    gameIndices[0] = 0;
+    return NO;
+  }
+
+  if(source->format != PGN_SOURCE_PLAIN)
+    [self readFramesFromIndex: data
+	  offset: sizeof(index_header_t) + 
+	  (numberOfGames + 1) * sizeof(int64_t)
+	  count: header.number_of_frames];
+  return YES;
+}
+
+// The access points are only needed for fast random access, so if they
+// can't be read, we just go on without them.
+
+-(void)readFramesFromIndex:(NSData *)data offset:(size_t)offset
+                     count:(int64_t)count {
+  const unsigned char *bytes = [data bytes];
+  pgn_frame_t *frames;
+  index_frame_t frame;
+  uLongf length;
+  int i, n = 0;
+
+  if(count < 1 || count >= INT_MAX / sizeof(pgn_frame_t)) return;
+  frames = calloc(count, sizeof(pgn_frame_t));
+  if(frames == NULL) return;
+  for(i = 0; i < count; i++) {
+    if(offset + sizeof(index_frame_t) > [data length]) break;
+    memcpy(&frame, bytes + offset, sizeof(index_frame_t));
+    offset += sizeof(index_frame_t);
+    if(frame.window_length > [data length] - offset) break;
+    frames[i].in = frame.in;
+    frames[i].out = frame.out;
+    frames[i].bits = frame.bits;
+    if(frame.bits >= 0) {
+      frames[i].window = malloc(PGN_SOURCE_WINDOW_SIZE);
+      length = PGN_SOURCE_WINDOW_SIZE;
+      if(frames[i].window == NULL ||
+	 uncompress(frames[i].window, &length, bytes + offset, 
+		    frame.window_length) != Z_OK || 
+	 length != PGN_SOURCE_WINDOW_SIZE) {
+	free(frames[i].window);
+	break;
+      }
+    }
+    offset += frame.window_length;
+    n++;
+  }
+  if(n == count && frames[0].out == 0)
+    pgn_source_set_frames(source, frames, n);
+  else {
+    for(i = 0; i < n; i++) free(frames[i].window);
+    free(frames);
+  }
+}
+
+-(void)writeIndexFile {
+  NSMutableData *data = [NSMutableData data];
+  index_header_t header;
+  int i;
+
+  memcpy(header.magic, INDEX_MAGIC, 8);
+  header.byte_order = INDEX_BYTE_ORDER;
+  header.reserved = 0;
+  header.indexed_size = gameIndices[numberOfGames];
+  header.file_size = indexedFileSize;
+  header.head_checksum = headChecksum;
+  header.tail_checksum = tailChecksum;
+  header.number_of_games = numberOfGames;
+  header.number_of_frames = 
+    (source->format == PGN_SOURCE_PLAIN)? 0 : source->frame_count;
+  [data appendBytes: &header length: sizeof(index_header_t)];
+  for(i = 0; i <= numberOfGames; i++) {
+    int64_t offset = gameIndices[i];
+    [data appendBytes: &offset length: sizeof(int64_t)];
+  }
+  for(i = 0; i < header.number_of_frames; i++) {
+    pgn_frame_t *f = source->frames + i;
+    unsigned char window[PGN_SOURCE_WINDOW_SIZE + 1024];
+    uLongf length = 0;
+    index_frame_t frame;
+
+    if(f->bits >= 0) {
+      length = sizeof(window);
+      if(compress(window, &length, f->window, PGN_SOURCE_WINDOW_SIZE) 
+	 != Z_OK) 
+	return;
+    }
+    frame.in = f->in;
+    frame.out = f->out;
+    frame.bits = f->bits;
+    frame.window_length = length;
+    [data appendBytes: &frame length: sizeof(index_frame_t)];
+    [data appendBytes: window length: length];
+  }
+  if([data writeToFile: [self indexFilename] atomically: YES])
+    gameIndicesChanged = NO;
+}
+
+-(void)resetLexer {
+  charHack = CHAR_EOF;
+  charColumn = 0;
+  charUnread = NO;
+  charFirst = YES;
+  tokenType = TOKEN_ERROR;
+  tokenUnread = NO; 
+  tokenFirst = YES;
+  depth = 0;
 }
 
 -(BOOL)nextGame {
@@ -646,6 +1002,26 @@ static BOOL is_symbol_next(int c) {
      strchr("ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789_+#=:-/",c) != NULL;
 }
 
+static uint64_t checksum(int fd, off_t start, off_t stop) {
+  unsigned char buffer[CHECKSUM_SIZE];
+  uint64_t h = 0xcbf29ce484222325ULL;
+  ssize_t i, n;
+
+  if(stop - start > CHECKSUM_SIZE) stop = start + CHECKSUM_SIZE;
+  if(stop <= start) return h;
+  n = pread(fd, buffer, stop - start, start);
+  for(i = 0; i < n; i++) 
+    h = (h ^ buffer[i]) * 0x100000001b3ULL;
+  return h;
+}
+
+static uint64_t string_checksum(const char *str) {
+  uint64_t h = 0xcbf29ce484222325ULL;
+  for( ; *str; str++)
+    h = (h ^ (unsigned char)*str) * 0x100000001b3ULL;
+  return h;
+}
+
 static void raisePGNException(NSString *exceptionreason) {
   NSException *e = [NSException exceptionWithName: @"PGNParseException" 
 				reason: exceptionreason			
@@ -678,7 +1054,7 @@ static void raisePGNException(NSString *exceptionreason) {
   }
 
   // read a new character
-  charHack = fgetc(file);
+  charHack = pgn_source_getc(source);
   if(charHack == EOF) {
     charHack = TOKEN_EOF;
   }
@@ -689,7 +1065,7 @@ static void raisePGNException(NSString *exceptionreason) {
 }
 
 -(void)rewind {
-  rewind(file);
+  pgn_source_seek(source, 0);
 }
 
 -(NSString *)white {
@@ -728,12 +1104,13 @@ static void raisePGNException(NSString *exceptionreason) {
       raise];
   charUnread = NO;
   tokenUnread = NO;
-  fseek(file, gameIndices[number], SEEK_SET);
+  pgn_source_seek(source, gameIndices[number]);
   [self nextGame];
 }
 
 -(NSString *)pgnStringForGameNumber:(int)number {
-  int start, stop, current, ch;
+  off_t start, stop, current;
+  int ch;
   NSMutableString *mstr = [[NSMutableString alloc] initWithString: @""];
   NSString *str;
   if(number < 0 || number >= numberOfGames)
@@ -743,9 +1120,9 @@ static void raisePGNException(NSString *exceptionreason) {
       raise];
   current = start = gameIndices[number];
   stop = gameIndices[number+1];
-  fseek(file, start, SEEK_SET);
+  pgn_source_seek(source, start);
   while(current < stop) {
-    ch = fgetc(file);
+    ch = pgn_source_getc(source);
     [mstr appendFormat: @"%c", ch];
     current++;
   }
@@ -754,6 +1131,43 @@ static void raisePGNException(NSString *exceptionreason) {
   return str;
 }
  
+// Returns the numbers of the games which match a query. The games are read
+// in order through a source of their own, so that a file can be searched
+// in another thread while it is browsed.
+
+-(NSIndexSet *)gamesMatchingQuery:(const struct pgn_query_t *)query {
+  NSMutableIndexSet *games = [NSMutableIndexSet indexSet];
+  pgn_source_t src;
+  pgn_game_t *game;
+  char *text = NULL;
+  size_t length, capacity = 0;
+  int i;
+
+  if(pgn_source_open(&src, [filename fileSystemRepresentation]) != 0)
+    [[NSException exceptionWithName: @"PGNFileNotFoundException"
+		  reason: [NSString stringWithFormat: @"File %@ not found",
+				    filename]
+		  userInfo: nil]
+      raise];
+  game = malloc(sizeof(pgn_game_t));
+  pgn_source_seek(&src, gameIndices[0]);
+  for(i = 0; i < numberOfGames && game != NULL; i++) {
+    length = gameIndices[i + 1] - gameIndices[i];
+    if(length > capacity) {
+      capacity = MAX(length, 2 * capacity);
+      free(text);
+      if((text = malloc(capacity)) == NULL) break;
+    }
+    if(pgn_source_read(&src, text, length) < length) break;
+    if(pgn_query_match(query, text, length, game))
+      [games addIndex: i];
+  }
+  free(text);
+  free(game);
+  pgn_source_close(&src);
+  return games;
+}
+
 -(NSString *)moveList {
   char cstr[256];
   NSMutableString *mstring = [[NSMutableString alloc] initWithString: @""];
@@ -771,7 +1185,16 @@ static void raisePGNException(NSString *exceptionreason) {
   return numberOfGames;
 }
 
+-(off_t)fileSize {
+  return fileSize;
+}
+
+-(NSString *)filename {
+  return filename;
+}
+
 -(void)dealloc {
+  [self close];
   free(gameIndices);
   [filename release];
   [super dealloc];
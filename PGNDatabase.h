@@ -0,0 +1,63 @@
+/*
+  Stockfish, a OS X GUI for the UCI chess engine with the same name.
+  Copyright (C) 2004-2011 Marco Costalba, Joona Kiiski, Tord Romstad
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#import <Cocoa/Cocoa.h>
+
+@class PGN;
+struct pgn_query_t;
+
+// A PGNDatabase presents a set of PGN files as a single list of games,
+// numbered consecutively through the files in the order they were given.
+// It answers the same messages as PGN, so that a game list can show either.
+// Queries on tags, positions and material search all files in parallel.
+
+@interface PGNDatabase : NSObject {
+  NSString *name;
+  NSMutableArray *files;
+  NSArray *filesBySize;
+  NSMutableArray *errors;
+  int *firstGames;
+  PGN *currentFile;
+  const struct pgn_query_t *query;  // The query being run
+  NSMutableIndexSet *matchingGames;
+  volatile int32_t nextFile;
+  volatile int32_t runningThreads;
+  volatile int64_t bytesIndexed;
+}
+
++(NSArray *)pgnFileTypes;
++(NSArray *)pgnFilenamesAtPath:(NSString *)path;
+-(id)initWithFilenames:(NSArray *)filenames name:(NSString *)aName;
+-(void)initializeGameIndices;
+-(void)close;
+-(void)goToGameNumber:(int)number;
+-(NSString *)pgnStringForGameNumber:(int)number;
+-(NSString *)filenameForGameNumber:(int)number;
+-(NSIndexSet *)gamesMatchingQuery:(const struct pgn_query_t *)aQuery;
+-(int)numberOfGames;
+-(int)numberOfFiles;
+-(NSString *)white;
+-(NSString *)black;
+-(NSString *)event;
+-(NSString *)date;
+-(NSString *)site;
+-(NSString *)round;
+-(NSString *)result;
+
+@end
@@ -0,0 +1,359 @@
+/*
+  Stockfish, a OS X GUI for the UCI chess engine with the same name.
+  Copyright (C) 2004-2011 Marco Costalba, Joona Kiiski, Tord Romstad
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#import "PGN.h"
+#import "PGNDatabase.h"
+#import "PGNProgressController.h"
+
+#import <libkern/OSAtomic.h>
+#import <sys/resource.h>
+#import <sys/syslimits.h>
+
+#include "pgnscan.h"
+
+
+// Files are indexed without a progress window when their total size is
+// less than this number of bytes:
+static const off_t PROGRESS_WINDOW_THRESHOLD = 4 * 1024 * 1024;
+
+// Maximum number of indexing errors listed in the alert panel:
+static const int MAX_REPORTED_ERRORS = 5;
+
+static NSInteger compareFileSizes(id pgn1, id pgn2, void *context);
+
+
+@interface PGNDatabase (PrivateAPI)
+-(void)processFilesInParallel:(SEL)selector title:(NSString *)title;
+-(void)indexFiles:(id)anObject;
+-(void)searchFiles:(id)anObject;
+-(void)computeGameNumbers;
+-(int)fileIndexForGameNumber:(int)number;
+@end
+
+
+@implementation PGNDatabase
+
+// The file name extensions of PGN files which can be opened. zstd
+// compressed files can only be read when pgnsource.m is compiled with
+// HAVE_ZSTD.
+
++(NSArray *)pgnFileTypes {
+#if defined(HAVE_ZSTD)
+  return [NSArray arrayWithObjects: @"pgn", @"gz", @"zst", nil];
+#else
+  return [NSArray arrayWithObjects: @"pgn", @"gz", nil];
+#endif
+}
+
+// Returns the PGN files (plain or compressed) in a directory and all its
+// subdirectories, sorted by name. If the path is a file, it is returned
+// as it is.
+
++(NSArray *)pgnFilenamesAtPath:(NSString *)path {
+  NSFileManager *fm = [NSFileManager defaultManager];
+  NSMutableArray *filenames = [NSMutableArray array];
+  NSDirectoryEnumerator *e;
+  NSString *file, *extension;
+  BOOL isDirectory;
+
+  if(![fm fileExistsAtPath: path isDirectory: &isDirectory])
+    return filenames;
+  if(!isDirectory) {
+    [filenames addObject: path];
+    return filenames;
+  }
+  e = [fm enumeratorAtPath: path];
+  while((file = [e nextObject]) != nil) {
+    extension = [[file pathExtension] lowercaseString];
+    if(![extension isEqualToString: @"pgn"] &&
+       [[self pgnFileTypes] containsObject: extension])
+      extension =
+	[[[file stringByDeletingPathExtension] pathExtension] lowercaseString];
+    if([extension isEqualToString: @"pgn"])
+      [filenames addObject: [path stringByAppendingPathComponent: file]];
+  }
+  return [filenames sortedArrayUsingSelector: @selector(compare:)];
+}
+
+-(id)initWithFilenames:(NSArray *)filenames name:(NSString *)aName {
+  NSEnumerator *e = [filenames objectEnumerator];
+  NSString *filename;
+  struct rlimit rl;
+
+  self = [super init];
+  name = [aName retain];
+  files = [[NSMutableArray alloc] init];
+  errors = [[NSMutableArray alloc] init];
+
+  // All files are kept open, which may need more file descriptors than
+  // the default limit allows:
+  if(getrlimit(RLIMIT_NOFILE, &rl) == 0 &&
+     rl.rlim_cur < [filenames count] + 64) {
+    rl.rlim_cur = MIN(rl.rlim_max, OPEN_MAX);
+    setrlimit(RLIMIT_NOFILE, &rl);
+  }
+
+  while((filename = [e nextObject]) != nil) {
+    @try {
+      PGN *pgn = [[PGN alloc] initWithFilename: filename];
+      [files addObject: pgn];
+      [pgn release];
+    }
+    @catch (NSException *ex) {
+      // PGN has already told the user about the problem.
+    }
+  }
+  [self computeGameNumbers];
+  return self;
+}
+
+// Runs the selector in one thread per processor, each taking the next
+// file until all are done. The largest files are taken first, so that the
+// threads finish at about the same time. On the main thread, the progress
+// window runs as a modal session while waiting, so that the application
+// keeps handling events.
+
+-(void)processFilesInParallel:(SEL)selector title:(NSString *)title {
+  PGNProgressController *progressController = nil;
+  NSModalSession session = NULL;
+  int i, threads = MIN(pgn_cpu_count(), (int)[files count]);
+  double totalSize = 0.0;
+
+  for(i = 0; i < [files count]; i++)
+    totalSize += [[files objectAtIndex: i] fileSize];
+  if(totalSize > PROGRESS_WINDOW_THRESHOLD) {
+    progressController =
+      [[PGNProgressController alloc] initWithFilename: title];
+    [progressController showWindow: self];
+    if([NSThread isMainThread])
+      session = [NSApp beginModalSessionForWindow: [progressController window]];
+  }
+
+  [filesBySize release];
+  filesBySize =
+    [[files sortedArrayUsingFunction: compareFileSizes context: NULL] retain];
+  nextFile = 0;
+  bytesIndexed = 0;
+  runningThreads = threads;
+  for(i = 0; i < threads; i++)
+    [NSThread detachNewThreadSelector: selector
+	      toTarget: self
+	      withObject: nil];
+  while(OSAtomicAdd32Barrier(0, &runningThreads) > 0) {
+    if(session != NULL)
+      [NSApp runModalSession: session];
+    [progressController setDoubleValue:
+      (OSAtomicAdd64Barrier(0, &bytesIndexed) * 100.0) / totalSize];
+    [NSThread sleepUntilDate: [NSDate dateWithTimeIntervalSinceNow: 0.05]];
+  }
+  if(session != NULL)
+    [NSApp endModalSession: session];
+  [[progressController window] close];
+  [progressController release];
+}
+
+// Indexes all files in parallel, using their index files where possible.
+
+-(void)initializeGameIndices {
+  [errors removeAllObjects];
+  [self processFilesInParallel: @selector(indexFiles:) title: name];
+  [self computeGameNumbers];
+  if([errors count] > 0) {
+    NSArray *reported = [errors subarrayWithRange:
+      NSMakeRange(0, MIN([errors count], MAX_REPORTED_ERRORS))];
+    NSRunAlertPanel(@"Error while opening PGN files",
+		    @"%d of the %d files could not be read completely. Games after the first error in a file are left out.\n\n%@",
+		    nil, nil, nil, (int)[errors count], (int)[files count],
+		    [reported componentsJoinedByString: @"\n"]);
+  }
+}
+
+-(void)indexFiles:(id)anObject {
+  NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+  int i;
+
+  while((i = OSAtomicIncrement32Barrier(&nextFile) - 1) < [filesBySize count]) {
+    PGN *pgn = [filesBySize objectAtIndex: i];
+    @try {
+      [pgn initializeGameIndicesQuietly];
+    }
+    @catch (NSException *e) {
+      @synchronized(errors) {
+	[errors addObject: [NSString stringWithFormat: @"%@: %@",
+				     [[pgn filename] lastPathComponent],
+				     [e reason]]];
+      }
+    }
+    OSAtomicAdd64Barrier([pgn fileSize], &bytesIndexed);
+  }
+  [pool release];
+  OSAtomicDecrement32Barrier(&runningThreads);
+}
+
+// Searches all files in parallel, and returns the numbers of the matching
+// games. Files which can't be read are skipped.
+
+-(NSIndexSet *)gamesMatchingQuery:(const struct pgn_query_t *)aQuery {
+  NSIndexSet *result;
+
+  query = aQuery;
+  matchingGames = [[NSMutableIndexSet alloc] init];
+  [self processFilesInParallel: @selector(searchFiles:)
+	title: [NSString stringWithFormat: @"Searching %@", name]];
+  result = [matchingGames autorelease];
+  matchingGames = nil;
+  query = NULL;
+  return result;
+}
+
+-(void)searchFiles:(id)anObject {
+  NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+  int i;
+
+  while((i = OSAtomicIncrement32Barrier(&nextFile) - 1) < [filesBySize count]) {
+    PGN *pgn = [filesBySize objectAtIndex: i];
+    int first = firstGames[[files indexOfObjectIdenticalTo: pgn]];
+    NSIndexSet *games;
+    NSUInteger number;
+
+    @try {
+      games = [pgn gamesMatchingQuery: query];
+      @synchronized(matchingGames) {
+	for(number = [games firstIndex]; number != NSNotFound;
+	    number = [games indexGreaterThanIndex: number])
+	  [matchingGames addIndex: first + number];
+      }
+    }
+    @catch (NSException *e) {
+      NSLog(@"%@: %@", [[pgn filename] lastPathComponent], [e reason]);
+    }
+    OSAtomicAdd64Barrier([pgn fileSize], &bytesIndexed);
+  }
+  [pool release];
+  OSAtomicDecrement32Barrier(&runningThreads);
+}
+
+-(void)computeGameNumbers {
+  int i;
+
+  firstGames = realloc(firstGames, ([files count] + 1) * sizeof(int));
+  firstGames[0] = 0;
+  for(i = 0; i < [files count]; i++)
+    firstGames[i + 1] = firstGames[i] + [[files objectAtIndex: i] numberOfGames];
+}
+
+// Returns the file containing a game, i.e. the last file whose first game
+// number is not greater than the game number. Files without games are
+// skipped because the following file has the same first game number.
+
+-(int)fileIndexForGameNumber:(int)number {
+  int low = 0, high = [files count] - 1, middle;
+
+  if(number < 0 || number >= [self numberOfGames])
+    [[NSException exceptionWithName: @"PGNGameOutOfBounds"
+		  reason: @"Game number out of bounds for PGN database"
+		  userInfo: nil]
+      raise];
+  while(low < high) {
+    middle = (low + high + 1) / 2;
+    if(firstGames[middle] <= number)
+      low = middle;
+    else
+      high = middle - 1;
+  }
+  return low;
+}
+
+-(void)close {
+  [files makeObjectsPerformSelector: @selector(close)];
+  currentFile = nil;
+}
+
+-(void)goToGameNumber:(int)number {
+  int i = [self fileIndexForGameNumber: number];
+  currentFile = [files objectAtIndex: i];
+  [currentFile goToGameNumber: number - firstGames[i]];
+}
+
+-(NSString *)pgnStringForGameNumber:(int)number {
+  int i = [self fileIndexForGameNumber: number];
+  return [[files objectAtIndex: i]
+	   pgnStringForGameNumber: number - firstGames[i]];
+}
+
+-(NSString *)filenameForGameNumber:(int)number {
+  return [[files objectAtIndex: [self fileIndexForGameNumber: number]]
+	   filename];
+}
+
+-(int)numberOfGames {
+  return firstGames[[files count]];
+}
+
+-(int)numberOfFiles {
+  return [files count];
+}
+
+-(NSString *)white {
+  return [currentFile white];
+}
+
+-(NSString *)black {
+  return [currentFile black];
+}
+
+-(NSString *)event {
+  return [currentFile event];
+}
+
+-(NSString *)date {
+  return [currentFile date];
+}
+
+-(NSString *)site {
+  return [currentFile site];
+}
+
+-(NSString *)round {
+  return [currentFile round];
+}
+
+-(NSString *)result {
+  return [currentFile result];
+}
+
+-(void)dealloc {
+  [name release];
+  [files release];
+  [filesBySize release];
+  [errors release];
+  free(firstGames);
+  [super dealloc];
+}
+
+@end
+
+
+static NSInteger compareFileSizes(id pgn1, id pgn2, void *context) {
+  off_t size1 = [pgn1 fileSize], size2 = [pgn2 fileSize];
+
+  if(size1 > size2) return NSOrderedAscending;
+  if(size1 < size2) return NSOrderedDescending;
+  return NSOrderedSame;
+}
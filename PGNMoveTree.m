@@ -0,0 +1,82 @@
+/*
+  Stockfish, a OS X GUI for the UCI chess engine with the same name.
+  Copyright (C) 2004-2011 Marco Costalba, Joona Kiiski, Tord Romstad
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+  
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#import "PGNMoveTree.h"
+
+
+@implementation PGNMoveTree
+
+// Returns nil if the game can't be parsed. The caller should then fall back
+// to the slower GameParser, which also gives a better error message.
+
+-(id)initWithPGNString:(NSString *)string {
+  const char *text = [string UTF8String];
+  int i;
+
+  self = [super init];
+  pgn_tree_init(tree);
+  if(text == NULL || pgn_parse_tree(text, strlen(text), tree) != PGN_OK) {
+    [self release];
+    return nil;
+  }
+
+  // The nesting frames are only needed while parsing, and the tags point
+  // into 'text', which goes away with the autorelease pool:
+  free(tree->frames);
+  tree->frames = NULL;
+  tree->frame_capacity = 0;
+  tags = [[NSMutableDictionary alloc] init];
+  for(i = 0; i < tree->tag_count; i++)
+    [tags setObject: [self stringWithBytes: tree->tags[i].value
+			   length: tree->tags[i].value_length]
+	  forKey: [self stringWithBytes: tree->tags[i].name
+			length: tree->tags[i].name_length]];
+  tree->tag_count = 0;
+  return self;
+}
+
+-(pgn_tree_t *)tree {
+  return tree;
+}
+
+-(NSString *)valueForTag:(NSString *)name {
+  return [tags objectForKey: name];
+}
+
+// PGN files should be in Latin-1, but many are in UTF-8. Try UTF-8 first,
+// since Latin-1 accepts anything.
+
+-(NSString *)stringWithBytes:(const char *)bytes length:(int)length {
+  NSString *string = [[NSString alloc] initWithBytes: bytes
+				       length: length
+				       encoding: NSUTF8StringEncoding];
+  if(string == nil)
+    string = [[NSString alloc] initWithBytes: bytes
+			       length: length
+			       encoding: NSISOLatin1StringEncoding];
+  return [string autorelease];
+}
+
+-(void)dealloc {
+  pgn_tree_free(tree);
+  [tags release];
+  [super dealloc];
+}
+
+@end
@@ -0,0 +1,44 @@
+/*
+  Stockfish, a OS X GUI for the UCI chess engine with the same name.
+  Copyright (C) 2004-2011 Marco Costalba, Joona Kiiski, Tord Romstad
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#import <Cocoa/Cocoa.h>
+
+@class Game;
+
+// A PGNWriter appends games to a PGN file which is kept open, through a
+// large buffer which is written out every few seconds rather than after
+// every game.
+
+@interface PGNWriter : NSObject {
+  NSString *filename;
+  FILE *file;
+  char *buffer;
+  int lastFlushTime;
+  int gamesWritten;
+}
+
+-(id)initWithFilename:(NSString *)aFilename;
+-(NSString *)filename;
+-(int)gamesWritten;
+-(void)writeGame:(Game *)game;
+-(void)writePGNString:(NSString *)string;
+-(void)flush;
+-(void)close;
+
+@end
@@ -0,0 +1,95 @@
+/*
+  Stockfish, a OS X GUI for the UCI chess engine with the same name.
+  Copyright (C) 2004-2011 Marco Costalba, Joona Kiiski, Tord Romstad
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#import "Game.h"
+#import "PGNWriter.h"
+
+// Size of the output buffer:
+static const int PGN_WRITER_BUFFER_SIZE = 256 * 1024;
+
+// The buffer is written to disk when this many milliseconds have passed
+// since the last time, so that little is lost if the program crashes:
+static const int FLUSH_INTERVAL = 5000;
+
+
+@implementation PGNWriter
+
+-(id)initWithFilename:(NSString *)aFilename {
+  self = [super init];
+  file = fopen([aFilename fileSystemRepresentation], "a");
+  if(file == NULL) {
+    [self release];
+    [[NSException exceptionWithName: @"PGNWriterOpenFailed"
+		  reason: [NSString stringWithFormat:
+				      @"Could not open %@ for writing: %s",
+				    aFilename, strerror(errno)]
+		  userInfo: nil]
+      raise];
+  }
+  buffer = malloc(PGN_WRITER_BUFFER_SIZE);
+  setvbuf(file, buffer, _IOFBF, PGN_WRITER_BUFFER_SIZE);
+  filename = [aFilename retain];
+  lastFlushTime = [ChessClock currentSystemTime];
+  gamesWritten = 0;
+  return self;
+}
+
+-(NSString *)filename {
+  return filename;
+}
+
+-(int)gamesWritten {
+  return gamesWritten;
+}
+
+-(void)writeGame:(Game *)game {
+  [self writePGNString: [game PGNString]];
+}
+
+// Writes a game which is already in PGN format, such as a game copied
+// unchanged from another file.
+
+-(void)writePGNString:(NSString *)string {
+  if(file == NULL) return;
+  fputs([string UTF8String], file);
+  gamesWritten++;
+  if([ChessClock currentSystemTime] - lastFlushTime >= FLUSH_INTERVAL)
+    [self flush];
+}
+
+-(void)flush {
+  if(file != NULL) fflush(file);
+  lastFlushTime = [ChessClock currentSystemTime];
+}
+
+-(void)close {
+  if(file != NULL) {
+    fclose(file);
+    file = NULL;
+  }
+}
+
+-(void)dealloc {
+  [self close];
+  free(buffer);
+  [filename release];
+  [super dealloc];
+}
+
+@end
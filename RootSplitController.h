@@ -0,0 +1,67 @@
+/*
+  Stockfish, a OS X GUI for the UCI chess engine with the same name.
+  Copyright (C) 2004-2011 Marco Costalba, Joona Kiiski, Tord Romstad
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#import <Cocoa/Cocoa.h>
+
+#include "pvsan.h"
+#include "rootsplit.h"
+#include "uciinfo.h"
+
+@class ChessPosition;
+@class Game;
+@class RootSplitWorker;
+
+// A RootSplitController analyzes a position by splitting its legal moves
+// over several engine processes, each searching one move at a time with
+// "go searchmoves", and shows all moves ranked by score in a window of
+// its own. The analysis runs until the window is closed, or until all
+// moves reach the maximum depth.
+
+@interface RootSplitController : NSWindowController {
+  NSTextView *textView;
+  ChessPosition *position;
+  NSMutableString *positionCommand;  // The game up to the position
+  BOOL frc;
+  NSString *enginePath;
+  NSMutableArray *workers;
+  NSMutableArray *moveStrings;  // The moves in coordinate notation
+  root_split_t *split;
+  pv_san_cache_t *pvCache;
+  NSTimer *displayTimer;
+  int threads, hash;
+  BOOL whiteScore;
+  BOOL stopped;
+}
+
++(int)defaultNumberOfWorkers;
+-(id)initWithGame:(Game *)game engine:(NSString *)engineName;
+-(void)start;
+-(void)stop;
+-(int)engineThreads;
+-(int)engineHash;
+
+// Messages from the workers:
+-(void)workerIsReady:(RootSplitWorker *)worker;
+-(void)worker:(RootSplitWorker *)worker
+ finishedMove:(int)index
+	depth:(int)depth
+	 info:(const uci_info_t *)info;
+-(void)workerDidTerminate:(RootSplitWorker *)worker;
+
+@end
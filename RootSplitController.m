@@ -0,0 +1,292 @@
+/*
+  Stockfish, a OS X GUI for the UCI chess engine with the same name.
+  Copyright (C) 2004-2011 Marco Costalba, Joona Kiiski, Tord Romstad
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#import "ChessMove.h"
+#import "ChessPosition.h"
+#import "Engine.h"
+#import "Game.h"
+#import "GameNode.h"
+#import "RootSplitController.h"
+#import "RootSplitWorker.h"
+
+#include "pgnscan.h"
+
+// Number of times per second the window is updated during the analysis:
+static const int DISPLAY_FRAME_RATE = 4;
+
+
+@interface RootSplitController (PrivateAPI)
+-(void)giveWorkTo:(RootSplitWorker *)worker;
+-(void)setNeedsDisplay;
+-(void)updateDisplay:(NSTimer *)timer;
+-(NSString *)scoreString:(const root_move_t *)m;
+@end
+
+
+@implementation RootSplitController
+
+// The engines together use one thread per core unless told otherwise.
+
++(int)defaultNumberOfWorkers {
+  NSUserDefaults *defaults = [NSUserDefaults standardUserDefaults];
+  int n = [defaults integerForKey: @"Split Analysis Engines"];
+  if(n <= 0)
+    n = MAX(pgn_cpu_count() /
+	    MAX([defaults integerForKey: @"Split Analysis Engine Threads"], 1),
+	    1);
+  return n;
+}
+
+-(id)initWithGame:(Game *)game engine:(NSString *)engineName {
+  NSUserDefaults *defaults = [NSUserDefaults standardUserDefaults];
+  NSMutableArray *path = [NSMutableArray array];
+  NSPanel *panel;
+  NSScrollView *scrollView;
+  GameNode *node;
+  int i;
+
+  panel = [[NSPanel alloc]
+	    initWithContentRect: NSMakeRect(0.0, 0.0, 560.0, 360.0)
+	    styleMask: (NSTitledWindowMask | NSClosableWindowMask |
+			NSResizableWindowMask)
+	    backing: NSBackingStoreBuffered
+	    defer: YES];
+  [panel setFloatingPanel: NO];
+  [panel setTitle: [NSString stringWithFormat: @"Split Analysis: %@",
+			     engineName]];
+  scrollView = [[NSScrollView alloc]
+		 initWithFrame: [[panel contentView] bounds]];
+  [scrollView setHasVerticalScroller: YES];
+  [scrollView setHasHorizontalScroller: YES];
+  [scrollView setAutoresizingMask: NSViewWidthSizable | NSViewHeightSizable];
+  textView = [[NSTextView alloc]
+	       initWithFrame: [[scrollView contentView] bounds]];
+  [textView setEditable: NO];
+  [textView setFont: [NSFont fontWithName: @"Monaco" size: 10.0]];
+  [textView setHorizontallyResizable: YES];
+  [[textView textContainer] setWidthTracksTextView: NO];
+  [[textView textContainer] setContainerSize: NSMakeSize(1.0e7, 1.0e7)];
+  [scrollView setDocumentView: textView];
+  [[panel contentView] addSubview: scrollView];
+  [scrollView release];
+
+  self = [super initWithWindow: panel];
+  [panel setDelegate: self];
+  [panel center];
+  [panel release];
+
+  position = [[game currentPosition] retain];
+  frc = [game isFRCGame];
+
+  // The position is sent with the moves from the start of the game, as by
+  // the engine controller, so that the engines know about repetitions:
+  for(node = [game currentNode]; [node parent] != nil; node = [node parent])
+    [path insertObject: node atIndex: 0];
+  positionCommand = [[NSMutableString alloc]
+		      initWithFormat: @"position fen %@", [game rootFEN]];
+  for(i = 0; i < [path count]; i++)
+    [positionCommand appendFormat: (i == 0)? @" moves %@" : @" %@",
+		     [[path objectAtIndex: i] UCIStringInFRCGame: frc]];
+  enginePath = [[Engine pathOfEngineWithName: engineName] retain];
+  workers = [[NSMutableArray alloc] init];
+  threads = MAX([defaults integerForKey: @"Split Analysis Engine Threads"], 1);
+  hash = MAX([defaults integerForKey: @"Split Analysis Engine Hash"], 1);
+  whiteScore =
+    [defaults boolForKey: @"Display all Scores from White's Point of View"];
+  pvCache = pv_san_cache_new();
+  split = malloc(sizeof(root_split_t));
+  root_split_init(split, [position pos],
+		  MAX([defaults integerForKey: @"Split Analysis Depth"], 0));
+
+  // In Chess960 games castling moves are sent as king takes rook:
+  moveStrings = [[NSMutableArray alloc] init];
+  for(i = 0; i < split->count; i++) {
+    ChessMove *move = [[ChessMove alloc] initWithPosition: position
+					 move: split->moves[i].move];
+    if(frc && [move isKingsideCastle])
+      [moveStrings addObject: [position UCIStringFromOOMove: move]];
+    else if(frc && [move isQueensideCastle])
+      [moveStrings addObject: [position UCIStringFromOOOMove: move]];
+    else
+      [moveStrings addObject: [move UCIString]];
+    [move release];
+  }
+  return self;
+}
+
+-(void)start {
+  int i, n = MIN([RootSplitController defaultNumberOfWorkers], split->count);
+
+  [self showWindow: self];
+  [self updateDisplay: nil];
+  for(i = 0; i < n; i++) {
+    RootSplitWorker *worker =
+      [[RootSplitWorker alloc] initWithController: self engine: enginePath];
+    [workers addObject: worker];
+    [worker release];
+  }
+}
+
+-(void)stop {
+  stopped = YES;
+  [workers makeObjectsPerformSelector: @selector(stop)];
+  [workers removeAllObjects];
+  [displayTimer invalidate];
+  displayTimer = nil;
+}
+
+-(int)engineThreads {
+  return threads;
+}
+
+-(int)engineHash {
+  return hash;
+}
+
+-(void)workerIsReady:(RootSplitWorker *)worker {
+  if(!stopped)
+    [self giveWorkTo: worker];
+}
+
+// A search without a score (the engine stopped it at once, say) leaves
+// the move as it was, to be searched again.
+
+-(void)worker:(RootSplitWorker *)worker
+ finishedMove:(int)index
+	depth:(int)depth
+	 info:(const uci_info_t *)info {
+  if(stopped) return;
+  if(info != NULL)
+    root_split_result(split, index, depth, info->score_type, info->score,
+		      info->bound, info->pv, info->pv_length);
+  else
+    root_split_abort(split, index);
+  [self setNeedsDisplay];
+  [self giveWorkTo: worker];
+}
+
+-(void)workerDidTerminate:(RootSplitWorker *)worker {
+  int i;
+
+  if(stopped) return;
+  [[worker retain] autorelease];
+  [workers removeObjectIdenticalTo: worker];
+  [self setNeedsDisplay];
+  for(i = 0; i < [workers count]; i++)
+    [self giveWorkTo: [workers objectAtIndex: i]];
+}
+
+-(void)windowWillClose:(NSNotification *)aNotification {
+  [self stop];
+}
+
+-(void)dealloc {
+  [self stop];
+  [position release];
+  [positionCommand release];
+  [enginePath release];
+  [workers release];
+  [moveStrings release];
+  [textView release];
+  pv_san_cache_delete(pvCache);
+  free(split);
+  [super dealloc];
+}
+
+@end
+
+
+@implementation RootSplitController (PrivateAPI)
+
+-(void)giveWorkTo:(RootSplitWorker *)worker {
+  int index, depth;
+
+  if(![worker isReady] || [worker isSearching]) return;
+  index = root_split_next(split, &depth);
+  if(index >= 0)
+    [worker searchMove: index
+	    string: [moveStrings objectAtIndex: index]
+	    depth: depth
+	    inPosition: position
+	    command: positionCommand
+	    FRC: frc];
+}
+
+-(void)setNeedsDisplay {
+  if(displayTimer == nil)
+    displayTimer =
+      [NSTimer scheduledTimerWithTimeInterval: 1.0 / DISPLAY_FRAME_RATE
+	       target: self
+	       selector: @selector(updateDisplay:)
+	       userInfo: nil
+	       repeats: NO];
+}
+
+// One row per move, the best first: rank, score and depth of the move's
+// last search, and its main line.
+
+-(void)updateDisplay:(NSTimer *)timer {
+  NSMutableString *text = [NSMutableString string];
+  int i, order[ROOT_SPLIT_MAX_MOVES];
+  char str[16];
+
+  displayTimer = nil;
+  if(split->count == 0) {
+    [textView setString: @"No legal moves"];
+    return;
+  }
+  [text appendFormat: @"%d moves, %d engines, depth %d\n\n",
+	split->count, (int)[workers count], root_split_depth(split)];
+  root_split_ranking(split, order);
+  for(i = 0; i < split->count; i++) {
+    const root_move_t *m = split->moves + order[i];
+    if(m->depth == 0)
+      [text appendFormat: @"%3d. %-8s %c\n", i + 1,
+	    san_string([position pos], m->move, str),
+	    m->searching? '*' : ' '];
+    else
+      [text appendFormat: @"%3d. %-8s %c %-12s %s\n", i + 1,
+	    san_string([position pos], m->move, str),
+	    m->searching? '*' : ' ',
+	    [[self scoreString: m] UTF8String],
+	    pv_san_line(pvCache, [position pos], m->pv, m->pv_length)];
+  }
+  [textView setString: text];
+}
+
+-(NSString *)scoreString:(const root_move_t *)m {
+  static char boundChar[3][2] = { ">", "", "<" };
+  int value = m->score, bound = m->bound;
+
+  if(whiteScore && ![position whiteToMove]) {
+    value = -value;
+    bound = -bound;
+  }
+  if(m->score_type == UCI_SCORE_CP)
+    return [NSString stringWithFormat: @"%s%+.2f/%d", boundChar[bound + 1],
+		     (float)value / 100.0, m->depth];
+  else if(value >= 0)
+    return [NSString stringWithFormat: @"%s+#%d/%d", boundChar[bound + 1],
+		     value, m->depth];
+  else
+    return [NSString stringWithFormat: @"%s-#%d/%d", boundChar[bound + 1],
+		     -value, m->depth];
+}
+
+@end
@@ -0,0 +1,62 @@
+/*
+  Stockfish, a OS X GUI for the UCI chess engine with the same name.
+  Copyright (C) 2004-2011 Marco Costalba, Joona Kiiski, Tord Romstad
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#import <Cocoa/Cocoa.h>
+
+#include "uciinfo.h"
+
+@class ChessPosition;
+@class Engine;
+@class RootSplitController;
+
+// A RootSplitWorker searches single root moves for a RootSplitController,
+// one at a time, with an engine process of its own. The last exact score
+// of a search and its PV are the result for the move.
+
+@interface RootSplitWorker : NSObject {
+  RootSplitController *controller;
+  Engine *engine;
+  BOOL configured;         // Threads and Hash have been set
+  BOOL changedOptions;     // ... to other values than the saved ones
+  ChessPosition *position; // The root position, while searching
+  int moveIndex, depth;
+  uci_info_t result;
+  BOOL hasScore, hasExactScore;
+}
+
+-(id)initWithController:(RootSplitController *)rsc engine:(NSString *)path;
+-(BOOL)isReady;
+-(BOOL)isSearching;
+-(void)searchMove:(int)index
+	   string:(NSString *)moveString
+	    depth:(int)aDepth
+       inPosition:(ChessPosition *)aPosition
+	  command:(NSString *)positionCommand
+	      FRC:(BOOL)frc;
+-(void)stop;
+
+// Messages from the engine:
+-(ChessPosition *)currentPosition;
+-(void)setEngineName:(NSString *)newEngineName;
+-(void)setEngineIsReady:(BOOL)state;
+-(void)setInfo:(const uci_info_t *)info;
+-(void)bestmove:(NSString *)bestmove ponder:(NSString *)ponder;
+-(void)engineDidTerminate:(Engine *)anEngine;
+
+@end
@@ -0,0 +1,169 @@
+/*
+  Stockfish, a OS X GUI for the UCI chess engine with the same name.
+  Copyright (C) 2004-2011 Marco Costalba, Joona Kiiski, Tord Romstad
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#import "ChessPosition.h"
+#import "Engine.h"
+#import "EnginePool.h"
+#import "RootSplitController.h"
+#import "RootSplitWorker.h"
+#import "UCIOption.h"
+
+
+@interface RootSplitWorker (PrivateAPI)
+-(void)setOptionName:(NSString *)optionName value:(NSString *)value;
+@end
+
+
+@implementation RootSplitWorker
+
+-(id)initWithController:(RootSplitController *)rsc engine:(NSString *)path {
+  self = [super init];
+  controller = rsc;
+  engine = [[[EnginePool sharedPool] engineWithController: self path: path]
+	     retain];
+  return self;
+}
+
+-(BOOL)isReady {
+  return configured;
+}
+
+-(BOOL)isSearching {
+  return position != nil;
+}
+
+-(void)searchMove:(int)index
+	   string:(NSString *)moveString
+	    depth:(int)aDepth
+       inPosition:(ChessPosition *)aPosition
+	  command:(NSString *)positionCommand
+	      FRC:(BOOL)frc {
+  [aPosition retain];
+  [position release];
+  position = aPosition;
+  moveIndex = index;
+  depth = aDepth;
+  hasScore = hasExactScore = NO;
+  result.pv_length = 0;
+
+  [engine setOptionName: @"Ponder" value: @"false"];
+  [engine setOptionName: @"OwnBook" value: @"false"];
+  [engine setOptionName: @"UCI_AnalyseMode" value: @"true"];
+  [engine setOptionName: @"MultiPV" value: @"1"];
+  [engine setOptionName: @"UCI_Chess960" value: frc? @"true" : @"false"];
+  [engine setPosition: positionCommand];
+  [engine searchWithDepth: depth
+	  nodes: 0
+	  searchMoves: [NSArray arrayWithObject: moveString]];
+}
+
+// An engine with other Threads or Hash values than the saved ones can't
+// be reused by the rest of the GUI, so it is quit rather than recycled.
+
+-(void)stop {
+  [position release];
+  position = nil;
+  if(engine == nil) return;
+  if(changedOptions) {
+    [engine setController: nil];
+    [engine quit];
+  }
+  else
+    [[EnginePool sharedPool] recycleEngine: engine];
+  [engine release];
+  engine = nil;
+}
+
+-(ChessPosition *)currentPosition {
+  return position;
+}
+
+-(void)setEngineName:(NSString *)newEngineName {
+}
+
+-(void)setEngineIsReady:(BOOL)state {
+  if(!state || configured || engine == nil) return;
+  [self setOptionName: @"Threads"
+	value: [NSString stringWithFormat: @"%d", [controller engineThreads]]];
+  [self setOptionName: @"Hash"
+	value: [NSString stringWithFormat: @"%d", [controller engineHash]]];
+  configured = YES;
+  [controller workerIsReady: self];
+}
+
+// Bounded scores only replace earlier bounded scores, as in game
+// annotation.
+
+-(void)setInfo:(const uci_info_t *)info {
+  const int needed = UCI_INFO_DEPTH | UCI_INFO_SCORE | UCI_INFO_PV;
+
+  if(position == nil || (info->fields & needed) != needed) return;
+  if(info->bound != 0 && hasExactScore) return;
+  result = *info;
+  hasScore = YES;
+  if(info->bound == 0) hasExactScore = YES;
+}
+
+-(void)bestmove:(NSString *)bestmove ponder:(NSString *)ponder {
+  int index = moveIndex;
+
+  if(position == nil) return;
+  [position release];
+  position = nil;
+  if(hasScore)
+    [controller worker: self finishedMove: index depth: depth info: &result];
+  else
+    [controller worker: self finishedMove: index depth: depth info: NULL];
+}
+
+// The move of a crashed engine is searched again by another worker.
+
+-(void)engineDidTerminate:(Engine *)anEngine {
+  if(anEngine != engine) return;
+  [engine setController: nil];
+  [engine release];
+  engine = nil;
+  configured = NO;
+  if(position != nil) {
+    [position release];
+    position = nil;
+    [controller worker: self finishedMove: moveIndex depth: depth info: NULL];
+  }
+  [controller workerDidTerminate: self];
+}
+
+-(void)dealloc {
+  [self stop];
+  [super dealloc];
+}
+
+@end
+
+
+@implementation RootSplitWorker (PrivateAPI)
+
+-(void)setOptionName:(NSString *)optionName value:(NSString *)value {
+  UCIOption *option = [engine optionWithName: optionName];
+
+  if(option == nil || [[option value] isEqualToString: value]) return;
+  [engine setOptionName: optionName value: value];
+  changedOptions = YES;
+}
+
+@end
@@ -0,0 +1,137 @@
+/*
+  Stockfish, a OS X GUI for the UCI chess engine with the same name.
+  Copyright (C) 2004-2011 Marco Costalba, Joona Kiiski, Tord Romstad
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#import "PGNProgressController.h"
+#import "TrainingDataExporter.h"
+
+#import <sys/stat.h>
+
+
+@interface TrainingDataExporter (PrivateAPI)
+-(void)exportPositions:(id)anObject;
+-(void)updateProgress:(NSTimer *)aTimer;
+-(void)finishedExporting:(id)anObject;
+@end
+
+
+@implementation TrainingDataExporter
+
+-(id)initWithFilenames:(NSArray *)someFilenames
+	outputFilename:(NSString *)anOutputFilename {
+  NSUserDefaults *defaults = [NSUserDefaults standardUserDefaults];
+  struct stat fs;
+  int i;
+
+  self = [super init];
+  filenames = [someFilenames copy];
+  outputFilename = [anOutputFilename retain];
+  for(i = 0; i < [filenames count]; i++)
+    if(stat([[filenames objectAtIndex: i] fileSystemRepresentation], &fs) == 0)
+      totalSize += fs.st_size;
+
+  options.threads = pgn_cpu_count();
+  options.shards = MAX([defaults integerForKey: @"Training Data Shards"], 1);
+  options.interval =
+    MAX([defaults integerForKey: @"Training Data Position Interval"], 1);
+  options.dedup = [defaults boolForKey: @"Remove Duplicate Training Positions"];
+  options.dedup_bits = 0;
+  return self;
+}
+
+-(void)start {
+  NSString *title;
+
+  if([filenames count] == 1)
+    title = [[filenames objectAtIndex: 0] lastPathComponent];
+  else
+    title = [NSString stringWithFormat: @"%d PGN files", (int)[filenames count]];
+  progressController =
+    [[PGNProgressController alloc] initWithFilename: title];
+  [[progressController window]
+    setTitle: [NSString stringWithFormat: @"Exporting positions from %@...",
+			title]];
+  [progressController showWindow: self];
+
+  // We stay alive until the export is finished:
+  [self retain];
+
+  timer = [[NSTimer scheduledTimerWithTimeInterval: 0.25
+		    target: self
+		    selector: @selector(updateProgress:)
+		    userInfo: nil
+		    repeats: YES]
+	    retain];
+  [NSThread detachNewThreadSelector: @selector(exportPositions:)
+	    toTarget: self
+	    withObject: nil];
+}
+
+-(void)exportPositions:(id)anObject {
+  NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+  const char **names = malloc([filenames count] * sizeof(char *));
+  int i;
+
+  for(i = 0; i < [filenames count]; i++)
+    names[i] = [[filenames objectAtIndex: i] fileSystemRepresentation];
+  result = pgn_export_files(names, [filenames count],
+			    [outputFilename fileSystemRepresentation],
+			    &options, &stats);
+  error = errno;
+  free(names);
+  [self performSelectorOnMainThread: @selector(finishedExporting:)
+	withObject: nil
+	waitUntilDone: NO];
+  [pool release];
+}
+
+// The progress of the export is the number of bytes scanned in all files,
+// which pgn_scan_file() keeps adding to stats.progress.
+
+-(void)updateProgress:(NSTimer *)aTimer {
+  if(totalSize > 0.0)
+    [progressController setDoubleValue: (stats.progress * 100.0) / totalSize];
+}
+
+-(void)finishedExporting:(id)anObject {
+  [timer invalidate];
+  [timer release];
+  timer = nil;
+  [[progressController window] close];
+  [progressController release];
+  progressController = nil;
+
+  if(result != 0)
+    NSRunAlertPanel(@"Error while exporting training data", @"%s",
+		    nil, nil, nil, strerror(error));
+  else
+    NSRunAlertPanel(@"Training data exported",
+		    @"Exported %lld positions from %ld games to %@. %lld duplicate positions were skipped, and %ld games could not be read.",
+		    nil, nil, nil, stats.positions, stats.games,
+		    [outputFilename lastPathComponent], stats.duplicates,
+		    stats.errors);
+  [self release];
+}
+
+-(void)dealloc {
+  [filenames release];
+  [outputFilename release];
+  [super dealloc];
+}
+
+@end
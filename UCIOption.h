@@ -31,6 +31,7 @@ enum {UCI_SPIN, UCI_COMBO, UCI_CHECK, UCI_STRING, UCI_BUTTON, UCI_UNKNOWN};
 }
 
 -(id)initWithString:(NSString *)string;
+-(id)initWithDictionary:(NSDictionary *)dict;
 -(NSString *)description;
 -(NSString *)name;
 -(int)type;
@@ -129,6 +129,24 @@
   return self;
 }
 
+// The inverse of -dictionary. The value is the default value unless the
+// dictionary has one.
+
+-(id)initWithDictionary:(NSDictionary *)dict {
+  [super init];
+  name = [[dict objectForKey: @"name"] retain];
+  type = [[dict objectForKey: @"type"] intValue];
+  min = [[dict objectForKey: @"min"] intValue];
+  max = [[dict objectForKey: @"max"] intValue];
+  comboValues = [[dict objectForKey: @"comboValues"] retain];
+  defaultValue = [[dict objectForKey: @"defaultValue"] retain];
+  if([dict objectForKey: @"value"])
+    value = [[dict objectForKey: @"value"] copy];
+  else
+    value = [defaultValue copy];
+  return self;
+}
+
 -(NSString *)description {
   switch(type) {
   case UCI_SPIN:
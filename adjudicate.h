@@ -0,0 +1,93 @@
+/*
+  Stockfish, a OS X GUI for the UCI chess engine with the same name.
+  Copyright (C) 2004-2011 Marco Costalba, Joona Kiiski, Tord Romstad
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+/*
+  Adjudication of engine games by the scores the engines report.  The
+  score of each engine move is converted to white's point of view.  A game
+  is a draw when the last draw_moves moves of both sides (2 * draw_moves
+  plies) all had an absolute score of at most draw_score centipawns, and
+  the game has reached move draw_move_number.  A game is won when the last
+  win_moves moves of both sides all gave the same side a score of at least
+  win_score centipawns; scores of mate count as above any limit.  A move
+  without a score (a book move, say) starts the counting anew.  A rule
+  with zero moves is not used.  Positions found in the Syzygy tablebases
+  end the game with their exact result, if the rules allow it.
+*/
+
+
+#if !defined(ADJUDICATE_H_INCLUDED)
+#define ADJUDICATE_H_INCLUDED
+
+////
+//// Includes
+////
+
+#include "position.h"
+
+
+////
+//// Constants and macros
+////
+
+enum {
+  ADJUDICATE_NONE, ADJUDICATE_DRAW, ADJUDICATE_WHITE_WINS,
+  ADJUDICATE_BLACK_WINS, ADJUDICATE_TABLEBASE_DRAW,
+  ADJUDICATE_TABLEBASE_WHITE_WINS, ADJUDICATE_TABLEBASE_BLACK_WINS
+};
+
+
+////
+//// Types
+////
+
+typedef struct adjudication_rules_t {
+  int draw_move_number;
+  int draw_moves;
+  int draw_score;
+  int win_moves;
+  int win_score;
+  bool tablebases;
+} adjudication_rules_t;
+
+typedef struct adjudication_t {
+  adjudication_rules_t rules;
+  int draw_plies;        // Consecutive plies with a drawish score
+  int win_plies;         // Consecutive plies with a winning score ...
+  int winner;            // ... for this side (WHITE or BLACK)
+} adjudication_t;
+
+
+////
+//// Functions
+////
+
+extern void adjudication_init(adjudication_t *a,
+                              const adjudication_rules_t *rules);
+extern int adjudication_add_move(adjudication_t *a, int move_number,
+                                 int side, bool has_score, int score,
+                                 bool mate);
+extern int adjudication_by_score(const adjudication_rules_t *rules,
+                                 int score, bool mate);
+extern int adjudication_by_tablebase(const adjudication_rules_t *rules,
+                                     const position_t *pos);
+extern result_t adjudication_result(int adjudication);
+extern const char *adjudication_reason(int adjudication);
+
+
+#endif // !defined(ADJUDICATE_H_INCLUDED)
@@ -0,0 +1,145 @@
+/*
+  Stockfish, a OS X GUI for the UCI chess engine with the same name.
+  Copyright (C) 2004-2011 Marco Costalba, Joona Kiiski, Tord Romstad
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+////
+//// Includes
+////
+
+#include <stdlib.h>
+
+#include "adjudicate.h"
+#include "syzygy.h"
+
+
+////
+//// Local definitions
+////
+
+static bool is_win(const adjudication_rules_t *rules, int score, bool mate);
+
+
+////
+//// Functions
+////
+
+void adjudication_init(adjudication_t *a, const adjudication_rules_t *rules) {
+  a->rules = *rules;
+  a->draw_plies = a->win_plies = 0;
+  a->winner = WHITE;
+}
+
+
+// Adds a move by the given side, with the score the side's engine gave it
+// (centipawns or moves to mate, from the engine's point of view). Returns
+// ADJUDICATE_NONE if the game goes on.
+
+int adjudication_add_move(adjudication_t *a, int move_number, int side,
+                          bool has_score, int score, bool mate) {
+  const adjudication_rules_t *r = &a->rules;
+
+  if(!has_score) {
+    a->draw_plies = a->win_plies = 0;
+    return ADJUDICATE_NONE;
+  }
+  if(side == BLACK) score = -score;
+
+  if(!mate && abs(score) <= r->draw_score) a->draw_plies++;
+  else a->draw_plies = 0;
+
+  if(is_win(r, score, mate)) {
+    int winner = (score > 0)? WHITE : BLACK;
+    if(a->win_plies > 0 && winner == a->winner) a->win_plies++;
+    else a->win_plies = 1;
+    a->winner = winner;
+  }
+  else a->win_plies = 0;
+
+  if(r->win_moves > 0 && a->win_plies >= 2 * r->win_moves)
+    return (a->winner == WHITE)? ADJUDICATE_WHITE_WINS : ADJUDICATE_BLACK_WINS;
+  if(r->draw_moves > 0 && a->draw_plies >= 2 * r->draw_moves &&
+     move_number >= r->draw_move_number)
+    return ADJUDICATE_DRAW;
+  return ADJUDICATE_NONE;
+}
+
+
+// The result of a game stopped at a score from white's point of view, for
+// games which are adjudicated by hand.
+
+int adjudication_by_score(const adjudication_rules_t *rules, int score,
+                          bool mate) {
+  if(is_win(rules, score, mate))
+    return (score > 0)? ADJUDICATE_WHITE_WINS : ADJUDICATE_BLACK_WINS;
+  return ADJUDICATE_DRAW;
+}
+
+
+// The result of a position found in the tablebases. Wins which the 50
+// move rule turns into draws count as draws, including wins which take
+// longer to the next capture or pawn move than the plies left on the 50
+// move counter of the game.
+
+int adjudication_by_tablebase(const adjudication_rules_t *rules,
+                              const position_t *pos) {
+  int wdl, dtz;
+
+  if(!rules->tablebases || !tb_probe_wdl(pos, &wdl))
+    return ADJUDICATE_NONE;
+  if((wdl == TB_WIN || wdl == TB_LOSS) && tb_probe_dtz(pos, &dtz) &&
+     abs(dtz) + pos->rule50 > 100)
+    return ADJUDICATE_TABLEBASE_DRAW;
+  switch(tb_result(wdl, pos->side)) {
+  case WHITE_WINS: return ADJUDICATE_TABLEBASE_WHITE_WINS;
+  case BLACK_WINS: return ADJUDICATE_TABLEBASE_BLACK_WINS;
+  default: return ADJUDICATE_TABLEBASE_DRAW;
+  }
+}
+
+
+result_t adjudication_result(int adjudication) {
+  switch(adjudication) {
+  case ADJUDICATE_WHITE_WINS:
+  case ADJUDICATE_TABLEBASE_WHITE_WINS: return WHITE_WINS;
+  case ADJUDICATE_BLACK_WINS:
+  case ADJUDICATE_TABLEBASE_BLACK_WINS: return BLACK_WINS;
+  case ADJUDICATE_DRAW:
+  case ADJUDICATE_TABLEBASE_DRAW: return DRAW;
+  default: return UNKNOWN;
+  }
+}
+
+
+// The comment added to the last move of an adjudicated game.
+
+const char *adjudication_reason(int adjudication) {
+  switch(adjudication) {
+  case ADJUDICATE_WHITE_WINS: return "White wins by adjudication";
+  case ADJUDICATE_BLACK_WINS: return "Black wins by adjudication";
+  case ADJUDICATE_DRAW: return "Draw by adjudication";
+  case ADJUDICATE_TABLEBASE_WHITE_WINS: return "White wins by tablebase";
+  case ADJUDICATE_TABLEBASE_BLACK_WINS: return "Black wins by tablebase";
+  case ADJUDICATE_TABLEBASE_DRAW: return "Draw by tablebase";
+  default: return "";
+  }
+}
+
+
+static bool is_win(const adjudication_rules_t *rules, int score, bool mate) {
+  return mate? score != 0 : abs(score) >= rules->win_score;
+}
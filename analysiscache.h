@@ -0,0 +1,80 @@
+/*
+  Stockfish, a OS X GUI for the UCI chess engine with the same name.
+  Copyright (C) 2004-2011 Marco Costalba, Joona Kiiski, Tord Romstad
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+/*
+  A persistent cache of analysis, kept in a memory mapped file so that
+  positions analyzed once are known again in later sessions.  The file is
+  a hash table of 64-byte entries in buckets of four, indexed by the hash
+  key of the position.  Each entry holds the deepest search seen for its
+  position: depth, score, bound and the beginning of the principal
+  variation.  When a bucket is full, the entry with the lowest depth is
+  replaced.
+
+  The key stored in an entry is xor'ed with the rest of the entry, so that
+  an entry which was only partly written (by another process using the
+  same file, say) is never found.  A file of the wrong size or format is
+  cleared.  The functions must all be called from the same thread.
+*/
+
+
+#if !defined(ANALYSISCACHE_H_INCLUDED)
+#define ANALYSISCACHE_H_INCLUDED
+
+////
+//// Includes
+////
+
+#include "position.h"
+
+
+////
+//// Constants and macros
+////
+
+#define ANALYSIS_CACHE_MAX_PV 12
+
+
+////
+//// Types
+////
+
+typedef struct analysis_cache_entry_t {
+  hashkey_t key;
+  int32_t score;         // Centipawns or moves to mate, side to move's view
+  uint8_t depth;
+  int8_t bound;          // -1 lower bound, 0 exact, 1 upper bound
+  uint8_t score_type;    // UCI_SCORE_CP or UCI_SCORE_MATE
+  uint8_t pv_length;
+  move_t pv[ANALYSIS_CACHE_MAX_PV];
+} analysis_cache_entry_t;
+
+
+////
+//// Functions
+////
+
+extern bool analysis_cache_init(const char *filename, int megabytes);
+extern void analysis_cache_close(void);
+extern bool analysis_cache_probe(hashkey_t key, analysis_cache_entry_t *entry);
+extern void analysis_cache_store(hashkey_t key, int depth, int score_type,
+                                 int score, int bound, const move_t pv[],
+                                 int pv_length);
+
+
+#endif // !defined(ANALYSISCACHE_H_INCLUDED)
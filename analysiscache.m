@@ -0,0 +1,187 @@
+/*
+  Stockfish, a OS X GUI for the UCI chess engine with the same name.
+  Copyright (C) 2004-2011 Marco Costalba, Joona Kiiski, Tord Romstad
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+////
+//// Includes
+////
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "analysiscache.h"
+
+
+////
+//// Local definitions
+////
+
+#define BUCKET_SIZE 4
+#define CACHE_MAGIC 0x53464143
+#define CACHE_VERSION 1
+
+typedef struct cache_header_t {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t buckets;      // A power of two
+  uint8_t padding[48];
+} cache_header_t;
+
+static cache_header_t *Header;
+static analysis_cache_entry_t *Entries;
+static size_t MapSize;
+
+static hashkey_t entry_check(const analysis_cache_entry_t *e);
+static bool is_better(int depth, int bound,
+                      const analysis_cache_entry_t *old);
+
+
+////
+//// Functions
+////
+
+// Opens the cache file, or creates it with room for the given number of
+// megabytes of entries. Returns false if the file can't be mapped, in
+// which case nothing is cached.
+
+bool analysis_cache_init(const char *filename, int megabytes) {
+  uint64_t buckets = 1;
+  struct stat st;
+  size_t size;
+  int fd;
+
+  analysis_cache_close();
+  if(megabytes <= 0) return false;
+  while(2 * buckets * BUCKET_SIZE * sizeof(analysis_cache_entry_t)
+        <= (uint64_t)megabytes << 20)
+    buckets *= 2;
+  size = sizeof(cache_header_t)
+    + buckets * BUCKET_SIZE * sizeof(analysis_cache_entry_t);
+
+  fd = open(filename, O_RDWR | O_CREAT, 0644);
+  if(fd < 0) return false;
+  if(fstat(fd, &st) != 0 ||
+     (st.st_size != (off_t)size && 
+      (ftruncate(fd, 0) != 0 || ftruncate(fd, size) != 0))) {
+    close(fd);
+    return false;
+  }
+  Header = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if(Header == MAP_FAILED) {
+    Header = NULL;
+    return false;
+  }
+  MapSize = size;
+  Entries = (analysis_cache_entry_t *)(Header + 1);
+  if(Header->magic != CACHE_MAGIC || Header->version != CACHE_VERSION ||
+     Header->buckets != buckets) {
+    memset(Header, 0, size);
+    Header->magic = CACHE_MAGIC;
+    Header->version = CACHE_VERSION;
+    Header->buckets = buckets;
+  }
+  return true;
+}
+
+
+void analysis_cache_close(void) {
+  if(Header == NULL) return;
+  msync(Header, MapSize, MS_ASYNC);
+  munmap(Header, MapSize);
+  Header = NULL;
+  Entries = NULL;
+}
+
+
+bool analysis_cache_probe(hashkey_t key, analysis_cache_entry_t *entry) {
+  analysis_cache_entry_t *e;
+  int i;
+
+  if(Header == NULL) return false;
+  e = Entries + (key & (Header->buckets - 1)) * BUCKET_SIZE;
+  for(i = 0; i < BUCKET_SIZE; i++, e++)
+    if((e->key ^ entry_check(e)) == key && e->depth > 0) {
+      *entry = *e;
+      entry->key = key;
+      entry->pv_length = Min(entry->pv_length, ANALYSIS_CACHE_MAX_PV);
+      return true;
+    }
+  return false;
+}
+
+
+// Stores a search result, unless the cache has a better one for the
+// position already. Only the first ANALYSIS_CACHE_MAX_PV moves of the PV
+// are kept.
+
+void analysis_cache_store(hashkey_t key, int depth, int score_type,
+                          int score, int bound, const move_t pv[],
+                          int pv_length) {
+  analysis_cache_entry_t *e, *replace = NULL;
+  int i;
+
+  if(Header == NULL || depth <= 0) return;
+  depth = Min(depth, 255);
+  e = Entries + (key & (Header->buckets - 1)) * BUCKET_SIZE;
+  for(i = 0; i < BUCKET_SIZE; i++, e++) {
+    if((e->key ^ entry_check(e)) == key && e->depth > 0) {
+      if(!is_better(depth, bound, e)) return;
+      replace = e;
+      break;
+    }
+    if(replace == NULL || e->depth < replace->depth)
+      replace = e;
+  }
+
+  pv_length = Min(pv_length, ANALYSIS_CACHE_MAX_PV);
+  memset(replace, 0, sizeof(analysis_cache_entry_t));
+  replace->score = score;
+  replace->depth = depth;
+  replace->bound = bound;
+  replace->score_type = score_type;
+  replace->pv_length = pv_length;
+  memcpy(replace->pv, pv, pv_length * sizeof(move_t));
+  replace->key = key ^ entry_check(replace);
+}
+
+
+// The xor of all 64-bit words of an entry after the key.
+
+static hashkey_t entry_check(const analysis_cache_entry_t *e) {
+  const uint64_t *w = (const uint64_t *)e;
+  hashkey_t check = 0;
+  size_t i;
+
+  for(i = 1; i < sizeof(analysis_cache_entry_t) / sizeof(uint64_t); i++)
+    check ^= w[i];
+  return check;
+}
+
+
+// A deeper search is better, and at the same depth an exact score is
+// better than a bound.
+
+static bool is_better(int depth, int bound,
+                      const analysis_cache_entry_t *old) {
+  if(depth != old->depth) return depth > old->depth;
+  return bound == 0 && old->bound != 0;
+}
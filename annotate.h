@@ -0,0 +1,90 @@
+/*
+  Stockfish, a OS X GUI for the UCI chess engine with the same name.
+  Copyright (C) 2004-2011 Marco Costalba, Joona Kiiski, Tord Romstad
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+/*
+  Classification of moves for the annotation of games.  Each position of a
+  game is analyzed, and a move is judged by the analysis of the position
+  before it, which gives the value of the best move, and the analysis of
+  the position after it, which gives the value of the move played.  Values
+  are in centipawns from the point of view of the side to move, with
+  scores of mate and tablebase wins converted to large values.  Both values
+  are limited to ANNOTATE_VALUE_LIMIT before they are compared, so that
+  moves which keep a decisive advantage are not marked.  Mate and
+  stalemate positions are not searched; their score is the result.  A move which loses
+  at least the blunder, mistake or inaccuracy limit of the rules gets the
+  NAG for a blunder ($4), a mistake ($2) or a dubious move ($6).
+*/
+
+
+#if !defined(ANNOTATE_H_INCLUDED)
+#define ANNOTATE_H_INCLUDED
+
+////
+//// Includes
+////
+
+#include "position.h"
+
+
+////
+//// Constants and macros
+////
+
+#define ANNOTATE_MATE_VALUE 30000
+#define ANNOTATE_TABLEBASE_VALUE 20000
+#define ANNOTATE_VALUE_LIMIT 1000
+
+enum {
+  ANNOTATE_NAG_NONE = 0, ANNOTATE_NAG_MISTAKE = 2, ANNOTATE_NAG_BLUNDER = 4,
+  ANNOTATE_NAG_DUBIOUS = 6
+};
+
+
+////
+//// Types
+////
+
+typedef struct annotation_rules_t {
+  int inaccuracy;        // Centipawns lost
+  int mistake;
+  int blunder;
+} annotation_rules_t;
+
+typedef struct analysis_t {
+  int depth;             // 0 for positions which were not searched
+  int score_type;        // UCI_SCORE_CP or UCI_SCORE_MATE
+  int score;             // Side to move's point of view
+  bool tablebase;        // The score is a WDL value (TB_LOSS ... TB_WIN)
+  bool terminal;         // Mate or stalemate, with the exact score
+  move_t move;           // The best move, or NoMove
+} analysis_t;
+
+
+////
+//// Functions
+////
+
+extern int analysis_value(const analysis_t *a);
+extern void analysis_of_move(const analysis_t *after, analysis_t *result);
+extern int annotation_nag(const annotation_rules_t *rules,
+                          const analysis_t *before, const analysis_t *after,
+                          move_t played);
+
+
+#endif // !defined(ANNOTATE_H_INCLUDED)
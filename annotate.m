@@ -0,0 +1,96 @@
+/*
+  Stockfish, a OS X GUI for the UCI chess engine with the same name.
+  Copyright (C) 2004-2011 Marco Costalba, Joona Kiiski, Tord Romstad
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+////
+//// Includes
+////
+
+#include "annotate.h"
+#include "syzygy.h"
+#include "uciinfo.h"
+
+
+////
+//// Local definitions
+////
+
+static int limited_value(const analysis_t *a);
+
+
+////
+//// Functions
+////
+
+// The value of an analysis in centipawns. Being mated in n moves is worse
+// than being mated in n + 1 moves, and a tablebase win or loss which can
+// be claimed a draw by the 50 move rule is a draw.
+
+int analysis_value(const analysis_t *a) {
+  if(a->tablebase) {
+    if(a->score == TB_WIN) return ANNOTATE_TABLEBASE_VALUE;
+    if(a->score == TB_LOSS) return -ANNOTATE_TABLEBASE_VALUE;
+    return 0;
+  }
+  if(a->score_type == UCI_SCORE_MATE)
+    return (a->score > 0)? ANNOTATE_MATE_VALUE - a->score :
+      -ANNOTATE_MATE_VALUE - a->score;
+  return a->score;
+}
+
+
+// The analysis of a move from the point of view of the side which made
+// it, given the analysis of the position after the move. Being mated in n
+// moves after the move means mating in n + 1 moves before it.
+
+void analysis_of_move(const analysis_t *after, analysis_t *result) {
+  *result = *after;
+  result->move = NoMove;
+  if(!after->tablebase && after->score_type == UCI_SCORE_MATE &&
+     after->score <= 0)
+    result->score = -after->score + 1;
+  else
+    result->score = -after->score;
+}
+
+
+// Returns the NAG for the move played from the position analyzed in
+// 'before', which led to the position analyzed in 'after', or
+// ANNOTATE_NAG_NONE. The best move is never marked.
+
+int annotation_nag(const annotation_rules_t *rules,
+                   const analysis_t *before, const analysis_t *after,
+                   move_t played) {
+  int loss;
+
+  if(played == before->move) return ANNOTATE_NAG_NONE;
+  loss = limited_value(before) + limited_value(after);
+  if(rules->blunder > 0 && loss >= rules->blunder)
+    return ANNOTATE_NAG_BLUNDER;
+  if(rules->mistake > 0 && loss >= rules->mistake)
+    return ANNOTATE_NAG_MISTAKE;
+  if(rules->inaccuracy > 0 && loss >= rules->inaccuracy)
+    return ANNOTATE_NAG_DUBIOUS;
+  return ANNOTATE_NAG_NONE;
+}
+
+
+static int limited_value(const analysis_t *a) {
+  int value = analysis_value(a);
+  return Max(Min(value, ANNOTATE_VALUE_LIMIT), -ANNOTATE_VALUE_LIMIT);
+}
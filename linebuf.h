@@ -0,0 +1,59 @@
+/*
+  Stockfish, a OS X GUI for the UCI chess engine with the same name.
+  Copyright (C) 2004-2011 Marco Costalba, Joona Kiiski, Tord Romstad
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+/*
+  Splitting of a byte stream (like the output of an engine) into lines.
+  Complete lines are passed to a handler as a pointer and a length, without
+  the line break and without being copied when they arrive in one piece.
+  Only the incomplete line at the end of each chunk is kept in the buffer,
+  and its bytes are never scanned for a line break again.  Lines longer
+  than the maximum size of the buffer are passed in pieces.
+*/
+
+
+#if !defined(LINEBUF_H_INCLUDED)
+#define LINEBUF_H_INCLUDED
+
+////
+//// Types
+////
+
+typedef void (*line_handler_t)(void *context, const char *line, int length);
+
+typedef struct line_buffer_t {
+  char *data;
+  int size;              // Allocated size
+  int max_size;          // Size the buffer may grow to
+  int length;            // Length of the incomplete line in the buffer
+} line_buffer_t;
+
+
+////
+//// Functions
+////
+
+extern void line_buffer_init(line_buffer_t *lb, int size, int max_size);
+extern void line_buffer_free(line_buffer_t *lb);
+extern int line_buffer_feed(line_buffer_t *lb, const char *bytes, int count,
+                            line_handler_t handler, void *context);
+extern void line_buffer_flush(line_buffer_t *lb, line_handler_t handler,
+                              void *context);
+
+
+#endif // !defined(LINEBUF_H_INCLUDED)
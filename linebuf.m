@@ -0,0 +1,139 @@
+/*
+  Stockfish, a OS X GUI for the UCI chess engine with the same name.
+  Copyright (C) 2004-2011 Marco Costalba, Joona Kiiski, Tord Romstad
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+////
+//// Includes
+////
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "linebuf.h"
+
+
+////
+//// Local definitions
+////
+
+static void pass_line(const char *line, int length, line_handler_t handler,
+                      void *context);
+static void append(line_buffer_t *lb, const char *bytes, int count,
+                   line_handler_t handler, void *context);
+
+
+////
+//// Functions
+////
+
+void line_buffer_init(line_buffer_t *lb, int size, int max_size) {
+  lb->size = size;
+  lb->max_size = max_size > size ? max_size : size;
+  lb->length = 0;
+  lb->data = malloc(size);
+}
+
+
+void line_buffer_free(line_buffer_t *lb) {
+  free(lb->data);
+  lb->data = NULL;
+  lb->size = lb->length = 0;
+}
+
+
+// Passes all lines completed by a chunk of bytes to the handler, and keeps
+// the rest for the next chunk.  Returns the number of lines passed.
+
+int line_buffer_feed(line_buffer_t *lb, const char *bytes, int count,
+                     line_handler_t handler, void *context) {
+  const char *end = bytes + count, *nl;
+  int lines = 0;
+
+  // Finish the line which was started by an earlier chunk:
+  if(lb->length > 0) {
+    if((nl = memchr(bytes, '\n', count)) == NULL) {
+      append(lb, bytes, count, handler, context);
+      return 0;
+    }
+    append(lb, bytes, nl - bytes, handler, context);
+    pass_line(lb->data, lb->length, handler, context);
+    lb->length = 0;
+    lines++;
+    bytes = nl + 1;
+  }
+
+  // Lines which are complete in this chunk are passed where they are:
+  while(bytes < end && (nl = memchr(bytes, '\n', end - bytes)) != NULL) {
+    pass_line(bytes, nl - bytes, handler, context);
+    lines++;
+    bytes = nl + 1;
+  }
+  if(bytes < end)
+    append(lb, bytes, end - bytes, handler, context);
+  return lines;
+}
+
+
+// Passes the incomplete line in the buffer, if any, at the end of the
+// stream.
+
+void line_buffer_flush(line_buffer_t *lb, line_handler_t handler,
+                       void *context) {
+  if(lb->length > 0)
+    pass_line(lb->data, lb->length, handler, context);
+  lb->length = 0;
+}
+
+
+// Passes a line to the handler without a trailing carriage return. Empty
+// lines are left out.
+
+static void pass_line(const char *line, int length, line_handler_t handler,
+                      void *context) {
+  if(length > 0 && line[length - 1] == '\r')
+    length--;
+  if(length > 0)
+    handler(context, line, length);
+}
+
+
+// Adds bytes without a line break to the incomplete line in the buffer.
+// When the buffer is full, its contents are passed on as a line.
+
+static void append(line_buffer_t *lb, const char *bytes, int count,
+                   line_handler_t handler, void *context) {
+  int n;
+
+  while(count > 0) {
+    if(lb->length == lb->size) {
+      if(lb->size < lb->max_size) {
+        lb->size = lb->size * 2 < lb->max_size ? lb->size * 2 : lb->max_size;
+        lb->data = realloc(lb->data, lb->size);
+      }
+      else {
+        pass_line(lb->data, lb->length, handler, context);
+        lb->length = 0;
+      }
+    }
+    n = lb->size - lb->length < count ? lb->size - lb->length : count;
+    memcpy(lb->data + lb->length, bytes, n);
+    lb->length += n;
+    bytes += n;
+    count -= n;
+  }
+}
@@ -0,0 +1,79 @@
+/*
+  Stockfish, a OS X GUI for the UCI chess engine with the same name.
+  Copyright (C) 2004-2011 Marco Costalba, Joona Kiiski, Tord Romstad
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+/*
+  Statistics of an engine match from the first engine's point of view:
+  the Elo difference with its 95% error margin, and the log-likelihood
+  ratio of a sequential probability ratio test (SPRT) between the
+  hypotheses elo = elo0 and elo = elo1.  The match is scored both game by
+  game (wins, draws, losses) and by pairs of games with reversed colors
+  (pentanomial: the number of pairs in which the first engine scored 0,
+  0.5, 1, 1.5 and 2 points).  Pairs are used when there are any, since
+  games with the same opening are not independent.  The LLR uses the
+  usual normal approximation of the generalized SPRT.
+*/
+
+
+#if !defined(MATCHSTATS_H_INCLUDED)
+#define MATCHSTATS_H_INCLUDED
+
+////
+//// Constants and macros
+////
+
+enum {
+  SPRT_CONTINUE, SPRT_ACCEPT_H0, SPRT_ACCEPT_H1
+};
+
+
+////
+//// Types
+////
+
+typedef struct match_stats_t {
+  int wins, draws, losses;
+  int pairs[5];          // Pairs by the first engine's score in half points
+} match_stats_t;
+
+typedef struct sprt_t {
+  double elo0, elo1;
+  double alpha, beta;
+} sprt_t;
+
+
+////
+//// Functions
+////
+
+extern void match_stats_init(match_stats_t *ms);
+extern void match_stats_add_game(match_stats_t *ms, int half_points);
+extern void match_stats_add_pair(match_stats_t *ms, int half_points);
+extern int match_stats_games(const match_stats_t *ms);
+extern int match_stats_pairs(const match_stats_t *ms);
+extern double match_stats_score(const match_stats_t *ms);
+extern int match_stats_elo(const match_stats_t *ms, double *elo,
+                           double *error);
+extern double match_stats_llr(const match_stats_t *ms, double elo0,
+                              double elo1);
+extern void sprt_bounds(const sprt_t *sprt, double *lower, double *upper);
+extern int sprt_status(const sprt_t *sprt, const match_stats_t *ms,
+                       double *llr);
+
+
+#endif // !defined(MATCHSTATS_H_INCLUDED)
@@ -0,0 +1,188 @@
+/*
+  Stockfish, a OS X GUI for the UCI chess engine with the same name.
+  Copyright (C) 2004-2011 Marco Costalba, Joona Kiiski, Tord Romstad
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+////
+//// Includes
+////
+
+#include <math.h>
+#include <string.h>
+
+#include "matchstats.h"
+
+
+////
+//// Local definitions
+////
+
+// Counts which are zero are replaced by this in the LLR, as otherwise a
+// short match with (say) no losses would seem to have no variance at all:
+#define REGULARIZATION 1e-3
+
+static int mean_and_variance(const match_stats_t *ms, int regularize,
+                             double *mean, double *variance);
+static double elo_to_score(double elo);
+static double score_to_elo(double score);
+
+
+////
+//// Functions
+////
+
+void match_stats_init(match_stats_t *ms) {
+  memset(ms, 0, sizeof(match_stats_t));
+}
+
+
+// Adds a game in which the first engine scored 0, 1 or 2 half points.
+
+void match_stats_add_game(match_stats_t *ms, int half_points) {
+  if(half_points == 2) ms->wins++;
+  else if(half_points == 1) ms->draws++;
+  else ms->losses++;
+}
+
+
+// Adds a finished pair of games in which the first engine scored 0 ... 4
+// half points. The games themselves are added by match_stats_add_game().
+
+void match_stats_add_pair(match_stats_t *ms, int half_points) {
+  if(half_points >= 0 && half_points <= 4) ms->pairs[half_points]++;
+}
+
+
+int match_stats_games(const match_stats_t *ms) {
+  return ms->wins + ms->draws + ms->losses;
+}
+
+
+int match_stats_pairs(const match_stats_t *ms) {
+  int i, n = 0;
+  for(i = 0; i < 5; i++) n += ms->pairs[i];
+  return n;
+}
+
+
+double match_stats_score(const match_stats_t *ms) {
+  int n = match_stats_games(ms);
+  return n > 0? (ms->wins + 0.5 * ms->draws) / n : 0.5;
+}
+
+
+// Computes the Elo difference and its 95% error margin. Returns 0 if the
+// difference is not finite, i.e. before the first game or while one
+// engine has scored every point.
+
+int match_stats_elo(const match_stats_t *ms, double *elo, double *error) {
+  double mean, variance, margin, low, high;
+  int n = mean_and_variance(ms, 0, &mean, &variance);
+
+  if(n == 0 || mean <= 0.0 || mean >= 1.0) return 0;
+  margin = 1.959964 * sqrt(variance / n);
+  low = mean - margin;
+  high = mean + margin;
+  if(low < 1e-6) low = 1e-6;
+  if(high > 1.0 - 1e-6) high = 1.0 - 1e-6;
+  *elo = score_to_elo(mean);
+  *error = (score_to_elo(high) - score_to_elo(low)) / 2.0;
+  return 1;
+}
+
+
+// The log-likelihood ratio of elo = elo1 against elo = elo0.
+
+double match_stats_llr(const match_stats_t *ms, double elo0, double elo1) {
+  double mean, variance, s0 = elo_to_score(elo0), s1 = elo_to_score(elo1);
+  int n = mean_and_variance(ms, 1, &mean, &variance);
+
+  if(n == 0 || variance <= 0.0) return 0.0;
+  return n * (s1 - s0) * (2.0 * mean - s0 - s1) / (2.0 * variance);
+}
+
+
+// The LLR at which H0 (elo = elo0) and H1 (elo = elo1) are accepted, for
+// the error rates alpha (accepting H1 when H0 is true) and beta.
+
+void sprt_bounds(const sprt_t *sprt, double *lower, double *upper) {
+  *lower = log(sprt->beta / (1.0 - sprt->alpha));
+  *upper = log((1.0 - sprt->beta) / sprt->alpha);
+}
+
+
+int sprt_status(const sprt_t *sprt, const match_stats_t *ms, double *llr) {
+  double lower, upper;
+
+  sprt_bounds(sprt, &lower, &upper);
+  *llr = match_stats_llr(ms, sprt->elo0, sprt->elo1);
+  if(*llr >= upper) return SPRT_ACCEPT_H1;
+  if(*llr <= lower) return SPRT_ACCEPT_H0;
+  return SPRT_CONTINUE;
+}
+
+
+// Computes the mean and variance of the score per game (from the
+// pentanomial counts if there are pairs, so that the result is the
+// variance of the mean score of a pair) and returns the number of samples.
+
+static int mean_and_variance(const match_stats_t *ms, int regularize,
+                             double *mean, double *variance) {
+  double counts[5], scores[5], total = 0.0, sum = 0.0, sum2 = 0.0;
+  int i, k, n;
+
+  if((n = match_stats_pairs(ms)) > 0) {
+    k = 5;
+    for(i = 0; i < 5; i++) {
+      counts[i] = ms->pairs[i];
+      scores[i] = i / 4.0;
+    }
+  }
+  else {
+    n = match_stats_games(ms);
+    k = 3;
+    counts[0] = ms->losses; counts[1] = ms->draws; counts[2] = ms->wins;
+    for(i = 0; i < 3; i++) scores[i] = i / 2.0;
+  }
+  if(n == 0) {
+    *mean = 0.5;
+    *variance = 0.0;
+    return 0;
+  }
+  for(i = 0; i < k; i++) {
+    if(regularize && counts[i] == 0.0) counts[i] = REGULARIZATION;
+    total += counts[i];
+  }
+  for(i = 0; i < k; i++) {
+    sum += counts[i] * scores[i];
+    sum2 += counts[i] * scores[i] * scores[i];
+  }
+  *mean = sum / total;
+  *variance = sum2 / total - *mean * *mean;
+  if(*variance < 0.0) *variance = 0.0;
+  return n;
+}
+
+
+static double elo_to_score(double elo) {
+  return 1.0 / (1.0 + pow(10.0, -elo / 400.0));
+}
+
+
+static double score_to_elo(double score) {
+  return -400.0 * log10(1.0 / score - 1.0);
+}
@@ -0,0 +1,76 @@
+/*
+  Stockfish, a OS X GUI for the UCI chess engine with the same name.
+  Copyright (C) 2004-2011 Marco Costalba, Joona Kiiski, Tord Romstad
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+/*
+  Storage of the lines of a MultiPV search.  Engines send the lines of each
+  depth in order, the best first, so while a new depth is searched the
+  lower lines are still those of the depth before.  The table keeps the
+  lines of the two deepest depths, indexed by depth and line number, and
+  each line is taken from the deepest depth which has it.  Lines are
+  numbered from 1, as in the "multipv" field of the UCI info command.
+*/
+
+
+#if !defined(MULTIPV_H_INCLUDED)
+#define MULTIPV_H_INCLUDED
+
+////
+//// Includes
+////
+
+#include "uciinfo.h"
+
+
+////
+//// Constants and macros
+////
+
+#define MULTIPV_MAX_LINES 16
+#define MULTIPV_MAX_PV 32
+
+
+////
+//// Types
+////
+
+typedef struct multipv_line_t {
+  int depth;             // 0 for a line which hasn't been seen
+  int score_type;
+  int score;             // Side to move's point of view
+  int bound;
+  int pv_length;
+  move_t pv[MULTIPV_MAX_PV];
+} multipv_line_t;
+
+typedef struct multipv_t {
+  int depth;             // The deepest depth seen
+  multipv_line_t lines[2][MULTIPV_MAX_LINES]; // By depth % 2 and line
+} multipv_t;
+
+
+////
+//// Functions
+////
+
+extern void multipv_clear(multipv_t *m);
+extern bool multipv_add(multipv_t *m, const uci_info_t *info);
+extern const multipv_line_t *multipv_line(const multipv_t *m, int n);
+
+
+#endif // !defined(MULTIPV_H_INCLUDED)
@@ -0,0 +1,84 @@
+/*
+  Stockfish, a OS X GUI for the UCI chess engine with the same name.
+  Copyright (C) 2004-2011 Marco Costalba, Joona Kiiski, Tord Romstad
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+////
+//// Includes
+////
+
+#include <string.h>
+
+#include "multipv.h"
+
+
+////
+//// Functions
+////
+
+void multipv_clear(multipv_t *m) {
+  memset(m, 0, sizeof(multipv_t));
+}
+
+
+// Stores the line of an info command which has a depth, a score and a PV.
+// Info commands without the multipv field are line 1. Returns false if
+// the info command was not stored.
+
+bool multipv_add(multipv_t *m, const uci_info_t *info) {
+  const int needed = UCI_INFO_DEPTH | UCI_INFO_SCORE | UCI_INFO_PV;
+  multipv_line_t *line;
+  int i, n = (info->fields & UCI_INFO_MULTIPV)? info->multipv : 1;
+
+  if((info->fields & needed) != needed || info->depth <= 0 ||
+     n < 1 || n > MULTIPV_MAX_LINES || info->depth < m->depth - 1)
+    return false;
+
+  // A new depth replaces the lines two depths back. If the engine skipped
+  // a depth, the lines of the last depth are moved out of the way first:
+  if(info->depth > m->depth) {
+    if((info->depth - m->depth) % 2 == 0)
+      for(i = 0; i < MULTIPV_MAX_LINES; i++)
+        if(m->lines[info->depth % 2][i].depth > 0)
+          m->lines[(info->depth + 1) % 2][i] = m->lines[info->depth % 2][i];
+    memset(m->lines[info->depth % 2], 0, sizeof(m->lines[0]));
+    m->depth = info->depth;
+  }
+
+  line = &m->lines[info->depth % 2][n - 1];
+  line->depth = info->depth;
+  line->score_type = info->score_type;
+  line->score = info->score;
+  line->bound = info->bound;
+  line->pv_length = Min(info->pv_length, MULTIPV_MAX_PV);
+  memcpy(line->pv, info->pv, line->pv_length * sizeof(move_t));
+  return true;
+}
+
+
+// Returns line n from the deepest depth which has it, or NULL.
+
+const multipv_line_t *multipv_line(const multipv_t *m, int n) {
+  const multipv_line_t *line;
+
+  if(n < 1 || n > MULTIPV_MAX_LINES || m->depth == 0) return NULL;
+  line = &m->lines[m->depth % 2][n - 1];
+  if(line->depth > 0) return line;
+  line = &m->lines[(m->depth + 1) % 2][n - 1];
+  if(line->depth > 0) return line;
+  return NULL;
+}
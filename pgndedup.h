@@ -0,0 +1,65 @@
+/*
+  Stockfish, a OS X GUI for the UCI chess engine with the same name.
+  Copyright (C) 2004-2011 Marco Costalba, Joona Kiiski, Tord Romstad
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+/*
+  Duplicate game detection for PGN files of any size.  Games are replayed
+  in parallel, and each game is summarized by a small record containing the
+  key of its final position, its length and a rolling hash of the keys of
+  all positions along the mainline.  The records are sorted in runs which
+  are written to temporary files and merged afterwards, so memory usage
+  does not depend on the size of the input.  Games whose records match are
+  replayed once more and compared move by move before they are reported as
+  duplicates.  Two games are duplicates when they start from the same
+  position and have the same mainline moves; tags, comments and variations
+  are not taken into account.
+*/
+
+
+#if !defined(PGNDEDUP_H_INCLUDED)
+#define PGNDEDUP_H_INCLUDED
+
+////
+//// Includes
+////
+
+#include "pgnscan.h"
+
+
+////
+//// Types
+////
+
+typedef struct pgn_dedup_stats_t {
+  long games;            // Number of games found
+  long duplicates;       // Number of duplicates found
+  long errors;           // Number of games which could not be replayed
+  volatile int64_t progress; // Number of bytes scanned so far
+} pgn_dedup_stats_t;
+
+
+////
+//// Functions
+////
+
+extern int pgn_dedup_file(const char *filename, const char *outfile,
+                          const char *reportfile, const char *tmpdir,
+                          int threads, pgn_dedup_stats_t *stats);
+
+
+#endif // !defined(PGNDEDUP_H_INCLUDED)
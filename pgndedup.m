@@ -0,0 +1,444 @@
+/*
+  Stockfish, a OS X GUI for the UCI chess engine with the same name.
+  Copyright (C) 2004-2011 Marco Costalba, Joona Kiiski, Tord Romstad
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+////
+//// Includes
+////
+
+#include <errno.h>
+#include <fcntl.h>
+
+#include "pgndedup.h"
+
+
+////
+//// Local definitions
+////
+
+typedef struct record_t {
+  hashkey_t final_key, signature;
+  int64_t offset;
+  int32_t length, plies;
+  int32_t worker, number;
+} record_t;
+
+typedef struct duplicate_t {
+  int64_t offset, length;
+  long number, original;
+} duplicate_t;
+
+typedef struct worker_t {
+  pgn_game_t game[1];
+  record_t *records;
+  int count;
+  FILE **runs;
+  int run_count, run_capacity;
+  const char *tmpdir;
+  int worker;
+  long errors;
+} worker_t;
+
+typedef struct run_t {
+  FILE *file;
+  record_t head;
+} run_t;
+
+typedef struct merger_t {
+  run_t *runs;
+  int count;
+} merger_t;
+
+// Number of records sorted in memory before they are written to a run
+// file. 256K records take 10 MB per worker thread.
+static const int RunSize = 256 * 1024;
+
+static int scan_callback(const char *text, long length, off_t offset,
+                         long number, void *context);
+static int flush_run(worker_t *w);
+static FILE *temporary_file(const char *tmpdir);
+static int compare_records(const void *a, const void *b);
+static int compare_duplicates(const void *a, const void *b);
+static bool same_group(const record_t *a, const record_t *b);
+static void merger_sift_down(merger_t *m, int i);
+static bool merger_next(merger_t *m, record_t *r);
+static int replay_at(int fd, const record_t *r, char **buffer, long *size,
+                     pgn_game_t *game);
+static bool same_moves(const pgn_game_t *a, const pgn_game_t *b);
+static int write_report(const char *reportfile, duplicate_t *dups, long n);
+static int write_unique_games(int fd, const char *outfile, duplicate_t *dups,
+                              long n);
+
+
+////
+//// Functions
+////
+
+// pgn_dedup_file() finds all duplicate games in a PGN file, using
+// 'threads' worker threads and temporary files in 'tmpdir'. If 'outfile'
+// is not NULL, a copy of the input with all duplicates removed is written
+// to it. If 'reportfile' is not NULL, a list of the duplicates (each with
+// the number of the first game it repeats) is written to it. Games are
+// numbered from 1. Returns 0 on success, and -1 with errno set on errors.
+
+int pgn_dedup_file(const char *filename, const char *outfile,
+                   const char *reportfile, const char *tmpdir,
+                   int threads, pgn_dedup_stats_t *stats) {
+  worker_t *workers;
+  void **contexts;
+  long *games, *base;
+  merger_t merger[1];
+  pgn_game_t *keeper, *candidate;
+  record_t first, r;
+  duplicate_t *dups = NULL;
+  long dup_count = 0, dup_capacity = 0;
+  char *keeper_text = NULL, *candidate_text = NULL;
+  long keeper_size = 0, candidate_size = 0;
+  bool have_group = false, keeper_ok = false;
+  int fd = -1, i, j, result = -1, saved_errno = 0;
+
+  stats->games = stats->duplicates = stats->errors = 0;
+  stats->progress = 0;
+
+  workers = calloc(threads, sizeof(worker_t));
+  contexts = malloc(threads * sizeof(void *));
+  games = malloc(threads * sizeof(long));
+  base = malloc(threads * sizeof(long));
+  keeper = malloc(sizeof(pgn_game_t));
+  candidate = malloc(sizeof(pgn_game_t));
+  merger->runs = NULL; merger->count = 0;
+  if(workers == NULL || contexts == NULL || games == NULL || base == NULL ||
+     keeper == NULL || candidate == NULL)
+    goto done;
+
+  // Pass 1: Replay all games in parallel, and write sorted runs of records
+  for(i = 0; i < threads; i++) {
+    workers[i].records = malloc(RunSize * sizeof(record_t));
+    workers[i].tmpdir = tmpdir;
+    workers[i].worker = i;
+    if(workers[i].records == NULL) goto done;
+    contexts[i] = workers + i;
+  }
+  if(pgn_scan_file(filename, threads, scan_callback, contexts, games,
+                   &stats->progress) != 0)
+    goto done;
+  for(i = 0; i < threads; i++) {
+    if(flush_run(workers + i) != 0) goto done;
+    base[i] = stats->games;
+    stats->games += games[i];
+    stats->errors += workers[i].errors;
+    merger->count += workers[i].run_count;
+  }
+
+  // Pass 2: Merge the runs. Records for identical games end up next to
+  // each other, with the first occurrence in the file first.
+  merger->runs = malloc(Max(merger->count, 1) * sizeof(run_t));
+  if(merger->runs == NULL) goto done;
+  merger->count = 0;
+  for(i = 0; i < threads; i++)
+    for(j = 0; j < workers[i].run_count; j++) {
+      FILE *f = workers[i].runs[j];
+      rewind(f);
+      if(fread(&merger->runs[merger->count].head, sizeof(record_t), 1, f) == 1)
+        merger->runs[merger->count++].file = f;
+    }
+  for(i = merger->count / 2 - 1; i >= 0; i--)
+    merger_sift_down(merger, i);
+
+  if((fd = open(filename, O_RDONLY)) < 0) goto done;
+  while(merger_next(merger, &r)) {
+    if(!have_group || !same_group(&first, &r)) {
+      first = r;
+      have_group = true;
+      keeper_ok = false;
+      continue;
+    }
+
+    // A candidate duplicate. Confirm by comparing the actual moves.
+    if(!keeper_ok) {
+      if(replay_at(fd, &first, &keeper_text, &keeper_size, keeper) != 0)
+        goto done;
+      keeper_ok = true;
+    }
+    if(replay_at(fd, &r, &candidate_text, &candidate_size, candidate) != 0)
+      goto done;
+    if(same_moves(keeper, candidate)) {
+      if(dup_count == dup_capacity) {
+        duplicate_t *d;
+        dup_capacity = dup_capacity ? 2 * dup_capacity : 1024;
+        if((d = realloc(dups, dup_capacity * sizeof(duplicate_t))) == NULL)
+          goto done;
+        dups = d;
+      }
+      dups[dup_count].offset = r.offset;
+      dups[dup_count].length = r.length;
+      dups[dup_count].number = base[r.worker] + r.number + 1;
+      dups[dup_count].original = base[first.worker] + first.number + 1;
+      dup_count++;
+    }
+  }
+  stats->duplicates = dup_count;
+
+  // Pass 3: Output
+  qsort(dups, dup_count, sizeof(duplicate_t), compare_duplicates);
+  if(reportfile != NULL && write_report(reportfile, dups, dup_count) != 0)
+    goto done;
+  if(outfile != NULL && write_unique_games(fd, outfile, dups, dup_count) != 0)
+    goto done;
+  result = 0;
+
+ done:
+  saved_errno = errno;
+  if(fd >= 0) close(fd);
+  if(workers != NULL)
+    for(i = 0; i < threads; i++) {
+      for(j = 0; j < workers[i].run_count; j++)
+        fclose(workers[i].runs[j]);
+      free(workers[i].runs);
+      free(workers[i].records);
+    }
+  free(workers); free(contexts); free(games); free(base);
+  free(keeper); free(candidate);
+  free(keeper_text); free(candidate_text);
+  free(merger->runs);
+  free(dups);
+  errno = saved_errno;
+  return result;
+}
+
+
+static int scan_callback(const char *text, long length, off_t offset,
+                         long number, void *context) {
+  worker_t *w = context;
+  record_t *r;
+
+  if(pgn_replay_game(text, length, w->game) != PGN_OK) {
+    w->errors++;
+    return 0;
+  }
+  if(w->count == RunSize && flush_run(w) != 0) return -1;
+
+  r = w->records + w->count++;
+  r->final_key = w->game->pos->key;
+  r->signature = pgn_game_signature(w->game);
+  r->offset = offset;
+  r->length = (int32_t)length;
+  r->plies = w->game->plies;
+  r->worker = w->worker;
+  r->number = (int32_t)number;
+  return 0;
+}
+
+
+static int flush_run(worker_t *w) {
+  FILE *f;
+
+  if(w->count == 0) return 0;
+  qsort(w->records, w->count, sizeof(record_t), compare_records);
+  if((f = temporary_file(w->tmpdir)) == NULL) return -1;
+  if(fwrite(w->records, sizeof(record_t), w->count, f) != (size_t)w->count) {
+    fclose(f);
+    return -1;
+  }
+  if(w->run_count == w->run_capacity) {
+    FILE **runs;
+    w->run_capacity = w->run_capacity ? 2 * w->run_capacity : 16;
+    if((runs = realloc(w->runs, w->run_capacity * sizeof(FILE *))) == NULL) {
+      fclose(f);
+      return -1;
+    }
+    w->runs = runs;
+  }
+  w->runs[w->run_count++] = f;
+  w->count = 0;
+  return 0;
+}
+
+
+// temporary_file() creates an anonymous temporary file, which disappears
+// as soon as it is closed.
+
+static FILE *temporary_file(const char *tmpdir) {
+  char path[1024];
+  FILE *f;
+  int fd;
+
+  snprintf(path, sizeof(path), "%s/stockfish-dedup.XXXXXX", tmpdir);
+  if((fd = mkstemp(path)) < 0) return NULL;
+  unlink(path);
+  if((f = fdopen(fd, "w+b")) == NULL) close(fd);
+  return f;
+}
+
+
+static int compare_records(const void *a, const void *b) {
+  const record_t *r1 = a, *r2 = b;
+  if(r1->final_key != r2->final_key)
+    return r1->final_key < r2->final_key ? -1 : 1;
+  if(r1->plies != r2->plies)
+    return r1->plies < r2->plies ? -1 : 1;
+  if(r1->signature != r2->signature)
+    return r1->signature < r2->signature ? -1 : 1;
+  if(r1->offset != r2->offset)
+    return r1->offset < r2->offset ? -1 : 1;
+  return 0;
+}
+
+
+static int compare_duplicates(const void *a, const void *b) {
+  const duplicate_t *d1 = a, *d2 = b;
+  if(d1->offset != d2->offset) return d1->offset < d2->offset ? -1 : 1;
+  return 0;
+}
+
+
+static bool same_group(const record_t *a, const record_t *b) {
+  return a->final_key == b->final_key && a->plies == b->plies &&
+    a->signature == b->signature;
+}
+
+
+// The merger is a binary heap of runs, ordered by their first record.
+
+static void merger_sift_down(merger_t *m, int i) {
+  while(true) {
+    int l = 2*i + 1, r = l + 1, min = i;
+    run_t tmp;
+    if(l < m->count && compare_records(&m->runs[l].head, &m->runs[min].head) < 0)
+      min = l;
+    if(r < m->count && compare_records(&m->runs[r].head, &m->runs[min].head) < 0)
+      min = r;
+    if(min == i) return;
+    tmp = m->runs[i]; m->runs[i] = m->runs[min]; m->runs[min] = tmp;
+    i = min;
+  }
+}
+
+
+static bool merger_next(merger_t *m, record_t *r) {
+  if(m->count == 0) return false;
+  *r = m->runs[0].head;
+  if(fread(&m->runs[0].head, sizeof(record_t), 1, m->runs[0].file) != 1)
+    m->runs[0] = m->runs[--m->count];
+  merger_sift_down(m, 0);
+  return true;
+}
+
+
+static int replay_at(int fd, const record_t *r, char **buffer, long *size,
+                     pgn_game_t *game) {
+  ssize_t n;
+
+  if(*size < r->length) {
+    char *b = realloc(*buffer, r->length);
+    if(b == NULL) return -1;
+    *buffer = b; *size = r->length;
+  }
+  n = pread(fd, *buffer, r->length, r->offset);
+  if(n != r->length) {
+    // A short read (the file was truncated) sets no errno of its own:
+    if(n >= 0) errno = EIO;
+    return -1;
+  }
+  pgn_replay_game(*buffer, r->length, game);
+  return 0;
+}
+
+
+static bool same_moves(const pgn_game_t *a, const pgn_game_t *b) {
+  int i;
+  if(a->plies != b->plies || a->start->key != b->start->key) return false;
+  for(i = 0; i < a->plies; i++)
+    if(a->ply[i].move != b->ply[i].move) return false;
+  return true;
+}
+
+
+static int write_report(const char *reportfile, duplicate_t *dups, long n) {
+  FILE *f;
+  long i;
+
+  if((f = fopen(reportfile, "w")) == NULL) return -1;
+  for(i = 0; i < n; i++)
+    fprintf(f, "Game %ld is a duplicate of game %ld\n",
+            dups[i].number, dups[i].original);
+  return fclose(f) == 0 ? 0 : -1;
+}
+
+
+// write_unique_games() copies the input file to 'outfile', leaving out the
+// duplicates (which must be sorted by offset) and the blank lines following
+// them.
+
+static int write_unique_games(int fd, const char *outfile, duplicate_t *dups,
+                              long n) {
+  static const int BufferSize = 1024 * 1024;
+  char *buffer;
+  FILE *f;
+  off_t offset = 0;
+  long d = 0;
+  bool skip_blanks = false;
+  int result = 0;
+
+  if((buffer = malloc(BufferSize)) == NULL) return -1;
+  if((f = fopen(outfile, "w")) == NULL) {
+    free(buffer);
+    return -1;
+  }
+  while(true) {
+    ssize_t len = pread(fd, buffer, BufferSize, offset);
+    char *p = buffer, *end;
+    if(len < 0) {
+      if(errno == EINTR) continue;
+      result = -1; break;
+    }
+    if(len == 0) break;
+    end = buffer + len;
+    while(p < end) {
+      off_t pos = offset + (p - buffer);
+      if(skip_blanks) {
+        while(p < end && isspace((unsigned char)*p)) p++;
+        if(p < end) skip_blanks = false;
+      }
+      else if(d < n && pos >= dups[d].offset) {
+        // Inside a duplicate
+        off_t stop = dups[d].offset + dups[d].length;
+        if(stop - pos <= end - p) {
+          p += stop - pos;
+          d++;
+          skip_blanks = true;
+        }
+        else p = end;
+      }
+      else {
+        // Copy up to the next duplicate
+        long count = end - p;
+        if(d < n && dups[d].offset - pos < count) count = dups[d].offset - pos;
+        if(fwrite(p, 1, count, f) != (size_t)count) {
+          result = -1; break;
+        }
+        p += count;
+      }
+    }
+    if(result != 0) break;
+    offset += len;
+  }
+  free(buffer);
+  if(fclose(f) != 0) result = -1;
+  return result;
+}
@@ -0,0 +1,111 @@
+/*
+  Stockfish, a OS X GUI for the UCI chess engine with the same name.
+  Copyright (C) 2004-2011 Marco Costalba, Joona Kiiski, Tord Romstad
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+/*
+  Export of positions from PGN files as training data for evaluation
+  tuning.  Games are replayed in parallel, and every position along the
+  mainline (or every n'th position) is written as a fixed size record of
+  PGN_EXPORT_RECORD_SIZE bytes:
+
+    bytes  0-31  The board, two squares per byte in the order a1, b1, ...,
+                 h8, the first square of each pair in the low nibble.  The
+                 nibble is 0 for an empty square, and the piece code from
+                 position.h (WP ... WK, BP ... BK) otherwise.
+    byte   32    Bits 0-3: castling rights (white O-O, white O-O-O, black
+                 O-O, black O-O-O); bit 4: side to move (1 = black); bits
+                 5-6: game result from the side to move's point of view
+                 (PGN_EXPORT_LOSS ... PGN_EXPORT_UNKNOWN).
+    byte   33    En passant square (0-63 as above), or 255 if none.
+    byte   34    Half move counter for the 50 move rule, at most 255.
+    byte   35    Search depth of the evaluation, 0 if there is none.
+    bytes 36-37  Evaluation in centipawns from the side to move's point of
+                 view, as a little endian signed 16 bit number, or
+                 PGN_EXPORT_NO_EVAL.
+    bytes 38-39  Number of plies since the start of the game, little endian.
+
+  Evaluations are taken from move comments in the format written by the
+  GUI during engine games ("+0.35/12", "-#3/20"); the evaluation after a
+  move belongs to the position the move was played from, and is always read
+  from the point of view of the side to move in that position.  Positions
+  can be deduplicated by hash key, and records can be spread over several
+  output files by hash key.
+*/
+
+
+#if !defined(PGNEXPORT_H_INCLUDED)
+#define PGNEXPORT_H_INCLUDED
+
+////
+//// Includes
+////
+
+#include "pgnscan.h"
+
+
+////
+//// Constants and macros
+////
+
+#define PGN_EXPORT_RECORD_SIZE 40
+#define PGN_EXPORT_NO_EVAL (-32768)
+#define PGN_EXPORT_MATE_SCORE 32000
+
+enum {
+  PGN_EXPORT_LOSS, PGN_EXPORT_DRAW, PGN_EXPORT_WIN, PGN_EXPORT_UNKNOWN
+};
+
+
+////
+//// Types
+////
+
+typedef struct pgn_export_options_t {
+  int threads;
+  int shards;            // Number of output files
+  int interval;          // Export every interval'th position of each game
+  bool dedup;            // Skip positions which were exported before
+  int dedup_bits;        // log2 of the number of keys remembered, 0 = auto
+} pgn_export_options_t;
+
+typedef struct pgn_export_stats_t {
+  long games;            // Number of games exported
+  long errors;           // Number of games which could not be replayed
+  int64_t positions;     // Number of positions written
+  int64_t duplicates;    // Number of positions skipped as duplicates
+  volatile int64_t progress; // Number of bytes scanned so far
+} pgn_export_stats_t;
+
+
+////
+//// Functions
+////
+
+extern int pgn_export_files(const char *filenames[], int count,
+                            const char *outfile,
+                            const pgn_export_options_t *options,
+                            pgn_export_stats_t *stats);
+extern char *pgn_export_shard_filename(const char *outfile, int shard,
+                                       int shards);
+extern void pgn_export_pack(const position_t *pos, int ply, int result,
+                            int eval, int depth, unsigned char record[]);
+extern bool pgn_parse_eval(const char *comment, int length, int *eval,
+                           int *depth);
+
+
+#endif // !defined(PGNEXPORT_H_INCLUDED)
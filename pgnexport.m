@@ -0,0 +1,459 @@
+/*
+  Stockfish, a OS X GUI for the UCI chess engine with the same name.
+  Copyright (C) 2004-2011 Marco Costalba, Joona Kiiski, Tord Romstad
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+////
+//// Includes
+////
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <libkern/OSAtomic.h>
+#include <sys/stat.h>
+
+#include "pgnexport.h"
+
+
+////
+//// Local definitions
+////
+
+typedef struct shard_t {
+  int fd;
+  pthread_mutex_t lock;
+  bool locked;
+} shard_t;
+
+// The state shared by all worker threads. The dedup table is an open
+// addressing hash table of position keys, filled with compare and swap.
+// Once it is three quarters full, no more keys are added, and the
+// remaining positions are only checked against the keys already in it.
+
+typedef struct exporter_t {
+  const pgn_export_options_t *options;
+  shard_t *shards;
+  volatile int64_t *table;
+  uint64_t table_mask;
+  int64_t table_limit;
+  volatile int64_t table_count;
+  volatile int failed;
+  int error;
+} exporter_t;
+
+// The positions of a game are packed into 'staged' while it is replayed,
+// and labelled with the evaluations and the result once the whole game has
+// been read.
+
+typedef struct worker_t {
+  exporter_t *exporter;
+  pgn_game_t game[1];
+  unsigned char *staged;
+  hashkey_t keys[MAX_GAME_LENGTH];
+  int plies[MAX_GAME_LENGTH];
+  int staged_count;
+  unsigned char *buffers;
+  int *counts;
+  long games, errors;
+  int64_t positions, duplicates;
+} worker_t;
+
+// Number of records buffered per worker and output file before they are
+// written.
+static const int BufferRecords = 1024;
+
+static int scan_callback(const char *text, long length, off_t offset,
+                         long number, void *context);
+static void stage_position(const position_t *pos, int ply, void *context);
+static bool insert_key(exporter_t *e, hashkey_t key);
+static int add_record(worker_t *w, hashkey_t key, const unsigned char record[]);
+static int flush_shard(worker_t *w, int shard);
+static int write_all(int fd, const unsigned char *data, size_t length);
+static int default_dedup_bits(const char *filenames[], int count);
+
+
+////
+//// Functions
+////
+
+// pgn_export_files() exports the positions of all games in the given
+// files to 'outfile', or to options->shards files named after it (see
+// pgn_export_shard_filename()). Returns 0 on success, and -1 with errno
+// set on errors.
+
+int pgn_export_files(const char *filenames[], int count,
+                     const char *outfile,
+                     const pgn_export_options_t *options,
+                     pgn_export_stats_t *stats) {
+  exporter_t e[1];
+  worker_t *workers = NULL;
+  void **contexts = NULL;
+  long *games = NULL;
+  char *name;
+  int threads = Max(options->threads, 1), shards = Max(options->shards, 1);
+  int bits, i, j, result = -1, saved_errno = 0;
+
+  stats->games = stats->errors = 0;
+  stats->positions = stats->duplicates = 0;
+  stats->progress = 0;
+
+  memset(e, 0, sizeof(exporter_t));
+  e->options = options;
+  e->shards = calloc(shards, sizeof(shard_t));
+  if(e->shards == NULL) goto done;
+  for(i = 0; i < shards; i++)
+    e->shards[i].fd = -1;
+  for(i = 0; i < shards; i++) {
+    if((name = pgn_export_shard_filename(outfile, i, shards)) == NULL)
+      goto done;
+    e->shards[i].fd = open(name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    free(name);
+    if(e->shards[i].fd < 0 ||
+       pthread_mutex_init(&e->shards[i].lock, NULL) != 0)
+      goto done;
+    e->shards[i].locked = true;
+  }
+
+  if(options->dedup) {
+    bits = options->dedup_bits;
+    if(bits <= 0) bits = default_dedup_bits(filenames, count);
+    e->table = calloc((size_t)1 << bits, sizeof(int64_t));
+    if(e->table == NULL) goto done;
+    e->table_mask = ((uint64_t)1 << bits) - 1;
+    e->table_limit = (((int64_t)1 << bits) / 4) * 3;
+  }
+
+  workers = calloc(threads, sizeof(worker_t));
+  contexts = malloc(threads * sizeof(void *));
+  games = malloc(threads * sizeof(long));
+  if(workers == NULL || contexts == NULL || games == NULL) goto done;
+  for(i = 0; i < threads; i++) {
+    workers[i].exporter = e;
+    workers[i].buffers =
+      malloc(shards * BufferRecords * PGN_EXPORT_RECORD_SIZE);
+    workers[i].counts = calloc(shards, sizeof(int));
+    workers[i].staged = malloc(MAX_GAME_LENGTH * PGN_EXPORT_RECORD_SIZE);
+    if(workers[i].buffers == NULL || workers[i].counts == NULL ||
+       workers[i].staged == NULL)
+      goto done;
+    contexts[i] = workers + i;
+  }
+
+  for(i = 0; i < count; i++)
+    if(pgn_scan_file(filenames[i], threads, scan_callback, contexts, games,
+                     &stats->progress) != 0) {
+      saved_errno = e->failed? e->error : errno;
+      goto done;
+    }
+  for(i = 0; i < threads; i++)
+    for(j = 0; j < shards; j++)
+      if(flush_shard(workers + i, j) != 0) {
+        saved_errno = e->error;
+        goto done;
+      }
+
+  for(i = 0; i < threads; i++) {
+    stats->games += workers[i].games;
+    stats->errors += workers[i].errors;
+    stats->positions += workers[i].positions;
+    stats->duplicates += workers[i].duplicates;
+  }
+  result = 0;
+
+ done:
+  if(result != 0 && saved_errno == 0) saved_errno = errno;
+  if(workers != NULL)
+    for(i = 0; i < threads; i++) {
+      free(workers[i].buffers);
+      free(workers[i].counts);
+      free(workers[i].staged);
+    }
+  free(workers); free(contexts); free(games);
+  free((void *)e->table);
+  if(e->shards != NULL)
+    for(i = 0; i < shards; i++) {
+      if(e->shards[i].fd >= 0 && close(e->shards[i].fd) != 0 &&
+         result == 0) {
+        result = -1;
+        saved_errno = errno;
+      }
+      if(e->shards[i].locked)
+        pthread_mutex_destroy(&e->shards[i].lock);
+    }
+  free(e->shards);
+  if(result != 0) errno = saved_errno;
+  return result;
+}
+
+
+// pgn_export_shard_filename() returns the name of an output file, which is
+// 'outfile' itself if there is only one, and 'outfile' with a shard number
+// inserted before the extension otherwise: "data.bin" becomes "data-000.bin",
+// "data-001.bin" and so on. The result must be freed by the caller.
+
+char *pgn_export_shard_filename(const char *outfile, int shard, int shards) {
+  const char *slash = strrchr(outfile, '/'), *dot = strrchr(outfile, '.');
+  size_t stem = strlen(outfile);
+  char *name = malloc(strlen(outfile) + 16);
+
+  if(name == NULL) return NULL;
+  if(shards <= 1) {
+    strcpy(name, outfile);
+    return name;
+  }
+  if(dot != NULL && (slash == NULL || dot > slash + 1))
+    stem = dot - outfile;
+  sprintf(name, "%.*s-%03d%s", (int)stem, outfile, shard, outfile + stem);
+  return name;
+}
+
+
+// pgn_export_pack() packs a position into a record in the format described
+// in pgnexport.h. 'result' is PGN_EXPORT_LOSS ... PGN_EXPORT_UNKNOWN, seen
+// from the side to move, and 'eval' is in centipawns from the side to move.
+
+void pgn_export_pack(const position_t *pos, int ply, int result,
+                     int eval, int depth, unsigned char record[]) {
+  int rank, file, piece, i = 0, flags = 0;
+
+  memset(record, 0, PGN_EXPORT_RECORD_SIZE);
+  for(rank = RANK_1; rank <= RANK_8; rank++)
+    for(file = FILE_A; file <= FILE_H; file++, i++) {
+      piece = pos->board[(rank << 4) | file];
+      if(piece == EMPTY) continue;
+      record[i / 2] |= (i & 1)? (piece & 15) << 4 : (piece & 15);
+    }
+
+  if(CanCastleKingside(pos, WHITE)) flags |= 1;
+  if(CanCastleQueenside(pos, WHITE)) flags |= 2;
+  if(CanCastleKingside(pos, BLACK)) flags |= 4;
+  if(CanCastleQueenside(pos, BLACK)) flags |= 8;
+  if(pos->side == BLACK) flags |= 16;
+  flags |= result << 5;
+  record[32] = flags;
+  record[33] = pos->ep_square?
+    (SquareRank(pos->ep_square) << 3) | SquareFile(pos->ep_square) : 255;
+  record[34] = Min(pos->rule50, 255);
+  record[35] = Min(Max(depth, 0), 255);
+  record[36] = eval & 255;
+  record[37] = (eval >> 8) & 255;
+  record[38] = ply & 255;
+  record[39] = (ply >> 8) & 255;
+}
+
+
+// pgn_parse_eval() parses an evaluation in the format written by the GUI
+// into move comments: a score in pawns or a mate distance in moves,
+// followed by a slash and the search depth, e.g. "+0.35/12" or "-#3/20".
+// Returns false if the comment doesn't start with an evaluation.
+
+bool pgn_parse_eval(const char *comment, int length, int *eval, int *depth) {
+  const char *p = comment, *end = comment + length;
+  int sign = 1, whole = 0, cents = 0, digits;
+  bool mate = false;
+
+  while(p < end && isspace((unsigned char)*p)) p++;
+  if(p < end && (*p == '+' || *p == '-')) {
+    if(*p == '-') sign = -1;
+    p++;
+  }
+  if(p < end && *p == '#') {
+    mate = true;
+    p++;
+  }
+  if(p == end || !isdigit((unsigned char)*p)) return false;
+  for( ; p < end && isdigit((unsigned char)*p); p++)
+    whole = Min(whole * 10 + (*p - '0'), 100000);
+  if(!mate && p < end && *p == '.') {
+    for(p++, digits = 0; p < end && isdigit((unsigned char)*p); p++, digits++)
+      if(digits < 2) cents = cents * 10 + (*p - '0');
+    if(digits == 1) cents *= 10;
+  }
+  if(p == end || *p != '/') return false;
+  for(p++, *depth = 0; p < end && isdigit((unsigned char)*p); p++)
+    *depth = Min(*depth * 10 + (*p - '0'), 1000);
+
+  if(mate)
+    *eval = sign * Max(PGN_EXPORT_MATE_SCORE - whole, 30000);
+  else
+    *eval = sign * Min(whole * 100 + cents, 30000);
+  return true;
+}
+
+
+// Evaluations in comments are read from the point of view of the side
+// making the move, which is the side to move in the exported position, so
+// that the labels don't depend on how the scores were displayed.
+
+static int scan_callback(const char *text, long length, off_t offset,
+                         long number, void *context) {
+  worker_t *w = context;
+  exporter_t *e = w->exporter;
+  const pgn_export_options_t *o = e->options;
+  pgn_game_t *g = w->game;
+  unsigned char *record;
+  int i, ply, eval, depth, result;
+  bool black;
+
+  if(e->failed) return 1;
+  w->staged_count = 0;
+  if(pgn_replay_positions(text, length, g, stage_position, w) != PGN_OK) {
+    w->errors++;
+    return 0;
+  }
+  w->games++;
+
+  for(i = 0; i < w->staged_count; i++) {
+    record = w->staged + i * PGN_EXPORT_RECORD_SIZE;
+    ply = w->plies[i];
+    black = (record[32] & 16) != 0;
+    if(ply >= g->plies || g->ply[ply].comment == NULL ||
+       !pgn_parse_eval(g->ply[ply].comment, g->ply[ply].comment_length,
+                       &eval, &depth)) {
+      eval = PGN_EXPORT_NO_EVAL;
+      depth = 0;
+    }
+    if(g->result == WHITE_WINS)
+      result = black? PGN_EXPORT_LOSS : PGN_EXPORT_WIN;
+    else if(g->result == BLACK_WINS)
+      result = black? PGN_EXPORT_WIN : PGN_EXPORT_LOSS;
+    else if(g->result == UNKNOWN)
+      result = PGN_EXPORT_UNKNOWN;
+    else
+      result = PGN_EXPORT_DRAW;
+    record[32] = (record[32] & 31) | (result << 5);
+    record[35] = Min(Max(depth, 0), 255);
+    record[36] = eval & 255;
+    record[37] = (eval >> 8) & 255;
+
+    if(o->dedup && !insert_key(e, w->keys[i]))
+      w->duplicates++;
+    else if(add_record(w, w->keys[i], record) != 0)
+      return 1;
+    else
+      w->positions++;
+  }
+  return 0;
+}
+
+
+// stage_position() packs every interval'th position of the game being
+// replayed, still without evaluation and result.
+
+static void stage_position(const position_t *pos, int ply, void *context) {
+  worker_t *w = context;
+  int n = w->staged_count;
+
+  if(ply % Max(w->exporter->options->interval, 1) != 0) return;
+  pgn_export_pack(pos, ply, PGN_EXPORT_UNKNOWN, PGN_EXPORT_NO_EVAL, 0,
+                  w->staged + n * PGN_EXPORT_RECORD_SIZE);
+  w->keys[n] = pos->key;
+  w->plies[n] = ply;
+  w->staged_count++;
+}
+
+
+// insert_key() adds a key to the dedup table, and returns false if it was
+// already there. Key 0 marks empty slots, so it is stored as 1.
+
+static bool insert_key(exporter_t *e, hashkey_t key) {
+  int64_t k = key? (int64_t)key : 1, v;
+  uint64_t i = (uint64_t)k & e->table_mask;
+
+  while(true) {
+    v = e->table[i];
+    if(v == k) return false;
+    if(v == 0) {
+      if(e->table_count >= e->table_limit) return true;
+      if(OSAtomicCompareAndSwap64Barrier(0, k, e->table + i)) {
+        OSAtomicAdd64(1, &e->table_count);
+        return true;
+      }
+      continue;
+    }
+    i = (i + 1) & e->table_mask;
+  }
+}
+
+
+// add_record() copies a record into the worker's buffer for the output
+// file chosen by the position's key.
+
+static int add_record(worker_t *w, hashkey_t key, const unsigned char record[]) {
+  int shards = Max(w->exporter->options->shards, 1), shard = 0;
+
+  if(shards > 1)
+    shard = ((key * 0x9E3779B97F4A7C15ULL) >> 32) % shards;
+  memcpy(w->buffers + (shard * BufferRecords + w->counts[shard]) *
+         PGN_EXPORT_RECORD_SIZE, record, PGN_EXPORT_RECORD_SIZE);
+  if(++w->counts[shard] == BufferRecords)
+    return flush_shard(w, shard);
+  return 0;
+}
+
+
+static int flush_shard(worker_t *w, int shard) {
+  exporter_t *e = w->exporter;
+  int result;
+
+  if(w->counts[shard] == 0) return 0;
+  pthread_mutex_lock(&e->shards[shard].lock);
+  result = write_all(e->shards[shard].fd,
+                     w->buffers + shard * BufferRecords * PGN_EXPORT_RECORD_SIZE,
+                     w->counts[shard] * PGN_EXPORT_RECORD_SIZE);
+  if(result != 0 && !e->failed) {
+    e->error = errno;
+    e->failed = true;
+  }
+  pthread_mutex_unlock(&e->shards[shard].lock);
+  w->counts[shard] = 0;
+  return result;
+}
+
+
+static int write_all(int fd, const unsigned char *data, size_t length) {
+  ssize_t n;
+
+  while(length > 0) {
+    n = write(fd, data, length);
+    if(n < 0 && errno == EINTR) continue;
+    if(n <= 0) return -1;
+    data += n;
+    length -= n;
+  }
+  return 0;
+}
+
+
+// The default dedup table has room for about one key per 8 bytes of input,
+// which is roughly one per mainline move, but never more than 2^27 keys
+// (1 GB).
+
+static int default_dedup_bits(const char *filenames[], int count) {
+  struct stat fs;
+  int64_t size = 0;
+  int i, bits = 16;
+
+  for(i = 0; i < count; i++)
+    if(stat(filenames[i], &fs) == 0)
+      size += fs.st_size;
+  while(bits < 27 && ((int64_t)1 << bits) / 4 * 3 < size / 8)
+    bits++;
+  return bits;
+}
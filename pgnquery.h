@@ -0,0 +1,81 @@
+/*
+  Stockfish, a OS X GUI for the UCI chess engine with the same name.
+  Copyright (C) 2004-2011 Marco Costalba, Joona Kiiski, Tord Romstad
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+/*
+  Queries on the games of PGN files.  A query combines conditions on the
+  tags of a game, on a position reached in its mainline and on the
+  material of a position reached in its mainline, and a game matches when
+  it meets all of them.  A tag condition is met when the value of the tag
+  contains the searched text, ignoring case; a condition without a tag
+  name is met by any tag.  Positions are compared by their keys, so that
+  side to move, castling rights and en passant squares count.  The
+  material condition is met by a position with exactly the given number
+  of pieces of each type for both sides.  Games with an illegal move are
+  searched up to that move.
+*/
+
+
+#if !defined(PGNQUERY_H_INCLUDED)
+#define PGNQUERY_H_INCLUDED
+
+////
+//// Includes
+////
+
+#include "pgnscan.h"
+
+
+////
+//// Constants and macros
+////
+
+#define PGN_QUERY_MAX_TAGS 8
+#define PGN_QUERY_STRING_SIZE 256
+
+
+////
+//// Types
+////
+
+typedef struct pgn_query_t {
+  int tag_count;
+  char tag_names[PGN_QUERY_MAX_TAGS][PGN_QUERY_STRING_SIZE];
+  char tag_values[PGN_QUERY_MAX_TAGS][PGN_QUERY_STRING_SIZE];
+  bool has_position;
+  hashkey_t key;
+  bool has_material;
+  int piece_count[2][KING];  // Indexed by side and piece type
+} pgn_query_t;
+
+
+////
+//// Functions
+////
+
+extern void pgn_query_init(pgn_query_t *query);
+extern bool pgn_query_add_tag(pgn_query_t *query, const char *name,
+                              const char *value);
+extern void pgn_query_set_position(pgn_query_t *query, const position_t *pos);
+extern void pgn_query_set_material(pgn_query_t *query, const position_t *pos);
+extern bool pgn_query_is_empty(const pgn_query_t *query);
+extern bool pgn_query_match(const pgn_query_t *query, const char *text,
+                            long length, pgn_game_t *game);
+
+
+#endif // !defined(PGNQUERY_H_INCLUDED)
@@ -0,0 +1,166 @@
+/*
+  Stockfish, a OS X GUI for the UCI chess engine with the same name.
+  Copyright (C) 2004-2011 Marco Costalba, Joona Kiiski, Tord Romstad
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+////
+//// Includes
+////
+
+#include <ctype.h>
+#include <string.h>
+
+#include "pgnquery.h"
+
+
+////
+//// Local definitions
+////
+
+typedef struct query_state_t {
+  const pgn_query_t *query;
+  bool found;
+} query_state_t;
+
+static void check_position(const position_t *pos, int ply, void *context);
+static bool material_matches(const pgn_query_t *query, const position_t *pos);
+static bool tag_matches(const pgn_game_t *game, const char *name,
+                        const char *value);
+static bool contains(const char *text, int length, const char *string);
+
+
+////
+//// Functions
+////
+
+void pgn_query_init(pgn_query_t *query) {
+  memset(query, 0, sizeof(pgn_query_t));
+}
+
+
+// Adds a condition on a tag, or on any tag if the name is empty. Returns
+// false if the query has no room for more tag conditions.
+
+bool pgn_query_add_tag(pgn_query_t *query, const char *name,
+                       const char *value) {
+  int i = query->tag_count;
+
+  if(i >= PGN_QUERY_MAX_TAGS) return false;
+  strncpy(query->tag_names[i], name, PGN_QUERY_STRING_SIZE - 1);
+  query->tag_names[i][PGN_QUERY_STRING_SIZE - 1] = '\0';
+  strncpy(query->tag_values[i], value, PGN_QUERY_STRING_SIZE - 1);
+  query->tag_values[i][PGN_QUERY_STRING_SIZE - 1] = '\0';
+  query->tag_count++;
+  return true;
+}
+
+
+void pgn_query_set_position(pgn_query_t *query, const position_t *pos) {
+  query->has_position = true;
+  query->key = pos->key;
+}
+
+
+void pgn_query_set_material(pgn_query_t *query, const position_t *pos) {
+  int side, type;
+
+  query->has_material = true;
+  for(side = WHITE; side <= BLACK; side++)
+    for(type = PAWN; type < KING; type++)
+      query->piece_count[side][type] = pos->piece_count[side][type];
+}
+
+
+bool pgn_query_is_empty(const pgn_query_t *query) {
+  return query->tag_count == 0 && !query->has_position &&
+    !query->has_material;
+}
+
+
+// Replays the game in 'text' into 'game' and tells whether it matches the
+// query.
+
+bool pgn_query_match(const pgn_query_t *query, const char *text,
+                     long length, pgn_game_t *game) {
+  query_state_t state;
+  int i;
+
+  state.query = query;
+  state.found = !query->has_position && !query->has_material;
+  game->tag_count = 0;
+  pgn_replay_positions(text, length, game,
+                       state.found? NULL : check_position, &state);
+  for(i = 0; i < query->tag_count; i++)
+    if(!tag_matches(game, query->tag_names[i], query->tag_values[i]))
+      return false;
+  return state.found;
+}
+
+
+static void check_position(const position_t *pos, int ply, void *context) {
+  query_state_t *state = context;
+  const pgn_query_t *query = state->query;
+
+  if(state->found) return;
+  if(query->has_position && pos->key != query->key) return;
+  if(query->has_material && !material_matches(query, pos)) return;
+  state->found = true;
+}
+
+
+static bool material_matches(const pgn_query_t *query, const position_t *pos) {
+  int side, type;
+
+  for(side = WHITE; side <= BLACK; side++)
+    for(type = PAWN; type < KING; type++)
+      if(pos->piece_count[side][type] != query->piece_count[side][type])
+        return false;
+  return true;
+}
+
+
+static bool tag_matches(const pgn_game_t *game, const char *name,
+                        const char *value) {
+  const char *tag;
+  int i, length;
+
+  if(name[0] != '\0') {
+    tag = pgn_tag_value(game, name, &length);
+    return tag != NULL && contains(tag, length, value);
+  }
+  for(i = 0; i < game->tag_count; i++)
+    if(contains(game->tags[i].value, game->tags[i].value_length, value))
+      return true;
+  return false;
+}
+
+
+// Whether the first 'length' characters of 'text' contain 'string',
+// ignoring case.
+
+static bool contains(const char *text, int length, const char *string) {
+  int n = strlen(string), i, j;
+
+  for(i = 0; i + n <= length; i++) {
+    for(j = 0; j < n; j++)
+      if(tolower((unsigned char)text[i + j]) !=
+         tolower((unsigned char)string[j]))
+        break;
+    if(j == n) return true;
+  }
+  return false;
+}
@@ -0,0 +1,161 @@
+/*
+  Stockfish, a OS X GUI for the UCI chess engine with the same name.
+  Copyright (C) 2004-2011 Marco Costalba, Joona Kiiski, Tord Romstad
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+/*
+  Fast, allocation-free scanning and replaying of PGN files.  Unlike the
+  PGN class, which is built for browsing one game at a time, the functions
+  in this file are meant for tools that have to walk through every game in
+  a (possibly huge) file: duplicate detection, data export and similar.
+  pgn_parse_tree() also reads a single game with all its variations into
+  a compact tree, which the Game class uses to load games quickly.
+  Everything here is plain C and thread safe, as long as each thread uses
+  its own pgn_game_t or pgn_tree_t.
+*/
+
+
+#if !defined(PGNSCAN_H_INCLUDED)
+#define PGNSCAN_H_INCLUDED
+
+////
+//// Includes
+////
+
+#include "position.h"
+
+
+////
+//// Constants and macros
+////
+
+#define PGN_MAX_TAGS 32
+
+enum {
+  PGN_OK = 0, PGN_ERROR_SYNTAX, PGN_ERROR_FEN, PGN_ERROR_ILLEGAL_MOVE,
+  PGN_ERROR_TOO_LONG, PGN_ERROR_MEMORY
+};
+
+
+////
+//// Types
+////
+
+typedef struct pgn_tag_t {
+  const char *name, *value;
+  int name_length, value_length;
+} pgn_tag_t;
+
+typedef struct pgn_ply_t {
+  move_t move;
+  int nag;
+  const char *comment;
+  int comment_length;
+} pgn_ply_t;
+
+// A replayed game.  All string pointers point into the text the game was
+// replayed from, and are only valid as long as that text is.  'start' is
+// the initial position, 'pos' the position after the last mainline move.
+// Because make_move() records the key of every position it leaves,
+// pos->previous_keys[0 .. plies-1] contain the keys of all positions before
+// the final one.
+
+typedef struct pgn_game_t {
+  int tag_count;
+  pgn_tag_t tags[PGN_MAX_TAGS];
+  result_t result;
+  int plies;
+  pgn_ply_t ply[MAX_GAME_LENGTH];
+  position_t start[1];
+  position_t pos[1];
+} pgn_game_t;
+
+// A game with variations, stored as an array of nodes linked by index.
+// nodes[0] is the root, which has no move. Comments are copied into 'text',
+// so that a tree stays valid after the text it was parsed from is gone.
+// Tag names and values still point into that text, though. All arrays grow
+// as needed and are reused when the tree is parsed into again.
+
+typedef struct pgn_tree_node_t {
+  move_t move;
+  int nag;
+  int comment;           // Offset of the comment in 'text', or -1
+  int comment_length;
+  int parent;            // Index of the parent, or -1 for the root
+  int first_child;       // Index of the first child, or -1
+  int next_sibling;      // Index of the next sibling, or -1
+} pgn_tree_node_t;
+
+typedef struct pgn_tree_frame_t pgn_tree_frame_t;
+
+typedef struct pgn_tree_t {
+  int tag_count;
+  pgn_tag_t tags[PGN_MAX_TAGS];
+  result_t result;
+  position_t start[1];
+  pgn_tree_node_t *nodes;
+  int node_count, node_capacity;
+  char *text;
+  int text_length, text_capacity;
+  pgn_tree_frame_t *frames;  // One per variation nesting level
+  int frame_capacity;
+} pgn_tree_t;
+
+// Called once for each game found while scanning a file.  'text' points to
+// 'length' bytes starting with the first tag of the game, 'offset' is the
+// file offset of the same byte, and 'number' counts the games seen by the
+// calling scanner, starting from 0.  A non-zero return value stops the
+// scan.
+
+typedef int (*pgn_game_callback_t)(const char *text, long length,
+                                   off_t offset, long number, void *context);
+
+// Called by pgn_replay_positions() for each position of the mainline, with
+// the number of plies played before it, starting with the initial position
+// and ending with the position after the last move.
+
+typedef void (*pgn_position_callback_t)(const position_t *pos, int ply,
+                                        void *context);
+
+
+////
+//// Functions
+////
+
+extern int pgn_cpu_count(void);
+extern const char *pgn_game_end(const char *text, const char *end, bool eof);
+extern int pgn_replay_game(const char *text, long length, pgn_game_t *game);
+extern int pgn_replay_positions(const char *text, long length,
+                                pgn_game_t *game,
+                                pgn_position_callback_t callback,
+                                void *context);
+extern void pgn_tree_init(pgn_tree_t *tree);
+extern void pgn_tree_free(pgn_tree_t *tree);
+extern int pgn_parse_tree(const char *text, long length, pgn_tree_t *tree);
+extern const char *pgn_tag_value(const pgn_game_t *game, const char *name,
+                                 int *length);
+extern hashkey_t pgn_game_signature(const pgn_game_t *game);
+extern int pgn_split_file(int fd, off_t size, int count, off_t bounds[]);
+extern int pgn_scan_range(int fd, off_t start, off_t stop, off_t size,
+                          pgn_game_callback_t callback, void *context,
+                          long *games, volatile int64_t *progress);
+extern int pgn_scan_file(const char *filename, int threads,
+                         pgn_game_callback_t callback, void *contexts[],
+                         long games[], volatile int64_t *progress);
+
+
+#endif // !defined(PGNSCAN_H_INCLUDED)
@@ -0,0 +1,896 @@
+/*
+  Stockfish, a OS X GUI for the UCI chess engine with the same name.
+  Copyright (C) 2004-2011 Marco Costalba, Joona Kiiski, Tord Romstad
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+////
+//// Includes
+////
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <libkern/OSAtomic.h>
+
+#include "pgnscan.h"
+
+
+////
+//// Local definitions
+////
+
+enum {
+  TOKEN_EOF = 256, TOKEN_SYMBOL, TOKEN_STRING, TOKEN_INTEGER, TOKEN_NAG,
+  TOKEN_RESULT, TOKEN_COMMENT, TOKEN_INCOMPLETE, TOKEN_ERROR
+};
+
+// The lexer works directly on a memory buffer and never copies anything.
+// 'eof' tells whether the end of the buffer is also the end of the input;
+// if it isn't, tokens running into the end of the buffer are reported as
+// TOKEN_INCOMPLETE so that the caller can read more data and try again.
+
+typedef struct lexer_t {
+  const char *begin, *p, *end;
+  bool eof;
+  int type;
+  const char *token;
+  int length;
+} lexer_t;
+
+typedef struct scan_job_t {
+  int fd;
+  off_t start, stop, size;
+  pgn_game_callback_t callback;
+  void *context;
+  long *games;
+  volatile int64_t *progress;
+  bool started;
+  int result;
+} scan_job_t;
+
+// The state of pgn_parse_tree() at one level of variation nesting: the
+// current position, the node the next move is added to, and the undo
+// information of the last move, for starting a variation before it.
+
+struct pgn_tree_frame_t {
+  position_t pos[1];
+  int node;
+  bool moved;
+  undo_info_t undo[1];
+};
+
+static const int InitialBufferSize = 4 * 1024 * 1024;
+static const int SplitWindowSize = 256 * 1024;
+
+static void lexer_init(lexer_t *lexer, const char *text, const char *end,
+                       bool eof);
+static int lexer_next(lexer_t *lexer);
+static bool skip_line(lexer_t *lexer);
+static int read_tags(lexer_t *lexer, pgn_tag_t tags[], int *count, int *type);
+static int setup_start(const pgn_tag_t tags[], int count, position_t *pos);
+static move_t parse_move_token(const lexer_t *lexer, position_t *pos);
+static int tree_add_node(pgn_tree_t *tree, int parent, move_t move);
+static int tree_add_comment(pgn_tree_t *tree, int node, const char *comment,
+                            int length);
+static pgn_tree_frame_t *tree_frame(pgn_tree_t *tree, int depth);
+static bool is_symbol_start(int c);
+static bool is_symbol_next(int c);
+static result_t result_from_string(const char *str, int length);
+static off_t find_game_start(int fd, off_t from, off_t size);
+static void *scan_thread(void *arg);
+
+
+////
+//// Functions
+////
+
+// pgn_cpu_count() returns the number of processors available, for use as
+// the default number of worker threads.
+
+int pgn_cpu_count(void) {
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  return n < 1 ? 1 : (int)n;
+}
+
+
+// pgn_game_end() finds the end of the game starting at 'text'. The game
+// ends just after its result token, or at the start of the next game if
+// the result is missing. If the buffer ends before the game does and 'eof'
+// is false, NULL is returned.
+
+const char *pgn_game_end(const char *text, const char *end, bool eof) {
+  lexer_t lexer[1];
+  int depth = 0;
+  bool in_tag = false, in_moves = false;
+
+  lexer_init(lexer, text, end, eof);
+  while(true) {
+    switch(lexer_next(lexer)) {
+    case TOKEN_INCOMPLETE:
+      return NULL;
+    case TOKEN_EOF:
+      return end;
+    case '[':
+      if(in_moves && depth == 0) return lexer->token;
+      in_tag = true;
+      break;
+    case ']':
+      in_tag = false;
+      break;
+    case '(':
+      in_moves = true; depth++;
+      break;
+    case ')':
+      if(depth > 0) depth--;
+      break;
+    case TOKEN_RESULT:
+      if(depth == 0) return lexer->p;
+      break;
+    case TOKEN_STRING:
+      break;
+    default:
+      if(!in_tag) in_moves = true;
+      break;
+    }
+  }
+}
+
+
+// pgn_replay_game() parses the tags of a game and plays through its
+// mainline, filling in 'game'. Variations are skipped; of the NAGs and
+// comments following a mainline move, the first one of each kind is kept.
+// The return value is PGN_OK or one of the PGN_ERROR_* codes; on errors,
+// 'game' describes the game up to the point where the error was found.
+
+int pgn_replay_game(const char *text, long length, pgn_game_t *game) {
+  return pgn_replay_positions(text, length, game, NULL, NULL);
+}
+
+
+// pgn_replay_positions() is pgn_replay_game(), which also passes every
+// mainline position to 'callback' (if not NULL) while the game is
+// replayed. The final position is only passed on if the whole game could
+// be replayed.
+
+int pgn_replay_positions(const char *text, long length, pgn_game_t *game,
+                         pgn_position_callback_t callback, void *context) {
+  lexer_t lexer[1];
+  undo_info_t u[1];
+  int depth = 0, type, error;
+  bool result_token = false;
+
+  game->result = UNKNOWN;
+  game->plies = 0;
+
+  lexer_init(lexer, text, text + length, true);
+  if((error = read_tags(lexer, game->tags, &game->tag_count, &type)) != PGN_OK)
+    return error;
+  if((error = setup_start(game->tags, game->tag_count, game->start)) != PGN_OK)
+    return error;
+  copy_position(game->pos, game->start);
+
+  // Movetext
+  for( ; type != TOKEN_EOF && type != '['; type = lexer_next(lexer)) {
+    if(false) {
+    } else if(type == '(') {
+      depth++;
+    } else if(type == ')') {
+      if(depth == 0) return PGN_ERROR_SYNTAX;
+      depth--;
+    } else if(type == TOKEN_RESULT) {
+      if(depth == 0) {
+        game->result = result_from_string(lexer->token, lexer->length);
+        result_token = true;
+        break;
+      }
+    } else if(depth > 0) {
+      // Anything inside a variation is skipped
+    } else if(type == TOKEN_NAG) {
+      if(game->plies > 0 && game->ply[game->plies - 1].nag == 0)
+        game->ply[game->plies - 1].nag = atoi(lexer->token);
+    } else if(type == TOKEN_COMMENT) {
+      if(game->plies > 0 && game->ply[game->plies - 1].comment == NULL) {
+        game->ply[game->plies - 1].comment = lexer->token;
+        game->ply[game->plies - 1].comment_length = lexer->length;
+      }
+    } else if(type == TOKEN_SYMBOL) {
+      pgn_ply_t *ply;
+      move_t move;
+
+      if(game->plies >= MAX_GAME_LENGTH - 1) return PGN_ERROR_TOO_LONG;
+      if((move = parse_move_token(lexer, game->pos)) == 0)
+        return PGN_ERROR_ILLEGAL_MOVE;
+      if(callback != NULL)
+        callback(game->pos, game->plies, context);
+      make_move(game->pos, move, u);
+
+      ply = game->ply + game->plies++;
+      ply->move = move;
+      ply->nag = 0;
+      ply->comment = NULL;
+      ply->comment_length = 0;
+    }
+    // Move numbers, dots and unknown characters are ignored
+  }
+
+  // No result token, use the Result tag instead
+  if(!result_token) {
+    const char *value;
+    int value_length;
+    if((value = pgn_tag_value(game, "Result", &value_length)) != NULL)
+      game->result = result_from_string(value, value_length);
+  }
+  if(callback != NULL)
+    callback(game->pos, game->plies, context);
+  return PGN_OK;
+}
+
+
+// pgn_tree_init() prepares a tree for pgn_parse_tree(), and
+// pgn_tree_free() releases the memory used by a tree.
+
+void pgn_tree_init(pgn_tree_t *tree) {
+  tree->tag_count = 0;
+  tree->result = UNKNOWN;
+  tree->nodes = NULL;
+  tree->node_count = tree->node_capacity = 0;
+  tree->text = NULL;
+  tree->text_length = tree->text_capacity = 0;
+  tree->frames = NULL;
+  tree->frame_capacity = 0;
+}
+
+
+void pgn_tree_free(pgn_tree_t *tree) {
+  free(tree->nodes);
+  free(tree->text);
+  free(tree->frames);
+  pgn_tree_init(tree);
+}
+
+
+// pgn_parse_tree() parses one game with all its variations, comments and
+// NAGs into 'tree'. Several comments after the same move are joined, and
+// of several NAGs the last one is kept. Returns PGN_OK or one of the
+// PGN_ERROR_* codes.
+
+int pgn_parse_tree(const char *text, long length, pgn_tree_t *tree) {
+  lexer_t lexer[1];
+  pgn_tree_frame_t *frame, *outer;
+  move_t move;
+  int depth = 0, type, error, i;
+
+  tree->result = UNKNOWN;
+  tree->node_count = 0;
+  tree->text_length = 0;
+
+  lexer_init(lexer, text, text + length, true);
+  if((error = read_tags(lexer, tree->tags, &tree->tag_count, &type)) != PGN_OK)
+    return error;
+  if((error = setup_start(tree->tags, tree->tag_count, tree->start)) != PGN_OK)
+    return error;
+  if(tree_add_node(tree, -1, 0) < 0 || (frame = tree_frame(tree, 0)) == NULL)
+    return PGN_ERROR_MEMORY;
+  copy_position(frame->pos, tree->start);
+  frame->node = 0;
+  frame->moved = false;
+
+  for( ; type != TOKEN_EOF && type != '['; type = lexer_next(lexer)) {
+    if(false) {
+    } else if(type == '(') {
+      // The variation replaces the last move of the enclosing line:
+      if(!tree->frames[depth].moved) return PGN_ERROR_SYNTAX;
+      if((frame = tree_frame(tree, depth + 1)) == NULL)
+        return PGN_ERROR_MEMORY;
+      outer = tree->frames + depth;
+      copy_position(frame->pos, outer->pos);
+      unmake_move(frame->pos, tree->nodes[outer->node].move, outer->undo);
+      frame->node = tree->nodes[outer->node].parent;
+      frame->moved = false;
+      depth++;
+    } else if(type == ')') {
+      if(depth == 0) return PGN_ERROR_SYNTAX;
+      depth--;
+    } else if(type == TOKEN_RESULT) {
+      if(depth == 0) {
+        tree->result = result_from_string(lexer->token, lexer->length);
+        return PGN_OK;
+      }
+    } else if(type == TOKEN_NAG) {
+      if(tree->frames[depth].node > 0)
+        tree->nodes[tree->frames[depth].node].nag = atoi(lexer->token);
+    } else if(type == TOKEN_COMMENT) {
+      // Comments before the first move of the game are dropped
+      if(tree->frames[depth].node > 0 &&
+         tree_add_comment(tree, tree->frames[depth].node, lexer->token,
+                          lexer->length) != 0)
+        return PGN_ERROR_MEMORY;
+    } else if(type == TOKEN_SYMBOL) {
+      frame = tree->frames + depth;
+      if(frame->pos->gply >= MAX_GAME_LENGTH - 1) return PGN_ERROR_TOO_LONG;
+      if((move = parse_move_token(lexer, frame->pos)) == 0)
+        return PGN_ERROR_ILLEGAL_MOVE;
+      make_move(frame->pos, move, frame->undo);
+      frame->moved = true;
+      if((frame->node = tree_add_node(tree, frame->node, move)) < 0)
+        return PGN_ERROR_MEMORY;
+    }
+    // Move numbers, dots and unknown characters are ignored
+  }
+
+  // No result token, use the Result tag instead
+  for(i = 0; i < tree->tag_count; i++)
+    if(tree->tags[i].name_length == 6 &&
+       strncmp(tree->tags[i].name, "Result", 6) == 0)
+      tree->result = result_from_string(tree->tags[i].value,
+                                        tree->tags[i].value_length);
+  return PGN_OK;
+}
+
+
+// pgn_tag_value() looks up a tag of a replayed game. The returned string
+// is not null-terminated; its length is stored in 'length'. NULL is
+// returned if the game has no such tag.
+
+const char *pgn_tag_value(const pgn_game_t *game, const char *name,
+                          int *length) {
+  int i, n = strlen(name);
+  for(i = 0; i < game->tag_count; i++)
+    if(game->tags[i].name_length == n &&
+       strncmp(game->tags[i].name, name, n) == 0) {
+      *length = game->tags[i].value_length;
+      return game->tags[i].value;
+    }
+  return NULL;
+}
+
+
+// pgn_game_signature() computes a rolling hash over the keys of all
+// positions in the mainline of a replayed game. Games with the same
+// signature almost certainly have the same moves.
+
+hashkey_t pgn_game_signature(const pgn_game_t *game) {
+  hashkey_t h = 0;
+  int i;
+  for(i = 0; i < game->plies; i++)
+    h = h * 0x9E3779B97F4A7C15ULL + game->pos->previous_keys[i];
+  return h * 0x9E3779B97F4A7C15ULL + game->pos->key;
+}
+
+
+// pgn_split_file() divides a PGN file into 'count' byte ranges which can
+// be scanned independently. bounds[i] and bounds[i+1] delimit range i, and
+// every boundary except the last one is the start of a game.
+
+int pgn_split_file(int fd, off_t size, int count, off_t bounds[]) {
+  int i;
+  bounds[0] = 0;
+  for(i = 1; i < count; i++) {
+    off_t target = (size / count) * i;
+    if(target < bounds[i-1]) target = bounds[i-1];
+    bounds[i] = find_game_start(fd, target, size);
+    if(bounds[i] < 0) return -1;
+  }
+  bounds[count] = size;
+  return 0;
+}
+
+
+// pgn_scan_range() calls 'callback' for every game starting at or after
+// the offset 'start' and before the offset 'stop'. 'start' must be the
+// start of a game. The file is read in large blocks with pread(), so that
+// several threads can scan different ranges of the same file descriptor.
+// The number of games found is stored in 'games', and the number of bytes
+// consumed is added to 'progress' as the scan proceeds.
+
+int pgn_scan_range(int fd, off_t start, off_t stop, off_t size,
+                   pgn_game_callback_t callback, void *context,
+                   long *games, volatile int64_t *progress) {
+  char *buffer;
+  long capacity = InitialBufferSize, length = 0, number = 0;
+  off_t offset = start; // File offset of buffer[0]
+  bool eof = false;
+  int result = 0;
+
+  if((buffer = malloc(capacity)) == NULL) return -1;
+
+  while(!eof && offset < stop) {
+    const char *p, *end, *next;
+    ssize_t n;
+
+    // Fill the buffer
+    n = pread(fd, buffer + length, capacity - length, offset + length);
+    if(n < 0) {
+      if(errno == EINTR) continue;
+      result = -1; break;
+    }
+    length += n;
+    eof = (n == 0 || offset + length >= size);
+
+    // Process all complete games in the buffer
+    p = buffer; end = buffer + length;
+    while(p < end) {
+      while(p < end && isspace((unsigned char)*p)) p++;
+      if(p == end || offset + (p - buffer) >= stop) break;
+      if((next = pgn_game_end(p, end, eof)) == NULL) break;
+      if(next > p) {
+        if((result = callback(p, next - p, offset + (p - buffer), number,
+                              context)) != 0)
+          goto done;
+        number++;
+      }
+      else next = p + 1;
+      p = next;
+    }
+    if(progress != NULL) OSAtomicAdd64(p - buffer, progress);
+    if(offset + (p - buffer) >= stop) break;
+
+    // Keep the unprocessed tail, and make room for more data
+    length -= p - buffer;
+    memmove(buffer, p, length);
+    offset += p - buffer;
+    if(length == capacity) {
+      char *b;
+      capacity *= 2;
+      if((b = realloc(buffer, capacity)) == NULL) {
+        result = -1; break;
+      }
+      buffer = b;
+    }
+  }
+
+ done:
+  free(buffer);
+  if(games != NULL) *games = number;
+  return result;
+}
+
+
+// pgn_scan_file() scans a PGN file using 'threads' worker threads, each of
+// which scans its own part of the file. Worker i passes contexts[i] to the
+// callback, and stores the number of games it found in games[i]; game
+// numbers passed to the callback are local to each worker, so the global
+// number of a game is its local number plus the counts of all workers
+// before it. Returns 0 on success, and -1 with errno set on I/O errors.
+// Any other non-zero value is a value returned by the callback.
+
+int pgn_scan_file(const char *filename, int threads,
+                  pgn_game_callback_t callback, void *contexts[],
+                  long games[], volatile int64_t *progress) {
+  struct stat fs;
+  scan_job_t *jobs;
+  pthread_t *tids;
+  off_t *bounds;
+  int fd, i, result = 0;
+
+  if((fd = open(filename, O_RDONLY)) < 0) return -1;
+  if(fstat(fd, &fs) < 0) {
+    close(fd); return -1;
+  }
+
+  jobs = malloc(threads * sizeof(scan_job_t));
+  tids = malloc(threads * sizeof(pthread_t));
+  bounds = malloc((threads + 1) * sizeof(off_t));
+  if(jobs == NULL || tids == NULL || bounds == NULL ||
+     pgn_split_file(fd, fs.st_size, threads, bounds) != 0) {
+    free(jobs); free(tids); free(bounds);
+    close(fd);
+    return -1;
+  }
+
+  for(i = 0; i < threads; i++) {
+    jobs[i].fd = fd;
+    jobs[i].start = bounds[i];
+    jobs[i].stop = bounds[i+1];
+    jobs[i].size = fs.st_size;
+    jobs[i].callback = callback;
+    jobs[i].context = contexts[i];
+    jobs[i].games = games + i;
+    jobs[i].progress = progress;
+    jobs[i].result = 0;
+    games[i] = 0;
+  }
+  for(i = 1; i < threads; i++) {
+    jobs[i].started = (pthread_create(tids + i, NULL, scan_thread, jobs + i) == 0);
+    if(!jobs[i].started) jobs[i].result = -1;
+  }
+  scan_thread(jobs);
+  for(i = 1; i < threads; i++)
+    if(jobs[i].started) pthread_join(tids[i], NULL);
+
+  for(i = 0; i < threads && result == 0; i++)
+    result = jobs[i].result;
+
+  free(jobs); free(tids); free(bounds);
+  close(fd);
+  return result;
+}
+
+
+static void *scan_thread(void *arg) {
+  scan_job_t *job = arg;
+  job->result = pgn_scan_range(job->fd, job->start, job->stop, job->size,
+                               job->callback, job->context, job->games,
+                               job->progress);
+  return NULL;
+}
+
+
+static void lexer_init(lexer_t *lexer, const char *text, const char *end,
+                       bool eof) {
+  lexer->begin = lexer->p = text;
+  lexer->end = end;
+  lexer->eof = eof;
+  lexer->type = TOKEN_ERROR;
+  lexer->token = text;
+  lexer->length = 0;
+}
+
+
+static int lexer_next(lexer_t *lexer) {
+  const char *p, *end = lexer->end;
+
+  // Skip white space, escaped lines and ';' comments
+  while(true) {
+    p = lexer->p;
+    if(p == end) {
+      lexer->token = p; lexer->length = 0;
+      return lexer->type = lexer->eof ? TOKEN_EOF : TOKEN_INCOMPLETE;
+    }
+    if(isspace((unsigned char)*p)) lexer->p++;
+    else if(*p == ';' || (*p == '%' && (p == lexer->begin || p[-1] == '\n'))) {
+      if(!skip_line(lexer)) return lexer->type = TOKEN_INCOMPLETE;
+    }
+    else break;
+  }
+
+  lexer->token = p;
+  lexer->length = 1;
+
+  if(*p != '\0' && strchr(".[]()<>", *p) != NULL) {
+    lexer->p = p + 1;
+    return lexer->type = *p;
+  }
+  if(*p == '*') {
+    lexer->p = p + 1;
+    return lexer->type = TOKEN_RESULT;
+  }
+  if(*p == '{') {
+    const char *q = memchr(p + 1, '}', end - p - 1);
+    if(q == NULL) {
+      if(!lexer->eof) return lexer->type = TOKEN_INCOMPLETE;
+      q = end; // Unterminated comment, extend it to the end of the game
+    }
+    lexer->token = p + 1;
+    lexer->length = q - p - 1;
+    lexer->p = q < end ? q + 1 : q;
+    return lexer->type = TOKEN_COMMENT;
+  }
+  if(*p == '"') {
+    const char *q;
+    for(q = p + 1; q < end && *q != '"'; q++)
+      if(*q == '\\' && q + 1 < end) q++;
+    if(q >= end) {
+      if(!lexer->eof) return lexer->type = TOKEN_INCOMPLETE;
+      q = end;
+    }
+    lexer->token = p + 1;
+    lexer->length = q - p - 1;
+    lexer->p = q < end ? q + 1 : q;
+    return lexer->type = TOKEN_STRING;
+  }
+  if(*p == '$') {
+    const char *q;
+    for(q = p + 1; q < end && isdigit((unsigned char)*q); q++);
+    if(q == end && !lexer->eof) return lexer->type = TOKEN_INCOMPLETE;
+    lexer->token = p + 1;
+    lexer->length = q - p - 1;
+    lexer->p = q;
+    return lexer->type = (q > p + 1)? TOKEN_NAG : TOKEN_ERROR;
+  }
+  if(*p == '!' || *p == '?') {
+    // Traditional annotation symbols, translated to NAGs
+    static const char *nags[2][3] = {{"1", "3", "5"}, {"2", "6", "4"}};
+    int i = (*p == '?'), j = 0;
+    if(p + 1 == end && !lexer->eof) return lexer->type = TOKEN_INCOMPLETE;
+    if(p + 1 < end && p[1] == '!') j = 1;
+    else if(p + 1 < end && p[1] == '?') j = 2;
+    lexer->token = nags[i][j];
+    lexer->length = 1;
+    lexer->p = p + (j ? 2 : 1);
+    return lexer->type = TOKEN_NAG;
+  }
+  if(is_symbol_start((unsigned char)*p)) {
+    const char *q;
+    bool digits = true;
+    for(q = p; q < end && is_symbol_next((unsigned char)*q); q++)
+      if(!isdigit((unsigned char)*q)) digits = false;
+    if(q == end && !lexer->eof) return lexer->type = TOKEN_INCOMPLETE;
+    lexer->length = q - p;
+    lexer->p = q;
+    if(digits) return lexer->type = TOKEN_INTEGER;
+    if(result_from_string(p, q - p) != UNKNOWN)
+      return lexer->type = TOKEN_RESULT;
+    return lexer->type = TOKEN_SYMBOL;
+  }
+
+  // Unknown character
+  lexer->p = p + 1;
+  return lexer->type = TOKEN_ERROR;
+}
+
+
+// read_tags() reads the tag pairs at the start of a game. 'type' is set to
+// the first token after them.
+
+static int read_tags(lexer_t *lexer, pgn_tag_t tags[], int *count, int *type) {
+  pgn_tag_t *tag;
+
+  *count = 0;
+  while((*type = lexer_next(lexer)) == '[') {
+    tag = tags + *count;
+    if(lexer_next(lexer) != TOKEN_SYMBOL) return PGN_ERROR_SYNTAX;
+    tag->name = lexer->token; tag->name_length = lexer->length;
+    if(lexer_next(lexer) != TOKEN_STRING) return PGN_ERROR_SYNTAX;
+    tag->value = lexer->token; tag->value_length = lexer->length;
+    if(lexer_next(lexer) != ']') return PGN_ERROR_SYNTAX;
+    if(*count < PGN_MAX_TAGS - 1) (*count)++;
+  }
+  return PGN_OK;
+}
+
+
+// setup_start() sets up the initial position of a game, given by its FEN
+// tag or the standard starting position if there is none.
+
+static int setup_start(const pgn_tag_t tags[], int count, position_t *pos) {
+  char fenstr[256];
+  int i, sq, kings = 0;
+
+  for(i = 0; i < count; i++)
+    if(tags[i].name_length == 3 && strncmp(tags[i].name, "FEN", 3) == 0)
+      break;
+  if(i == count) {
+    position_from_fen(pos, STARTPOS);
+    return PGN_OK;
+  }
+  if(tags[i].value_length >= 256) return PGN_ERROR_FEN;
+  memcpy(fenstr, tags[i].value, tags[i].value_length);
+  fenstr[tags[i].value_length] = '\0';
+  position_from_fen(pos, fenstr);
+  for(sq = A1; sq <= H8; sq++)
+    if(!(sq & 0x88) && PieceIsKing(pos->board[sq])) kings++;
+  return (kings == 2)? PGN_OK : PGN_ERROR_FEN;
+}
+
+
+// parse_move_token() parses the SAN move in the current token, returning 0
+// if it isn't a legal move in 'pos'.
+
+static move_t parse_move_token(const lexer_t *lexer, position_t *pos) {
+  char str[16];
+  int i;
+
+  if(lexer->length >= (int)sizeof(str)) return 0;
+  memcpy(str, lexer->token, lexer->length);
+  str[lexer->length] = '\0';
+  // Some programs write castling moves with zeros
+  if(str[0] == '0')
+    for(i = 0; str[i] == '0' || str[i] == '-'; i++)
+      if(str[i] == '0') str[i] = 'O';
+  return parse_san_move_nocopy(pos, str);
+}
+
+
+// tree_add_node() adds a node with the given move as the last child of
+// 'parent', and returns its index, or -1 if there is no memory.
+
+static int tree_add_node(pgn_tree_t *tree, int parent, move_t move) {
+  pgn_tree_node_t *node;
+  int n = tree->node_count, i;
+
+  if(n == tree->node_capacity) {
+    int capacity = Max(2 * tree->node_capacity, 256);
+    node = realloc(tree->nodes, capacity * sizeof(pgn_tree_node_t));
+    if(node == NULL) return -1;
+    tree->nodes = node;
+    tree->node_capacity = capacity;
+  }
+  node = tree->nodes + n;
+  node->move = move;
+  node->nag = 0;
+  node->comment = -1;
+  node->comment_length = 0;
+  node->parent = parent;
+  node->first_child = node->next_sibling = -1;
+  tree->node_count++;
+
+  if(parent >= 0) {
+    if((i = tree->nodes[parent].first_child) < 0)
+      tree->nodes[parent].first_child = n;
+    else {
+      while(tree->nodes[i].next_sibling >= 0) i = tree->nodes[i].next_sibling;
+      tree->nodes[i].next_sibling = n;
+    }
+  }
+  return n;
+}
+
+
+// tree_add_comment() stores a comment for a node, with line breaks turned
+// into spaces and surrounding white space removed. A second comment for
+// the same node is appended to the first one, which is moved to the end
+// of the text first if necessary.
+
+static int tree_add_comment(pgn_tree_t *tree, int node, const char *comment,
+                            int length) {
+  pgn_tree_node_t *n = tree->nodes + node;
+  int needed, capacity, i;
+  char *p;
+
+  while(length > 0 && isspace((unsigned char)comment[0])) {
+    comment++; length--;
+  }
+  while(length > 0 && isspace((unsigned char)comment[length - 1]))
+    length--;
+  if(length == 0) return 0;
+
+  needed = tree->text_length + length + 1;
+  if(n->comment >= 0 && n->comment + n->comment_length != tree->text_length)
+    needed += n->comment_length;
+  if(needed > tree->text_capacity) {
+    capacity = Max(Max(2 * tree->text_capacity, needed), 4096);
+    if((p = realloc(tree->text, capacity)) == NULL) return -1;
+    tree->text = p;
+    tree->text_capacity = capacity;
+  }
+
+  if(n->comment < 0) {
+    n->comment = tree->text_length;
+    n->comment_length = 0;
+  }
+  else {
+    if(n->comment + n->comment_length != tree->text_length) {
+      memcpy(tree->text + tree->text_length, tree->text + n->comment,
+             n->comment_length);
+      n->comment = tree->text_length;
+      tree->text_length += n->comment_length;
+    }
+    tree->text[tree->text_length++] = ' ';
+    n->comment_length++;
+  }
+  p = tree->text + tree->text_length;
+  for(i = 0; i < length; i++)
+    p[i] = (comment[i] == '\n' || comment[i] == '\r')? ' ' : comment[i];
+  tree->text_length += length;
+  n->comment_length += length;
+  return 0;
+}
+
+
+// tree_frame() returns the frame for a nesting level, making room for it
+// if necessary. The board pointer of each position points into the
+// position itself, so it is set again for the frames which have moved.
+
+static pgn_tree_frame_t *tree_frame(pgn_tree_t *tree, int depth) {
+  pgn_tree_frame_t *frames;
+  int capacity, i;
+
+  if(depth >= tree->frame_capacity) {
+    capacity = Max(2 * tree->frame_capacity, 4);
+    frames = realloc(tree->frames, capacity * sizeof(pgn_tree_frame_t));
+    if(frames == NULL) return NULL;
+    for(i = 0; i < capacity; i++)
+      frames[i].pos->board = frames[i].pos->board_ + 64;
+    tree->frames = frames;
+    tree->frame_capacity = capacity;
+  }
+  return tree->frames + depth;
+}
+
+
+static bool skip_line(lexer_t *lexer) {
+  const char *q = memchr(lexer->p, '\n', lexer->end - lexer->p);
+  if(q == NULL) {
+    if(!lexer->eof) return false;
+    lexer->p = lexer->end;
+  }
+  else lexer->p = q + 1;
+  return true;
+}
+
+
+static bool is_symbol_start(int c) {
+  return isalnum(c);
+}
+
+
+static bool is_symbol_next(int c) {
+  return isalnum(c) || (c != '\0' && strchr("_+#=:-/", c) != NULL);
+}
+
+
+static result_t result_from_string(const char *str, int length) {
+  if(length >= 7 && strncmp(str, "1/2-1/2", 7) == 0) return DRAW;
+  if(length >= 3 && strncmp(str, "1-0", 3) == 0) return WHITE_WINS;
+  if(length >= 3 && strncmp(str, "0-1", 3) == 0) return BLACK_WINS;
+  return UNKNOWN;
+}
+
+
+// find_game_start() returns the offset of the first game starting at or
+// after 'from'. A game start is a tag line following either an empty line
+// or a line which is not a tag line.
+
+static off_t find_game_start(int fd, off_t from, off_t size) {
+  char *buffer;
+  bool prev_blank = false, prev_tag = false, have_prev = false;
+  bool skip_partial = (from > 0);
+  off_t result = size;
+
+  if((buffer = malloc(SplitWindowSize)) == NULL) return -1;
+  while(from < size) {
+    ssize_t n = pread(fd, buffer, SplitWindowSize, from);
+    const char *p = buffer, *end, *eol;
+
+    if(n < 0) {
+      if(errno == EINTR) continue;
+      result = -1; break;
+    }
+    if(n == 0) break;
+    end = buffer + n;
+
+    if(skip_partial) {
+      // We may be in the middle of a line
+      if((eol = memchr(p, '\n', end - p)) == NULL) {
+        from += n; continue;
+      }
+      p = eol + 1;
+      skip_partial = false;
+    }
+
+    while(p < end) {
+      const char *q;
+      if((eol = memchr(p, '\n', end - p)) == NULL) {
+        if(from + n < size) break; // Incomplete line, read it again
+        eol = end;
+      }
+      for(q = p; q < eol && isspace((unsigned char)*q); q++);
+      if(q == eol) prev_blank = true;
+      else {
+        if(*p == '[' && p + 1 < eol && isalpha((unsigned char)p[1]) &&
+           (prev_blank || (have_prev && !prev_tag))) {
+          result = from + (p - buffer);
+          goto done;
+        }
+        prev_tag = (*p == '[');
+        prev_blank = false;
+        have_prev = true;
+      }
+      p = eol + 1;
+    }
+    if(p == buffer) {
+      // A single line longer than the window; skip it
+      from += n; skip_partial = true;
+    }
+    else from += p - buffer;
+  }
+
+ done:
+  free(buffer);
+  return result;
+}
@@ -0,0 +1,133 @@
+/*
+  Stockfish, a OS X GUI for the UCI chess engine with the same name.
+  Copyright (C) 2004-2011 Marco Costalba, Joona Kiiski, Tord Romstad
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+/*
+  A buffered, seekable byte source for reading PGN files which may be
+  compressed.  The format is detected from the first bytes of the file:
+
+  - Plain text files are read directly.
+  - gzip files are decompressed on the fly with zlib.  While the file is
+    read, access points are recorded at regular intervals, each with the
+    32 KB of data preceding it, so that seeking only needs to decompress
+    from the nearest access point.  Files consisting of several gzip
+    members are supported, and when the members are BGZF blocks (whose
+    compressed size is stored in the header), batches of members are
+    decompressed in parallel.
+  - zstd files are supported when compiled with HAVE_ZSTD.  Access points
+    are recorded at frame boundaries, and batches of frames are
+    decompressed in parallel.
+
+  Offsets are always offsets in the uncompressed data.
+*/
+
+
+#if !defined(PGNSOURCE_H_INCLUDED)
+#define PGNSOURCE_H_INCLUDED
+
+////
+//// Includes
+////
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+
+////
+//// Constants and macros
+////
+
+enum {
+  PGN_SOURCE_PLAIN, PGN_SOURCE_GZIP, PGN_SOURCE_BGZF, PGN_SOURCE_ZSTD
+};
+
+#define PGN_SOURCE_WINDOW_SIZE 32768
+
+
+////
+//// Types
+////
+
+// An access point in a compressed file. 'in' and 'out' are the compressed
+// and uncompressed offsets of the point. If 'bits' is -1, the point is the
+// start of a gzip member or a zstd frame. Otherwise it is a deflate block
+// boundary in the middle of a gzip member: the first 'bits' bits of the
+// point are in the byte before 'in', and 'window' holds the 32 KB of
+// uncompressed data preceding 'out'.
+
+typedef struct pgn_frame_t {
+  int64_t in, out;
+  int bits;
+  unsigned char *window;
+} pgn_frame_t;
+
+typedef struct pgn_source_t {
+  int fd, format, threads;
+  int64_t size;                  // Size of the file
+  bool eof, error;
+
+  // Uncompressed data. buffer[0] is at uncompressed offset 'offset'.
+  unsigned char *buffer;
+  size_t capacity, length, pos;
+  int64_t offset;
+
+  // Compressed data. input[input_length] is at file offset 'input_offset'.
+  unsigned char *input;
+  size_t input_capacity, input_length, input_pos;
+  int64_t input_offset;
+
+  // Decompressor state
+  void *stream;
+  int stream_mode;
+  bool in_stream;
+  unsigned char *history;        // The last 32 KB of output, circular
+  size_t history_pos;
+
+  // Access points, sorted by offset
+  pgn_frame_t *frames;
+  int frame_count, frame_capacity;
+} pgn_source_t;
+
+
+////
+//// Functions
+////
+
+extern int pgn_source_open(pgn_source_t *src, const char *filename);
+extern void pgn_source_close(pgn_source_t *src);
+extern size_t pgn_source_fill(pgn_source_t *src);
+extern int pgn_source_seek(pgn_source_t *src, int64_t offset);
+extern size_t pgn_source_read(pgn_source_t *src, void *buf, size_t n);
+extern int64_t pgn_source_position(const pgn_source_t *src);
+extern void pgn_source_set_frames(pgn_source_t *src, pgn_frame_t *frames,
+                                  int count);
+
+static inline int pgn_source_getc(pgn_source_t *src) {
+  if(src->pos < src->length || pgn_source_fill(src) > 0)
+    return src->buffer[src->pos++];
+  return EOF;
+}
+
+static inline int64_t pgn_source_tell(const pgn_source_t *src) {
+  return src->offset + src->pos;
+}
+
+
+#endif // !defined(PGNSOURCE_H_INCLUDED)
@@ -0,0 +1,817 @@
+/*
+  Stockfish, a OS X GUI for the UCI chess engine with the same name.
+  Copyright (C) 2004-2011 Marco Costalba, Joona Kiiski, Tord Romstad
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+////
+//// Includes
+////
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <zlib.h>
+#if defined(HAVE_ZSTD)
+#include <zstd.h>
+#endif
+
+#include "pgnscan.h"
+#include "pgnsource.h"
+
+
+////
+//// Local definitions
+////
+
+enum {
+  STREAM_NONE, STREAM_GZIP, STREAM_RAW, STREAM_ZSTD
+};
+
+// A gzip member or zstd frame which is decompressed as a whole by one of
+// the threads of a parallel batch.
+
+typedef struct batch_item_t {
+  const unsigned char *in;
+  size_t in_length;
+  int64_t in_offset;
+  unsigned char *out;
+  size_t out_length;
+  int64_t out_offset;
+} batch_item_t;
+
+typedef struct batch_job_t {
+  int format;
+  batch_item_t *items;
+  int first, count, stride;
+  bool started, failed;
+} batch_job_t;
+
+// Many sources may be open at the same time, so the buffers start small,
+// and the input buffer only grows when batches are decompressed.
+static const size_t BufferSize = 256 * 1024;
+static const size_t InputSize = 256 * 1024;
+static const size_t BatchInputSize = 4 * 1024 * 1024;
+static const size_t MaxBatchOutput = 64 * 1024 * 1024;
+static const int64_t FrameSpan = 4 * 1024 * 1024;
+
+// A batch has a few items per thread, which keeps the threads busy without
+// decompressing much more than needed after a seek.
+#define BATCH_ITEMS_PER_THREAD 8
+#define MAX_BATCH_THREADS 16
+#define MAX_BATCH_ITEMS (BATCH_ITEMS_PER_THREAD * MAX_BATCH_THREADS)
+
+static bool start_stream(pgn_source_t *src, int mode);
+static void end_stream(pgn_source_t *src);
+static size_t read_input(pgn_source_t *src, size_t n);
+static bool grow_input(pgn_source_t *src, size_t size);
+static int64_t input_position(const pgn_source_t *src);
+static void add_history(pgn_source_t *src, const unsigned char *data,
+                        size_t n);
+static void add_frame(pgn_source_t *src, int64_t in, int64_t out, int bits);
+static const pgn_frame_t *find_frame(const pgn_source_t *src, int64_t out);
+static int restart_at_frame(pgn_source_t *src, const pgn_frame_t *frame);
+static void plain_fill(pgn_source_t *src);
+static void gzip_fill(pgn_source_t *src);
+static bool bgzf_batch_fill(pgn_source_t *src);
+#if defined(HAVE_ZSTD)
+static void zstd_fill(pgn_source_t *src);
+static bool zstd_batch_fill(pgn_source_t *src);
+#endif
+static bool run_batch(pgn_source_t *src, batch_item_t *items, int count,
+                      size_t total);
+static void *batch_thread(void *arg);
+static bool decompress_item(int format, batch_item_t *item);
+
+
+////
+//// Functions
+////
+
+// pgn_source_open() opens a file for reading, and detects whether it is
+// compressed. Returns 0 on success and -1 (with errno set) on failure.
+
+int pgn_source_open(pgn_source_t *src, const char *filename) {
+  unsigned char magic[18];
+  struct stat st;
+  ssize_t n;
+
+  memset(src, 0, sizeof(pgn_source_t));
+  src->fd = open(filename, O_RDONLY);
+  if(src->fd < 0)
+    return -1;
+  if(fstat(src->fd, &st) != 0) {
+    close(src->fd);
+    return -1;
+  }
+  src->size = st.st_size;
+  src->threads = Min(pgn_cpu_count(), MAX_BATCH_THREADS);
+
+  n = pread(src->fd, magic, sizeof(magic), 0);
+  if(n >= 2 && magic[0] == 0x1f && magic[1] == 0x8b) {
+    if(n == 18 && (magic[3] & 4) && magic[12] == 'B' && magic[13] == 'C')
+      src->format = PGN_SOURCE_BGZF;
+    else
+      src->format = PGN_SOURCE_GZIP;
+  }
+  else if(n >= 4 && magic[0] == 0x28 && magic[1] == 0xb5 &&
+          magic[2] == 0x2f && magic[3] == 0xfd) {
+#if defined(HAVE_ZSTD)
+    src->format = PGN_SOURCE_ZSTD;
+#else
+    close(src->fd);
+    errno = ENOTSUP;
+    return -1;
+#endif
+  }
+  else
+    src->format = PGN_SOURCE_PLAIN;
+
+  src->capacity = BufferSize;
+  src->buffer = malloc(src->capacity);
+  if(src->format != PGN_SOURCE_PLAIN) {
+    src->input_capacity = InputSize;
+    src->input = malloc(src->input_capacity);
+    src->history = calloc(1, PGN_SOURCE_WINDOW_SIZE);
+    add_frame(src, 0, 0, -1);
+  }
+  if(src->buffer == NULL || (src->format != PGN_SOURCE_PLAIN &&
+     (src->input == NULL || src->history == NULL || src->frame_count == 0))) {
+    pgn_source_close(src);
+    errno = ENOMEM;
+    return -1;
+  }
+  return 0;
+}
+
+
+// pgn_source_close() closes the file and frees all memory used by the
+// source.
+
+void pgn_source_close(pgn_source_t *src) {
+  int i;
+
+  end_stream(src);
+  for(i = 0; i < src->frame_count; i++)
+    free(src->frames[i].window);
+  free(src->frames);
+  free(src->buffer);
+  free(src->input);
+  free(src->history);
+  if(src->fd >= 0)
+    close(src->fd);
+  memset(src, 0, sizeof(pgn_source_t));
+  src->fd = -1;
+}
+
+
+// pgn_source_fill() discards the contents of the buffer and reads the
+// following data into it. Returns the number of bytes read, which is 0 at
+// the end of the file.
+
+size_t pgn_source_fill(pgn_source_t *src) {
+  src->offset += src->length;
+  src->length = src->pos = 0;
+  while(src->length == 0 && !src->eof) {
+    switch(src->format) {
+    case PGN_SOURCE_PLAIN:
+      plain_fill(src); break;
+    case PGN_SOURCE_GZIP: case PGN_SOURCE_BGZF:
+      gzip_fill(src); break;
+#if defined(HAVE_ZSTD)
+    case PGN_SOURCE_ZSTD:
+      zstd_fill(src); break;
+#endif
+    default:
+      src->eof = src->error = true;
+    }
+  }
+  return src->length;
+}
+
+
+// pgn_source_seek() moves to the given uncompressed offset. In compressed
+// files, decompression is restarted from the nearest access point before
+// the offset unless the offset is close ahead of the current position.
+// Returns -1 if the offset can't be reached in a compressed file; in plain
+// files, seeking past the end is only noticed when reading.
+
+int pgn_source_seek(pgn_source_t *src, int64_t offset) {
+  const pgn_frame_t *frame;
+
+  if(src->format == PGN_SOURCE_PLAIN) {
+    // The file may have grown since we last hit its end:
+    src->eof = false;
+    if(offset < src->offset || offset > src->offset + (int64_t)src->length) {
+      src->offset = offset;
+      src->length = 0;
+    }
+    src->pos = offset - src->offset;
+    return 0;
+  }
+
+  if(offset < src->offset) {
+    if(restart_at_frame(src, find_frame(src, offset)) != 0)
+      return -1;
+  }
+  else if(offset > src->offset + (int64_t)src->length) {
+    frame = find_frame(src, offset);
+    if(frame->out > src->offset + (int64_t)src->length &&
+       restart_at_frame(src, frame) != 0)
+      return -1;
+  }
+  while(offset > src->offset + (int64_t)src->length)
+    if(pgn_source_fill(src) == 0)
+      return -1;
+  src->pos = offset - src->offset;
+  return 0;
+}
+
+
+// pgn_source_read() reads up to n bytes, and returns the number of bytes
+// read.
+
+size_t pgn_source_read(pgn_source_t *src, void *buf, size_t n) {
+  size_t done = 0, count;
+
+  while(done < n) {
+    if(src->pos == src->length && pgn_source_fill(src) == 0)
+      break;
+    count = Min(n - done, src->length - src->pos);
+    memcpy((char *)buf + done, src->buffer + src->pos, count);
+    src->pos += count;
+    done += count;
+  }
+  return done;
+}
+
+
+// pgn_source_position() returns the number of bytes of the file read so
+// far, which for compressed files is less than the uncompressed offset.
+// Used for progress indicators.
+
+int64_t pgn_source_position(const pgn_source_t *src) {
+  if(src->format == PGN_SOURCE_PLAIN)
+    return pgn_source_tell(src);
+  return input_position(src);
+}
+
+
+// pgn_source_set_frames() replaces the access points of the source, for
+// instance with access points read from an index file. The source takes
+// ownership of the array and the windows. The first access point must be
+// at the start of the file.
+
+void pgn_source_set_frames(pgn_source_t *src, pgn_frame_t *frames,
+                           int count) {
+  int i;
+
+  for(i = 0; i < src->frame_count; i++)
+    free(src->frames[i].window);
+  free(src->frames);
+  src->frames = frames;
+  src->frame_count = src->frame_capacity = count;
+}
+
+
+static bool start_stream(pgn_source_t *src, int mode) {
+  z_stream *zs;
+
+  if(src->stream_mode == mode && mode != STREAM_ZSTD)
+    return inflateReset(src->stream) == Z_OK;
+#if defined(HAVE_ZSTD)
+  if(src->stream_mode == mode && mode == STREAM_ZSTD)
+    return !ZSTD_isError(ZSTD_initDStream(src->stream));
+#endif
+  end_stream(src);
+  if(mode == STREAM_ZSTD) {
+#if defined(HAVE_ZSTD)
+    ZSTD_DStream *zds = ZSTD_createDStream();
+    if(zds == NULL)
+      return false;
+    if(ZSTD_isError(ZSTD_initDStream(zds))) {
+      ZSTD_freeDStream(zds);
+      return false;
+    }
+    src->stream = zds;
+#else
+    return false;
+#endif
+  }
+  else {
+    zs = calloc(1, sizeof(z_stream));
+    if(zs == NULL)
+      return false;
+    if(inflateInit2(zs, (mode == STREAM_RAW)? -15 : 31) != Z_OK) {
+      free(zs);
+      return false;
+    }
+    src->stream = zs;
+  }
+  src->stream_mode = mode;
+  return true;
+}
+
+
+static void end_stream(pgn_source_t *src) {
+  if(src->stream == NULL)
+    return;
+#if defined(HAVE_ZSTD)
+  if(src->stream_mode == STREAM_ZSTD)
+    ZSTD_freeDStream(src->stream);
+  else
+#endif
+  {
+    inflateEnd(src->stream);
+    free(src->stream);
+  }
+  src->stream = NULL;
+  src->stream_mode = STREAM_NONE;
+  src->in_stream = false;
+}
+
+
+// read_input() makes sure that at least n unconsumed bytes are in the
+// input buffer, unless the end of the file is reached first. Returns the
+// number of unconsumed bytes.
+
+static size_t read_input(pgn_source_t *src, size_t n) {
+  size_t avail = src->input_length - src->input_pos;
+  ssize_t count;
+
+  if(avail >= n)
+    return avail;
+  memmove(src->input, src->input + src->input_pos, avail);
+  src->input_length = avail;
+  src->input_pos = 0;
+  while(src->input_length < n) {
+    count = pread(src->fd, src->input + src->input_length,
+                  src->input_capacity - src->input_length,
+                  src->input_offset);
+    if(count < 0 && errno == EINTR)
+      continue;
+    if(count < 0)
+      src->error = true;
+    if(count <= 0)
+      break;
+    src->input_length += count;
+    src->input_offset += count;
+  }
+  return src->input_length;
+}
+
+
+static bool grow_input(pgn_source_t *src, size_t size) {
+  unsigned char *input;
+
+  if(src->input_capacity >= size)
+    return true;
+  input = realloc(src->input, size);
+  if(input == NULL)
+    return false;
+  src->input = input;
+  src->input_capacity = size;
+  return true;
+}
+
+
+static int64_t input_position(const pgn_source_t *src) {
+  return src->input_offset - (int64_t)(src->input_length - src->input_pos);
+}
+
+
+static void add_history(pgn_source_t *src, const unsigned char *data,
+                        size_t n) {
+  size_t first;
+
+  if(n >= PGN_SOURCE_WINDOW_SIZE) {
+    memcpy(src->history, data + n - PGN_SOURCE_WINDOW_SIZE,
+           PGN_SOURCE_WINDOW_SIZE);
+    src->history_pos = 0;
+    return;
+  }
+  first = Min(n, PGN_SOURCE_WINDOW_SIZE - src->history_pos);
+  memcpy(src->history + src->history_pos, data, first);
+  memcpy(src->history, data + first, n - first);
+  src->history_pos = (src->history_pos + n) % PGN_SOURCE_WINDOW_SIZE;
+}
+
+
+// add_frame() records an access point, unless there already is one less
+// than FrameSpan bytes before it. Access points are optional, so failing
+// to allocate memory for one is not an error.
+
+static void add_frame(pgn_source_t *src, int64_t in, int64_t out, int bits) {
+  pgn_frame_t *frame, *frames;
+  size_t tail;
+
+  if(src->frame_count > 0 &&
+     out < src->frames[src->frame_count - 1].out + FrameSpan)
+    return;
+  if(src->frame_count == src->frame_capacity) {
+    frames = realloc(src->frames, (src->frame_capacity + 64) *
+                     sizeof(pgn_frame_t));
+    if(frames == NULL)
+      return;
+    src->frames = frames;
+    src->frame_capacity += 64;
+  }
+  frame = src->frames + src->frame_count;
+  frame->in = in;
+  frame->out = out;
+  frame->bits = bits;
+  frame->window = NULL;
+  if(bits >= 0) {
+    frame->window = malloc(PGN_SOURCE_WINDOW_SIZE);
+    if(frame->window == NULL)
+      return;
+    tail = PGN_SOURCE_WINDOW_SIZE - src->history_pos;
+    memcpy(frame->window, src->history + src->history_pos, tail);
+    memcpy(frame->window + tail, src->history, src->history_pos);
+  }
+  src->frame_count++;
+}
+
+
+// find_frame() returns the last access point at or before the given
+// uncompressed offset.
+
+static const pgn_frame_t *find_frame(const pgn_source_t *src, int64_t out) {
+  int low = 0, high = src->frame_count - 1, middle;
+
+  while(low < high) {
+    middle = (low + high + 1) / 2;
+    if(src->frames[middle].out <= out)
+      low = middle;
+    else
+      high = middle - 1;
+  }
+  return src->frames + low;
+}
+
+
+static int restart_at_frame(pgn_source_t *src, const pgn_frame_t *frame) {
+  z_stream *zs;
+
+  src->offset = frame->out;
+  src->length = src->pos = 0;
+  src->eof = src->error = false;
+  src->input_offset = frame->in;
+  src->input_length = src->input_pos = 0;
+  src->in_stream = false;
+
+  if(frame->bits >= 0) {
+    // A deflate block boundary inside a gzip member: start a raw inflate
+    // stream with the preceding data as its dictionary.
+    if(!start_stream(src, STREAM_RAW))
+      goto error;
+    zs = src->stream;
+    if(frame->bits > 0) {
+      src->input_offset = frame->in - 1;
+      if(read_input(src, 1) < 1)
+        goto error;
+      inflatePrime(zs, frame->bits,
+                   src->input[src->input_pos++] >> (8 - frame->bits));
+    }
+    if(inflateSetDictionary(zs, frame->window, PGN_SOURCE_WINDOW_SIZE)
+       != Z_OK)
+      goto error;
+    memcpy(src->history, frame->window, PGN_SOURCE_WINDOW_SIZE);
+    src->history_pos = 0;
+    src->in_stream = true;
+  }
+  return 0;
+
+ error:
+  src->eof = src->error = true;
+  return -1;
+}
+
+
+static void plain_fill(pgn_source_t *src) {
+  ssize_t count;
+
+  do
+    count = pread(src->fd, src->buffer, src->capacity, src->offset);
+  while(count < 0 && errno == EINTR);
+  if(count <= 0) {
+    src->eof = true;
+    src->error = (count < 0);
+  }
+  else
+    src->length = count;
+}
+
+
+static void gzip_fill(pgn_source_t *src) {
+  z_stream *zs;
+  size_t space;
+  int ret;
+
+  while(src->length < src->capacity && !src->eof) {
+    if(!src->in_stream) {
+      // At the start of a new gzip member, or at the end of the file.
+      if(read_input(src, 18) < 2 || src->input[src->input_pos] != 0x1f ||
+         src->input[src->input_pos + 1] != 0x8b) {
+        src->eof = true;
+        break;
+      }
+      if(src->format == PGN_SOURCE_BGZF) {
+        if(src->length > 0)
+          break;
+        if(bgzf_batch_fill(src))
+          return;
+      }
+      add_frame(src, input_position(src), src->offset + src->length, -1);
+      if(!start_stream(src, STREAM_GZIP)) {
+        src->eof = src->error = true;
+        break;
+      }
+      src->in_stream = true;
+    }
+    if(src->input_pos == src->input_length && read_input(src, 1) == 0) {
+      // Truncated file
+      src->eof = true;
+      break;
+    }
+
+    zs = src->stream;
+    space = src->capacity - src->length;
+    zs->next_in = src->input + src->input_pos;
+    zs->avail_in = src->input_length - src->input_pos;
+    zs->next_out = src->buffer + src->length;
+    zs->avail_out = space;
+    ret = inflate(zs, Z_BLOCK);
+    add_history(src, src->buffer + src->length, space - zs->avail_out);
+    src->length += space - zs->avail_out;
+    src->input_pos = src->input_length - zs->avail_in;
+
+    if(ret == Z_STREAM_END) {
+      // A raw stream started at an access point doesn't read the gzip
+      // trailer, so we have to skip it ourselves.
+      if(src->stream_mode == STREAM_RAW) {
+        if(read_input(src, 8) < 8) {
+          src->eof = true;
+          break;
+        }
+        src->input_pos += 8;
+      }
+      src->in_stream = false;
+    }
+    else if(ret != Z_OK) {
+      src->eof = src->error = true;
+      break;
+    }
+    else if((zs->data_type & 128) && !(zs->data_type & 64))
+      add_frame(src, input_position(src), src->offset + src->length,
+                zs->data_type & 7);
+  }
+}
+
+
+// bgzf_batch_fill() decompresses the complete BGZF members at the start
+// of the input buffer in parallel. Returns false if there is no such
+// member, in which case the caller falls back to sequential decompression.
+
+static bool bgzf_batch_fill(pgn_source_t *src) {
+  batch_item_t items[MAX_BATCH_ITEMS];
+  const unsigned char *p, *member;
+  size_t avail, used = 0, size, total = 0, isize;
+  int count = 0;
+
+  if(!grow_input(src, BatchInputSize))
+    return false;
+  avail = read_input(src, src->input_capacity / 2);
+  p = src->input + src->input_pos;
+  while(count < src->threads * BATCH_ITEMS_PER_THREAD && avail - used >= 18) {
+    member = p + used;
+    if(member[0] != 0x1f || member[1] != 0x8b || member[2] != 8 ||
+       !(member[3] & 4) || member[12] != 'B' || member[13] != 'C')
+      break;
+    size = (member[16] | (member[17] << 8)) + 1;
+    if(size < 26 || size > avail - used)
+      break;
+    isize = member[size - 4] | (member[size - 3] << 8) |
+      (member[size - 2] << 16) | ((size_t)member[size - 1] << 24);
+    if(total + isize > MaxBatchOutput)
+      break;
+    items[count].in = member;
+    items[count].in_length = size;
+    items[count].in_offset = input_position(src) + used;
+    items[count].out_length = isize;
+    items[count].out_offset = total;
+    used += size;
+    total += isize;
+    count++;
+  }
+  if(count == 0 || !run_batch(src, items, count, total))
+    return false;
+  src->input_pos += used;
+  return true;
+}
+
+
+#if defined(HAVE_ZSTD)
+
+static void zstd_fill(pgn_source_t *src) {
+  ZSTD_inBuffer in;
+  ZSTD_outBuffer out;
+  const unsigned char *p;
+  size_t ret;
+
+  while(src->length < src->capacity && !src->eof) {
+    if(!src->in_stream) {
+      // At the start of a new frame, or at the end of the file. Skippable
+      // frames (such as seek tables) are decompressed like other frames.
+      if(read_input(src, 4) < 4)
+        p = NULL;
+      else
+        p = src->input + src->input_pos;
+      if(p == NULL ||
+         !((p[0] == 0x28 && p[1] == 0xb5 && p[2] == 0x2f && p[3] == 0xfd) ||
+           ((p[0] & 0xf0) == 0x50 && p[1] == 0x2a && p[2] == 0x4d &&
+            p[3] == 0x18))) {
+        src->eof = true;
+        break;
+      }
+      if(src->length > 0)
+        break;
+      if(zstd_batch_fill(src))
+        return;
+      add_frame(src, input_position(src), src->offset + src->length, -1);
+      if(!start_stream(src, STREAM_ZSTD)) {
+        src->eof = src->error = true;
+        break;
+      }
+      src->in_stream = true;
+    }
+    if(src->input_pos == src->input_length && read_input(src, 1) == 0) {
+      src->eof = true;
+      break;
+    }
+
+    in.src = src->input;
+    in.size = src->input_length;
+    in.pos = src->input_pos;
+    out.dst = src->buffer;
+    out.size = src->capacity;
+    out.pos = src->length;
+    ret = ZSTD_decompressStream(src->stream, &out, &in);
+    src->length = out.pos;
+    src->input_pos = in.pos;
+    if(ZSTD_isError(ret)) {
+      src->eof = src->error = true;
+      break;
+    }
+    if(ret == 0)
+      src->in_stream = false;
+  }
+}
+
+
+// zstd_batch_fill() decompresses the complete frames with a known content
+// size at the start of the input buffer in parallel. Returns false if there
+// is no such frame, for instance when the file is a single large frame.
+
+static bool zstd_batch_fill(pgn_source_t *src) {
+  batch_item_t items[MAX_BATCH_ITEMS];
+  const unsigned char *p;
+  size_t avail, used = 0, size, total = 0;
+  unsigned long long content;
+  int count = 0;
+
+  if(!grow_input(src, BatchInputSize))
+    return false;
+  avail = read_input(src, src->input_capacity / 2);
+  p = src->input + src->input_pos;
+  while(count < src->threads * BATCH_ITEMS_PER_THREAD && used < avail) {
+    size = ZSTD_findFrameCompressedSize(p + used, avail - used);
+    if(ZSTD_isError(size))
+      break;
+    content = ZSTD_getFrameContentSize(p + used, avail - used);
+    if(content == ZSTD_CONTENTSIZE_UNKNOWN ||
+       content == ZSTD_CONTENTSIZE_ERROR || total + content > MaxBatchOutput)
+      break;
+    items[count].in = p + used;
+    items[count].in_length = size;
+    items[count].in_offset = input_position(src) + used;
+    items[count].out_length = content;
+    items[count].out_offset = total;
+    used += size;
+    total += content;
+    count++;
+  }
+  if(count == 0 || !run_batch(src, items, count, total))
+    return false;
+  src->input_pos += used;
+  return true;
+}
+
+#endif // defined(HAVE_ZSTD)
+
+
+// run_batch() decompresses a batch of independent members or frames into
+// the buffer, which must be empty, and records an access point for each of
+// them. The items are distributed round robin over the threads.
+
+static bool run_batch(pgn_source_t *src, batch_item_t *items, int count,
+                      size_t total) {
+  batch_job_t jobs[MAX_BATCH_THREADS];
+  pthread_t threads[MAX_BATCH_THREADS];
+  unsigned char *buffer;
+  int i, n = Max(1, Min(src->threads, count));
+  bool failed = false;
+
+  if(total > src->capacity) {
+    buffer = realloc(src->buffer, total);
+    if(buffer == NULL)
+      return false;
+    src->buffer = buffer;
+    src->capacity = total;
+  }
+  for(i = 0; i < count; i++)
+    items[i].out = src->buffer + items[i].out_offset;
+
+  for(i = 0; i < n; i++) {
+    jobs[i].format = src->format;
+    jobs[i].items = items;
+    jobs[i].first = i;
+    jobs[i].count = count;
+    jobs[i].stride = n;
+    jobs[i].started = false;
+    jobs[i].failed = false;
+  }
+  for(i = 1; i < n; i++)
+    jobs[i].started =
+      (pthread_create(&threads[i], NULL, batch_thread, &jobs[i]) == 0);
+  batch_thread(&jobs[0]);
+  for(i = 1; i < n; i++) {
+    if(jobs[i].started)
+      pthread_join(threads[i], NULL);
+    else
+      batch_thread(&jobs[i]);
+  }
+  for(i = 0; i < n; i++)
+    failed = failed || jobs[i].failed;
+  if(failed) {
+    src->eof = src->error = true;
+    return true;
+  }
+
+  for(i = 0; i < count; i++)
+    add_frame(src, items[i].in_offset, src->offset + items[i].out_offset, -1);
+  src->length = total;
+  return true;
+}
+
+
+static void *batch_thread(void *arg) {
+  batch_job_t *job = arg;
+  int i;
+
+  for(i = job->first; i < job->count; i += job->stride)
+    if(!decompress_item(job->format, job->items + i))
+      job->failed = true;
+  return NULL;
+}
+
+
+static bool decompress_item(int format, batch_item_t *item) {
+  z_stream zs;
+  bool ok;
+
+#if defined(HAVE_ZSTD)
+  if(format == PGN_SOURCE_ZSTD)
+    return ZSTD_decompress(item->out, item->out_length, item->in,
+                           item->in_length) == item->out_length;
+#endif
+  if(format != PGN_SOURCE_GZIP && format != PGN_SOURCE_BGZF)
+    return false;
+  memset(&zs, 0, sizeof(z_stream));
+  if(inflateInit2(&zs, 31) != Z_OK)
+    return false;
+  zs.next_in = (Bytef *)item->in;
+  zs.avail_in = item->in_length;
+  zs.next_out = item->out;
+  zs.avail_out = item->out_length;
+  ok = (inflate(&zs, Z_FINISH) == Z_STREAM_END && zs.avail_out == 0);
+  inflateEnd(&zs);
+  return ok;
+}
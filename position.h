@@ -283,6 +283,9 @@ extern bool position_is_stalemate(position_t *pos);
 extern bool position_is_draw(position_t *pos);
 extern char *move2str(move_t move, char *str);
 extern char *san_string(position_t *pos, move_t move, char *str);
+extern char *san_line(const position_t *pos, const move_t moves[],
+                      int start_column, bool break_lines, bool move_numbers,
+                      char *str);
 extern char *san_move_from_string(const position_t *pos, const char *istr, 
                                   char *ostr);
 extern char *san_line_from_string(const position_t *pos, int start_column, 
@@ -295,11 +298,16 @@ extern move_t find_move_matching(const position_t *pos,
 extern move_t parse_move(position_t *pos, const char *movestr);
 extern void make_move(position_t *pos, move_t m, undo_info_t *u);
 extern void unmake_move(position_t *pos, move_t m, undo_info_t *u);
+extern void make_nullmove(position_t *pos, undo_info_t *u);
+extern void unmake_nullmove(position_t *pos, undo_info_t *u);
 extern void print_position(const position_t *pos);
 extern void fprint_position(FILE *f, const position_t *pos);
 extern void copy_position(position_t *dst, const position_t *src);
 extern move_t parse_san_move(const position_t *pos, const char *movestr);
+extern move_t parse_san_move_nocopy(position_t *pos, const char *movestr);
 extern int count_legal_moves(const position_t *pos);
+extern move_stack_t *generate_moves(position_t *pos, move_stack_t *ms);
+extern bool move_is_legal(position_t *pos, move_t m);
 extern move_t can_castle_kingside(position_t *pos);
 extern move_t can_castle_queenside(position_t *pos);
 
@@ -1331,26 +1331,28 @@ move_t find_move_matching(const position_t *pos,
   return 0;
 }
   
-move_t parse_san_move(const position_t *pos, const char *movestr) {
+// parse_san_move_nocopy() is like parse_san_move(), but generates moves
+// directly in the supplied position instead of in a private copy. The
+// position is left unchanged. This saves a position copy per move, which
+// matters when replaying large numbers of games.
+
+move_t parse_san_move_nocopy(position_t *pos, const char *movestr) {
   char str[10], *cc;
   const char *c;
   int i, left, right;
   int piece = -1, from_file = -1, from_rank = -1, to, promotion = 0;
-  position_t p[1];
   move_stack_t moves[256], *m, *end;
   move_t move = 0;
 
   if(strncmp(movestr, "O-O-O", 5) == 0) {
-    copy_position(p, pos);
-    end = generate_moves(p, moves);
+    end = generate_moves(pos, moves);
     for(m = moves; m < end; m++)
       if(MvLongCastle(m->move)) return m->move;
     return 0;
   }
 
   if(strncmp(movestr, "O-O", 3) == 0) {
-    copy_position(p, pos);
-    end = generate_moves(p, moves);
+    end = generate_moves(pos, moves);
     for(m = moves; m < end; m++)
       if(MvShortCastle(m->move)) return m->move;
     return 0;
@@ -1411,11 +1413,10 @@ move_t parse_san_move(const position_t *pos, const char *movestr) {
   }
 
   // Generate moves:
-  copy_position(p, pos);
-  end = generate_moves(p, moves);
+  end = generate_moves(pos, moves);
   i = 0;
   for(m = moves; m < end; m++)
-    if(move_is_legal(p, m->move) && !MvCastle(m->move)) {
+    if(move_is_legal(pos, m->move) && !MvCastle(m->move)) {
       bool match = true;
       if(MvPiece(m->move) != piece) match = false;
       else if(MvTo(m->move) != to) match = false;
@@ -1433,6 +1434,12 @@ move_t parse_san_move(const position_t *pos, const char *movestr) {
   return 0;
 }
 
+move_t parse_san_move(const position_t *pos, const char *movestr) {
+  position_t p[1];
+  copy_position(p, pos);
+  return parse_san_move_nocopy(p, movestr);
+}
+
 int count_legal_moves(const position_t *pos) {
   position_t p[1];
   move_stack_t moves[256], *m, *end;
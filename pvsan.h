@@ -0,0 +1,74 @@
+/*
+  Stockfish, a OS X GUI for the UCI chess engine with the same name.
+  Copyright (C) 2004-2011 Marco Costalba, Joona Kiiski, Tord Romstad
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+/*
+  Conversion of principal variations to SAN.  Consecutive PVs from an
+  engine usually start with the same moves, so the cache remembers the
+  last line converted: its root position, its moves, the position after
+  them and the SAN text after each move.  A new PV from the same root only
+  has the moves after the common prefix converted, after the cached
+  position has been taken back to the end of the prefix.
+*/
+
+
+#if !defined(PVSAN_H_INCLUDED)
+#define PVSAN_H_INCLUDED
+
+////
+//// Includes
+////
+
+#include "position.h"
+
+
+////
+//// Constants and macros
+////
+
+#define PV_SAN_MAX_LENGTH 128
+#define PV_SAN_TEXT_SIZE 4096
+
+
+////
+//// Types
+////
+
+typedef struct pv_san_cache_t {
+  hashkey_t root_key;
+  int root_gply;
+  position_t pos[1];     // The root position after the cached moves
+  int length;            // Number of cached moves
+  move_t moves[PV_SAN_MAX_LENGTH];
+  undo_info_t undo[PV_SAN_MAX_LENGTH];
+  int text_length[PV_SAN_MAX_LENGTH + 1];
+  char text[PV_SAN_TEXT_SIZE];
+} pv_san_cache_t;
+
+
+////
+//// Functions
+////
+
+extern pv_san_cache_t *pv_san_cache_new(void);
+extern void pv_san_cache_delete(pv_san_cache_t *cache);
+extern const char *pv_san_line(pv_san_cache_t *cache, const position_t *root,
+                               const move_t moves[], int count);
+
+
+#endif // !defined(PVSAN_H_INCLUDED)
@@ -0,0 +1,119 @@
+/*
+  Stockfish, a OS X GUI for the UCI chess engine with the same name.
+  Copyright (C) 2004-2011 Marco Costalba, Joona Kiiski, Tord Romstad
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+////
+//// Includes
+////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pvsan.h"
+
+
+////
+//// Local definitions
+////
+
+static void reset(pv_san_cache_t *cache, const position_t *root);
+static void take_back(pv_san_cache_t *cache);
+
+
+////
+//// Functions
+////
+
+pv_san_cache_t *pv_san_cache_new(void) {
+  pv_san_cache_t *cache = malloc(sizeof(pv_san_cache_t));
+
+  cache->root_key = 0;
+  cache->root_gply = -1;
+  cache->length = 0;
+  cache->text_length[0] = 0;
+  cache->text[0] = '\0';
+  return cache;
+}
+
+
+void pv_san_cache_delete(pv_san_cache_t *cache) {
+  free(cache);
+}
+
+
+// Returns the moves as a SAN line with move numbers, like san_line(). The
+// string belongs to the cache and is valid until its next use. At most
+// PV_SAN_MAX_LENGTH moves are converted.
+
+const char *pv_san_line(pv_san_cache_t *cache, const position_t *root,
+                        const move_t moves[], int count) {
+  char *text = cache->text, san[16];
+  int i, n, length;
+
+  if(root->key != cache->root_key || root->gply != cache->root_gply)
+    reset(cache, root);
+
+  // Take back the cached moves which aren't in the new line:
+  count = Min(count, PV_SAN_MAX_LENGTH);
+  for(i = 0; i < count && i < cache->length; i++)
+    if(moves[i] != cache->moves[i]) break;
+  while(cache->length > i)
+    take_back(cache);
+
+  // Convert the rest:
+  length = cache->text_length[cache->length];
+  for(i = cache->length; i < count; i++) {
+    if(cache->pos->gply >= MAX_GAME_LENGTH - 1) break;
+    san_string(cache->pos, moves[i], san);
+    if(cache->pos->side == WHITE)
+      n = snprintf(text + length, PV_SAN_TEXT_SIZE - length, "%d. %s ",
+                   cache->pos->gply / 2 + 1, san);
+    else if(i == 0)
+      n = snprintf(text + length, PV_SAN_TEXT_SIZE - length, "%d... %s ",
+                   cache->pos->gply / 2 + 1, san);
+    else
+      n = snprintf(text + length, PV_SAN_TEXT_SIZE - length, "%s ", san);
+    if(length + n >= PV_SAN_TEXT_SIZE) break;
+    length += n;
+    if(moves[i] == NullMove) make_nullmove(cache->pos, cache->undo + i);
+    else make_move(cache->pos, moves[i], cache->undo + i);
+    cache->moves[i] = moves[i];
+    cache->text_length[i + 1] = length;
+    cache->length = i + 1;
+  }
+  text[cache->text_length[cache->length]] = '\0';
+  return text;
+}
+
+
+static void reset(pv_san_cache_t *cache, const position_t *root) {
+  copy_position(cache->pos, root);
+  cache->root_key = root->key;
+  cache->root_gply = root->gply;
+  cache->length = 0;
+  cache->text_length[0] = 0;
+}
+
+
+static void take_back(pv_san_cache_t *cache) {
+  int i = --cache->length;
+
+  if(cache->moves[i] == NullMove) unmake_nullmove(cache->pos, cache->undo + i);
+  else unmake_move(cache->pos, cache->moves[i], cache->undo + i);
+}
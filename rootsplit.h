@@ -0,0 +1,86 @@
+/*
+  Stockfish, a OS X GUI for the UCI chess engine with the same name.
+  Copyright (C) 2004-2011 Marco Costalba, Joona Kiiski, Tord Romstad
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+/*
+  Scheduling of a root-split analysis, in which the legal moves of a
+  position are searched one by one by several engines, each search limited
+  to a single move with "go searchmoves".  Every move thus gets an exact
+  score of its own.  The moves are deepened together: the next move to
+  search is always one of the moves with the lowest finished depth which
+  no engine is searching, the best ranked first, and it is searched one
+  ply deeper than before.  Moves are ranked by their last score, and moves
+  which haven't been searched yet come last, in generation order.
+*/
+
+
+#if !defined(ROOTSPLIT_H_INCLUDED)
+#define ROOTSPLIT_H_INCLUDED
+
+////
+//// Includes
+////
+
+#include "position.h"
+
+
+////
+//// Constants and macros
+////
+
+#define ROOT_SPLIT_MAX_MOVES 256
+#define ROOT_SPLIT_MAX_PV 32
+
+
+////
+//// Types
+////
+
+typedef struct root_move_t {
+  move_t move;
+  bool searching;
+  int depth;             // Depth of the last finished search, 0 if none
+  int score_type;        // UCI_SCORE_CP or UCI_SCORE_MATE
+  int score;             // Side to move's point of view at the root
+  int bound;
+  int pv_length;         // The PV starts with the move itself
+  move_t pv[ROOT_SPLIT_MAX_PV];
+} root_move_t;
+
+typedef struct root_split_t {
+  int count;
+  int max_depth;         // 0 for no limit
+  root_move_t moves[ROOT_SPLIT_MAX_MOVES];
+} root_split_t;
+
+
+////
+//// Functions
+////
+
+extern void root_split_init(root_split_t *rs, position_t *pos, int max_depth);
+extern int root_split_next(root_split_t *rs, int *depth);
+extern void root_split_result(root_split_t *rs, int index, int depth,
+                              int score_type, int score, int bound,
+                              const move_t pv[], int pv_length);
+extern void root_split_abort(root_split_t *rs, int index);
+extern int root_split_depth(const root_split_t *rs);
+extern void root_split_ranking(const root_split_t *rs, int order[]);
+
+
+#endif // !defined(ROOTSPLIT_H_INCLUDED)
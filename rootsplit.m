@@ -0,0 +1,145 @@
+/*
+  Stockfish, a OS X GUI for the UCI chess engine with the same name.
+  Copyright (C) 2004-2011 Marco Costalba, Joona Kiiski, Tord Romstad
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+////
+//// Includes
+////
+
+#include <string.h>
+
+#include "rootsplit.h"
+#include "uciinfo.h"
+
+
+////
+//// Local definitions
+////
+
+#define MATE_VALUE 30000
+
+static int move_value(const root_move_t *m);
+static bool ranks_before(const root_move_t *m1, int i1,
+                         const root_move_t *m2, int i2);
+
+
+////
+//// Functions
+////
+
+void root_split_init(root_split_t *rs, position_t *pos, int max_depth) {
+  move_stack_t ms[ROOT_SPLIT_MAX_MOVES], *end, *m;
+
+  memset(rs, 0, sizeof(root_split_t));
+  rs->max_depth = max_depth;
+  end = generate_moves(pos, ms);
+  for(m = ms; m < end; m++)
+    if(move_is_legal(pos, m->move))
+      rs->moves[rs->count++].move = m->move;
+}
+
+
+// Returns the index of the next move to search and the depth to search it
+// to, or -1 if all moves are being searched or have reached the maximum
+// depth. The move is marked as being searched.
+
+int root_split_next(root_split_t *rs, int *depth) {
+  int i, best = -1;
+
+  for(i = 0; i < rs->count; i++) {
+    root_move_t *m = rs->moves + i;
+    if(m->searching || (rs->max_depth > 0 && m->depth >= rs->max_depth))
+      continue;
+    if(best < 0 || m->depth < rs->moves[best].depth ||
+       (m->depth == rs->moves[best].depth &&
+        ranks_before(m, i, rs->moves + best, best)))
+      best = i;
+  }
+  if(best >= 0) {
+    rs->moves[best].searching = true;
+    *depth = rs->moves[best].depth + 1;
+  }
+  return best;
+}
+
+
+void root_split_result(root_split_t *rs, int index, int depth,
+                       int score_type, int score, int bound,
+                       const move_t pv[], int pv_length) {
+  root_move_t *m = rs->moves + index;
+
+  m->searching = false;
+  m->depth = depth;
+  m->score_type = score_type;
+  m->score = score;
+  m->bound = bound;
+  m->pv_length = Min(pv_length, ROOT_SPLIT_MAX_PV);
+  memcpy(m->pv, pv, m->pv_length * sizeof(move_t));
+  if(m->pv_length == 0 || m->pv[0] != m->move) {
+    m->pv[0] = m->move;
+    m->pv_length = 1;
+  }
+}
+
+
+void root_split_abort(root_split_t *rs, int index) {
+  rs->moves[index].searching = false;
+}
+
+
+// The depth all moves have been searched to.
+
+int root_split_depth(const root_split_t *rs) {
+  int i, depth = -1;
+
+  for(i = 0; i < rs->count; i++)
+    if(depth < 0 || rs->moves[i].depth < depth)
+      depth = rs->moves[i].depth;
+  return Max(depth, 0);
+}
+
+
+// Fills order[] with the indices of the moves, the best first.
+
+void root_split_ranking(const root_split_t *rs, int order[]) {
+  int i, j;
+
+  for(i = 0; i < rs->count; i++) {
+    for(j = i; j > 0 && ranks_before(rs->moves + i, i,
+                                     rs->moves + order[j - 1], order[j - 1]);
+        j--)
+      order[j] = order[j - 1];
+    order[j] = i;
+  }
+}
+
+
+static int move_value(const root_move_t *m) {
+  if(m->score_type == UCI_SCORE_MATE)
+    return (m->score > 0)? MATE_VALUE - m->score : -MATE_VALUE - m->score;
+  return m->score;
+}
+
+
+static bool ranks_before(const root_move_t *m1, int i1,
+                         const root_move_t *m2, int i2) {
+  if((m1->depth > 0) != (m2->depth > 0)) return m1->depth > 0;
+  if(m1->depth > 0 && move_value(m1) != move_value(m2))
+    return move_value(m1) > move_value(m2);
+  return i1 < i2;
+}
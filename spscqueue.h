@@ -0,0 +1,66 @@
+/*
+  Stockfish, a OS X GUI for the UCI chess engine with the same name.
+  Copyright (C) 2004-2011 Marco Costalba, Joona Kiiski, Tord Romstad
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+/*
+  A lock-free queue of variable length records, for one producer thread and
+  one consumer thread.  Records are stored contiguously in a ring of bytes,
+  so the consumer can use a record where it is until it pops it.  The
+  producer only writes the tail and the consumer only writes the head;
+  memory barriers make a record visible before the new tail is.
+*/
+
+
+#if !defined(SPSCQUEUE_H_INCLUDED)
+#define SPSCQUEUE_H_INCLUDED
+
+////
+//// Includes
+////
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+////
+//// Types
+////
+
+typedef struct spsc_queue_t {
+  char *data;
+  uint32_t size;                 // A power of two
+  volatile uint32_t head;        // Written by the consumer only
+  volatile uint32_t tail;        // Written by the producer only
+} spsc_queue_t;
+
+
+////
+//// Functions
+////
+
+extern void spsc_queue_init(spsc_queue_t *q, uint32_t size);
+extern void spsc_queue_free(spsc_queue_t *q);
+extern bool spsc_queue_push(spsc_queue_t *q, int type, const char *bytes,
+                            int length);
+extern bool spsc_queue_peek(spsc_queue_t *q, int *type, const char **bytes,
+                            int *length);
+extern void spsc_queue_pop(spsc_queue_t *q);
+extern bool spsc_queue_is_empty(const spsc_queue_t *q);
+
+
+#endif // !defined(SPSCQUEUE_H_INCLUDED)
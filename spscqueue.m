@@ -0,0 +1,140 @@
+/*
+  Stockfish, a OS X GUI for the UCI chess engine with the same name.
+  Copyright (C) 2004-2011 Marco Costalba, Joona Kiiski, Tord Romstad
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+////
+//// Includes
+////
+
+#include <libkern/OSAtomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "spscqueue.h"
+
+
+////
+//// Local definitions
+////
+
+typedef struct record_t {
+  int32_t type, length;
+} record_t;
+
+// Type of the filler record at the end of the ring when the next record
+// doesn't fit there:
+static const int32_t Padding = -1;
+
+static uint32_t record_size(int length);
+
+
+////
+//// Functions
+////
+
+void spsc_queue_init(spsc_queue_t *q, uint32_t size) {
+  q->data = malloc(size);
+  q->size = size;
+  q->head = q->tail = 0;
+}
+
+
+void spsc_queue_free(spsc_queue_t *q) {
+  free(q->data);
+  q->data = NULL;
+}
+
+
+// Called by the producer. Returns false if there is no room for the record
+// at the moment.
+
+bool spsc_queue_push(spsc_queue_t *q, int type, const char *bytes,
+                     int length) {
+  uint32_t tail = q->tail, used = tail - q->head;
+  uint32_t offset = tail & (q->size - 1), size = record_size(length);
+  record_t *r;
+
+  if(q->size - offset < size) {
+    // Fill the end of the ring, and start again at the beginning:
+    if(q->size - used < (q->size - offset) + size) return false;
+    r = (record_t *)(q->data + offset);
+    r->type = Padding;
+    r->length = 0;
+    tail += q->size - offset;
+    offset = 0;
+  }
+  else if(q->size - used < size)
+    return false;
+
+  r = (record_t *)(q->data + offset);
+  r->type = type;
+  r->length = length;
+  memcpy(r + 1, bytes, length);
+  OSMemoryBarrier();
+  q->tail = tail + size;
+  return true;
+}
+
+
+// Called by the consumer. Returns the oldest record without removing it
+// from the queue, or false if the queue is empty.
+
+bool spsc_queue_peek(spsc_queue_t *q, int *type, const char **bytes,
+                     int *length) {
+  uint32_t head, offset;
+  record_t *r;
+
+  while((head = q->head) != q->tail) {
+    OSMemoryBarrier();
+    offset = head & (q->size - 1);
+    r = (record_t *)(q->data + offset);
+    if(r->type == Padding) {
+      q->head = head + (q->size - offset);
+      continue;
+    }
+    *type = r->type;
+    *bytes = (const char *)(r + 1);
+    *length = r->length;
+    return true;
+  }
+  return false;
+}
+
+
+// Called by the consumer after spsc_queue_peek() has returned a record.
+
+void spsc_queue_pop(spsc_queue_t *q) {
+  record_t *r = (record_t *)(q->data + (q->head & (q->size - 1)));
+  uint32_t size = record_size(r->length);
+
+  OSMemoryBarrier();
+  q->head += size;
+}
+
+
+bool spsc_queue_is_empty(const spsc_queue_t *q) {
+  return q->head == q->tail;
+}
+
+
+// Records start at multiples of 8 bytes, so that the filler record always
+// fits at the end of the ring.
+
+static uint32_t record_size(int length) {
+  return (sizeof(record_t) + length + 7) & ~7;
+}
@@ -0,0 +1,77 @@
+/*
+  Stockfish, a OS X GUI for the UCI chess engine with the same name.
+  Copyright (C) 2004-2011 Marco Costalba, Joona Kiiski, Tord Romstad
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+/*
+  Probing of Syzygy endgame tablebases.  The WDL (.rtbw) and DTZ (.rtbz)
+  files are looked for in a list of directories separated by colons, and
+  each file is memory mapped the first time a position with its material
+  is probed.  Positions with castling rights are never found in the
+  tablebases.
+
+  WDL values are from the point of view of the side to move.  A cursed win
+  is a win which the 50 move rule turns into a draw, and a blessed loss is
+  the corresponding loss.  DTZ values are the number of plies to the next
+  capture or pawn move with best play, positive when the side to move wins
+  and negative when it loses; 0 means a draw, and values beyond 100 in
+  either direction mean cursed wins and blessed losses.  A DTZ value may be
+  one ply too large.
+
+  The probing functions may be called from several threads at once, but
+  not while tb_init() or tb_free() runs.
+*/
+
+
+#if !defined(SYZYGY_H_INCLUDED)
+#define SYZYGY_H_INCLUDED
+
+////
+//// Includes
+////
+
+#include "position.h"
+
+
+////
+//// Constants and macros
+////
+
+#define TB_MAX_PIECES 7
+
+enum {
+  TB_LOSS = -2, TB_BLESSED_LOSS = -1, TB_DRAW = 0, TB_CURSED_WIN = 1,
+  TB_WIN = 2
+};
+
+
+////
+//// Functions
+////
+
+extern int tb_init(const char *paths);
+extern void tb_free(void);
+extern int tb_max_pieces(void);
+extern bool tb_can_probe(const position_t *pos);
+extern bool tb_probe_wdl(const position_t *pos, int *wdl);
+extern bool tb_probe_dtz(const position_t *pos, int *dtz);
+extern bool tb_probe_root(const position_t *pos, move_t *move, int *wdl,
+                          int *dtz);
+extern result_t tb_result(int wdl, int side);
+
+
+#endif // !defined(SYZYGY_H_INCLUDED)
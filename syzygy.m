@@ -0,0 +1,1066 @@
+/*
+  Stockfish, a OS X GUI for the UCI chess engine with the same name.
+  Copyright (C) 2004-2011 Marco Costalba, Joona Kiiski, Tord Romstad
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+////
+//// Includes
+////
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <libkern/OSAtomic.h>
+#include <sys/mman.h>
+
+#include "syzygy.h"
+
+
+////
+//// Local definitions
+////
+
+// The table files use their own square numbering (a1 = 0, b1 = 1, ...,
+// h8 = 63), but the same piece codes as position.h.
+
+enum { TB_WDL, TB_DTZ };
+
+// Flags of the compressed tables. All but SingleValue are only used in
+// DTZ tables.
+enum {
+  FlagSTM = 1, FlagMapped = 2, FlagWinPlies = 4, FlagLossPlies = 8,
+  FlagWide = 16, FlagSingleValue = 128
+};
+
+enum { PROBE_FAIL, PROBE_OK, PROBE_CHANGE_STM, PROBE_ZEROING_BEST_MOVE };
+
+// The indexing and decompression data of one table of a file. A file has
+// a table per side to move (WDL files only) and, with pawns, per file of
+// the leading pawn. All pointers except base64 and symlen point into the
+// mapped file, and all numbers in the file are read byte by byte, because
+// they are little endian (or big endian in the compressed data) and may
+// not be aligned.
+
+typedef struct pairs_data_t {
+  int flags;
+  int max_sym_len, min_sym_len;
+  uint32_t num_blocks;
+  uint64_t block_size;
+  uint64_t span;                 // Values between sparse index entries
+  const uint8_t *lowest_sym;     // Lowest symbol of each code length
+  const uint8_t *btree;          // Children of each symbol, 3 bytes each
+  const uint8_t *block_length;   // Number of values - 1 in each block
+  uint32_t block_length_size;
+  const uint8_t *sparse_index;   // Block and offset every span values
+  uint64_t sparse_index_size;
+  const uint8_t *data;
+  uint64_t *base64;              // Lowest code of each length, left aligned
+  uint8_t *symlen;               // Number of values - 1 of each symbol
+  int symbols;
+  int pieces[TB_MAX_PIECES];
+  uint64_t group_idx[TB_MAX_PIECES + 1];
+  int group_len[TB_MAX_PIECES + 1];
+  int map_idx[4];
+} pairs_data_t;
+
+typedef struct tb_file_t {
+  volatile int ready;
+  void *base;
+  size_t size;
+  const uint8_t *map;            // DTZ value maps
+  pairs_data_t items[2][4];      // [side to move][file of leading pawn]
+} tb_file_t;
+
+// A table entry, like "KRPvKR". key is the material key with white having
+// the pieces before the 'v', key2 the one with the colours swapped.
+
+typedef struct tb_entry_t {
+  char name[TB_MAX_PIECES + 2];
+  hashkey_t key, key2;
+  int piece_count;
+  bool has_pawns, has_unique_pieces;
+  int pawn_count[2];             // Leading colour first
+  tb_file_t files[2];            // WDL and DTZ
+} tb_entry_t;
+
+#define HASH_BITS 14
+#define MAX_DTZ (1 << 18)
+
+static char **Paths;
+static int PathCount;
+static tb_entry_t *Entries;
+static int EntryCount, MaxPieces;
+static int Slots[1 << HASH_BITS];
+static pthread_mutex_t MapLock = PTHREAD_MUTEX_INITIALIZER;
+
+static int MapPawns[64];
+static int MapB1H1H7[64];
+static int MapA1D1D4[64];
+static int MapKK[10][64];
+static int Binomial[6][64];
+static int LeadPawnIdx[6][64];
+static int LeadPawnsSize[6][4];
+
+#define SqRank(s) ((s) >> 3)
+#define SqFile(s) ((s) & 7)
+#define OffA1H8(s) (SqRank(s) - SqFile(s))
+#define Sign(x) (((x) > 0) - ((x) < 0))
+
+static void init_tables(void);
+static int add_entry(const char *name);
+static tb_entry_t *find_entry(hashkey_t key);
+static hashkey_t material_key(const int white[], const int black[]);
+static bool map_file(tb_entry_t *e, int type);
+static void unmap_file(tb_file_t *f);
+static bool setup_file(tb_entry_t *e, int type, const uint8_t *data);
+static void set_groups(tb_entry_t *e, pairs_data_t *d, const int order[],
+                       int f);
+static const uint8_t *set_sizes(pairs_data_t *d, const uint8_t *data);
+static int set_symlen(pairs_data_t *d, int s, bool visited[]);
+static int decompress_pairs(pairs_data_t *d, uint64_t idx);
+static int probe_table(const position_t *pos, int type, int wdl, int *state);
+static int search(position_t *pos, bool check_zeroing, int *state);
+static int probe_dtz(position_t *pos, int *state);
+static int dtz_before_zeroing(int wdl);
+static void sort_squares(int squares[], int n, const int *order);
+
+static inline uint16_t read_le16(const uint8_t *p) {
+  return p[0] | (p[1] << 8);
+}
+
+static inline uint32_t read_le32(const uint8_t *p) {
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint32_t read_be32(const uint8_t *p) {
+  return ((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static inline int pairs_left(const pairs_data_t *d, int s) {
+  const uint8_t *lr = d->btree + 3 * s;
+  return ((lr[1] & 0xF) << 8) | lr[0];
+}
+
+static inline int pairs_right(const pairs_data_t *d, int s) {
+  const uint8_t *lr = d->btree + 3 * s;
+  return (lr[2] << 4) | (lr[1] >> 4);
+}
+
+static inline pairs_data_t *pairs(tb_entry_t *e, int type, int stm, int f) {
+  return &e->files[type].items[type == TB_WDL ? stm : 0][e->has_pawns ? f : 0];
+}
+
+
+////
+//// Functions
+////
+
+// tb_init() replaces the tablebases in use by those found in a list of
+// directories separated by colons, and returns the number of WDL files
+// found. An empty list turns probing off.
+
+int tb_init(const char *paths) {
+  const char *p, *q;
+  struct dirent *d;
+  DIR *dir;
+  int i, n;
+
+  tb_free();
+  init_tables();
+  for(p = paths; p != NULL && *p != '\0'; p = (*q == ':')? q + 1 : q) {
+    q = strchr(p, ':');
+    if(q == NULL) q = p + strlen(p);
+    if(q == p) continue;
+    Paths = realloc(Paths, (PathCount + 1) * sizeof(char *));
+    Paths[PathCount] = malloc(q - p + 1);
+    memcpy(Paths[PathCount], p, q - p);
+    Paths[PathCount][q - p] = '\0';
+    PathCount++;
+  }
+
+  for(i = 0; i < PathCount; i++) {
+    if((dir = opendir(Paths[i])) == NULL) continue;
+    while((d = readdir(dir)) != NULL) {
+      n = strlen(d->d_name);
+      if(n > 5 && strcmp(d->d_name + n - 5, ".rtbw") == 0) {
+        char name[64];
+        if(n - 5 >= (int)sizeof(name)) continue;
+        memcpy(name, d->d_name, n - 5);
+        name[n - 5] = '\0';
+        add_entry(name);
+      }
+    }
+    closedir(dir);
+  }
+
+  for(i = 0; i < EntryCount; i++) {
+    hashkey_t keys[2] = { Entries[i].key, Entries[i].key2 };
+    int j, k;
+    for(k = 0; k < 2; k++) {
+      j = (keys[k] * 0x9E3779B97F4A7C15ULL) >> (64 - HASH_BITS);
+      while(Slots[j] && Entries[Slots[j] - 1].key != keys[k])
+        j = (j + 1) & ((1 << HASH_BITS) - 1);
+      Slots[j] = i + 1;
+    }
+    MaxPieces = Max(MaxPieces, Entries[i].piece_count);
+  }
+  return EntryCount;
+}
+
+// tb_free() unmaps all tablebase files and forgets about them.
+
+void tb_free(void) {
+  int i;
+
+  for(i = 0; i < EntryCount; i++) {
+    unmap_file(&Entries[i].files[TB_WDL]);
+    unmap_file(&Entries[i].files[TB_DTZ]);
+  }
+  free(Entries);
+  Entries = NULL;
+  EntryCount = MaxPieces = 0;
+  memset(Slots, 0, sizeof(Slots));
+  for(i = 0; i < PathCount; i++)
+    free(Paths[i]);
+  free(Paths);
+  Paths = NULL;
+  PathCount = 0;
+}
+
+int tb_max_pieces(void) {
+  return MaxPieces;
+}
+
+// tb_can_probe() tests whether a position has few enough pieces for the
+// tablebases found and no castling rights. It does not test whether the
+// file for its material exists.
+
+bool tb_can_probe(const position_t *pos) {
+  int count = 2, type;
+
+  if(MaxPieces == 0 || (pos->castle_flags & 15) != 15) return false;
+  for(type = PAWN; type <= QUEEN; type++)
+    count += pos->piece_count[WHITE][type] + pos->piece_count[BLACK][type];
+  return count <= MaxPieces;
+}
+
+bool tb_probe_wdl(const position_t *pos, int *wdl) {
+  position_t p[1];
+  int state = PROBE_OK;
+
+  if(!tb_can_probe(pos)) return false;
+  copy_position(p, pos);
+  p->gply = 0;
+  *wdl = search(p, false, &state);
+  return state != PROBE_FAIL;
+}
+
+bool tb_probe_dtz(const position_t *pos, int *dtz) {
+  position_t p[1];
+  int state;
+
+  if(!tb_can_probe(pos)) return false;
+  copy_position(p, pos);
+  p->gply = 0;
+  *dtz = probe_dtz(p, &state);
+  return state != PROBE_FAIL;
+}
+
+// tb_probe_root() finds the best move in a tablebase position: the fastest
+// win which is not spoiled by the 50 move rule, or else a draw, or else the
+// slowest loss. The move is NoMove when there are no legal moves.
+
+bool tb_probe_root(const position_t *pos, move_t *move, int *wdl,
+                   int *dtz) {
+  position_t p[1];
+  move_stack_t moves[256], *m, *end;
+  undo_info_t u[1];
+  int state = PROBE_OK, v, rank, best_rank = -MAX_DTZ - 1, best_v = 0;
+  int cnt50 = pos->rule50;
+
+  if(!tb_can_probe(pos)) return false;
+  copy_position(p, pos);
+  p->gply = 0;
+  *wdl = search(p, false, &state);
+  if(state == PROBE_FAIL) return false;
+  *dtz = probe_dtz(p, &state);
+  if(state == PROBE_FAIL) return false;
+
+  *move = NoMove;
+  end = generate_moves(p, moves);
+  for(m = moves; m < end; m++) {
+    if(!move_is_legal(p, m->move)) continue;
+    make_move(p, m->move, u);
+    state = PROBE_OK;
+    if(p->rule50 == 0)
+      v = dtz_before_zeroing(-search(p, false, &state));
+    else {
+      v = -probe_dtz(p, &state);
+      v += Sign(v);
+    }
+    if(v == 2 && p->check && count_legal_moves(p) == 0)
+      v = 1;
+    unmake_move(p, m->move, u);
+    if(state == PROBE_FAIL) return false;
+
+    // Wins within reach of the 50 move rule rank equally, as do losses
+    // which are not saved by it. Ties are broken by the distance.
+    if(v > 0)
+      rank = (v + cnt50 <= 99)? MAX_DTZ : MAX_DTZ - (v + cnt50);
+    else if(v < 0)
+      rank = (-v * 2 + cnt50 < 100)? -MAX_DTZ : -MAX_DTZ + (-v + cnt50);
+    else
+      rank = 0;
+    if(rank > best_rank || (rank == best_rank && v < best_v)) {
+      best_rank = rank;
+      best_v = v;
+      *move = m->move;
+    }
+  }
+  return true;
+}
+
+// tb_result() converts a WDL value to a game result. Cursed wins and
+// blessed losses are draws.
+
+result_t tb_result(int wdl, int side) {
+  if(wdl == TB_WIN) return (side == WHITE)? WHITE_WINS : BLACK_WINS;
+  if(wdl == TB_LOSS) return (side == WHITE)? BLACK_WINS : WHITE_WINS;
+  return DRAW;
+}
+
+
+// The encoding tables. MapKK[] numbers the 462 placements of the two kings
+// with the first king in the a1-d1-d4 triangle, MapPawns[] numbers the
+// squares a2-h7 so that the leading pawn has the highest number, and
+// LeadPawnIdx[] and LeadPawnsSize[] encode the leading pawns per file.
+
+static void init_tables(void) {
+  static bool initialized = false;
+  static const int triangle[] = {
+    0, 1, 2, 3, 8, 9, 10, 11, 16, 17, 18, 19, 24, 25, 26, 27
+  };
+  int diagonal[4], both[64][2];
+  int s, s1, s2, idx, n, k, f, r, code, count, available, lead;
+
+  if(initialized) return;
+
+  for(s = 0, code = 0; s < 64; s++)
+    if(OffA1H8(s) < 0)
+      MapB1H1H7[s] = code++;
+
+  for(n = 0, code = 0, count = 0; n < 16; n++) {
+    s = triangle[n];
+    if(OffA1H8(s) < 0)
+      MapA1D1D4[s] = code++;
+    else if(OffA1H8(s) == 0)
+      diagonal[count++] = s;
+  }
+  for(n = 0; n < count; n++)
+    MapA1D1D4[diagonal[n]] = code++;
+
+  for(idx = 0, code = 0, count = 0; idx < 10; idx++)
+    for(s1 = 0; s1 <= 27; s1++)
+      if(MapA1D1D4[s1] == idx && (idx || s1 == 1)) {
+        for(s2 = 0; s2 < 64; s2++) {
+          if(abs(SqFile(s1) - SqFile(s2)) <= 1 &&
+             abs(SqRank(s1) - SqRank(s2)) <= 1)
+            continue;
+          if(OffA1H8(s1) == 0 && OffA1H8(s2) > 0)
+            continue;
+          if(OffA1H8(s1) == 0 && OffA1H8(s2) == 0) {
+            both[count][0] = idx;
+            both[count++][1] = s2;
+          }
+          else
+            MapKK[idx][s2] = code++;
+        }
+      }
+  for(n = 0; n < count; n++)
+    MapKK[both[n][0]][both[n][1]] = code++;
+
+  Binomial[0][0] = 1;
+  for(n = 1; n < 64; n++)
+    for(k = 0; k < 6 && k <= n; k++)
+      Binomial[k][n] = ((k > 0)? Binomial[k - 1][n - 1] : 0)
+        + ((k < n)? Binomial[k][n - 1] : 0);
+
+  available = 47;
+  for(lead = 1; lead <= 5; lead++)
+    for(f = FILE_A; f <= FILE_D; f++) {
+      for(r = RANK_2, idx = 0; r <= RANK_7; r++) {
+        s = r * 8 + f;
+        if(lead == 1) {
+          MapPawns[s] = available--;
+          MapPawns[s ^ 7] = available--;
+        }
+        LeadPawnIdx[lead][s] = idx;
+        idx += Binomial[lead - 1][MapPawns[s]];
+      }
+      LeadPawnsSize[lead][f] = idx;
+    }
+
+  initialized = true;
+}
+
+// add_entry() adds a table from its name, like "KRPvKR". Names which are
+// not valid and duplicates are ignored.
+
+static int add_entry(const char *name) {
+  static const char PieceChars[] = " PNBRQK";
+  int counts[2][8], side = WHITE, i, t, total = 0;
+  const char *c;
+  tb_entry_t *e;
+  bool white_lead;
+
+  if(strlen(name) > TB_MAX_PIECES + 1) return 0;
+  memset(counts, 0, sizeof(counts));
+  for(i = 0; name[i] != '\0'; i++) {
+    if(name[i] == 'v' && side == WHITE) {
+      side = BLACK;
+      continue;
+    }
+    if((c = strchr(PieceChars + 1, name[i])) == NULL)
+      return 0;
+    counts[side][c - PieceChars]++;
+    total++;
+  }
+  if(side != BLACK || counts[WHITE][KING] != 1 || counts[BLACK][KING] != 1
+     || name[0] != 'K' || total > TB_MAX_PIECES)
+    return 0;
+  for(i = 0; i < EntryCount; i++)
+    if(Entries[i].key == material_key(counts[WHITE], counts[BLACK]) ||
+       Entries[i].key2 == material_key(counts[WHITE], counts[BLACK]))
+      return 0;
+
+  Entries = realloc(Entries, (EntryCount + 1) * sizeof(tb_entry_t));
+  e = &Entries[EntryCount++];
+  memset(e, 0, sizeof(tb_entry_t));
+  strcpy(e->name, name);
+  e->key = material_key(counts[WHITE], counts[BLACK]);
+  e->key2 = material_key(counts[BLACK], counts[WHITE]);
+  e->piece_count = total;
+  e->has_pawns = counts[WHITE][PAWN] + counts[BLACK][PAWN] > 0;
+  for(side = WHITE; side <= BLACK; side++)
+    for(t = PAWN; t <= QUEEN; t++)
+      if(counts[side][t] == 1)
+        e->has_unique_pieces = true;
+
+  // The leading colour is the one with fewer pawns, but at least one.
+  white_lead = counts[BLACK][PAWN] == 0 ||
+    (counts[WHITE][PAWN] && counts[BLACK][PAWN] >= counts[WHITE][PAWN]);
+  e->pawn_count[0] = counts[white_lead? WHITE : BLACK][PAWN];
+  e->pawn_count[1] = counts[white_lead? BLACK : WHITE][PAWN];
+  return 1;
+}
+
+// find_entry() looks up the table for a material key. The hash table is
+// only valid once tb_init() has added all entries.
+
+static tb_entry_t *find_entry(hashkey_t key) {
+  int j = (key * 0x9E3779B97F4A7C15ULL) >> (64 - HASH_BITS);
+
+  while(Slots[j]) {
+    tb_entry_t *e = &Entries[Slots[j] - 1];
+    if(e->key == key || e->key2 == key) return e;
+    j = (j + 1) & ((1 << HASH_BITS) - 1);
+  }
+  return NULL;
+}
+
+static hashkey_t material_key(const int white[], const int black[]) {
+  hashkey_t key = 0;
+  int t;
+
+  for(t = PAWN; t <= QUEEN; t++)
+    key |= ((hashkey_t)white[t] << (4 * t)) |
+      ((hashkey_t)black[t] << (4 * t + 32));
+  return key;
+}
+
+// map_file() maps a WDL or DTZ file and reads its table headers the first
+// time it is needed, and returns whether the file is available.
+
+static bool map_file(tb_entry_t *e, int type) {
+  static const uint8_t Magic[2][4] = {
+    { 0x71, 0xE8, 0x23, 0x5D }, { 0xD7, 0x66, 0x0C, 0xA5 }
+  };
+  tb_file_t *f = &e->files[type];
+  char filename[PATH_MAX];
+  struct stat st;
+  int i, fd;
+
+  if(f->ready) {
+    OSMemoryBarrier();
+    return f->base != NULL;
+  }
+
+  pthread_mutex_lock(&MapLock);
+  for(i = 0; i < PathCount && !f->ready && f->base == NULL; i++) {
+    snprintf(filename, PATH_MAX, "%s/%s%s", Paths[i], e->name,
+             (type == TB_WDL)? ".rtbw" : ".rtbz");
+    if((fd = open(filename, O_RDONLY)) < 0) continue;
+    if(fstat(fd, &st) == 0 && st.st_size > 16) {
+      f->size = st.st_size;
+      f->base = mmap(NULL, f->size, PROT_READ, MAP_SHARED, fd, 0);
+      if(f->base == MAP_FAILED)
+        f->base = NULL;
+      else
+        madvise(f->base, f->size, MADV_RANDOM);
+    }
+    close(fd);
+    if(f->base != NULL &&
+       (memcmp(f->base, Magic[type], 4) != 0 ||
+        !setup_file(e, type, (uint8_t *)f->base + 4))) {
+      fprintf(stderr, "Corrupt tablebase file %s\n", filename);
+      unmap_file(f);
+    }
+  }
+  OSMemoryBarrier();
+  f->ready = 1;
+  pthread_mutex_unlock(&MapLock);
+  return f->base != NULL;
+}
+
+static void unmap_file(tb_file_t *f) {
+  int i, j;
+
+  for(i = 0; i < 2; i++)
+    for(j = 0; j < 4; j++) {
+      free(f->items[i][j].base64);
+      free(f->items[i][j].symlen);
+    }
+  if(f->base != NULL)
+    munmap(f->base, f->size);
+  memset(f, 0, sizeof(tb_file_t));
+}
+
+// setup_file() reads the piece order, group encoding and compression data
+// of all tables in a file, following the layout written by the generator.
+
+static bool setup_file(tb_entry_t *e, int type, const uint8_t *data) {
+  tb_file_t *file = &e->files[type];
+  pairs_data_t *d;
+  int sides, max_file, f, i, k;
+  bool pp = e->has_pawns && e->pawn_count[1];
+
+  if(e->has_pawns != ((*data & 2) != 0) ||
+     (e->key != e->key2) != ((*data & 1) != 0))
+    return false;
+  data++;
+
+  sides = (type == TB_WDL && e->key != e->key2)? 2 : 1;
+  max_file = e->has_pawns? FILE_D : FILE_A;
+
+  for(f = FILE_A; f <= max_file; f++) {
+    int order[2][2] = {
+      { *data & 0xF, pp? *(data + 1) & 0xF : 0xF },
+      { *data >> 4, pp? *(data + 1) >> 4 : 0xF }
+    };
+    data += 1 + pp;
+    for(k = 0; k < e->piece_count; k++, data++)
+      for(i = 0; i < sides; i++)
+        pairs(e, type, i, f)->pieces[k] = i? *data >> 4 : *data & 0xF;
+    for(i = 0; i < sides; i++)
+      set_groups(e, pairs(e, type, i, f), order[i], f);
+  }
+  data += (uintptr_t)data & 1;
+
+  for(f = FILE_A; f <= max_file; f++)
+    for(i = 0; i < sides; i++)
+      data = set_sizes(pairs(e, type, i, f), data);
+
+  if(type == TB_DTZ) {
+    file->map = data;
+    for(f = FILE_A; f <= max_file; f++) {
+      d = pairs(e, type, 0, f);
+      if(!(d->flags & FlagMapped)) continue;
+      if(d->flags & FlagWide) {
+        data += (uintptr_t)data & 1;
+        for(i = 0; i < 4; i++) {
+          d->map_idx[i] = (data - file->map) / 2 + 1;
+          data += 2 * read_le16(data) + 2;
+        }
+      }
+      else
+        for(i = 0; i < 4; i++) {
+          d->map_idx[i] = data - file->map + 1;
+          data += *data + 1;
+        }
+    }
+    data += (uintptr_t)data & 1;
+  }
+
+  for(f = FILE_A; f <= max_file; f++)
+    for(i = 0; i < sides; i++) {
+      d = pairs(e, type, i, f);
+      d->sparse_index = data;
+      data += d->sparse_index_size * 6;
+    }
+  for(f = FILE_A; f <= max_file; f++)
+    for(i = 0; i < sides; i++) {
+      d = pairs(e, type, i, f);
+      d->block_length = data;
+      data += d->block_length_size * 2;
+    }
+  for(f = FILE_A; f <= max_file; f++)
+    for(i = 0; i < sides; i++) {
+      d = pairs(e, type, i, f);
+      data = (const uint8_t *)(((uintptr_t)data + 0x3F) & ~(uintptr_t)0x3F);
+      d->data = data;
+      data += d->num_blocks * d->block_size;
+    }
+  return data <= (const uint8_t *)file->base + file->size;
+}
+
+// set_groups() splits the pieces of a table into the groups which are
+// encoded together: the leading pawns or the leading pieces (three unique
+// pieces, or else the two kings), the other side's pawns, and the rest by
+// piece. The order in which the groups are multiplied into the index is
+// stored per table.
+
+static void set_groups(tb_entry_t *e, pairs_data_t *d, const int order[],
+                       int f) {
+  int n = 0, i, k, next, free_squares;
+  int first_len = e->has_pawns? 0 : (e->has_unique_pieces? 3 : 2);
+  bool pp = e->has_pawns && e->pawn_count[1];
+  uint64_t idx = 1;
+
+  d->group_len[n] = 1;
+  for(i = 1; i < e->piece_count; i++)
+    if(--first_len > 0 || d->pieces[i] == d->pieces[i - 1])
+      d->group_len[n]++;
+    else
+      d->group_len[++n] = 1;
+  d->group_len[++n] = 0;
+
+  next = pp? 2 : 1;
+  free_squares = 64 - d->group_len[0] - (pp? d->group_len[1] : 0);
+  for(k = 0; next < n || k == order[0] || k == order[1]; k++)
+    if(k == order[0]) {
+      d->group_idx[0] = idx;
+      idx *= e->has_pawns? LeadPawnsSize[d->group_len[0]][f]
+        : (e->has_unique_pieces? 31332 : 462);
+    }
+    else if(k == order[1]) {
+      d->group_idx[1] = idx;
+      idx *= Binomial[d->group_len[1]][48 - d->group_len[0]];
+    }
+    else {
+      d->group_idx[next] = idx;
+      idx *= Binomial[d->group_len[next]][free_squares];
+      free_squares -= d->group_len[next++];
+    }
+  d->group_idx[n] = idx;
+}
+
+// set_sizes() reads the Huffman code and block layout of a table. The
+// canonical code has longer codes for lower values, so base64[] holds the
+// lowest code of each length, left aligned in 64 bits, in decreasing
+// order.
+
+static const uint8_t *set_sizes(pairs_data_t *d, const uint8_t *data) {
+  uint64_t tb_size;
+  bool *visited;
+  int i, n, padding;
+
+  d->flags = *data++;
+  if(d->flags & FlagSingleValue) {
+    d->num_blocks = d->span = d->block_length_size = d->sparse_index_size = 0;
+    d->min_sym_len = *data++;
+    return data;
+  }
+
+  for(i = 0; d->group_len[i]; i++);
+  tb_size = d->group_idx[i];
+
+  d->block_size = 1ULL << *data++;
+  d->span = 1ULL << *data++;
+  d->sparse_index_size = (tb_size + d->span - 1) / d->span;
+  padding = *data++;
+  d->num_blocks = read_le32(data);
+  data += 4;
+  d->block_length_size = d->num_blocks + padding;
+  d->max_sym_len = *data++;
+  d->min_sym_len = *data++;
+  d->lowest_sym = data;
+
+  n = d->max_sym_len - d->min_sym_len + 1;
+  d->base64 = calloc(n, sizeof(uint64_t));
+  for(i = n - 2; i >= 0; i--)
+    d->base64[i] = (d->base64[i + 1] + read_le16(d->lowest_sym + 2 * i)
+                    - read_le16(d->lowest_sym + 2 * i + 2)) / 2;
+  for(i = 0; i < n; i++)
+    d->base64[i] <<= 64 - i - d->min_sym_len;
+  data += 2 * n;
+
+  d->symbols = read_le16(data);
+  data += 2;
+  d->btree = data;
+  d->symlen = calloc(d->symbols, 1);
+  visited = calloc(d->symbols, sizeof(bool));
+  for(i = 0; i < d->symbols; i++)
+    if(!visited[i])
+      d->symlen[i] = set_symlen(d, i, visited);
+  free(visited);
+
+  return data + 3 * d->symbols + (d->symbols & 1);
+}
+
+// set_symlen() computes the number of values a symbol expands to, minus
+// one. Symbols are pairs of other symbols, and a symbol whose right child
+// is 0xFFF is a value.
+
+static int set_symlen(pairs_data_t *d, int s, bool visited[]) {
+  int left, right;
+
+  visited[s] = true;
+  right = pairs_right(d, s);
+  if(right == 0xFFF) return 0;
+  left = pairs_left(d, s);
+  if(!visited[left])
+    d->symlen[left] = set_symlen(d, left, visited);
+  if(!visited[right])
+    d->symlen[right] = set_symlen(d, right, visited);
+  return (d->symlen[left] + d->symlen[right] + 1) & 0xFF;
+}
+
+// decompress_pairs() returns the value stored at an index of a table. The
+// sparse index gives a block and an offset close to the index, which are
+// corrected by the block lengths. The symbols in the block are then read
+// until the one containing the offset, which is expanded to a value.
+
+static int decompress_pairs(pairs_data_t *d, uint64_t idx) {
+  const uint8_t *ptr;
+  uint64_t buf64;
+  uint32_t block, k;
+  int offset, buf64_size, len, sym, left;
+
+  if(d->flags & FlagSingleValue) return d->min_sym_len;
+
+  k = idx / d->span;
+  block = read_le32(d->sparse_index + 6 * k);
+  offset = read_le16(d->sparse_index + 6 * k + 4);
+  offset += (int)(idx % d->span) - (int)(d->span / 2);
+
+  while(offset < 0)
+    offset += read_le16(d->block_length + 2 * --block) + 1;
+  while(offset > read_le16(d->block_length + 2 * block))
+    offset -= read_le16(d->block_length + 2 * block++) + 1;
+
+  ptr = d->data + (uint64_t)block * d->block_size;
+  buf64 = ((uint64_t)read_be32(ptr) << 32) | read_be32(ptr + 4);
+  ptr += 8;
+  buf64_size = 64;
+
+  while(true) {
+    len = 0;
+    while(buf64 < d->base64[len])
+      len++;
+    sym = (buf64 - d->base64[len]) >> (64 - len - d->min_sym_len);
+    sym = (sym + read_le16(d->lowest_sym + 2 * len)) & 0xFFFF;
+    if(offset < d->symlen[sym] + 1)
+      break;
+    offset -= d->symlen[sym] + 1;
+    len += d->min_sym_len;
+    buf64 <<= len;
+    buf64_size -= len;
+    if(buf64_size <= 32) {
+      buf64_size += 32;
+      buf64 |= (uint64_t)read_be32(ptr) << (64 - buf64_size);
+      ptr += 4;
+    }
+  }
+
+  while(d->symlen[sym]) {
+    left = pairs_left(d, sym);
+    if(offset < d->symlen[left] + 1)
+      sym = left;
+    else {
+      offset -= d->symlen[left] + 1;
+      sym = pairs_right(d, sym);
+    }
+  }
+  return pairs_left(d, sym);
+}
+
+// probe_table() looks up a position in a single WDL or DTZ table. The
+// tables are stored with the stronger side as white, and the position is
+// mirrored when black is stronger. The pieces are then mapped to the
+// canonical squares and encoded group by group into an index. For DTZ
+// tables, the expected WDL value is needed to decode the stored value, and
+// *state is set to PROBE_CHANGE_STM if the table only has the other side
+// to move.
+
+static int probe_table(const position_t *pos, int type, int wdl, int *state) {
+  static const int WDLMap[] = { 1, 3, 0, 2, 0 };
+  int squares[TB_MAX_PIECES], pieces[TB_MAX_PIECES];
+  int i, j, s, tmp, size = 0, lead_pawns = 0, tb_file = 0, next = 0;
+  int flip, stm, lead_pawn = EMPTY, value, adjust, adjust1, adjust2;
+  hashkey_t key = material_key(pos->piece_count[WHITE],
+                               pos->piece_count[BLACK]);
+  bool remaining_pawns;
+  const uint8_t *map;
+  int *group_sq;
+  tb_entry_t *e;
+  pairs_data_t *d;
+  uint64_t idx, n;
+
+  if(key == 0) return TB_DRAW;
+  e = find_entry(key);
+  if(e == NULL || !map_file(e, type)) {
+    *state = PROBE_FAIL;
+    return 0;
+  }
+
+  flip = (e->key == e->key2 && pos->side == BLACK) || key != e->key;
+  stm = flip ^ pos->side;
+
+  if(e->has_pawns) {
+    lead_pawn = pairs(e, type, 0, 0)->pieces[0] ^ (flip * 8);
+    for(s = 0; s < 64; s++)
+      if(pos->board[EXPAND(s)] == lead_pawn)
+        squares[size++] = s ^ (flip * 56);
+    lead_pawns = size;
+    for(i = 1, j = 0; i < lead_pawns; i++)
+      if(MapPawns[squares[i]] > MapPawns[squares[j]]) j = i;
+    tmp = squares[0]; squares[0] = squares[j]; squares[j] = tmp;
+    tb_file = Min(SqFile(squares[0]), 7 - SqFile(squares[0]));
+  }
+
+  if(type == TB_DTZ &&
+     (pairs(e, type, 0, tb_file)->flags & FlagSTM) != stm &&
+     (e->key != e->key2 || e->has_pawns)) {
+    *state = PROBE_CHANGE_STM;
+    return 0;
+  }
+
+  for(s = 0; s < 64; s++)
+    if(pos->board[EXPAND(s)] != EMPTY &&
+       pos->board[EXPAND(s)] != lead_pawn) {
+      squares[size] = s ^ (flip * 56);
+      pieces[size++] = pos->board[EXPAND(s)] ^ (flip * 8);
+    }
+
+  d = pairs(e, type, stm, tb_file);
+
+  for(i = lead_pawns; i < size - 1; i++)
+    for(j = i + 1; j < size; j++)
+      if(d->pieces[i] == pieces[j]) {
+        tmp = pieces[i]; pieces[i] = pieces[j]; pieces[j] = tmp;
+        tmp = squares[i]; squares[i] = squares[j]; squares[j] = tmp;
+        break;
+      }
+
+  if(SqFile(squares[0]) > FILE_D)
+    for(i = 0; i < size; i++)
+      squares[i] ^= 7;
+
+  if(e->has_pawns) {
+    idx = LeadPawnIdx[lead_pawns][squares[0]];
+    sort_squares(squares + 1, lead_pawns - 1, MapPawns);
+    for(i = 1; i < lead_pawns; i++)
+      idx += Binomial[i][MapPawns[squares[i]]];
+  }
+  else {
+    if(SqRank(squares[0]) > RANK_4)
+      for(i = 0; i < size; i++)
+        squares[i] ^= 56;
+
+    for(i = 0; i < d->group_len[0]; i++) {
+      if(OffA1H8(squares[i]) == 0) continue;
+      if(OffA1H8(squares[i]) > 0)
+        for(j = i; j < size; j++)
+          squares[j] = ((squares[j] >> 3) | (squares[j] << 3)) & 63;
+      break;
+    }
+
+    if(e->has_unique_pieces) {
+      adjust1 = squares[1] > squares[0];
+      adjust2 = (squares[2] > squares[0]) + (squares[2] > squares[1]);
+      if(OffA1H8(squares[0]))
+        idx = (MapA1D1D4[squares[0]] * 63 + (squares[1] - adjust1)) * 62
+          + squares[2] - adjust2;
+      else if(OffA1H8(squares[1]))
+        idx = (6 * 63 + SqRank(squares[0]) * 28 + MapB1H1H7[squares[1]]) * 62
+          + squares[2] - adjust2;
+      else if(OffA1H8(squares[2]))
+        idx = 6 * 63 * 62 + 4 * 28 * 62
+          + SqRank(squares[0]) * 7 * 28
+          + (SqRank(squares[1]) - adjust1) * 28
+          + MapB1H1H7[squares[2]];
+      else
+        idx = 6 * 63 * 62 + 4 * 28 * 62 + 4 * 7 * 28
+          + SqRank(squares[0]) * 7 * 6
+          + (SqRank(squares[1]) - adjust1) * 6
+          + (SqRank(squares[2]) - adjust2);
+    }
+    else
+      idx = MapKK[MapA1D1D4[squares[0]]][squares[1]];
+  }
+
+  // The remaining groups: each is sorted, and its squares are numbered
+  // among the squares not taken by the groups before it.
+  idx *= d->group_idx[0];
+  group_sq = squares + d->group_len[0];
+  remaining_pawns = e->has_pawns && e->pawn_count[1];
+  while(d->group_len[++next]) {
+    sort_squares(group_sq, d->group_len[next], NULL);
+    for(i = 0, n = 0; i < d->group_len[next]; i++) {
+      for(j = 0, adjust = 0; squares + j < group_sq; j++)
+        adjust += group_sq[i] > squares[j];
+      n += Binomial[i + 1][group_sq[i] - adjust - 8 * remaining_pawns];
+    }
+    remaining_pawns = false;
+    idx += n * d->group_idx[next];
+    group_sq += d->group_len[next];
+  }
+
+  value = decompress_pairs(d, idx);
+  if(type == TB_WDL) return value - 2;
+
+  // DTZ values are mapped by frequency per WDL value, and may be stored
+  // in moves rather than plies.
+  d = pairs(e, type, 0, tb_file);
+  map = e->files[TB_DTZ].map;
+  if(d->flags & FlagMapped) {
+    if(d->flags & FlagWide)
+      value = read_le16(map + 2 * (d->map_idx[WDLMap[wdl + 2]] + value));
+    else
+      value = map[d->map_idx[WDLMap[wdl + 2]] + value];
+  }
+  if((wdl == TB_WIN && !(d->flags & FlagWinPlies)) ||
+     (wdl == TB_LOSS && !(d->flags & FlagLossPlies)) ||
+     wdl == TB_CURSED_WIN || wdl == TB_BLESSED_LOSS)
+    value *= 2;
+  return value + 1;
+}
+
+// search() probes the WDL value of a position, resolving captures (and,
+// with check_zeroing, pawn moves) by a search, since the tables store
+// arbitrary values where such a move is best and know nothing of en
+// passant captures. *state is set to PROBE_ZEROING_BEST_MOVE when a
+// capture or pawn move is best.
+
+static int search(position_t *pos, bool check_zeroing, int *state) {
+  move_stack_t moves[256], *m, *end;
+  undo_info_t u[1];
+  int value, best = TB_LOSS, total = 0, count = 0;
+  bool no_more_moves;
+
+  end = generate_moves(pos, moves);
+  for(m = moves; m < end; m++) {
+    if(!move_is_legal(pos, m->move)) continue;
+    total++;
+    if(!MvCapture(m->move) && (!check_zeroing || MvPiece(m->move) != PAWN))
+      continue;
+    count++;
+    make_move(pos, m->move, u);
+    value = -search(pos, false, state);
+    unmake_move(pos, m->move, u);
+    if(*state == PROBE_FAIL) return TB_DRAW;
+    if(value > best) {
+      best = value;
+      if(value >= TB_WIN) {
+        *state = PROBE_ZEROING_BEST_MOVE;
+        return value;
+      }
+    }
+  }
+
+  no_more_moves = count && count == total;
+  if(no_more_moves)
+    value = best;
+  else {
+    value = probe_table(pos, TB_WDL, TB_DRAW, state);
+    if(*state == PROBE_FAIL) return TB_DRAW;
+  }
+
+  if(best >= value) {
+    *state = (best > TB_DRAW || no_more_moves)?
+      PROBE_ZEROING_BEST_MOVE : PROBE_OK;
+    return best;
+  }
+  *state = PROBE_OK;
+  return value;
+}
+
+static int probe_dtz(position_t *pos, int *state) {
+  move_stack_t moves[256], *m, *end;
+  undo_info_t u[1];
+  int wdl, dtz, min_dtz = 0xFFFF;
+  bool zeroing;
+
+  *state = PROBE_OK;
+  wdl = search(pos, true, state);
+  if(*state == PROBE_FAIL || wdl == TB_DRAW) return 0;
+  if(*state == PROBE_ZEROING_BEST_MOVE) return dtz_before_zeroing(wdl);
+
+  dtz = probe_table(pos, TB_DTZ, wdl, state);
+  if(*state == PROBE_FAIL) return 0;
+  if(*state != PROBE_CHANGE_STM)
+    return (dtz + 100 * (wdl == TB_BLESSED_LOSS || wdl == TB_CURSED_WIN))
+      * Sign(wdl);
+
+  // The table only has the other side to move, so the best move is found
+  // by a one ply search.
+  end = generate_moves(pos, moves);
+  for(m = moves; m < end; m++) {
+    if(!move_is_legal(pos, m->move)) continue;
+    zeroing = MvCapture(m->move) || MvPiece(m->move) == PAWN;
+    make_move(pos, m->move, u);
+    dtz = zeroing? -dtz_before_zeroing(search(pos, false, state))
+      : -probe_dtz(pos, state);
+    if(dtz == 1 && pos->check && count_legal_moves(pos) == 0)
+      min_dtz = 1;
+    if(!zeroing)
+      dtz += Sign(dtz);
+    if(dtz < min_dtz && Sign(dtz) == Sign(wdl))
+      min_dtz = dtz;
+    unmake_move(pos, m->move, u);
+    if(*state == PROBE_FAIL) return 0;
+  }
+  return (min_dtz == 0xFFFF)? -1 : min_dtz;
+}
+
+// The DTZ value of a position in which a capture or pawn move is best.
+
+static int dtz_before_zeroing(int wdl) {
+  switch(wdl) {
+  case TB_WIN: return 1;
+  case TB_CURSED_WIN: return 101;
+  case TB_BLESSED_LOSS: return -101;
+  case TB_LOSS: return -1;
+  default: return 0;
+  }
+}
+
+// sort_squares() sorts a few squares in ascending order, or by a mapping
+// of the squares if one is given.
+
+static void sort_squares(int squares[], int n, const int *order) {
+  int i, j, s;
+
+  for(i = 1; i < n; i++) {
+    s = squares[i];
+    for(j = i; j > 0 &&
+          (order? order[squares[j - 1]] > order[s] : squares[j - 1] > s); j--)
+      squares[j] = squares[j - 1];
+    squares[j] = s;
+  }
+}
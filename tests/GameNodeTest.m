@@ -0,0 +1,96 @@
+/*
+  Stockfish, a OS X GUI for the UCI chess engine with the same name.
+  Copyright (C) 2004-2011 Marco Costalba, Joona Kiiski, Tord Romstad
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// Checks the move numbers in the move list of games starting with black to
+// move, both for games loaded from PGN (whose nodes are created lazily from
+// a PGNMoveTree) and for games built move by move, and the loading of deeply
+// nested variations. Built and run by tests/run-tests.sh (Mac OS X only).
+
+#import <Cocoa/Cocoa.h>
+
+#import "ChessMove.h"
+#import "ChessPosition.h"
+#import "Game.h"
+
+#define BLACK_TO_MOVE_FEN \
+  @"rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 1"
+
+#define NESTED_PGN \
+  @"[Event \"?\"]\n\n1. e4 (1. d4 (1. c4 (1. Nf3 (1. g3 (1. b3 " \
+  @"(1. f4)))))) e5 2. Nf3 Nc6 *\n"
+
+static int failures = 0;
+
+static void check(NSString *what, NSString *found, NSString *expected) {
+  found = [found stringByTrimmingCharactersInSet:
+		   [NSCharacterSet whitespaceAndNewlineCharacterSet]];
+  if(![found isEqualToString: expected]) {
+    NSLog(@"%@: expected \"%@\", found \"%@\"", what, expected, found);
+    failures++;
+  }
+}
+
+static void checkMoveList(NSString *what, Game *game, NSString *expected) {
+  check([what stringByAppendingString: @", move list"],
+	[[game moveListAttributedStringWithComments: NO variations: NO]
+	  string],
+	expected);
+  check([what stringByAppendingString: @", PGN movetext"],
+	[game moveListStringWithComments: NO variations: NO],
+	expected);
+}
+
+int main(int argc, char *argv[]) {
+  NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+  NSArray *moves = [NSArray arrayWithObjects: @"e5", @"Nf3", @"Nc6", @"Bb5",
+			    nil];
+  NSString *expected = @"1... e5 2. Nf3 Nc6 3. Bb5";
+  NSString *pgn =
+    [NSString stringWithFormat:
+		@"[Event \"?\"]\n[SetUp \"1\"]\n[FEN \"%@\"]\n\n%@ *\n",
+	      BLACK_TO_MOVE_FEN, expected];
+  Game *game;
+  int i;
+
+  [ChessPosition class];  // Initializes the move generator
+
+  game = [[Game alloc] initWithPGNString: pgn];
+  checkMoveList(@"Game loaded from PGN", game, expected);
+  [game release];
+
+  game = [[Game alloc] initWithFEN: BLACK_TO_MOVE_FEN];
+  for(i = 0; i < [moves count]; i++)
+    [game makeMove: [game parseSANMove: [moves objectAtIndex: i]]];
+  checkMoveList(@"Game built move by move", game, expected);
+  [game release];
+
+  // Variations nested deeper than the parser's first frames:
+  game = [[Game alloc] initWithPGNString: NESTED_PGN];
+  checkMoveList(@"Game with nested variations", game, @"1. e4 e5 2. Nf3 Nc6");
+  if([[game moveListStringWithComments: NO variations: YES]
+	rangeOfString: @"1. f4"].location == NSNotFound) {
+    NSLog(@"Game with nested variations: innermost variation missing");
+    failures++;
+  }
+  [game release];
+
+  [pool release];
+  if(failures == 0) printf("All tests passed\n");
+  return failures == 0? 0 : 1;
+}
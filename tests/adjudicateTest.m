@@ -0,0 +1,78 @@
+/*
+  Stockfish, a OS X GUI for the UCI chess engine with the same name.
+  Copyright (C) 2004-2011 Marco Costalba, Joona Kiiski, Tord Romstad
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// Checks tablebase adjudication against the 50 move counter of the game: a
+// won position is a draw when the plies to the next capture or pawn move
+// (its DTZ) and the plies already on the counter add up to more than 100.
+// Needs the 3-piece Syzygy tables (KQvK.rtbw and KQvK.rtbz), in the directory
+// given as argument or in $SYZYGY_PATH; without them the test is skipped.
+// Built and run by tests/run-tests.sh.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "adjudicate.h"
+#include "syzygy.h"
+
+static int failures = 0;
+
+static void check(const char *fen, bool tablebases, int expected) {
+  adjudication_rules_t rules = { 0, 0, 0, 0, 0, tablebases };
+  position_t pos[1];
+  int found;
+
+  position_from_fen(pos, fen);
+  found = adjudication_by_tablebase(&rules, pos);
+  if(found != expected) {
+    printf("%s: expected \"%s\", found \"%s\"\n", fen,
+           adjudication_reason(expected), adjudication_reason(found));
+    failures++;
+  }
+}
+
+int main(int argc, char *argv[]) {
+  const char *path = argc > 1? argv[1] : getenv("SYZYGY_PATH");
+
+  if(path == NULL || *path == '\0') {
+    printf("Skipped: no Syzygy path given\n");
+    return 0;
+  }
+  init();
+  tb_init(path);
+  if(tb_max_pieces() < 3) {
+    printf("Skipped: no 3-piece tablebases in %s\n", path);
+    tb_free();
+    return 0;
+  }
+
+  check("8/8/8/4k3/8/8/8/KQ6 w - - 0 1", false, ADJUDICATE_NONE);
+  check("8/8/8/4k3/8/8/8/KQ6 w - - 0 1", true,
+        ADJUDICATE_TABLEBASE_WHITE_WINS);
+  check("8/8/8/4k3/8/8/8/KQ6 b - - 0 1", true,
+        ADJUDICATE_TABLEBASE_WHITE_WINS);
+  check("8/8/8/4k3/8/8/8/KQ6 w - - 95 60", true, ADJUDICATE_TABLEBASE_DRAW);
+  check("8/8/8/4k3/8/8/8/KQ6 b - - 95 60", true, ADJUDICATE_TABLEBASE_DRAW);
+  check("k7/8/1K6/8/8/8/7Q/8 w - - 99 80", true,
+        ADJUDICATE_TABLEBASE_WHITE_WINS);
+  check("8/8/8/4K3/8/8/8/kq6 b - - 95 60", true, ADJUDICATE_TABLEBASE_DRAW);
+
+  tb_free();
+  if(failures == 0) printf("All tests passed\n");
+  return failures != 0;
+}
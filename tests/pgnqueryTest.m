@@ -0,0 +1,101 @@
+/*
+  Stockfish, a OS X GUI for the UCI chess engine with the same name.
+  Copyright (C) 2004-2011 Marco Costalba, Joona Kiiski, Tord Romstad
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// Checks the tag, position and material conditions of PGN queries. Built
+// and run by tests/run-tests.sh.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "pgnquery.h"
+
+#define GAME \
+  "[Event \"Casual\"]\n[White \"Anderssen, A.\"]\n[Black \"Kieseritzky\"]\n" \
+  "\n1. e4 e5 2. f4 exf4 3. Bc4 Qh4+ 4. Kf1 *\n"
+
+// White has a pawn less after 2... exf4:
+#define PAWN_DOWN_FEN "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPP1/RNBQKBNR w - - 0 1"
+
+static int failures = 0;
+static pgn_game_t game[1];
+
+static void check(const char *what, const pgn_query_t *query, bool expected) {
+  if(pgn_query_match(query, GAME, strlen(GAME), game) != expected) {
+    printf("%s: expected %s\n", what, expected? "a match" : "no match");
+    failures++;
+  }
+}
+
+static void check_fen(const char *what, const char *fen, bool material,
+                      bool expected) {
+  pgn_query_t query[1];
+  position_t pos[1];
+
+  position_from_fen(pos, fen);
+  pgn_query_init(query);
+  if(material) pgn_query_set_material(query, pos);
+  else pgn_query_set_position(query, pos);
+  check(what, query, expected);
+}
+
+static void check_tag(const char *what, const char *name, const char *value,
+                      bool expected) {
+  pgn_query_t query[1];
+
+  pgn_query_init(query);
+  pgn_query_add_tag(query, name, value);
+  check(what, query, expected);
+}
+
+int main(int argc, char *argv[]) {
+  pgn_query_t query[1];
+  position_t pos[1];
+
+  init();
+
+  check_tag("White tag", "White", "anderssen", true);
+  check_tag("Black tag", "Black", "anderssen", false);
+  check_tag("Any tag", "", "kiESER", true);
+  check_tag("Missing tag", "Site", "", false);
+
+  check_fen("Position after 2. f4",
+            "rnbqkbnr/pppp1ppp/8/4p3/4PP2/8/PPPP2PP/RNBQKBNR b KQkq - 0 2",
+            false, true);
+  check_fen("Final position",
+            "rnb1kbnr/pppp1ppp/8/8/2B1Pp1q/8/PPPP2PP/RNBQ1KNR b kq - 3 4",
+            false, true);
+  check_fen("Position with the other side to move",
+            "rnbqkbnr/pppp1ppp/8/4p3/4PP2/8/PPPP2PP/RNBQKBNR w KQkq - 0 2",
+            false, false);
+  check_fen("Material after 2... exf4", PAWN_DOWN_FEN, true, true);
+  check_fen("Material never reached", "4k3/8/8/8/8/8/8/4K3 w - - 0 1",
+            true, false);
+
+  // All conditions must be met:
+  pgn_query_init(query);
+  position_from_fen(pos, PAWN_DOWN_FEN);
+  pgn_query_set_material(query, pos);
+  pgn_query_add_tag(query, "Event", "casual");
+  check("Material and tag", query, true);
+  pgn_query_add_tag(query, "Event", "olympiad");
+  check("Material and wrong tag", query, false);
+
+  if(failures == 0) printf("All tests passed\n");
+  return failures != 0;
+}
@@ -0,0 +1,137 @@
+/*
+  Stockfish, a OS X GUI for the UCI chess engine with the same name.
+  Copyright (C) 2004-2011 Marco Costalba, Joona Kiiski, Tord Romstad
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// Writes a BGZF file and reads it back through pgn_source_t, both in one
+// sequential pass and after seeks. Built and run by tests/run-tests.sh.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include "pgnsource.h"
+
+#define TEXT_SIZE (1 << 20)
+#define BLOCK_SIZE 60000
+
+static int failures = 0;
+
+static void put16(FILE *f, unsigned n) {
+  fputc(n & 0xff, f); fputc(n >> 8, f);
+}
+
+static void put32(FILE *f, unsigned long n) {
+  put16(f, n & 0xffff); put16(f, n >> 16);
+}
+
+// Writes one BGZF member: a gzip member whose extra field holds the size of
+// the whole member minus one.
+
+static void write_member(FILE *f, const unsigned char *data, size_t length) {
+  static const unsigned char header[] = {
+    0x1f, 0x8b, 8, 4, 0, 0, 0, 0, 0, 0xff, 6, 0, 'B', 'C', 2, 0
+  };
+  unsigned char out[BLOCK_SIZE + 1024];
+  z_stream zs;
+  size_t size;
+
+  memset(&zs, 0, sizeof(z_stream));
+  deflateInit2(&zs, 6, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY);
+  zs.next_in = (Bytef *)data;
+  zs.avail_in = length;
+  zs.next_out = out;
+  zs.avail_out = sizeof(out);
+  deflate(&zs, Z_FINISH);
+  size = sizeof(out) - zs.avail_out;
+  deflateEnd(&zs);
+
+  fwrite(header, 1, sizeof(header), f);
+  put16(f, sizeof(header) + 2 + size + 8 - 1);
+  fwrite(out, 1, size, f);
+  put32(f, crc32(0, data, length));
+  put32(f, length);
+}
+
+static void check_read(pgn_source_t *src, const unsigned char *text,
+                       int64_t offset, size_t n) {
+  unsigned char buf[4096];
+
+  if(pgn_source_seek(src, offset) != 0) {
+    printf("Seek to %lld failed\n", (long long)offset);
+    failures++;
+  }
+  else if(pgn_source_read(src, buf, n) != n || memcmp(buf, text + offset, n)) {
+    printf("Read at %lld differs\n", (long long)offset);
+    failures++;
+  }
+}
+
+int main(int argc, char *argv[]) {
+  char filename[] = "/tmp/pgnsource-test-XXXXXX";
+  unsigned char *text, *copy;
+  pgn_source_t src[1];
+  size_t i, n;
+  FILE *f;
+  int fd;
+
+  text = malloc(TEXT_SIZE);
+  copy = malloc(TEXT_SIZE + 1);
+  srand(1);
+  for(i = 0; i < TEXT_SIZE; i++)
+    text[i] = "1. e4 e5 2. Nf3 Nc6 3. Bb5 a6\n"[rand() % 30];
+
+  fd = mkstemp(filename);
+  f = fdopen(fd, "wb");
+  for(i = 0; i < TEXT_SIZE; i += BLOCK_SIZE)
+    write_member(f, text + i, TEXT_SIZE - i < BLOCK_SIZE?
+                 TEXT_SIZE - i : BLOCK_SIZE);
+  write_member(f, text, 0); // End of file marker
+  fclose(f);
+
+  if(pgn_source_open(src, filename) != 0) {
+    printf("Can't open %s\n", filename);
+    unlink(filename);
+    return 1;
+  }
+  if(src->format != PGN_SOURCE_BGZF) {
+    printf("File not recognized as BGZF\n");
+    failures++;
+  }
+
+  for(i = 0; (n = pgn_source_read(src, copy + i, 8192)) > 0; i += n)
+    if(i + n > TEXT_SIZE) break;
+  if(i != TEXT_SIZE || memcmp(copy, text, TEXT_SIZE)) {
+    printf("Sequential read differs: %zu of %d bytes\n", i, TEXT_SIZE);
+    failures++;
+  }
+
+  check_read(src, text, 12345, 1000);
+  check_read(src, text, TEXT_SIZE - 100, 100);
+  check_read(src, text, BLOCK_SIZE - 10, 20);
+  check_read(src, text, 3 * BLOCK_SIZE + 7, 4096);
+
+  pgn_source_close(src);
+  unlink(filename);
+  free(text);
+  free(copy);
+
+  printf("%s\n", failures? "FAILED" : "All tests passed");
+  return failures? 1 : 0;
+}
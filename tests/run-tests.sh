@@ -0,0 +1,52 @@
+#!/bin/sh
+#
+# Builds and runs the unit tests in this directory. Run from anywhere with
+#
+#   tests/run-tests.sh [<syzygy dir>]
+#
+# The tablebase adjudication test uses the given directory, or $SYZYGY_PATH,
+# and is skipped when neither holds the 3-piece Syzygy tables. The GameNode
+# test needs Cocoa and is skipped on other systems. Extra compiler flags can
+# be passed in $CFLAGS.
+
+cd "$(dirname "$0")/.." || exit 1
+
+CC=${CC:-cc}
+BUILD=$(mktemp -d "${TMPDIR:-/tmp}/stockfish-tests.XXXXXX") || exit 1
+trap 'rm -rf "$BUILD"' EXIT
+failed=0
+
+# run <name> <compiler arguments...>
+run() {
+  name=$1
+  shift
+  echo "== $name"
+  if ! $CC $CFLAGS -I. -o "$BUILD/$name" "$@"; then
+    echo "$name: build failed"
+    failed=1
+  elif ! "$BUILD/$name" $TEST_ARGS; then
+    echo "$name: FAILED"
+    failed=1
+  fi
+  TEST_ARGS=
+}
+
+run pgnsource-test -x c tests/pgnsourceTest.m pgnsource.m pgnscan.m \
+  position.m mersenne.m -lz -lpthread -lm
+run pgnquery-test -x c tests/pgnqueryTest.m pgnquery.m pgnscan.m \
+  position.m mersenne.m -lpthread -lm
+TEST_ARGS=$1
+run adjudicate-test -x c tests/adjudicateTest.m adjudicate.m syzygy.m \
+  position.m mersenne.m -lpthread -lm
+
+if [ "$(uname)" = Darwin ]; then
+  run gamenode-test -framework Cocoa tests/GameNodeTest.m Game.m \
+    GameNode.m GameParser.m PGNMoveTree.m ChessMove.m ChessPosition.m \
+    ChessClock.m MyNSAttributedStringAdditions.m \
+    MyNSMutableAttributedStringAdditions.m pgnscan.m position.m mersenne.m
+else
+  echo "== gamenode-test"
+  echo "Skipped: needs Cocoa"
+fi
+
+exit $failed
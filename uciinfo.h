@@ -0,0 +1,92 @@
+/*
+  Stockfish, a OS X GUI for the UCI chess engine with the same name.
+  Copyright (C) 2004-2011 Marco Costalba, Joona Kiiski, Tord Romstad
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+/*
+  Parsing of the UCI "info" command.  The arguments are read in a single
+  pass into a uci_info_t, with the moves of the current move and the
+  principal variation converted to move_t for the position the engine is
+  searching.  The fields which were present are marked in info->fields;
+  everything after "string" is ignored.
+*/
+
+
+#if !defined(UCIINFO_H_INCLUDED)
+#define UCIINFO_H_INCLUDED
+
+////
+//// Includes
+////
+
+#include "position.h"
+
+
+////
+//// Constants and macros
+////
+
+#define UCI_INFO_MAX_PV 128
+
+enum {
+  UCI_INFO_DEPTH = 1,
+  UCI_INFO_SELDEPTH = 2,
+  UCI_INFO_TIME = 4,
+  UCI_INFO_NODES = 8,
+  UCI_INFO_NPS = 16,
+  UCI_INFO_SCORE = 32,
+  UCI_INFO_MULTIPV = 64,
+  UCI_INFO_CURRMOVE = 128,
+  UCI_INFO_HASHFULL = 256,
+  UCI_INFO_PV = 512
+};
+
+enum {
+  UCI_SCORE_CP, UCI_SCORE_MATE
+};
+
+
+////
+//// Types
+////
+
+typedef struct uci_info_t {
+  int fields;            // UCI_INFO_* flags of the fields present
+  int depth, seldepth;
+  int time;              // Milliseconds
+  int64_t nodes, nps;
+  int score_type;        // UCI_SCORE_CP or UCI_SCORE_MATE
+  int score;             // Centipawns or moves to mate, side to move's view
+  int bound;             // -1 lower bound, 0 exact, 1 upper bound
+  int multipv;
+  move_t currmove;
+  int currmovenumber;
+  int hashfull;
+  int pv_length;
+  move_t pv[UCI_INFO_MAX_PV];
+} uci_info_t;
+
+
+////
+//// Functions
+////
+
+extern bool uci_parse_info(const position_t *pos, const char *args,
+                           int length, uci_info_t *info);
+
+
+#endif // !defined(UCIINFO_H_INCLUDED)
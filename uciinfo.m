@@ -0,0 +1,213 @@
+/*
+  Stockfish, a OS X GUI for the UCI chess engine with the same name.
+  Copyright (C) 2004-2011 Marco Costalba, Joona Kiiski, Tord Romstad
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+////
+//// Includes
+////
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "uciinfo.h"
+
+
+////
+//// Local definitions
+////
+
+typedef struct tokenizer_t {
+  const char *next, *end;
+  const char *token;
+  int length;
+} tokenizer_t;
+
+static bool next_token(tokenizer_t *t);
+static bool token_is(const tokenizer_t *t, const char *word);
+static bool token_number(tokenizer_t *t, int64_t *value);
+static move_t token_move(const tokenizer_t *t, position_t *pos);
+
+
+////
+//// Functions
+////
+
+// Parses the arguments of an info command (the line without "info").
+// Returns false if nothing was recognized.
+
+bool uci_parse_info(const position_t *pos, const char *args, int length,
+                    uci_info_t *info) {
+  tokenizer_t t[1];
+  position_t p[1];
+  undo_info_t undo[UCI_INFO_MAX_PV];
+  bool copied = false, pending;
+  int64_t value;
+  move_t m;
+  int type, i;
+
+  info->fields = 0;
+  info->currmovenumber = 0;
+  info->pv_length = 0;
+  t->next = args;
+  t->end = args + length;
+
+  pending = next_token(t);
+  while(pending) {
+    pending = false;
+    if(token_is(t, "depth") && token_number(t, &value)) {
+      info->depth = value;
+      info->fields |= UCI_INFO_DEPTH;
+    }
+    else if(token_is(t, "seldepth") && token_number(t, &value)) {
+      info->seldepth = value;
+      info->fields |= UCI_INFO_SELDEPTH;
+    }
+    else if(token_is(t, "time") && token_number(t, &value)) {
+      info->time = value;
+      info->fields |= UCI_INFO_TIME;
+    }
+    else if(token_is(t, "nodes") && token_number(t, &value)) {
+      info->nodes = value;
+      info->fields |= UCI_INFO_NODES;
+    }
+    else if(token_is(t, "nps") && token_number(t, &value)) {
+      info->nps = value;
+      info->fields |= UCI_INFO_NPS;
+    }
+    else if(token_is(t, "multipv") && token_number(t, &value)) {
+      info->multipv = value;
+      info->fields |= UCI_INFO_MULTIPV;
+    }
+    else if(token_is(t, "hashfull") && token_number(t, &value)) {
+      info->hashfull = value;
+      info->fields |= UCI_INFO_HASHFULL;
+    }
+    else if(token_is(t, "currmovenumber") && token_number(t, &value))
+      info->currmovenumber = value;
+    else if(token_is(t, "score") && next_token(t)) {
+      if(token_is(t, "cp") || token_is(t, "mate")) {
+        type = token_is(t, "cp")? UCI_SCORE_CP : UCI_SCORE_MATE;
+        if(token_number(t, &value)) {
+          info->score_type = type;
+          info->score = value;
+          info->bound = 0;
+          info->fields |= UCI_INFO_SCORE;
+          if((pending = next_token(t)) && token_is(t, "lowerbound"))
+            info->bound = -1, pending = false;
+          else if(pending && token_is(t, "upperbound"))
+            info->bound = 1, pending = false;
+        }
+      }
+      else
+        pending = true;
+    }
+    else if(token_is(t, "currmove") && next_token(t)) {
+      if(!copied) copy_position(p, pos), copied = true;
+      if((m = token_move(t, p)) != NoMove) {
+        info->currmove = m;
+        info->fields |= UCI_INFO_CURRMOVE;
+      }
+    }
+    else if(token_is(t, "pv")) {
+      // The moves are played on the copy of the position to parse the
+      // next one, and taken back afterwards. The PV should be the last
+      // field, so parsing stops if it is too long.
+      if(!copied) copy_position(p, pos), copied = true;
+      info->fields |= UCI_INFO_PV;
+      while((pending = next_token(t)) && (m = token_move(t, p)) != NoMove) {
+        if(info->pv_length == UCI_INFO_MAX_PV ||
+           p->gply >= MAX_GAME_LENGTH - 1) {
+          t->next = t->end;
+          pending = false;
+          break;
+        }
+        if(m == NullMove) make_nullmove(p, undo + info->pv_length);
+        else make_move(p, m, undo + info->pv_length);
+        info->pv[info->pv_length++] = m;
+      }
+      for(i = info->pv_length - 1; i >= 0; i--) {
+        if(info->pv[i] == NullMove) unmake_nullmove(p, undo + i);
+        else unmake_move(p, info->pv[i], undo + i);
+      }
+    }
+    else if(token_is(t, "string"))
+      break;
+
+    if(!pending) pending = next_token(t);
+  }
+  return info->fields != 0;
+}
+
+
+static bool next_token(tokenizer_t *t) {
+  while(t->next < t->end && (*t->next == ' ' || *t->next == '\t'))
+    t->next++;
+  if(t->next == t->end) return false;
+  t->token = t->next;
+  while(t->next < t->end && *t->next != ' ' && *t->next != '\t')
+    t->next++;
+  t->length = t->next - t->token;
+  return true;
+}
+
+
+static bool token_is(const tokenizer_t *t, const char *word) {
+  return strncmp(t->token, word, t->length) == 0 && word[t->length] == '\0';
+}
+
+
+// Reads the next token as a number. On failure, the token is left for
+// the caller to read again.
+
+static bool token_number(tokenizer_t *t, int64_t *value) {
+  const char *c, *saved = t->next;
+  bool negative = false;
+
+  if(!next_token(t)) return false;
+  c = t->token;
+  if(*c == '-' || *c == '+') negative = (*c++ == '-');
+  if(c == t->token + t->length) {
+    t->next = saved;
+    return false;
+  }
+  for(*value = 0; c < t->token + t->length; c++) {
+    if(*c < '0' || *c > '9') {
+      t->next = saved;
+      return false;
+    }
+    *value = *value * 10 + (*c - '0');
+  }
+  if(negative) *value = -*value;
+  return true;
+}
+
+
+// Returns the move in coordinate notation in the current token, NullMove
+// for "0000", or NoMove if the token is not a legal move.
+
+static move_t token_move(const tokenizer_t *t, position_t *pos) {
+  char str[8];
+  move_t m;
+
+  if(t->length < 4 || t->length > 5) return NoMove;
+  memcpy(str, t->token, t->length);
+  str[t->length] = '\0';
+  if(strcmp(str, "0000") == 0) return NullMove;
+  m = parse_move(pos, str);
+  return (m == NullMove)? NoMove : m;
+}